@@ -1,7 +1,11 @@
 type:   shdr    self            write_Shader    read_Shader
 type:   mesh    self            write_Mesh      read_Mesh
 type:   skel    self            write_Skel      read_Skel
+type:   anim    self            write_Anim      read_Anim
+map:    mesh    self            pack_Mesh       map_Mesh
+map:    skel    self            pack_Skel       map_Skel
 import: shdr    .vert           self    import_Shader
 import: shdr    .frag           self    import_Shader
 import: skel    .md5mesh        self    import_MD5
+import: anim    .md5anim        self    import_MD5anim
 import: mesh    .obj            self    import_Obj
@@ -34,6 +34,19 @@
 
 #endif
 
+// Instruction sets
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#define feature_SSE2
+
+#endif
+
+#if defined(__AVX__)
+
+#define feature_AVX
+
+#endif
+
 // Platform specific
 #if defined(__linux__)
 
@@ -0,0 +1,70 @@
+#ifndef __data_hash64_h__
+#define __data_hash64_h__
+
+#include "core.types.h"
+
+// Fast 64-bit hashes, for hash tables and content keys; not for anything
+// cryptographic.
+//
+// hash64 hashes a byte string. It reads the key 8 bytes at a time and
+// mixes with 64x64->128 bit multiplies, so short keys cost a handful of
+// instructions and long ones run at several bytes per cycle.
+//
+// hash64_u32, hash64_u64 and hash64_ptr mix a single integer; use them for
+// keys that are a handle, an id or a pointer. They do not give the same
+// result as hash64 of the same bytes.
+//
+// The Hash64 streaming API hashes a key that arrives in pieces; the result
+// is the same as hash64 of all the pieces concatenated.
+
+// Hash `len` bytes at `key`
+uint64 hash64( const void* key, size_t len, uint64 seed );
+
+// Integer mixers (the MurmurHash3 finalizer)
+static inline
+uint64 hash64_u64( uint64 x ) {
+
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+
+	return x;
+
+}
+
+static inline
+uint64 hash64_u32( uint32 x ) {
+
+	return hash64_u64( x );
+
+}
+
+static inline
+uint64 hash64_ptr( const void* p ) {
+
+	return hash64_u64( (uint64)(uintptr_t)p );
+
+}
+
+// Streaming
+typedef struct Hash64 Hash64;
+struct Hash64 {
+
+	uint64 seed;
+	uint64 see1, see2;  // Extra lanes, once more than 48 bytes have come in
+	bool   wide;
+
+	uint64 len;         // Total bytes so far
+
+	int    count;       // Bytes in `buf` not yet hashed
+	uint8  buf[16 + 96]; // Last 16 bytes hashed, then the ones not yet
+
+};
+
+void   init_Hash64( Hash64* h, uint64 seed );
+void update_Hash64( Hash64* h, const void* data, size_t len );
+uint64  final_Hash64( const Hash64* h );
+
+#endif
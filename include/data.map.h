@@ -4,6 +4,9 @@
 #include "core.types.h"
 #include "mm.zone.h" 
 
+// Hash maps from byte-string keys to pointers. Keys are copied into the map,
+// so they need not outlive the call that inserts them. See data.map.c.
+
 typedef struct Map Map;
 
 // Instantiation
@@ -17,9 +20,16 @@ pointer   lookup_Map( const Map* map, int len, const pointer key );
 bool    contains_Map( const Map* map, int len, const pointer key );
 
 // Mutators
+
+// Map `key` to `value`. Returns the value previously mapped to `key` if 
+// there was one, otherwise `value`.
 pointer      put_Map( Map* map, int len, const pointer key, pointer value );
+
+// Returns the value that was mapped to `key`, or NULL
 pointer   remove_Map( Map* map, int len, const pointer key );
 
+// Iteration, in no particular order. Returns NULL once past the last entry;
+// the map must not be modified while iterating.
 pointer    first_Map( Map* map );
 pointer     next_Map( Map* map, pointer kv );
 pointer      key_Map( pointer kv );
@@ -0,0 +1,143 @@
+#ifndef __data_pool_h__
+#define __data_pool_h__
+
+#include <stdlib.h> // NULL
+
+#include "core.types.h"
+#include "mm.region.h"
+
+// Pools are doubly linked lists whose items live packed in a slab owned by
+// the list, linked by 32-bit indices instead of pointers. They take the
+// place of List where a list is walked or churned often: the items sit next
+// to each other in memory instead of one per region allocation, and freed
+// items are recycled from a free list instead of being left behind in the
+// region.
+//
+// The slab is a single array which doubles in size when it runs out of
+// room. The index of an item is stable for as long as it is allocated, but
+// growing moves the items: a pointer to an item is only good until the next
+// call to new_Pool_item. Keep indices, or copy the value out, across that.
+//
+// As with List, items are allocated with new_Pool_item and then linked
+// with one of the push or insert functions; an item removed from the list
+// stays allocated until it is handed back with free_Pool_item. All storage
+// comes from the pool's region and is released when the region is. Given a
+// NULL region, new_Pool makes one of its own, which delete_Pool frees;
+// delete_Pool leaves a region passed in to its owner.
+
+#define nilPool        0xffffffff
+
+#define poolMinCapacity 16
+
+// Types
+
+typedef struct Pool_Node Pool_Node;
+struct Pool_Node {
+
+	uint32 prev;
+	uint32 next;
+	uint32 self;    // Index of this node
+	uint32 pad;
+
+	uchar  value[];
+
+};
+
+typedef struct Pool Pool;
+struct Pool {
+
+	region_p R;
+	bool     ownsR;           // R was made by new_Pool, and goes with the pool
+	uint     li_size;
+	uint     stride;
+
+	uint32   head;
+	uint32   tail;
+	uint     size;            // Items linked into the list
+
+	uint32   free;            // Free list of items, linked through `next'
+	uint32   used;            // Items ever allocated; index of the next new one
+	uint32   capacity;
+
+	uint8*   items;
+
+};
+
+// Instantiation
+Pool*          new_Pool( region_p R, uint li_size );
+void        delete_Pool( Pool* pool );
+
+pointer        new_Pool_item( Pool* pool );
+void          free_Pool_item( Pool* pool, pointer li );
+
+// Functions
+uint          size_Pool( const Pool* pool );
+uint32       index_Pool( const Pool* pool, const pointer li );
+
+pointer       last_Pool( const Pool* pool );
+pointer       prev_Pool( const Pool* pool, const pointer li );
+
+// Mutators
+pointer  pop_front_Pool( Pool* pool );
+pointer   pop_back_Pool( Pool* pool );
+void    push_front_Pool( Pool* pool, pointer li );
+void     push_back_Pool( Pool* pool, pointer li );
+void insert_before_Pool( Pool* pool, pointer before, pointer li );
+void        remove_Pool( Pool* pool, pointer li );
+
+// Inline functions, used when walking a pool
+
+static inline
+Pool_Node*     Pool_Node_item( const pointer li ) {
+
+	return (Pool_Node*)((uint8*)li - sizeof(Pool_Node));
+
+}
+
+// Returns the item at index `i'
+static inline
+pointer         at_Pool( const Pool* pool, uint32 i ) {
+
+	return ((Pool_Node*)( pool->items + (size_t)i * pool->stride ))->value;
+
+}
+
+static inline
+bool       isempty_Pool( const Pool* pool ) {
+
+	return nilPool == pool->head;
+
+}
+
+// NULL if the pool is empty
+static inline
+pointer      first_Pool( const Pool* pool ) {
+
+	return isempty_Pool(pool) ? NULL : at_Pool( pool, pool->head );
+
+}
+
+// NULL at the end of the list
+static inline
+pointer       next_Pool( const Pool* pool, const pointer li ) {
+
+	uint32 next = Pool_Node_item(li)->next;
+	return nilPool == next ? NULL : at_Pool( pool, next );
+
+}
+
+// Macros
+
+// Like find__List, except that `node' is NULL if no item satisfies `pred'
+#define      find__Pool( pool, node, pred ) \
+	do { \
+		(node) = first_Pool( (pool) ); \
+		while( NULL != (node) ) { \
+			if( pred ) { \
+				break; \
+			} \
+			(node) = next_Pool( (pool), (node) ); \
+		} \
+	} while( 0 )
+
+#endif
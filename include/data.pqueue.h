@@ -0,0 +1,66 @@
+#ifndef __data_pqueue_h__
+#define __data_pqueue_h__
+
+#include "core.types.h"
+#include "mm.zone.h"
+
+// Priority queues. A min-heap of items ordered by an unsigned 32-bit key,
+// e.g. a Job's deadline. Items with equal keys come out in the order they
+// were pushed.
+//
+// The heap is 4-ary and stored in a flat array of (key, seq, item) entries;
+// compared to a binary heap it is half as deep and the children of a node
+// sit next to each other in memory, so sifting touches fewer cache lines.
+//
+// The queue only stores pointers to the items; it does not own them.
+
+typedef struct Pqueue_Entry Pqueue_Entry;
+struct Pqueue_Entry {
+
+	uint32  key;
+	uint32  seq;   // Insertion order; breaks ties between equal keys
+
+	pointer item;
+
+};
+
+typedef struct Pqueue Pqueue;
+struct Pqueue {
+
+	zone_p        Z;
+
+	uint32        seq;
+
+	int           size;
+	int           capacity;
+
+	Pqueue_Entry* v;
+
+};
+
+// Instantiation
+Pqueue*       new_Pqueue( zone_p zone, int capacity );
+void       delete_Pqueue( Pqueue* q );
+
+// Functions
+uint         size_Pqueue( const Pqueue* q );
+
+// Returns the item with the least key, without removing it; NULL if empty
+pointer     first_Pqueue( const Pqueue* q );
+uint32  first_key_Pqueue( const Pqueue* q );
+
+// Predicates
+bool      isempty_Pqueue( const Pqueue* q );
+
+// Mutators
+void         push_Pqueue( Pqueue* q, uint32 key, pointer item );
+
+// Removes and returns the item with the least key; NULL if empty
+pointer       pop_Pqueue( Pqueue* q );
+
+// Removes and returns the last entry of the heap in O(1); NULL if empty.
+// This is a leaf, so it is never the least item unless it is the only one,
+// but otherwise no particular order is guaranteed.
+pointer  pop_back_Pqueue( Pqueue* q );
+
+#endif
@@ -27,4 +27,67 @@ int remaining_RINGBUF( ringbuf_p buf );
 // write is performed.
 int available_RINGBUF( ringbuf_p buf );
 
+// Zero-copy access. Returns a pointer to the bytes that can be read (written)
+// in one contiguous run, i.e. up to the point where the buffer wraps, and 
+// stores how many in `len'. Follow with commit_read_RINGBUF 
+// (commit_write_RINGBUF) giving the number of bytes actually consumed 
+// (produced); the rest stay where they are.
+pointer   read_span_RINGBUF( ringbuf_p buf, uint16* len );
+void    commit_read_RINGBUF( ringbuf_p buf, uint16 len );
+pointer  write_span_RINGBUF( ringbuf_p buf, uint16* len );
+void   commit_write_RINGBUF( ringbuf_p buf, uint16 len );
+
+// Lock-free rings ////////////////////////////////////////////////////////////
+//
+// Unlike ringbuf_t, which is a byte stream and must be locked by the caller,
+// these rings hold `count' fixed-size messages of `size' bytes and are safe
+// to use from several threads at once without a lock. Every read and write
+// moves exactly one message.
+//
+// lfringSPSC is for exactly one writer thread and one reader thread at a
+// time, and costs no atomic read-modify-write at all. lfringMPMC allows any
+// number of writers and readers; each slot carries a sequence number that
+// tells writers and readers whether it is theirs to fill or drain.
+//
+// `count' is rounded up to a power of two.
+
+typedef enum {
+
+	lfringSPSC,
+	lfringMPMC
+
+} lfringMode_e;
+
+typedef struct lfring_s lfring_t;
+typedef lfring_t* lfring_p;
+
+lfring_p new_LFRING( lfringMode_e mode, uint16 size, uint16 count );
+void destroy_LFRING( lfring_p ring );
+
+// Writes one message from `data`. Returns the message size on success or -1
+// if the ring is full. If `was_empty' is not NULL it is set when readers had
+// drained everything before this message, i.e. a reader may be waiting for it.
+int      write_LFRING( lfring_p ring, const pointer data, bool* was_empty );
+
+// Reads one message into `dest`. Returns the message size on success or -1
+// if the ring is empty. If `was_full' is not NULL it is set when a writer may
+// have found the ring full just before this read.
+int       read_LFRING( lfring_p ring, pointer dest, bool* was_full );
+
+// Number of messages that can currently be read/written. These are snapshots
+// only; other threads may change them at any time.
+int  available_LFRING( lfring_p ring );
+int  remaining_LFRING( lfring_p ring );
+
+// Zero-copy access, lfringSPSC only; the reader (writer) side may only be 
+// used from the single reader (writer) thread. Returns a pointer to the 
+// messages that can be read (written) in one contiguous run and stores how 
+// many in `count'. Follow with commit_read_LFRING (commit_write_LFRING) 
+// giving the number of messages actually consumed (produced). `was_full' 
+// and `was_empty' are as for read_LFRING and write_LFRING.
+pointer   read_span_LFRING( lfring_p ring, int* count );
+void    commit_read_LFRING( lfring_p ring, int count, bool* was_full );
+pointer  write_span_LFRING( lfring_p ring, int* count );
+void   commit_write_LFRING( lfring_p ring, int count, bool* was_empty );
+
 #endif
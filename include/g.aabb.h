@@ -12,6 +12,15 @@ typedef struct {
 
 } AABB;
 
+// Boxes by component, for testing many at once: box i runs from
+// (min_x[i], min_y[i], min_z[i]) to (max_x[i], max_y[i], max_z[i])
+typedef struct {
+
+	const float *min_x, *min_y, *min_z;
+	const float *max_x, *max_y, *max_z;
+
+} AABB_SoA;
+
 bool inside_AABB( AABB *aabb, float4 pt );
 
 bool intersects_AABB( AABB *aabb, AABB *other );
@@ -0,0 +1,61 @@
+#ifndef __g_bvh_H__
+#define __g_bvh_H__
+
+#include "core.types.h"
+#include "g.aabb.h"
+#include "math.vec.h"
+#include "mm.zone.h"
+#include "r.xform.h"
+
+// A dynamic bounding volume hierarchy over the bounds of tagged objects,
+// for culling and picking.
+//
+// A leaf holds the local bounds of an object (say Mesh::bounds), the Xform
+// placing it and a tag; its world bounds are the local bounds transformed
+// by the world matrix. Leaves are inserted where they add the least surface
+// area to the tree, and removed by collapsing their parent.
+//
+// When the transform of a leaf changes, tell the tree with move_Bvh;
+// refit_Bvh then recomputes the bounds of the moved leaves and of their
+// ancestors, leaving the shape of the tree as it is. Refitting is cheap but
+// the tree gets looser as things move far; rebuild_Bvh builds it again from
+// scratch, top-down.
+//
+// Leaves and the nodes above them are named by int32 ids, which stay valid
+// until the leaf is removed.
+
+typedef struct Bvh Bvh;
+
+// Instantiation
+Bvh*         new_Bvh( zone_p Z );
+void      delete_Bvh( Bvh* bvh );
+
+// Functions
+uint        size_Bvh( const Bvh* bvh );
+pointer      tag_Bvh( const Bvh* bvh, int32 leaf );
+const AABB* bounds_Bvh( const Bvh* bvh, int32 leaf );
+
+// Mutators
+//
+// `xf' may be NULL, in which case `bounds' are in world space and never
+// move
+int32     insert_Bvh( Bvh* bvh, pointer tag, const AABB* bounds, Xform* xf );
+void      remove_Bvh( Bvh* bvh, int32 leaf );
+void        move_Bvh( Bvh* bvh, int32 leaf );
+void       refit_Bvh( Bvh* bvh );
+void     rebuild_Bvh( Bvh* bvh );
+
+// Queries
+//
+// cull_Bvh writes the tags of the leaves not wholly outside any of the
+// planes to `tags', up to `max' of them, and returns how many there are.
+// Planes are (a,b,c,d) with a point inside when ax + by + cz + d >= 0;
+// up to 8 of them are tested together.
+uint        cull_Bvh( Bvh* bvh, const float4* planes, int n_planes,
+                      pointer* tags, uint max );
+
+// The leaf whose bounds the ray from `origin' along `dir' enters first,
+// before `tmax', and where; -1 if none
+int32    raycast_Bvh( Bvh* bvh, float4 origin, float4 dir, float tmax, float* t );
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef __g_frustum_H__
+#define __g_frustum_H__
+
+#include "core.types.h"
+#include "g.aabb.h"
+#include "math.matrix.h"
+#include "math.vec.h"
+
+// View frustums, as the six planes bounding the clip volume of a
+// view-projection matrix, and culling of boxes against them.
+//
+// Planes are (a,b,c,d) with a point inside when ax + by + cz + d >= 0, and
+// normalized, so that this is the distance to the plane. They can be passed
+// as they are to cull_Bvh.
+//
+// classify_Frustum sorts arrays of boxes into those wholly inside, those
+// intersecting the frustum and those wholly outside, 8 boxes at a time with
+// AVX, 4 with SSE. A box is outside when it is behind one plane; it may
+// still be outside when it is behind none (near the edges of the frustum),
+// which only costs a draw.
+
+typedef enum {
+
+	frustumOutside    = -1,
+	frustumIntersects =  0,
+	frustumInside     =  1
+
+} frustumClass_e;
+
+typedef enum {
+
+	frustumLeft,
+	frustumRight,
+	frustumBottom,
+	frustumTop,
+	frustumNear,
+	frustumFar
+
+} frustumPlane_e;
+
+typedef struct Frustum Frustum;
+struct Frustum {
+
+	float4 planes[6];
+
+};
+
+// Of the matrix taking world space to clip space, e.g. projection * view
+Frustum   extract_Frustum( const mat44* viewproj );
+
+// Classifies boxes [first, first+n) into `out', one frustumClass_e each
+void     classify_Frustum( const Frustum* f, const AABB_SoA* boxes,
+                           uint first, uint n, int8* out );
+int8 classify_Frustum_AABB( const Frustum* f, const AABB* box );
+
+#endif
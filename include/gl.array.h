@@ -12,6 +12,9 @@ typedef struct Varray Varray;
 Varray* define_Varray( int n, ... );
 Varray*    new_Varray( int n, Vattrib* vattribs[] );
 Varray*    new_Varray_indexed( int n, Vindex* index, Vattrib* vattribs[] );
+// The n fields of `storage', at locations 0..n-1; the vertex array owns
+// the storage as it would separate attributes
+Varray*    new_Varray_interleaved( Vattrib* storage, int n, const Vfield fields[], Vindex* index );
 void    delete_Varray( Varray* varray );
 void      draw_Varray( Varray* varray, 
                        GLenum mode, 
@@ -23,5 +26,14 @@ void      draw_Varray_indexed( Vindex* indices,
                                GLsizeiptr first, 
                                GLsizei count );
 
+// As above, but with the vertex array already bound by bind_Varray; these
+// leave it bound, so that a run of draws from the same array binds it once
+void      bind_Varray( Varray* varray );
+void      draw_bound_Varray( GLenum mode, GLint first, GLsizei count );
+void      draw_bound_Varray_indexed( Vindex* indices,
+                                     Varray* varray,
+                                     GLenum mode,
+                                     GLsizeiptr first,
+                                     GLsizei count );
 
 #endif
@@ -20,6 +20,20 @@ struct Vattrib {
 	
 };
 
+// One attribute of an interleaved vertex: `offset' bytes into each vertex
+// of a single Vattrib whose stride is the size of the whole vertex
+typedef struct Vfield Vfield;
+struct Vfield {
+
+	const char* name;
+
+	short       size;
+	GLenum      type;
+	GLboolean   normalize;
+	short       offset;
+
+};
+
 Vattrib*  new_Vattrib( const char* name, 
                        short size, 
                        GLenum type, 
@@ -0,0 +1,75 @@
+#ifndef __gl_cache_h__
+#define __gl_cache_h__
+
+#include <GL/glew.h>
+
+#include "core.types.h"
+#include "math.vec.h"
+
+// A shadow of the GL state the renderer sets: capabilities, blending,
+// depth, stencil and clear values, the program and vertex array bound and
+// the uniforms of every program. Setting a value the shadow already holds
+// costs a compare instead of a GL call.
+//
+// The shadow starts out (and is reset to) unknown, so the first set of
+// every value goes to GL. Code that changes any of this state behind the
+// cache's back, or makes another context current, must reset_Glcache.
+//
+// There is one shadow, for the context current on the render thread; like
+// GL itself, it is not safe to use from other threads.
+
+typedef struct Glcache_stats Glcache_stats;
+struct Glcache_stats {
+
+	uint64 state_issued;      // Capabilities, blend, depth, stencil, clear
+	uint64 state_skipped;
+
+	uint64 programs_issued;
+	uint64 programs_skipped;
+
+	uint64 varrays_issued;
+	uint64 varrays_skipped;
+
+	uint64 uniforms_issued;
+	uint64 uniforms_skipped;
+
+};
+
+void          reset_Glcache( void );
+void          stats_Glcache( Glcache_stats* stats );
+void    clear_stats_Glcache( void );
+
+// Capabilities; only GL_BLEND, GL_DEPTH_TEST and GL_STENCIL_TEST are
+// shadowed, others always go to GL
+void         enable_Glcache( GLenum cap, bool enabled );
+
+void     blend_func_Glcache( GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha );
+void blend_equation_Glcache( GLenum modeRGB, GLenum modeAlpha );
+void    blend_color_Glcache( float4 color );
+
+void     depth_func_Glcache( GLenum func );
+void     depth_mask_Glcache( bool mask );
+void    depth_range_Glcache( double znear, double zfar );
+
+// `face' is GL_FRONT or GL_BACK
+void   stencil_func_Glcache( GLenum face, GLenum func, GLint ref, GLuint mask );
+void     stencil_op_Glcache( GLenum face, GLenum sfail, GLenum dpfail, GLenum dppass );
+
+void    clear_color_Glcache( float4 color );
+void    clear_depth_Glcache( double depth );
+void  clear_stencil_Glcache( GLint stencil );
+
+void    use_program_Glcache( GLuint program );
+void    bind_varray_Glcache( GLuint varray );
+
+// Uniforms are loaded by the caller, which knows their types. This returns
+// true, and remembers the value, if the uniform at `loc' of the current
+// program does not already hold the `size' bytes at `value'.
+bool        uniform_Glcache( GLint loc, uint size, const void* value );
+
+// Forget a program or vertex array that is being deleted, as its id may
+// be reused
+void forget_program_Glcache( GLuint program );
+void  forget_varray_Glcache( GLuint varray );
+
+#endif
@@ -15,10 +15,26 @@ typedef enum {
 
 } muxOp_e;
 
+typedef enum {
+
+	channelLocked,  // Spinlock around a byte ringbuf; reads/writes of any size
+	channelSPSC,    // Lock-free; one writer and one reader at a time
+	channelMPMC,    // Lock-free; any number of writers and readers
+
+} channelMode_e;
+
 #define channelEof     -1
 #define channelBlocked -2
 
+// Create a channel holding `count' messages of `size' bytes.
+//
+// A channelLocked channel is a byte stream: reads and writes may be of any
+// size, and blocked readers are only woken once the buffer fills up or it is
+// flushed. The lock-free modes move exactly one `size'-byte message per read
+// or write, and wake blocked readers (writers) as soon as the channel stops
+// being empty (full); `count' is rounded up to a power of two.
 Channel*       new_Channel( uint16 size, uint16 count );
+Channel*  new_Channel_mode( channelMode_e mode, uint16 size, uint16 count );
 void       destroy_Channel( Channel* chan );
 
 int       try_read_Channel( Channel* chan, uint16 size, pointer dest );
@@ -26,6 +42,27 @@ int      try_write_Channel( Channel* chan, uint16 size, const pointer data );
 int          write_Channel( Job* job, Channel* chan, uint16 size, const pointer data );
 int           read_Channel( Job* job, Channel* chan, uint16 size, pointer dest );
 
+// Batched transfers. Move up to `n' messages of `size' bytes each to/from the
+// array at `data'/`dest' under a single lock acquisition (or none at all for
+// the lock-free modes), with at most one wakeup. Returns the number of 
+// messages moved, which is at least one, or channelBlocked if not even one
+// could be moved.
+int     try_readv_Channel( Channel* chan, uint16 size, int n, pointer dest );
+int    try_writev_Channel( Channel* chan, uint16 size, int n, const pointer data );
+int        writev_Channel( Job* job, Channel* chan, uint16 size, int n, const pointer data );
+int         readv_Channel( Job* job, Channel* chan, uint16 size, int n, pointer dest );
+
+// Zero-copy access to the channel buffer; channelLocked and channelSPSC only.
+// begin_read_Channel returns a pointer to the bytes that can be read in one 
+// contiguous run and stores how many in `len'; end_read_Channel then consumes
+// the first `len' of them. Likewise for writing. A channelLocked channel stays
+// locked between begin_ and end_; for channelSPSC only the single reader 
+// (writer) may do this, and lengths are whole messages.
+pointer begin_read_Channel( Channel* chan, uint16* len );
+void      end_read_Channel( Channel* chan, uint16 len );
+pointer begin_write_Channel( Channel* chan, uint16* len );
+void      end_write_Channel( Channel* chan, uint16 len );
+
 void         flush_Channel( Channel* chan );
 void          poll_Channel( Channel* chan );
 
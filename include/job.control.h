@@ -298,6 +298,46 @@
 #define writech_buf( chan, size, data ) \
 	performch( write_Channel, (chan), (size), (data) )
 
+// Internal; do not call directly
+#define performch_batch( action, chan, size, n, p, count )	  \
+	do { \
+		set_duff( &self->fibre ); \
+		int ret = (action)( self, (chan), (size), (n), (p) ); \
+		if( channelBlocked == ret ) \
+			return( jobBlocked ); \
+		(count) = ret; \
+	} while(0)
+
+// Read up to `n` messages of sizeof(*`dest`) bytes from `chan` into the
+// array `dest`. Blocks until at least one message is available; stores the
+// number of messages read in `count`.
+//
+// @chan  - Channel* to read data from
+// @dest  - pointer to an array of at least `n` messages
+// @n     - maximum number of messages to read
+// @count - int lvalue receiving the number of messages read
+#define readch_batch( chan, dest, n, count ) \
+	performch_batch( readv_Channel, (chan), sizeof( *(dest) ), (n), (dest), count )
+
+// Write up to `n` messages of sizeof(*`data`) bytes from the array `data`
+// into `chan`. Blocks until there is room for at least one message; stores
+// the number of messages written in `count`.
+//
+// @chan  - Channel* to write data to
+// @data  - pointer to an array of `n` messages
+// @n     - maximum number of messages to write
+// @count - int lvalue receiving the number of messages written
+#define writech_batch( chan, data, n, count ) \
+	performch_batch( writev_Channel, (chan), sizeof( *(data) ), (n), (data), count )
+
+// As readch_batch, but for messages of `size` bytes in an untyped buffer
+#define readch_batch_buf( chan, size, n, dest, count ) \
+	performch_batch( readv_Channel, (chan), (size), (n), (dest), count )
+
+// As writech_batch, but for messages of `size` bytes in an untyped buffer
+#define writech_batch_buf( chan, size, n, data, count ) \
+	performch_batch( writev_Channel, (chan), (size), (n), (data), count )
+
 // Flush the contents of the channel waking up any readers waiting on it
 //
 // @chan - Channel* to flush
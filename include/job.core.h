@@ -2,8 +2,8 @@
 #define __job_core_H__
 
 #include "core.types.h"
-#include "data.list.h"
 #include "data.handle.h"
+#include "data.pool.h"
 #include "job.fibre.h"
 #include "mm.region.h"
 #include "sync.condition.h"
@@ -53,7 +53,7 @@ struct Job {
 	jobstatus_e status;
 
 	spinlock_t  waitqueue_lock;
-	List*       waitqueue;      // List of other Jobs waiting on this job
+	Pool*       waitqueue;      // Handles of other Jobs waiting on this job
 
 	uint32      deadline;
 	jobclass_e  jobclass;
@@ -96,4 +96,29 @@ void          cancel_Job( Handle job );
 // - signal is the condition that will be signalled when deadline has completed
 int    join_deadline_Job( uint32 deadline, mutex_t* mutex, condition_t* signal );
 
+// A countdown for a batch of jobs, for the thread that submitted them to
+// wait on. Unlike join_deadline_Job it waits for just that batch, whatever
+// else shares its deadline, and returns at once for an empty one.
+//
+// - add each job, or the whole batch, before submitting it, so that none
+//   can arrive before it is counted
+// - each job arrives as its last act; the one that brings the count to
+//   zero wakes the waiter
+// - the latch can be reused, or destroyed, once wait has returned
+typedef struct Job_Latch Job_Latch;
+struct Job_Latch {
+
+	int          pending;     // Under mutex
+	mutex_t      mutex;
+	condition_t  done;
+
+};
+
+int       init_Job_Latch( Job_Latch* latch );
+int    destroy_Job_Latch( Job_Latch* latch );
+
+void       add_Job_Latch( Job_Latch* latch, int n );
+void    arrive_Job_Latch( Job_Latch* latch );
+void      wait_Job_Latch( Job_Latch* latch );
+
 #endif
@@ -2,17 +2,20 @@
 #define __job_queue_h__
 
 #include "data.list.h"
+#include "data.pool.h"
 #include "job.core.h"
 #include "job.fibre.h"
 #include "sync.spinlock.h"
 #include "time.core.h"
 
-typedef List* Waitqueue;
+typedef Pool* Waitqueue;
 
 // Job queue //////////////////////////////////////////////////////////////////
 
-int               init_Job_queue(void);
-int               init_Job_queue_thread(pointer thread);
+int               init_Job_queue( int n_workers );
+int               init_Job_queue_thread( int worker_id );
+void            wakeup_Job_queue(void);
+void          shutdown_Job_queue(void);
 void            insert_Job( Job* job );
 Job*           dequeue_Job( usec_t timeout );
 Handle           alloc_Job( uint32, jobclass_e, void*, jobfunc_f, void* );
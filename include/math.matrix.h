@@ -119,38 +119,65 @@ static inline mat44 mmul( const mat44 m, const mat44 n ) {
   
 }
 
+#if defined(feature_SSE2)
+
+static inline __m128 mtransform_SSE( const mat44* m, __m128 v ) {
+
+	__m128 r = _mm_mul_ps( load_FLOAT4(&m->_1), _mm_shuffle_ps( v, v, _MM_SHUFFLE(0,0,0,0) ) );
+	r = _mm_add_ps( r, _mm_mul_ps( load_FLOAT4(&m->_2), _mm_shuffle_ps( v, v, _MM_SHUFFLE(1,1,1,1) ) ) );
+	r = _mm_add_ps( r, _mm_mul_ps( load_FLOAT4(&m->_3), _mm_shuffle_ps( v, v, _MM_SHUFFLE(2,2,2,2) ) ) );
+	r = _mm_add_ps( r, _mm_mul_ps( load_FLOAT4(&m->_4), _mm_shuffle_ps( v, v, _MM_SHUFFLE(3,3,3,3) ) ) );
+
+	return r;
+
+}
+
+#endif
+
+// As mmul, but through pointers, which lets it load whole columns at once.
+// Column j of m.n is m's columns weighted by column j of n.
 static inline mat44 mmulv( const mat44* m, const mat44* n ) {
-  
-  return (mat44) {
-	  ._1 = { 
-		 m->_1.x*n->_1.x + m->_2.x*n->_1.y + m->_3.x*n->_1.z + m->_4.x*n->_1.w,
-		 m->_1.y*n->_1.x + m->_2.y*n->_1.y + m->_3.y*n->_1.z + m->_4.y*n->_1.w,
-		 m->_1.z*n->_1.x + m->_2.z*n->_1.y + m->_3.z*n->_1.z + m->_4.z*n->_1.w,
-		 m->_1.w*n->_1.x + m->_2.w*n->_1.y + m->_3.w*n->_1.z + m->_4.w*n->_1.w
-	  },
-      
-	  ._2 = { 
-		 m->_1.x*n->_2.x + m->_2.x*n->_2.y + m->_3.x*n->_2.z + m->_4.x*n->_2.w,
-		 m->_1.y*n->_2.x + m->_2.y*n->_2.y + m->_3.y*n->_2.z + m->_4.y*n->_2.w,
-		 m->_1.z*n->_2.x + m->_2.z*n->_2.y + m->_3.z*n->_2.z + m->_4.z*n->_2.w,
-		 m->_1.w*n->_2.x + m->_2.w*n->_2.y + m->_3.w*n->_2.z + m->_4.w*n->_2.w
-	  },
-		   
-	  ._3 = { 
-		 m->_1.x*n->_3.x + m->_2.x*n->_3.y + m->_3.x*n->_3.z + m->_4.x*n->_3.w,
-		 m->_1.y*n->_3.x + m->_2.y*n->_3.y + m->_3.y*n->_3.z + m->_4.y*n->_3.w,
-		 m->_1.z*n->_3.x + m->_2.z*n->_3.y + m->_3.z*n->_3.z + m->_4.z*n->_3.w,
-		 m->_1.w*n->_3.x + m->_2.w*n->_3.y + m->_3.w*n->_3.z + m->_4.w*n->_3.w
-	  },
-		   
-	  ._4 = { 
-		 m->_1.x*n->_4.x + m->_2.x*n->_4.y + m->_3.x*n->_4.z + m->_4.x*n->_4.w,
-		 m->_1.y*n->_4.x + m->_2.y*n->_4.y + m->_3.y*n->_4.z + m->_4.y*n->_4.w,
-		 m->_1.z*n->_4.x + m->_2.z*n->_4.y + m->_3.z*n->_4.z + m->_4.z*n->_4.w,
-		 m->_1.w*n->_4.x + m->_2.w*n->_4.y + m->_3.w*n->_4.z + m->_4.w*n->_4.w
-	  }
-  };
-  
+
+#if defined(feature_AVX)
+
+	mat44 r;
+
+	__m256 m1 = _mm256_broadcast_ps( (const __m128*)&m->_1 );
+	__m256 m2 = _mm256_broadcast_ps( (const __m128*)&m->_2 );
+	__m256 m3 = _mm256_broadcast_ps( (const __m128*)&m->_3 );
+	__m256 m4 = _mm256_broadcast_ps( (const __m128*)&m->_4 );
+
+	// Two columns at a time
+	for( int j=0; j<16; j+=8 ) {
+
+		__m256 c = _mm256_loadu_ps( &n->_1.x + j );
+
+		__m256 p = _mm256_mul_ps( m1, _mm256_permute_ps( c, _MM_SHUFFLE(0,0,0,0) ) );
+		p = _mm256_add_ps( p, _mm256_mul_ps( m2, _mm256_permute_ps( c, _MM_SHUFFLE(1,1,1,1) ) ) );
+		p = _mm256_add_ps( p, _mm256_mul_ps( m3, _mm256_permute_ps( c, _MM_SHUFFLE(2,2,2,2) ) ) );
+		p = _mm256_add_ps( p, _mm256_mul_ps( m4, _mm256_permute_ps( c, _MM_SHUFFLE(3,3,3,3) ) ) );
+
+		_mm256_storeu_ps( &r._1.x + j, p );
+
+	}
+
+	return r;
+
+#elif defined(feature_SSE2)
+
+	return (mat44) {
+		store_FLOAT4( mtransform_SSE( m, load_FLOAT4(&n->_1) ) ),
+		store_FLOAT4( mtransform_SSE( m, load_FLOAT4(&n->_2) ) ),
+		store_FLOAT4( mtransform_SSE( m, load_FLOAT4(&n->_3) ) ),
+		store_FLOAT4( mtransform_SSE( m, load_FLOAT4(&n->_4) ) )
+	};
+
+#else
+
+	return mmul( *m, *n );
+
+#endif
+
 }
 
 static inline mat44 mtranspose( const mat44 m ) {
@@ -313,6 +340,14 @@ static inline mat44 qmatrix( const float4 q ) {
 
 }
 
+// Array kernels; dst may be the same array as an input
+// dst[i] = m . v[i]
+void mtransform_n( float4* dst, const mat44* m, const float4* v, int n );
+// dst[i] = a[i] . b[i]
+void      mmul_n( mat44* dst, const mat44* a, const mat44* b, int n );
+// dst[i] = qmatrix( q[i] )
+void   qmatrix_n( mat44* dst, const float4* q, int n );
+
 // Constants
 extern const mat44 identity_MAT44;
 extern const mat44 zero_MAT44;
@@ -0,0 +1,58 @@
+#ifndef __math_pack_h__
+#define __math_pack_h__
+
+#include <math.h>
+
+#include "core.types.h"
+#include "math.vec.h"
+
+// Packing floats into fewer bits, for vertex data.
+//
+// pack_half rounds to the nearest half float, ties to even, as the GPU
+// reads it; values beyond the largest half become infinities, NaNs stay
+// NaNs. pack_unorm16 and pack_snorm16 clamp to [0,1] and [-1,1] and round
+// to the nearest of 65536 steps, as GL normalizes them back.
+//
+// pack_oct16 maps a unit vector onto the octahedron |x|+|y|+|z| = 1, folds
+// the lower half over the upper one and stores the two coordinates left as
+// snorm16. Of the four nearest encodings it keeps the one decoding closest
+// to the vector given.
+
+uint16  pack_half( float f );
+float unpack_half( uint16 h );
+
+static inline
+uint16  pack_unorm16( float f ) {
+
+	f = f < 0.f ? 0.f : f > 1.f ? 1.f : f;
+	return (uint16)lrintf( f * 65535.f );
+
+}
+
+static inline
+float unpack_unorm16( uint16 q ) {
+
+	return (float)q * (1.f / 65535.f);
+
+}
+
+static inline
+int16   pack_snorm16( float f ) {
+
+	f = f < -1.f ? -1.f : f > 1.f ? 1.f : f;
+	return (int16)lrintf( f * 32767.f );
+
+}
+
+static inline
+float unpack_snorm16( int16 q ) {
+
+	float f = (float)q * (1.f / 32767.f);
+	return f < -1.f ? -1.f : f;
+
+}
+
+void    pack_oct16( float4 n, int16 out[2] );
+float4 unpack_oct16( const int16 in[2] );
+
+#endif
@@ -3,6 +3,14 @@
 
 #include <math.h>
 
+#include "core.features.h"
+
+#if defined(feature_AVX)
+#include <immintrin.h>
+#elif defined(feature_SSE2)
+#include <emmintrin.h>
+#endif
+
 typedef struct {
 
   float x;
@@ -15,6 +23,31 @@ typedef struct {
 // Provide an alias to communicate intent
 typedef float4 float3;
 
+// The operators take and return float4s by value. The compiler vectorizes
+// these well as written, better than intrinsics do once the arguments have
+// been unpacked from and packed back into structs, so they stay portable C.
+// Work over arrays goes through the *_n kernels instead, which are written
+// with SSE intrinsics, and AVX when it is enabled (see core.features.h).
+
+#if defined(feature_SSE2)
+
+static inline __m128 load_FLOAT4( const float4* v ) {
+
+	return _mm_loadu_ps( &v->x );
+
+}
+
+static inline float4 store_FLOAT4( __m128 r ) {
+
+	float4 v;
+	_mm_storeu_ps( &v.x, r );
+
+	return v;
+
+}
+
+#endif
+
 // Vector opeators
 static inline float4 vadd( float4 a, float4 b ) {
 
@@ -102,6 +135,9 @@ static inline float4 qmul( float4 q, float4 r ) {
 
 }
 
+// dst[i] = q[i] * r[i]; dst may be the same array as q or r
+void qmul_n( float4* dst, const float4* q, const float4* r, int n );
+
 static inline float4 qconj( const float4 q ) {
 
   return (float4){ -q.x, -q.y, -q.z, q.w };
@@ -177,6 +213,37 @@ static inline float4 qspherical( float lat, float lon, float theta ) {
 
 }
 
+// Spherical linear interpolation between unit quaternions, along the
+// shorter arc. Falls back to a normalized lerp when they are close, where
+// the two agree and slerp would divide by almost zero.
+static inline float4 qslerp( float4 a, float4 b, float t ) {
+
+	float c = vdot( a, b );
+	if( c < 0.f ) {
+		b = vneg( b );
+		c = -c;
+	}
+
+	float wa, wb;
+	if( c > 0.9995f ) {
+
+		wa = 1.f - t;
+		wb = t;
+
+	} else {
+
+		float theta = acosf( c );
+		float oos   = 1.f / sinf( theta );
+
+		wa = sinf( (1.f - t) * theta ) * oos;
+		wb = sinf( t * theta ) * oos;
+
+	}
+
+	return qversor( vadd( vscale( wa, a ), vscale( wb, b ) ) );
+
+}
+
 // Constants
 extern const float4 origin_PT;
 extern const float4 zero_VEC;
@@ -5,6 +5,7 @@ typedef struct region_s region_t;
 typedef region_t* region_p;
 
 #include "core.types.h"
+#include "time.core.h"
 
 // Memory regions, loosely based on (citation).
 //
@@ -23,7 +24,10 @@ typedef region_t* region_p;
 //
 // Notes: Operations on a region_p are not thread-safe; the caller is
 //        responsible for ensuring each region_p is accessed sequentially.
-//        It is probably best to keep regions thread-local.
+//        A region may however migrate between threads, e.g. be allocated 
+//        from on one thread and collected on another; pages go through
+//        per-thread caches backed by a shared depot, so they are reused
+//        regardless of which thread frees them.
 
 // Allocate a new region with given `name`. The name has no significance other
 // than auditing/reporting/debugging.
@@ -31,11 +35,13 @@ typedef region_t* region_p;
 // @name - C-string naming the region
 region_p region( const char* name );
 
-// Allocate `sz` bytes from region `R`
+// Allocate `sz` bytes from region `R`. Allocations that do not fit in a 
+// region page get a block of their own; either way they are freed when the
+// region is collected.
 //
 // @R  - region from which to allocate bytes.
-// @sz - size in bytes to allocate; must be less than region_MM_pagesize
-pointer  ralloc( region_p R, uint16 sz );
+// @sz - size in bytes to allocate
+pointer  ralloc( region_p R, size_t sz );
 
 // Allocate a page from region `R`.
 //
@@ -63,4 +69,38 @@ void     rfree( region_p R );
 int      region_MM_init( void );
 void     region_MM_shutdown( void );
 
+// Back region pages with 2 MiB transparent huge pages (mmap + madvise), 
+// which cuts TLB misses when scenes touch a lot of region memory. Returns
+// -1 if unsupported, or if any region memory has already been allocated;
+// call it at startup.
+int      region_MM_hugepages( bool enable );
+
+// Usage statistics /////////////////////////////////////////////////////////
+
+// Counters for all regions sharing a name
+typedef struct region_stats_s region_stats_t;
+struct region_stats_s {
+
+	const char* name;
+
+	uint64      requested;  // Bytes asked for with ralloc
+	uint64      wasted;     // Bytes lost rounding allocations up for alignment
+	uint32      pages;      // 64 KiB pages held right now
+	uint32      peak_pages; // Most pages held at once
+	uint32      collects;   // Times rcollect (or rfree) was called
+
+};
+
+// Snapshot the counters of up to `max` region names into `dst`; returns how
+// many were written.
+int      region_MM_stats( int max, region_stats_t* dst );
+
+// Log how much memory the region system holds from the system, and the
+// counters of each region name, largest peak first.
+void     region_MM_report( void );
+
+// Call region_MM_report every `period` microseconds from a background
+// thread; a period of 0 stops it. Returns -1 if the thread can't be started.
+int      region_MM_report_every( usec_t period );
+
 #endif
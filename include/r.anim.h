@@ -0,0 +1,105 @@
+#ifndef __r_anim_h__
+#define __r_anim_h__
+
+#include <stdio.h>
+
+#include "core.types.h"
+#include "math.vec.h"
+#include "mm.region.h"
+#include "r.skel.h"
+
+// Skeletal animations, as imported from .md5anim.
+//
+// An animation keeps the pose of every joint in every frame, relative to
+// the joint's parent, quantized to 16 bytes a key: the quaternion as four
+// 16-bit signed fractions and the position as three 16-bit fractions of
+// the range the joint moves over. The quaternions of a joint are kept in
+// the same hemisphere from one frame to the next.
+//
+// sample_Anim gives the pose at time `t' (in seconds; the animation loops)
+// in the joint space of a Skeleton, ready for palette_Skin: the two frames
+// around `t' are decoded, the quaternions slerped and the positions
+// lerped, and the joints composed with their parents. Joints come after
+// their parents, as in MD5 files.
+//
+// Many instances can be sampled at once: fill an array of Anim_Instance,
+// and sample_Anim_instances samples a run of them; an Anim_Batch splits
+// the array into jobs of `animBatchSize' instances.
+
+#define animBatchSize 32
+
+typedef struct Anim_Joint Anim_Joint;
+struct Anim_Joint {
+
+	const char* name;
+	int32       parent;   // -1 for roots
+
+	float4      p_min;    // Positions are p_min + p_scale * p
+	float4      p_scale;
+
+};
+
+typedef struct Anim_Key Anim_Key;
+struct Anim_Key {
+
+	int16  q[4];
+	uint16 p[4];          // p[3] is unused
+
+};
+
+typedef struct Anim Anim;
+struct Anim {
+
+	uint32      n_joints;
+	uint32      n_frames;
+	float       frame_rate;
+
+	Anim_Joint* joints;
+	Anim_Key*   keys;     // n_joints per frame, frame after frame
+	float4*     bounds;   // Min and max of the mesh in each frame
+
+};
+
+typedef struct Anim_Instance Anim_Instance;
+struct Anim_Instance {
+
+	const Anim* anim;
+	float       t;
+	Skel_Joint* pose;     // n_joints of output
+
+};
+
+typedef struct Anim_Batch Anim_Batch;
+
+// Instantiation
+//
+// Quantizes `n_frames' frames of local joint positions `p' and quaternions
+// `q', n_joints per frame. `bounds' may be NULL.
+Anim*             new_Anim( uint32 n_joints, uint32 n_frames, float frame_rate,
+                            const char** names, const int32* parents,
+                            const float4* p, const float4* q,
+                            const float4* bounds );
+void           delete_Anim( Anim* anim );
+
+// Resource I/O
+void            write_Anim( pointer res, FILE *outp );
+pointer         *read_Anim( FILE *inp );
+
+// Functions
+float        duration_Anim( const Anim* anim );
+void           decode_Anim( const Anim* anim, uint32 frame, uint32 joint,
+                            float4* p, float4* q );
+
+void           sample_Anim( const Anim* anim, float t, Skel_Joint* pose );
+void sample_Anim_instances( Anim_Instance* instances, uint32 n );
+
+// Batches
+Anim_Batch*  new_Anim_Batch( region_p R, Anim_Instance* instances, uint32 n );
+void      delete_Anim_Batch( Anim_Batch* batch );
+
+// Submits jobs sampling every instance, with the given deadline; returns
+// the number of jobs. join_Anim_Batch blocks until they are done.
+int       submit_Anim_Batch( Anim_Batch* batch, uint32 deadline );
+void        join_Anim_Batch( Anim_Batch* batch );
+
+#endif
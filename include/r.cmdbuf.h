@@ -0,0 +1,79 @@
+#ifndef __r_cmdbuf_h__
+#define __r_cmdbuf_h__
+
+#include "core.types.h"
+#include "mm.zone.h"
+#include "r.drawlist.h"
+
+// Command buffers hold the calls submitting a draw list would make (bind a
+// program, load uniforms, bind a vertex array, draw) so that they can be
+// made later, on another thread.
+//
+// Recording needs no GL context, and buffers share nothing, so the passes of
+// a frame, or slices of a long pass, can be recorded by jobs side by side;
+// the GL thread then only replays them, in order, through gl_Draw_Ops.
+// Commands point at the programs, uniform sets and drawables they use,
+// which must live until the buffer is replayed; uniform values are read
+// when replayed.
+//
+// null_Draw_Ops does nothing at all, to measure recording and replay
+// without a GPU.
+
+typedef enum {
+
+	cmdProgram,
+	cmdUniforms,
+	cmdVarray,
+	cmdDraw
+
+} cmdOp_e;
+
+typedef struct Draw_Cmd Draw_Cmd;
+struct Draw_Cmd {
+
+	uint32  op;
+	uint32  pad;
+
+	pointer a;      // Program, Shader_Arg, Varray or Drawable
+	pointer b;      // Shader_Arg of a program
+
+};
+
+typedef struct Cmd_Buffer Cmd_Buffer;
+struct Cmd_Buffer {
+
+	zone_p    Z;
+
+	uint      size;
+	uint      capacity;
+
+	Draw_Cmd* cmds;
+
+};
+
+// Records into the Cmd_Buffer passed as `ctx'
+extern const Draw_Ops record_Draw_Ops;
+extern const Draw_Ops   null_Draw_Ops;
+
+// Instantiation
+Cmd_Buffer*     new_Cmd_Buffer( zone_p Z, uint capacity );
+void         delete_Cmd_Buffer( Cmd_Buffer* buf );
+
+// Functions
+uint           size_Cmd_Buffer( const Cmd_Buffer* buf );
+
+// Makes the recorded calls, in order, through `ops'
+void         replay_Cmd_Buffer( const Cmd_Buffer* buf,
+                                const Draw_Ops* ops, pointer ctx );
+
+// Mutators
+void          clear_Cmd_Buffer( Cmd_Buffer* buf );
+void           push_Cmd_Buffer( Cmd_Buffer* buf, cmdOp_e op, pointer a, pointer b );
+
+// Appends the submission of draws [first, first+n) of a sorted list
+void         record_Cmd_Buffer( Cmd_Buffer* buf,
+                                const Draw_List* list,
+                                uint first, uint n,
+                                Draw_Stats* stats );
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef __r_drawlist_h__
+#define __r_drawlist_h__
+
+#include "core.types.h"
+#include "data.map.h"
+#include "gl.array.h"
+#include "gl.shader.h"
+#include "mm.zone.h"
+#include "r.drawable.h"
+
+// Draw lists collect the draws of a pass, sort them by the state they need
+// and submit them, skipping the binds that would not change anything.
+//
+// Each draw gets a 64-bit key; from the top:
+//
+//   program:8 | uniforms:16 | vertex array:16 | depth:24
+//
+// The program, uniform and vertex array fields are ids the list gives each
+// distinct pointer, in the order it is first pushed, so draws sharing state
+// sort next to each other and different states never interleave. The ids
+// are kept across clear_Draw_List, so they do not change from frame to
+// frame; a list that has seen more states than a field holds (256 programs,
+// 65536 uniform sets or vertex arrays) starts that field's ids over when
+// next cleared. Until then ids wrap, and two states sharing one only cost
+// binds: submission compares the pointers themselves, never the ids. Depth
+// is the top bits of the float, which order the same as non-negative floats
+// do, so draws with the same state go front to back.
+//
+// The sort is an LSD radix sort over the bytes of the keys, skipping the
+// bytes that are the same in every key.
+//
+// Submission goes through a Draw_Ops table, whose functions all get the
+// same `ctx'; gl_Draw_Ops issues the GL calls. Keying, sorting and the
+// state tracking of submit_Draw_List need no GL context given other ops,
+// such as record_Draw_Ops (r.cmdbuf.h).
+
+typedef struct Draw_Item Draw_Item;
+struct Draw_Item {
+
+	Program*    pgm;
+	Shader_Arg* pgm_argv;   // Loaded with the program
+
+	Drawable*   draw;
+	Shader_Arg* argv;
+
+};
+
+typedef struct Draw_Key Draw_Key;
+struct Draw_Key {
+
+	uint64 key;
+	uint32 item;
+	uint32 pad;
+
+};
+
+// The ids of one field of the key
+typedef struct Draw_Ids Draw_Ids;
+struct Draw_Ids {
+
+	Map*        map;        // Id + 1 of each state, keyed by its address
+	const void* last;       // The state last looked up, and its id; draws
+	uint32      last_id;    // pushed together tend to share state
+
+};
+
+typedef struct Draw_List Draw_List;
+struct Draw_List {
+
+	zone_p      Z;
+
+	uint        size;
+	uint        capacity;
+
+	Draw_Item*  items;
+	Draw_Key*   keys;
+	Draw_Key*   scratch;
+
+	Draw_Ids    programs;
+	Draw_Ids    uniforms;
+	Draw_Ids    varrays;
+
+};
+
+typedef struct Draw_Stats Draw_Stats;
+struct Draw_Stats {
+
+	uint64 draws;
+
+	uint64 programs;          // Binds made
+	uint64 uniforms;
+	uint64 varrays;
+
+	uint64 programs_skipped;  // Binds avoided
+	uint64 uniforms_skipped;
+	uint64 varrays_skipped;
+
+};
+
+typedef struct Draw_Ops Draw_Ops;
+struct Draw_Ops {
+
+	void (*program) ( pointer ctx, Program* pgm, Shader_Arg* argv );
+	void (*uniforms)( pointer ctx, Shader_Arg* argv );
+	void (*varray)  ( pointer ctx, Varray* varray );    // NULL unbinds
+	void (*draw)    ( pointer ctx, Drawable* dr );      // With its vertex array bound
+
+};
+
+extern const Draw_Ops gl_Draw_Ops;
+
+// Instantiation
+Draw_List*     new_Draw_List( zone_p Z, uint capacity );
+void        delete_Draw_List( Draw_List* list );
+
+// Functions
+uint          size_Draw_List( const Draw_List* list );
+// The key of a draw, from the ids of its state
+uint64     key_Draw_List_item( uint32 pgm, uint32 argv, uint32 varray,
+                               float depth );
+
+// Item `i' in sorted order, once sorted
+static inline
+Draw_Item*      nth_Draw_List( const Draw_List* list, uint i ) {
+
+	return &list->items[ list->keys[i].item ];
+
+}
+
+// Mutators
+void         clear_Draw_List( Draw_List* list );
+void          push_Draw_List( Draw_List* list,
+                              Program* pgm, Shader_Arg* pgm_argv,
+                              Drawable* draw, Shader_Arg* argv,
+                              float depth );
+void          sort_Draw_List( Draw_List* list );
+
+// Submits the draws in order; `stats' may be NULL
+void        submit_Draw_List( const Draw_List* list,
+                              const Draw_Ops* ops, pointer ctx,
+                              Draw_Stats* stats );
+
+// Submits draws [first, first+n) in sorted order, as if nothing were bound
+// before them; slices of a list can so be submitted independently
+void  submit_Draw_List_range( const Draw_List* list,
+                              uint first, uint n,
+                              const Draw_Ops* ops, pointer ctx,
+                              Draw_Stats* stats );
+
+#endif
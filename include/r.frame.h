@@ -12,11 +12,14 @@
 #include "gl.context.h"
 #include "gl.shader.h"
 
+#include "r.cmdbuf.h"
+#include "r.drawlist.h"
 #include "r.scene.h"
 #include "r.state.h"
 
 typedef struct Rpipeline Rpipeline;
 typedef struct Rpass Rpass;
+typedef struct Rpass_Job Rpass_Job;
 
 struct Rpass {
 
@@ -24,12 +27,21 @@ struct Rpass {
 
 	Scene      *sc;
 	predicate_f cull;
+	depth_f     depth;    // NULL leaves draws in state order only
+
+	// Culls by the bounds of the buckets instead of `cull', if set
+	const Frustum *frustum;
 
 	Program    *proc;
 	Shader_Arg *argv;
 
 	Rstate      rstate;
 
+	// Recorded by a job, replayed by render_Frame
+	Draw_List  *drawlist;
+	Cmd_Buffer *cmds;
+	Draw_Stats  stats;
+
 };
 
 typedef enum {
@@ -44,6 +56,13 @@ struct Rpipeline {
 
 	clearMask  mask;
 
+	Draw_Stats stats;    // Of the last frame rendered
+
+	// The passes are recorded side by side, by jobs with this deadline
+	uint32        deadline;
+	Rpass_Job    *jobs;
+	Job_Latch     recorded;
+
 	int    passc;
 	Rpass *passv[];
 
@@ -60,6 +79,9 @@ Rpipeline *define_Rpipeline( clearMask mask, int passc, ... );
 Rpipeline    *new_Rpipeline( clearMask mask, int passc, Rpass *passv[] );
 void      destroy_Rpipeline( Rpipeline *pipe );
 
+// Collects, sorts and records the draws of every pass in jobs, then applies
+// the state of each pass and replays its draws, in order. The cull and
+// depth functions of the passes are called from the jobs.
 void  render_Frame( Rpipeline *rpipe, float t0, float t, float dt );
 void  render_Frame_loop( Display *dpy, Channel *clk, Rpipeline *(*sync)(pointer), pointer arg );
 
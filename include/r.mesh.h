@@ -1,9 +1,13 @@
 #ifndef __r_mesh_h__
 #define __r_mesh_h__
 
+#include <stdio.h>
+
 #include "g.aabb.h"
 #include "mm.region.h"
 #include "r.drawable.h"
+#include "r.vformat.h"
+#include "res.map.h"
 #include "sys.dll.h"
 
 typedef struct Mesh Mesh;
@@ -36,8 +40,14 @@ struct Mesh {
 
 dllExport void         write_Mesh( pointer res, FILE *outp );
 dllExport pointer      *read_Mesh( FILE *inp );
+dllExport void          pack_Mesh( pointer res, Res_Pack *pack );
+dllExport pointer        map_Mesh( const Res_Map *map );
 
 void          dump_Mesh_info( Mesh *mesh );
 Drawable *drawable_Mesh( region_p R, Mesh *mesh );
 
+// As above, in the given vertex format, fitted to the mesh's bounds and
+// texcoords; the shader decodes with the offsets and scales left in `fmt'
+Drawable *drawable_Mesh_as( region_p R, Mesh *mesh, Vformat *fmt );
+
 #endif
@@ -0,0 +1,71 @@
+#ifndef __r_meshopt_h__
+#define __r_meshopt_h__
+
+#include "core.types.h"
+#include "mm.zone.h"
+#include "r.mesh.h"
+
+// Turns a Mesh into an indexed triangle list the vertex cache does well
+// with.
+//
+// weld_Mesh gives every distinct corner (position, texcoord and normal)
+// one vertex. Corners are compared by value, through a hash table, so
+// corners with the same indices always weld and corners that only repeat
+// values do too. Meshes without normals get the face normal at each
+// corner, as drawable_Mesh always drew them; such corners weld within a
+// flat region only.
+//
+// order_Mesh_Indexed_tris reorders the triangles for the post-transform
+// cache with Forsyth's algorithm: it greedily emits the triangle whose
+// vertices score best, a vertex scoring higher the more recently it was
+// used and the fewer of its triangles remain. order_Mesh_Indexed_verts
+// then renumbers the vertices in the order the triangles first use them,
+// so vertex fetches walk the buffers forwards.
+//
+// ACMR, the average cache miss ratio, is the number of vertices
+// transformed per triangle, with a FIFO cache of the given size; it is 3
+// when nothing is shared and about 0.5 at best for a regular grid.
+
+#define meshoptCacheSize 32
+
+typedef struct Mesh_Indexed Mesh_Indexed;
+struct Mesh_Indexed {
+
+	zone_p  Z;
+
+	uint32  n_verts;
+	float  *verts;      // 3 per vertex
+	float  *uvs;        // 2 per vertex
+	float  *normals;    // 3 per vertex
+
+	uint32  n_tris;
+	uint32 *tris;       // 3 per triangle
+
+};
+
+typedef struct Mesh_Opt_Stats Mesh_Opt_Stats;
+struct Mesh_Opt_Stats {
+
+	uint32 corners;       // 3 per triangle, the vertices drawn unindexed
+	uint32 verts;         // Once welded
+
+	float  acmr_welded;   // With the triangles in their original order
+	float  acmr;          // Once ordered
+
+};
+
+// Instantiation
+Mesh_Indexed*          weld_Mesh( zone_p Z, const Mesh* mesh );
+void         delete_Mesh_Indexed( Mesh_Indexed* mesh );
+
+// Welds, then orders the triangles and vertices; `stats' may be NULL
+Mesh_Indexed*      optimize_Mesh( zone_p Z, const Mesh* mesh, Mesh_Opt_Stats* stats );
+
+// Functions
+float            acmr_Mesh_Indexed( const Mesh_Indexed* mesh, uint cache_size );
+
+// Mutators
+void       order_Mesh_Indexed_tris( Mesh_Indexed* mesh );
+void      order_Mesh_Indexed_verts( Mesh_Indexed* mesh );
+
+#endif
@@ -4,18 +4,62 @@
 #include "control.predicate.h"
 #include "core.types.h"
 #include "data.map.h"
+#include "g.aabb.h"
+#include "g.frustum.h"
 #include "gl.shader.h"
 #include "mm.region.h"
 #include "r.drawable.h"
+#include "r.drawlist.h"
 #include "r.xform.h"
 
 typedef struct Scene Scene;
 typedef struct Visual Visual;
 
+// Depth of a bucket, given its key as cull is; smaller is nearer
+typedef float (*depth_f)( pointer tag );
+
 Scene*  new_Scene( region_p R );
 
 void    draw_Scene( float t0, float t, float dt, Scene* sc, uint32 pass, predicate_f cull );
 
+// Pushes the visuals of the pass that are not culled onto `list', to be
+// drawn with `pgm'; `depth' may be NULL
+void collect_Scene( Scene       *sc,
+                    uint32       pass,
+                    predicate_f  cull,
+                    depth_f      depth,
+                    Program     *pgm,
+                    Shader_Arg  *pgm_argv,
+                    Draw_List   *list );
+
+// As draw_Scene and collect_Scene, culling by the world bounds given to
+// each bucket with bound_Scene; all the bounds are classified against the
+// frustum in one go. Buckets without bounds are always drawn.
+void    draw_Scene_frustum( float t0, float t, float dt,
+                            Scene* sc, uint32 pass, const Frustum* f );
+void collect_Scene_frustum( Scene         *sc,
+                            uint32         pass,
+                            const Frustum *f,
+                            depth_f        depth,
+                            Program       *pgm,
+                            Shader_Arg    *pgm_argv,
+                            Draw_List     *list );
+
+// As draw_Scene and collect_Scene, with the buckets given by the tags of
+// those visible (say by cull_Bvh) rather than culled one by one; tags
+// without a bucket are skipped
+void    draw_Scene_visible( float t0, float t, float dt,
+                            Scene* sc, uint32 pass,
+                            const pointer* tags, uint n );
+void collect_Scene_visible( Scene       *sc,
+                            uint32       pass,
+                            const pointer* tags,
+                            uint         n,
+                            depth_f      depth,
+                            Program     *pgm,
+                            Shader_Arg  *pgm_argv,
+                            Draw_List   *list );
+
 Visual* link_Scene( Scene      *sc, 
                     pointer     tag, 
                     uint32      mask, 
@@ -24,4 +68,7 @@ Visual* link_Scene( Scene      *sc,
 
 void  unlink_Scene( Scene *sc, Visual *vis );
 
+// Sets the world bounds of the bucket of `tag', for draw_Scene_frustum
+void   bound_Scene( Scene *sc, pointer tag, const AABB *bounds );
+
 #endif
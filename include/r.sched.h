@@ -0,0 +1,94 @@
+#ifndef __r_sched_h__
+#define __r_sched_h__
+
+#include "core.types.h"
+#include "mm.region.h"
+#include "time.core.h"
+
+// A pipelined frame scheduler: frame N+1 is prepared on the job system
+// while the render thread draws frame N.
+//
+// Each frame goes through the stages below in order. The prepare stages
+// (update, transform, cull) run in one job per frame, one frame after the
+// other, and fill in a snapshot of everything the render stages need. The
+// render stages (render, present) run on the thread calling
+// render_Rsched, from the snapshot alone; they must not touch the state
+// the prepare stages work on, and nothing writes the snapshot while they
+// read it.
+//
+// There are `depth' snapshots, used in turn. With a depth of 1 preparing
+// and rendering take turns, as a serial loop would; with 2 the next frame
+// is prepared while this one renders; with 3 the one after that may be
+// prepared too, if rendering falls behind.
+//
+// A stage returning false ends the pipeline: the frame is not rendered,
+// and render_Rsched returns -1 once the frames before it have been.
+//
+// Any stage may be NULL. Nothing here calls GL, so the render stages can
+// be stubbed out to run the pipeline headless.
+
+#define rschedMaxDepth 4
+
+typedef enum {
+
+	rschedUpdate,
+	rschedTransform,
+	rschedCull,
+	rschedRender,
+	rschedPresent,
+
+	rschedStages
+
+} rschedStage_e;
+
+typedef bool (*rschedStage_f)( pointer arg, int64 frame, pointer snapshot );
+
+typedef struct Rsched_timing Rsched_timing;
+struct Rsched_timing {
+
+	uint64 count;
+	usec_t last;
+	usec_t total;
+	usec_t max;
+
+};
+
+typedef struct Rsched_stats Rsched_stats;
+struct Rsched_stats {
+
+	Rsched_timing stages[ rschedStages ];
+
+	Rsched_timing waiting;   // Render thread waiting for a snapshot
+	Rsched_timing frame;     // From one present to the next
+	Rsched_timing latency;   // From the start of update to the end of present
+
+};
+
+typedef struct Rsched Rsched;
+
+// Instantiation
+//
+// `snapshots' holds `depth' snapshots, in whatever form the stages agree
+// on; `arg' is passed to every stage. Jobs are submitted with `deadline'.
+Rsched*     new_Rsched( region_p R,
+                        uint depth,
+                        pointer snapshots[],
+                        rschedStage_f stages[ rschedStages ],
+                        pointer arg,
+                        uint32 deadline );
+void     delete_Rsched( Rsched* sched );
+
+// Starts preparing frames
+void      start_Rsched( Rsched* sched );
+
+// Renders the next frame, waiting for it to be prepared if need be, and
+// returns its number; -1 once the pipeline has ended
+int64    render_Rsched( Rsched* sched );
+
+// Prepares no more frames, and waits for the one being prepared, if any;
+// frames already prepared are dropped
+void       stop_Rsched( Rsched* sched );
+
+void      stats_Rsched( Rsched* sched, Rsched_stats* stats );
+
+#endif
@@ -5,6 +5,8 @@
 #include "math.vec.h"
 #include "mm.region.h"
 #include "r.drawable.h"
+#include "r.vformat.h"
+#include "res.map.h"
 
 typedef struct Skel_Joint Skel_Joint;
 struct Skel_Joint {
@@ -67,8 +69,14 @@ struct Skeleton {
 
 void         write_Skel( pointer res, FILE *outp );
 pointer      *read_Skel( FILE *inp );
+void          pack_Skel( pointer res, Res_Pack *pack );
+pointer        map_Skel( const Res_Map *map );
 
 void          dump_Skel_info( Skeleton *skel );
 Drawable* drawable_Skel( region_p R, Skeleton *skel, int which_mesh );
 
+// As above, in the given vertex format, fitted to the bind pose; the shader
+// decodes with the offsets and scales left in `fmt'
+Drawable* drawable_Skel_as( region_p R, Skeleton *skel, int which_mesh, Vformat *fmt );
+
 #endif
@@ -0,0 +1,99 @@
+#ifndef __r_skin_h__
+#define __r_skin_h__
+
+#include "core.types.h"
+#include "gl.attrib.h"
+#include "job.core.h"
+#include "math.matrix.h"
+#include "math.vec.h"
+#include "mm.region.h"
+#include "r.skel.h"
+
+// CPU skinning of a Skel_Mesh.
+//
+// new_Skin flattens the per-vertex weight runs of a mesh into one array,
+// in vertex order. Each weight keeps the index of its joint, its offset in
+// joint space premultiplied by its bias, and the bind-pose normal of its
+// vertex taken into joint space and weighted the same way. A vertex is then
+// the sum of its weights, each transformed by the matrix of its joint.
+//
+// A palette holds one matrix per joint, built from the joints of a pose by
+// palette_Skin. eval_Skin computes the positions and normals of a run of
+// vertices against a palette, 3 floats per vertex, and eval_Skin_reference
+// does the same from the Skel_Vertex and Skel_Weight structures alone, one
+// quaternion rotation at a time, to check it against; it finds the bind-pose
+// normals again on every call, so it is slow.
+//
+// submit_Skin splits the mesh into chunks of `skinChunkSize' vertices, one
+// job per chunk, and join_Skin waits for them; stream_Skin does both,
+// straight into the mapped vertex and normal buffers of drawable_Skin. The
+// chunk jobs share the parameters and the count kept in the Skin, so only
+// one evaluation of a Skin may be in flight at a time.
+
+#define skinChunkSize 2048
+
+typedef struct Skin_Weight Skin_Weight;
+struct Skin_Weight {
+
+	float4 pos;     // bias * (offset, 1)
+	float4 normal;  // bias * (normal, 0)
+
+};
+
+typedef struct Skin_Chunk Skin_Chunk;
+
+typedef struct Skin Skin;
+struct Skin {
+
+	region_p        R;
+
+	const Skeleton* skel;
+	const Skel_Mesh* mesh;
+
+	uint32          n_joints;
+	uint32          n_verts;
+	uint32          n_weights;
+
+	uint32*         first;      // Weights of vertex v are [first[v], first[v+1])
+	uint32*         joint;
+	Skin_Weight*    weights;
+
+	uint32          n_chunks;
+	Skin_Chunk*     chunks;
+
+	Job_Latch       pending;    // Chunk jobs not yet done
+
+	// Streamed buffers, once drawable_Skin has been called
+	Vattrib*        verts;
+	Vattrib*        normals;
+
+};
+
+// Instantiation
+Skin*            new_Skin( region_p R, const Skeleton* skel, int which_mesh );
+void          delete_Skin( Skin* skin );
+
+// Fills `palette' with the matrix of each of the `n' joints
+void         palette_Skin( mat44* palette, const Skel_Joint* joints, uint32 n );
+
+// Computes vertices [first, first+n) into `verts' and `normals', which
+// point at the slot of vertex `first'
+void            eval_Skin( const Skin* skin, const mat44* palette,
+                           uint32 first, uint32 n,
+                           float* verts, float* normals );
+void  eval_Skin_reference( const Skin* skin, const Skel_Joint* joints,
+                           uint32 first, uint32 n,
+                           float* verts, float* normals );
+
+// Submits the jobs computing the whole mesh, with the given deadline.
+// Returns the number of jobs.
+int           submit_Skin( Skin* skin, const mat44* palette,
+                           float* verts, float* normals, uint32 deadline );
+// Blocks until the jobs of the last submit_Skin are done
+void            join_Skin( Skin* skin );
+
+// GL
+Drawable*   drawable_Skin( region_p R, Skin* skin );
+int           stream_Skin( Skin* skin, const mat44* palette, uint32 deadline );
+
+#endif
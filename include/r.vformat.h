@@ -0,0 +1,89 @@
+#ifndef __r_vformat_h__
+#define __r_vformat_h__
+
+#include "core.types.h"
+#include "g.aabb.h"
+#include "gl.array.h"
+#include "gl.attrib.h"
+#include "gl.index.h"
+#include "math.vec.h"
+
+// Interleaved vertex formats: position, texcoord and normal in one buffer,
+// each stored as floats or packed smaller (see math.pack.h).
+//
+// Packed positions are relative to the bounds they were fitted to: half
+// floats about the center, unorm16 across the box. Packed texcoords are
+// unorm16 across their own range, and packed normals octahedral, two
+// snorm16s. A shader reads them back with the functions in vformat_GLSL,
+// given pos_offset/pos_scale and uv_offset/uv_scale as the uniforms
+// vposOffset/vposScale and vuvOffset/vuvScale; for floats these are the
+// identity, so the same shader serves both. Octahedral normals come in as
+// a vec2, which vformat_oct turns back into a vector.
+//
+// The fields are at locations 0 (pos), 1 (uv) and 2 (normal), as the
+// separate attributes were. All floats take 32 bytes a vertex, everything
+// packed 16.
+
+typedef enum {
+
+	vposFloat,
+	vposHalf,
+	vposUnorm16
+
+} vpos_e;
+
+typedef enum {
+
+	vuvFloat,
+	vuvUnorm16
+
+} vuv_e;
+
+typedef enum {
+
+	vnormalFloat,
+	vnormalOct16
+
+} vnormal_e;
+
+typedef struct Vformat Vformat;
+struct Vformat {
+
+	vpos_e    pos;
+	vuv_e     uv;
+	vnormal_e normal;
+
+	short     stride;
+	Vfield    fields[3];
+
+	float4    pos_offset, pos_scale;
+	float     uv_offset[2], uv_scale[2];
+
+};
+
+extern const char* vformat_GLSL;
+
+// Instantiation; identity offsets and scales until fitted
+Vformat define_Vformat( vpos_e pos, vuv_e uv, vnormal_e normal );
+
+// Mutators
+
+// Fits the offsets and scales to `bounds' and to the n texcoords given,
+// which may be NULL
+void       fit_Vformat( Vformat* fmt, const AABB* bounds, uint32 n, const float* uvs );
+
+// Functions
+
+// Writes n vertices, fmt->stride bytes each, to `out'; `uvs' and `normals'
+// may be NULL, for zeros
+void    encode_Vformat( const Vformat* fmt, uint32 n,
+                        const float* verts, const float* uvs, const float* normals,
+                        pointer out );
+// Reads back vertex i of `in'; any of `v', `uv' and `n' may be NULL
+void    decode_Vformat( const Vformat* fmt, const void* in, uint32 i,
+                        float v[3], float uv[2], float n[3] );
+
+// The vertex array drawing the n vertices of `data', as encoded
+Varray*   new_Varray_Vformat( const Vformat* fmt, uint32 n, const void* data, Vindex* index );
+
+#endif
@@ -6,8 +6,22 @@
 #include "math.vec.h"
 #include "mm.region.h"
 
-// Opaque transform type
-typedef struct Xform Xform;
+// Transforms are kept in stores, one per tree: a new Xform without a
+// parent starts a store in region `R', and its descendants join it. A store
+// keeps the matrices of all its nodes in flat arrays, in depth-first order,
+// so parents come before children and every subtree is a contiguous run of
+// slots. An Xform is a handle to a slot.
+//
+// The mutators only record what changed. The first query of a matrix after
+// a change brings the whole store up to date in one pass over the arrays,
+// recomputing the world matrices and inverses of the changed nodes and of
+// everything below them; so make all the changes for a frame first, then
+// query. The matrices returned stay where they are until the shape of the
+// tree changes (a node is created, adopted or detached).
+
+// Opaque transform types
+typedef struct Xform       Xform;
+typedef struct Xform_Store Xform_Store;
 
 // Visiter function type
 typedef bool (*xformVisitor_f)( const Xform*, pointer tag );
@@ -34,8 +48,30 @@ Xform       *detach_Xform( Xform *xf, Xform *parent );
 Xform       *parent_Xform( const Xform *xf );
 pointer         tag_Xform( const Xform *xf );
 
+Xform  *first_child_Xform( const Xform *xf );
+Xform *next_sibling_Xform( const Xform *xf );
+
+// Visits `xf' and its descendants depth-first, skipping the descendants of
+// a node whose visit returns false
 void       traverse_Xform( const Xform *xf, xformVisitor_f visit );
 
+// Store //////////////////////////////////////////////////////////////////////
+Xform_Store   *store_Xform( const Xform *xf );
+uint32     size_Xform_Store( const Xform_Store *S );
+
+// Brings every matrix in the store up to date
+void      update_Xform_Store( Xform_Store *S );
+
+// An update can be split between threads by subtree. After
+// begin_update_Xform_Store, update_Xform_Store_range brings slots [begin,end)
+// up to date, given that the parents of the slots in the range are either in
+// it or already up to date. span_Xform gives the range of the subtree of
+// `xf'. For example, update [0, b+1) where [b,e) is the span of some node,
+// then the spans of its children concurrently, then [e, size).
+void begin_update_Xform_Store( Xform_Store *S );
+void update_Xform_Store_range( Xform_Store *S, uint32 begin, uint32 end );
+void            span_Xform( const Xform *xf, uint32 *begin, uint32 *end );
+
 // Mutators ///////////////////////////////////////////////////////////////////
 Xform          *set_Xform( Xform *xf, const mat44 *t );
 Xform          *mul_Xform( Xform *xf, const mat44 *m );
@@ -0,0 +1,50 @@
+#ifndef __res_cache_h__
+#define __res_cache_h__
+
+#include "core.types.h"
+#include "time.core.h"
+
+// A content-addressed store of what res.import made, so that an input it
+// has seen before, with the same importer, is copied back rather than
+// imported again.
+//
+// Entries are keyed by a hash64 of the input's bytes seeded with the
+// identity of its importer (see importer_Res_spec), which is also what
+// res.manifest.h records as the input's hash: the manifest takes an input
+// to its key, and the entry under the key to the files written from it.
+//
+// Each entry is a single file in the cache directory, named after its key,
+// that bundles every file written from the input (a resource and its
+// children) with how long importing and writing them took. Entries are
+// written to a temporary file and renamed into place, so concurrent
+// writers, in this process or another, never see half of one. Files are
+// copied in and out rather than linked: write_Res rewrites outputs in
+// place, which would rewrite the entry too.
+//
+// Bundles are native, like res.map.h containers, and the cache is only
+// ever local. Nothing is evicted; remove the directory to start over.
+
+typedef struct Res_Cache Res_Cache;
+
+// Instantiation
+
+// Creates `dir' if it does not exist; NULL if it cannot
+Res_Cache*   open_Res_Cache( const char* dir );
+void        close_Res_Cache( Res_Cache* cache );
+
+// Functions
+
+// Copies the files stored under `key' into `outdir'. Returns how many, or
+// -1 when there is no such entry or it cannot be read back whole. On
+// success `output' gets the first file, the top-level resource, which the
+// caller frees; `size' their bytes and `cost' how long they took to make.
+// Any of them may be NULL
+int         fetch_Res_Cache( const Res_Cache* cache, uint64 key, const char* outdir,
+                             char** output, size_t* size, usec_t* cost );
+
+// Stores the `n' files at `outputs', relative to `outdir', under `key'; the
+// first should be the top-level resource. 0 on success, -1 if not
+int         store_Res_Cache( const Res_Cache* cache, uint64 key, const char* outdir,
+                             int n, const char* outputs[], usec_t cost );
+
+#endif
@@ -8,6 +8,7 @@
 #include "core.types.h"
 #include "math.matrix.h"
 #include "math.vec.h"
+#include "res.map.h"
 
 typedef struct Resource Resource;
 typedef struct Res_Type Res_Type;
@@ -16,6 +17,11 @@ typedef Resource *(*import_Resource_f)( const char *name, size_t szbuf, const po
 typedef void      (*write_Resource_f)( pointer res, FILE *outp );
 typedef pointer  *(  *read_Resource_f)( FILE *inp );
 
+// Optional, for resources that can be used where they are mapped; see
+// res.map.h
+typedef void      (  *pack_Resource_f)( pointer res, Res_Pack *pack );
+typedef pointer   (   *map_Resource_f)( const Res_Map *map );
+
 struct Res_Type {
 	
 	char              id[4];
@@ -23,6 +29,9 @@ struct Res_Type {
 	write_Resource_f write;
 	read_Resource_f   read;
 
+	pack_Resource_f   pack;
+	map_Resource_f    map;
+
 	Res_Type         *next;
 
 };
@@ -50,10 +59,15 @@ void    register_Res_importer( const char id[4],
 void    register_Res_type( const char id[4],
                            write_Resource_f writefunc,
                            read_Resource_f readfunc );
+void    register_Res_map( const char id[4],
+                          pack_Resource_f packfunc,
+                          map_Resource_f mapfunc );
 
 void         add_Res_path( const char *scheme, const char *path );
 
 Resource *import_Res( const char *name, const char *path );
+// As above, with the file already read; `path' picks the importer
+Resource *import_Res_buf( const char *name, const char *path, size_t sz, const pointer buf );
 Resource    *new_Res( Resource *parent,
                       const char *name,
                       const char typeid[4],
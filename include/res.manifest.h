@@ -0,0 +1,65 @@
+#ifndef __res_manifest_h__
+#define __res_manifest_h__
+
+#include "core.types.h"
+
+// What res.import last made of each input, so that it can skip the ones
+// that have not changed.
+//
+// Each entry records the input's size, modification time, the identity of
+// the importer that read it (see importer_Res_spec) and a hash64 of its
+// bytes, seeded with that identity, and the top-level resource written
+// from it. An input whose size, time and importer still match is taken as
+// unchanged without reading it; one whose time moved is read and hashed,
+// and unchanged if the hash matches. The hash doubles as the input's key
+// in the build cache, res.cache.h.
+//
+// The manifest is a text file, one entry a line, tab separated:
+//
+//   <hash> <importer> <mtime, ns> <size> <output> <input>
+//
+// with the hash and importer as 16 hex digits.
+//
+// Lines starting with '#' are comments. write_Res_Manifest writes to a
+// temporary file and renames it over the old one, so an interrupted run
+// leaves the previous manifest whole.
+
+typedef struct Res_Manifest_Entry Res_Manifest_Entry;
+struct Res_Manifest_Entry {
+
+	uint64  hash;
+	uint64  importer;
+	int64   mtime;
+	uint64  size;
+
+	char   *output;
+	char   *input;
+
+};
+
+typedef struct Res_Manifest Res_Manifest;
+
+// Instantiation
+Res_Manifest*    new_Res_Manifest( void );
+void          delete_Res_Manifest( Res_Manifest* manifest );
+
+// An empty manifest if there is no file at `path'; NULL if it cannot be
+// read. Lines that do not parse are skipped, with a warning
+Res_Manifest*   read_Res_Manifest( const char* path );
+int            write_Res_Manifest( const Res_Manifest* manifest, const char* path );
+
+// Functions
+uint             size_Res_Manifest( const Res_Manifest* manifest );
+Res_Manifest_Entry*
+               lookup_Res_Manifest( const Res_Manifest* manifest, const char* input );
+
+// Mutators
+
+// Adds or replaces the entry for `input'
+Res_Manifest_Entry*
+               update_Res_Manifest( Res_Manifest* manifest,
+                                    const char* input, const char* output,
+                                    uint64 hash, uint64 importer,
+                                    int64 mtime, uint64 size );
+
+#endif
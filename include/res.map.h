@@ -0,0 +1,54 @@
+#ifndef __res_map_h__
+#define __res_map_h__
+
+#include <stdio.h>
+
+#include "core.types.h"
+
+// Resources laid out to be used where they are mapped.
+//
+// A packed resource is a header, a table of sections and the sections
+// themselves, each an array of fixed-size elements starting on a
+// resMapAlign boundary. Sections are found by a four character id and
+// located by their offset from the header, so the container can sit
+// anywhere in a file; write_Res puts it after the type id and name, with
+// the magic right after the name and padding up to the header.
+//
+// open_Res_Map maps the whole file, privately and writable: a resource
+// with pointers patches them in place, and only the pages it patches are
+// copied. Everything else stays backed by the file, read when first
+// touched. The mapping lives as long as the Res_Map, which a mapped
+// resource's data must not outlive.
+//
+// Containers are native: they record the pointer size and byte order
+// they were written with, and will not open elsewhere.
+
+#define resMapMagic   "RMAP"
+#define resMapVersion 1
+#define resMapAlign   64
+
+typedef struct Res_Pack Res_Pack;
+typedef struct Res_Map  Res_Map;
+
+// Writing
+Res_Pack*    new_Res_Pack( void );
+void      delete_Res_Pack( Res_Pack* pack );
+
+// Adds a section of `count' elements of `stride' bytes. `data' is written
+// as is and must live until the pack is written; when NULL the pack
+// allocates the section, zeroed, and returns it to be filled in
+pointer      add_Res_Pack( Res_Pack* pack, const char id[4], uint32 stride, uint64 count, const void* data );
+size_t     write_Res_Pack( Res_Pack* pack, FILE* outp );
+
+// Reading
+
+// True when the next thing in `inp' is a container; consumes nothing
+bool          is_Res_Map( FILE* inp );
+Res_Map*    open_Res_Map( FILE* inp );
+void       close_Res_Map( Res_Map* map );
+
+// The section `id', or NULL if there is none or its elements are not
+// `stride' bytes; `count' may be NULL
+pointer  section_Res_Map( const Res_Map* map, const char id[4], uint32 stride, uint64* count );
+
+#endif
@@ -5,7 +5,8 @@
 #include "res.core.h"
 #include "sys.dll.h"
 
-// Resource loader
+// Resource loaders
 dllExport Resource *import_MD5( const char *name, size_t sz, const pointer data );
+dllExport Resource *import_MD5anim( const char *name, size_t sz, const pointer data );
 
 #endif
@@ -1,6 +1,14 @@
 #ifndef __res_spec_h__
 #define __res_spec_h__
 
+#include "core.types.h"
+
 int load_Res_spec( const char* spec );
 
+// Identifies what the spec would make of `path': a hash of the import
+// record for its extension, with its version, and of the type and map
+// records for the type imported. Any change to those changes it. 0 when
+// nothing imports `path'
+uint64 importer_Res_spec( const char* path );
+
 #endif
@@ -8,6 +8,21 @@
 #define atomic_cas( val, old, new ) \
 	__sync_bool_compare_and_swap( &(val), (old), (new) )
 
+// Load with acquire semantics; no later load or store is moved before it
+#define atomic_load( val ) \
+	__atomic_load_n( &(val), __ATOMIC_ACQUIRE )
+
+// Store with release semantics; no earlier load or store is moved after it
+#define atomic_store( val, x ) \
+	__atomic_store_n( &(val), (x), __ATOMIC_RELEASE )
+
+// Add `x' to `val' and return the new value; full barrier
+#define atomic_add( val, x ) \
+	__sync_add_and_fetch( &(val), (x) )
+
+// Full memory barrier
+#define atomic_fence() \
+	__sync_synchronize()
 
 #else
 #error "Unsupported platform"
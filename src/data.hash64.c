@@ -0,0 +1,366 @@
+#include <string.h>
+
+#include "data.hash64.h"
+
+// The construction follows wyhash (Wang Yi, public domain): the key is read
+// in 8-byte words which are multiplied together, 64x64->128 bits, and the
+// two halves of the product folded back together. Keys of more than 48
+// bytes are consumed in 48-byte blocks with three independent lanes.
+
+static const uint64 P0 = 0xa0761d6478bd642fULL;
+static const uint64 P1 = 0xe7037ed1a0b428dbULL;
+static const uint64 P2 = 0x8ebc6af09c88c6e3ULL;
+static const uint64 P3 = 0x589965cc75374cc3ULL;
+
+// Internal ///////////////////////////////////////////////////////////////////
+
+// Replace `a` and `b` by the low and high halves of a*b
+static inline void mul128( uint64* a, uint64* b ) {
+
+#if defined( __SIZEOF_INT128__ )
+
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (uint64)r;
+	*b = (uint64)(r >> 64);
+
+#else
+
+	uint64 ha = *a >> 32, hb = *b >> 32, la = (uint32)*a, lb = (uint32)*b;
+	uint64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64 t = rl + (rm0 << 32), c = t < rl;
+	uint64 lo = t + (rm1 << 32); c += lo < t;
+	uint64 hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+	*a = lo;
+	*b = hi;
+
+#endif
+
+}
+
+static inline uint64 mum( uint64 a, uint64 b ) {
+
+	mul128( &a, &b );
+	return a ^ b;
+
+}
+
+static inline uint64 r8( const uint8* p ) {
+
+	uint64 x; memcpy( &x, p, 8 );
+	return x;
+
+}
+
+static inline uint64 r4( const uint8* p ) {
+
+	uint32 x; memcpy( &x, p, 4 );
+	return x;
+
+}
+
+// 1..3 bytes
+static inline uint64 r3( const uint8* p, size_t k ) {
+
+	return ((uint64)p[0] << 16) | ((uint64)p[k >> 1] << 8) | p[k - 1];
+
+}
+
+static inline void block( uint64* seed, uint64* see1, uint64* see2, const uint8* p ) {
+
+	*seed = mum( r8(p)      ^ P1, r8(p + 8)  ^ *seed );
+	*see1 = mum( r8(p + 16) ^ P2, r8(p + 24) ^ *see1 );
+	*see2 = mum( r8(p + 32) ^ P3, r8(p + 40) ^ *see2 );
+
+}
+
+// Hash the last `i` bytes at `p` of a key `len` bytes long. If the key is
+// longer than 16 bytes, the 16 bytes before `p` must be the ones preceding
+// it in the key.
+static uint64 tail( uint64 seed, const uint8* p, size_t i, uint64 len ) {
+
+	uint64 a, b;
+
+	if( len <= 16 ) {
+
+		if( len >= 4 ) {
+
+			size_t k = (len >> 3) << 2;
+			a = (r4(p) << 32) | r4(p + k);
+			b = (r4(p + len - 4) << 32) | r4(p + len - 4 - k);
+
+		} else if( len > 0 ) {
+
+			a = r3( p, len );
+			b = 0;
+
+		} else
+			a = b = 0;
+
+	} else {
+
+		while( i > 16 ) {
+
+			seed = mum( r8(p) ^ P1, r8(p + 8) ^ seed );
+			p += 16;
+			i -= 16;
+
+		}
+
+		a = r8(p + i - 16);
+		b = r8(p + i - 8);
+
+	}
+
+	a ^= P1;
+	b ^= seed;
+	mul128( &a, &b );
+
+	return mum( a ^ P0 ^ len, b ^ P1 );
+
+}
+
+// Public API /////////////////////////////////////////////////////////////////
+
+uint64 hash64( const void* key, size_t len, uint64 seed ) {
+
+	const uint8* p = key;
+	size_t       i = len;
+
+	seed ^= mum( seed ^ P0, P1 );
+
+	if( i > 48 ) {
+
+		uint64 see1 = seed, see2 = seed;
+		do {
+
+			block( &seed, &see1, &see2, p );
+			p += 48;
+			i -= 48;
+
+		} while( i > 48 );
+
+		seed ^= see1 ^ see2;
+
+	}
+
+	return tail( seed, p, i, len );
+
+}
+
+void   init_Hash64( Hash64* h, uint64 seed ) {
+
+	h->seed  = seed ^ mum( seed ^ P0, P1 );
+	h->see1  = h->see2 = 0;
+	h->wide  = false;
+	h->len   = 0;
+	h->count = 0;
+
+}
+
+void update_Hash64( Hash64* h, const void* data, size_t len ) {
+
+	const uint8* p   = data;
+	uint8*       buf = h->buf + 16;
+
+	h->len += len;
+
+	while( len > 0 ) {
+
+		// Nothing buffered; hash whole blocks straight from `data`
+		if( 0 == h->count && len > 48 ) {
+
+			if( !h->wide ) {
+				h->see1 = h->see2 = h->seed;
+				h->wide = true;
+			}
+
+			size_t k = 0;
+			while( len - k > 48 ) {
+				block( &h->seed, &h->see1, &h->see2, p + k );
+				k += 48;
+			}
+
+			memcpy( h->buf, p + k - 16, 16 + len - k );
+			h->count = len - k;
+			return;
+
+		}
+
+		size_t n = sizeof(h->buf) - 16 - h->count;
+		if( n > len )
+			n = len;
+
+		memcpy( buf + h->count, p, n );
+		h->count += n;
+		p        += n;
+		len      -= n;
+
+		// More than 48 bytes to go, so none of the first 48 are in the tail
+		if( h->count <= 48 )
+			continue;
+
+		if( !h->wide ) {
+			h->see1 = h->see2 = h->seed;
+			h->wide = true;
+		}
+
+		int k = 0;
+		while( h->count - k > 48 ) {
+			block( &h->seed, &h->see1, &h->see2, buf + k );
+			k += 48;
+		}
+
+		// Keep the last 16 bytes hashed in front of the rest, for tail()
+		memmove( h->buf, buf + k - 16, 16 + h->count - k );
+		h->count -= k;
+
+	}
+
+}
+
+uint64  final_Hash64( const Hash64* h ) {
+
+	uint64 seed = h->wide ? h->seed ^ h->see1 ^ h->see2 : h->seed;
+	return tail( seed, h->buf + 16, h->count, h->len );
+
+}
+
+#ifdef __data_hash64_TEST__
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "data.hash.h"
+#include "time.core.h"
+
+static volatile uint64 sink;
+
+typedef uint64 (*hash_f)( const uint8* key, size_t len );
+
+static uint64 do_hashlittle( const uint8* key, size_t len ) {
+	return hashlittle( key, len, 0 );
+}
+
+static uint64 do_superfast( const uint8* key, size_t len ) {
+	return SuperFastHash( (const char*)key, (int)len );
+}
+
+static uint64 do_hash64( const uint8* key, size_t len ) {
+	return hash64( key, len, 0 );
+}
+
+static uint64 do_stream( const uint8* key, size_t len ) {
+	Hash64 h; init_Hash64( &h, 0 );
+	update_Hash64( &h, key, len );
+	return final_Hash64( &h );
+}
+
+static uint64 do_mixer( const uint8* key, size_t len ) {
+	if( 8 == len ) {
+		uint64 x; memcpy( &x, key, 8 );
+		return hash64_u64( x );
+	}
+	uint32 x; memcpy( &x, key, 4 );
+	return hash64_u32( x );
+}
+
+// Hash `total` bytes worth of keys of `len` bytes, taken from successive 
+// offsets of `buf`; returns the throughput in MB/s
+static double bench( hash_f hash, const uint8* buf, size_t bufsz, size_t len, size_t total ) {
+
+	size_t n = total / len;
+	uint64 acc = 0;
+
+	usec_t timebase = microseconds();
+	for( size_t i=0, ofs=0; i<n; i++ ) {
+
+		acc += hash( buf + ofs, len );
+		ofs += len;
+		if( ofs + len > bufsz )
+			ofs = 0;
+
+	}
+	usec_t elapsed = microseconds() - timebase;
+
+	sink = acc;
+	return elapsed > 0 ? (double)(n * len) / (double)elapsed : 0.;
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	const size_t bufsz = 64 * 1024;
+	uint8* buf = malloc( bufsz );
+	for( size_t i=0; i<bufsz; i++ )
+		buf[i] = (uint8)rand();
+
+	// Streaming gives the same hash as one-shot, however the key is split
+	for( size_t len=0; len<=600; len++ ) {
+
+		uint64 expected = hash64( buf, len, 42 );
+
+		for( int trial=0; trial<8; trial++ ) {
+
+			Hash64 h; init_Hash64( &h, 42 );
+			size_t ofs = 0;
+			while( ofs < len ) {
+				size_t n = 1 + rand() % (trial < 4 ? 7 : 130);
+				if( n > len - ofs )
+					n = len - ofs;
+				update_Hash64( &h, buf + ofs, n );
+				ofs += n;
+			}
+
+			uint64 got = final_Hash64( &h );
+			assert( got == expected );
+
+		}
+
+	}
+
+	// Every byte of the key, the length and the seed matter
+	for( size_t len=1; len<=200; len++ ) {
+
+		uint64 h = hash64( buf, len, 0 );
+		assert( h != hash64( buf, len, 1 ) );
+		assert( h != hash64( buf, len - 1, 0 ) );
+
+		for( size_t i=0; i<len; i++ ) {
+			buf[i] ^= 1;
+			assert( h != hash64( buf, len, 0 ) );
+			buf[i] ^= 1;
+		}
+
+	}
+
+	const size_t total = argc > 1 ? (size_t)strtol( argv[1], NULL, 10 ) << 20 : 64 << 20;
+
+	printf("Throughput in MB/s, %zu MB per measurement\n\n", total >> 20);
+	printf("%6s %12s %12s %12s %12s %12s\n",
+	       "len", "hashlittle", "superfast", "hash64", "Hash64", "mixer");
+
+	for( size_t len=4; len<=1024; len*=2 ) {
+
+		printf("%6zu %12.1f %12.1f %12.1f %12.1f ",
+		       len,
+		       bench( do_hashlittle, buf, bufsz, len, total ),
+		       bench( do_superfast, buf, bufsz, len, total ),
+		       bench( do_hash64, buf, bufsz, len, total ),
+		       bench( do_stream, buf, bufsz, len, total ) );
+
+		if( len <= 8 )
+			printf("%12.1f\n", bench( do_mixer, buf, bufsz, len, total ));
+		else
+			printf("%12s\n", "-");
+
+	}
+
+	free( buf );
+
+	printf("\nOk\n");
+	return 0;
+
+}
+
+#endif
@@ -2,242 +2,348 @@
 #include <math.h>
 #include <string.h>
 
+#include "core.features.h"
 #include "core.types.h"
 
-#include "data.hash.h"
+#include "data.hash64.h"
 #include "data.map.h"
 
-#include "math.util.h"
-
 #include "mm.zone.h"
 
-#define  H         32
-#define  PROBEDIST 256
-
-struct Bucket {
+#if defined( feature_SSE2 )
+#include <emmintrin.h>
+#endif
 
-	uint    neighbourhood;
-	
-	pointer key;
+// Hopscotch hashing. Every entry lives within H slots of its home slot (the
+// slot its hash maps to), and each home slot keeps a bitmap of which of the
+// H slots starting at it hold its entries. A lookup only ever looks at those
+// slots, and removing an entry just clears its bit; there are no tombstones.
+//
+// Alongside the slots the map keeps a control byte per slot: emptyCtrl if
+// the slot is free, otherwise a 7-bit fingerprint of the entry's hash. A 
+// lookup matches the fingerprint against the H control bytes of the 
+// neighbourhood, 16 at a time with SSE2, and only compares the keys of 
+// entries that both match and belong to the neighbourhood. The first H-1
+// control bytes are mirrored past the end of the table, so that loading a
+// neighbourhood never has to wrap around.
+//
+// Keys are copied into the map; up to inlineKey bytes are kept in the slot,
+// longer keys are copied into memory from the map's zone.
+
+#define  H          32
+#define  PROBEDIST  256  // How far to look for a free slot before growing
+#define  inlineKey  16
+#define  emptyCtrl  0x80
+
+// Grow once more than maxLoad of the slots are used
+#define  maxLoadNum 7
+#define  maxLoadDen 8
+
+struct Slot {
+
+	uint32  hash;
 	int     len;
-	
+
 	pointer value;
 
+	union {
+		uint8   bytes[ inlineKey ];
+		pointer ptr;
+	} key;
+
 };
 
 struct Map {
 
-	zone_p         Z;
+	zone_p       Z;
 
-	uint           N;
-	uint           S;
-	struct Bucket* buckets;
+	uint         N;
+	uint         S;
+
+	uint8*       ctrl;
+	uint32*      neighbourhood;
+	struct Slot* slots;
 
 };
 
 // Internal ///////////////////////////////////////////////////////////////////
 
-static inline int find_lsb_set( uint mask ) {
+static inline int find_lsb_set( uint32 mask ) {
 	
-	for( int i=0; i<H; i++ ) {
-		if( mask & (1U << i) )
-			return i;
+	assert( 0 != mask );
+	return __builtin_ctz( mask );
+
+}
+
+static inline uint8 fingerprint( uint32 hash ) {
+
+	return (uint8)(hash >> 25);
+
+}
+
+// Keys of 4 and 8 bytes are nearly always an integer id, a handle or a
+// pointer, so they go through the integer mixer instead of the byte hash
+static inline uint32 hash_key( int len, const pointer key ) {
+
+	uint64 hash;
+	if( 8 == len ) {
+
+		uint64 x; memcpy( &x, key, 8 );
+		hash = hash64_u64( x );
+
+	} else if( 4 == len ) {
+
+		uint32 x; memcpy( &x, key, 4 );
+		hash = hash64_u32( x );
+
+	} else
+		hash = hash64( key, len, 0 );
+
+	return (uint32)hash;
+
+}
+
+static inline bool eqkey( const pointer k1, const pointer k2, int len ) {
+
+	// Spare the common cases a call to memcmp
+	if( 8 == len ) {
+
+		uint64 a, b; memcpy( &a, k1, 8 ); memcpy( &b, k2, 8 );
+		return a == b;
+
+	} else if( 4 == len ) {
+
+		uint32 a, b; memcpy( &a, k1, 4 ); memcpy( &b, k2, 4 );
+		return a == b;
+
 	}
 
-	return -1;
+	return 0 == memcmp( k1, k2, len );
 
 }
 
-static inline bool eqkey( const pointer k1, int l1, const pointer k2, int l2 ) {
+static inline pointer slot_key( const struct Slot* slot ) {
 
-	return (l1 == l2)
-		&& (NULL != k1 && NULL != k2)
-		&& (0 == memcmp( k1, k2, l1 ));
+	return slot->len <= inlineKey ? (pointer)slot->key.bytes : slot->key.ptr;
 
 }
 
-static inline bool isempty( struct Bucket* bucket ) {
+static inline bool isempty( const Map* map, uint i ) {
 
-	return NULL == bucket->key;
+	return emptyCtrl == map->ctrl[i];
 
 }
 
-/*
-static void expand( Map* map ) {
+static inline void set_ctrl( Map* map, uint i, uint8 c ) {
 
-	struct Bucket** old_buckets = map->buckets;
+	map->ctrl[i] = c;
+	if( i < H-1 )
+		map->ctrl[ map->S + i ] = c;
 
-	// Double the number of buckets
-	map->buckets    = new_array( map, struct Bucket*, 2 * map->S );
-	memset( map->buckets, 0, sizeof(struct Bucket*) * 2 * map->S );
+}
 
-	// Re-hash all the entries
-	for( int i=0; i<map->S; i++ ) {
+// Bitmap of which of the H control bytes at `ctrl` equal `c`
+static inline uint32 match( const uint8* ctrl, uint8 c ) {
 
-		struct Bucket* node; slist_pop_front( old_buckets[i], node );
-		while( node ) {
-			uint32_t        hash = hashlittle( node->key, node->len, node->len );
-			size_t          bucket_idx = hash & (2 * map->S - 1);
-			struct Bucket** bucket = &map->buckets[ bucket_idx ];
+#if defined( feature_SSE2 )
 
-			slist_push_front( *bucket, node );
-			slist_pop_front( old_buckets[i], node );
-		}
+	const __m128i needle = _mm_set1_epi8( (char)c );
 
+	__m128i lo = _mm_loadu_si128( (const __m128i*)ctrl );
+	__m128i hi = _mm_loadu_si128( (const __m128i*)(ctrl + 16) );
+
+	uint32 mlo = (uint32)_mm_movemask_epi8( _mm_cmpeq_epi8( lo, needle ) );
+	uint32 mhi = (uint32)_mm_movemask_epi8( _mm_cmpeq_epi8( hi, needle ) );
+
+	return mlo | (mhi << 16);
+
+#else
+
+	uint32 mask = 0;
+	for( int i=0; i<H; i++ ) {
+		if( c == ctrl[i] )
+			mask |= 1U << i;
 	}
 
-	// Update stats
-	map->S          = 2 * map->S;
-	map->load = (float)map->N / map->S;
-	
-	// Free the old buckets
-	delete( old_buckets );
+	return mask;
+
+#endif
 
-	return;
 }
-*/
 
-static struct Bucket* lookup( const Map* map, int len, const pointer key ) {
+static void alloc_table( Map* map, uint S ) {
 
-	uint32_t       hash = hashlittle( key, len, len );
-	size_t         base_idx = hash & (map->S - 1);
-	struct Bucket* base = &map->buckets[ base_idx ];
+	map->S             = S;
+	map->N             = 0;
+	map->ctrl          = zalloc( map->Z, S + H );
+	map->neighbourhood = zalloc( map->Z, S * sizeof(uint32) );
+	map->slots         = zalloc( map->Z, S * sizeof(struct Slot) );
 
-	// Is this a worthwhile optimization?
-//	if( 1 == base->neighbourhood 
-//	    && eqkey( key, len, base->key, base->len ) )
-//		return base;
+	memset( map->ctrl, emptyCtrl, S + H );
+	memset( map->neighbourhood, 0, S * sizeof(uint32) );
 
-	// Check buckets in this neighbourhood
-	uint mask = base->neighbourhood;
-	while( mask ) {
-		int i = find_lsb_set( mask );
-		if( i < 0 )
-			break;
-		struct Bucket* bucket = &map->buckets[ (base_idx + i) & (map->S-1) ];
+}
+
+static void free_table( Map* map ) {
+
+	zfree( map->Z, map->ctrl );
+	zfree( map->Z, map->neighbourhood );
+	zfree( map->Z, map->slots );
+
+}
+
+// Returns the index of the slot holding `key`, or -1
+static int lookup( const Map* map, uint32 hash, int len, const pointer key ) {
+
+	const uint mask = map->S - 1;
+	const uint base = hash & mask;
+
+	const uint8 fp = fingerprint(hash);
 
-		assert( i <= 31 );
+	uint32 candidates = map->neighbourhood[base];
+#if defined( feature_SSE2 )
+	candidates &= match( &map->ctrl[base], fp );
+#endif
+
+	while( candidates ) {
+
+		uint i = (base + find_lsb_set( candidates )) & mask;
+		const struct Slot* slot = &map->slots[i];
+
+		if( fp == map->ctrl[i]
+		    && hash == slot->hash 
+		    && len == slot->len 
+		    && eqkey( key, slot_key(slot), len ) )
+			return i;
 
-		if( eqkey( key, len, bucket->key, bucket->len ) )
-			return bucket;
+		candidates &= candidates - 1;
 
-		mask &= ~(1U << i);
 	}
-	
+
 	// Nope
-	return NULL;
+	return -1;
 
 }
 
-// This is where the magic happens. The goal is find the minimal bucket
-// within a distance of H-1 from `freebucket` that can be moved to 
-// `freebucket` without breaking its neighbourhood property
-//static struct Bucket* pull( struct Bucket* freebucket ) {
-static int pull( struct Bucket* buckets, uint S, uint freebucket_idx ) {
+// Move entries around until the free slot `dist` slots after `base` is
+// within its neighbourhood. This is where the magic happens: we look for 
+// the entry furthest before the free slot that can move into it without
+// leaving its own neighbourhood, move it, and repeat from where it was.
+//
+// Returns the index of the free slot, or -1 if it can't be brought close 
+// enough.
+static int hop( Map* map, uint base, uint dist ) {
 
-	struct Bucket* freebucket = &buckets[ freebucket_idx ];
+	const uint mask = map->S - 1;
+	uint free_idx = (base + dist) & mask;
+
+	while( dist >= H ) {
+
+		bool moved = false;
+		for( uint d=H-1; d>0 && !moved; d-- ) {
+
+			// Entries of this home slot that sit before the free slot
+			uint   home = (free_idx - d) & mask;
+			uint32 hops = map->neighbourhood[home] & ((1U << d) - 1);
+			if( !hops )
+				continue;
+
+			int  i    = find_lsb_set( hops );
+			uint from = (home + i) & mask;
+
+			map->slots[free_idx] = map->slots[from];
+			set_ctrl( map, free_idx, map->ctrl[from] );
+			set_ctrl( map, from, emptyCtrl );
+
+			map->neighbourhood[home] &= ~(1U << i);
+			map->neighbourhood[home] |=  (1U << d);
+
+			dist    -= d - i;
+			free_idx = from;
+			moved    = true;
 
-	int base_idx = freebucket_idx - (H-1); // HOW SURE AM I THAT freebucket_idx is always correct?
-	if( base_idx < 0 )
-		base_idx = S + base_idx;
-	
-	for( int freedist=H-1; freedist>0; freedist-- ) {
-
-		struct Bucket* base = &buckets[ base_idx ];
-
-		assert( freedist <= 31 );
-		assert( base != freebucket );
-
-		// Look for a bucket before `freebucket` and in `base`'s neighbourhood
-		// that belongs in `base`'s bucket
-		for( int i=0; i<freedist; i++ ) {
-			
-			assert( i <= 31 );
-
-			// Found one?
-			if( (1U << i) & base->neighbourhood ) {
-
-				const int target_idx = (base_idx + i) & (S-1);
-				struct Bucket* target = &buckets[ target_idx ];
-
-				// Mark the free location as used
-				base->neighbourhood |= (1U << freedist);
-				
-				// Move the target's data into the free bucket
-				freebucket->key = target->key;
-				freebucket->len = target->len;
-				freebucket->value = target->value;
-				
-				// Free the old location
-				base->neighbourhood &= ~(1U << i);
-				target->key = NULL;
-				target->len = 0;
-				target->value = NULL;
-
-				return target_idx;
-				
-			}
-				
 		}
 
-		// Try next
-		base_idx = (base_idx + 1) & (S-1);
+		// Didn't find anything
+		if( !moved )
+			return -1;
 
 	}
 
-	// Didn't find anything
-	return -1;
+	return free_idx;
 
 }
 
-// It is an error to call this function when `0 != lookup(map, key, len)`
-// Calling code should check the existence of the key before calling this.
-static struct Bucket* put( Map* map, int len, const pointer key, pointer value ) {
+// It is an error to call this function when `lookup` would find the key;
+// calling code should check the existence of the key before calling this.
+//
+// Returns the index of the slot `entry` went into, or -1 if there is no room
+// for it near its home slot.
+static int insert( Map* map, const struct Slot* entry ) {
 
-	uint32_t       hash = hashlittle( key, len, len );
-	size_t         base_idx = hash & (map->S - 1);
-	struct Bucket* base = &map->buckets[ base_idx ];
+	const uint mask = map->S - 1;
+	const uint base = entry->hash & mask;
+	const uint probe = map->S < PROBEDIST ? map->S : PROBEDIST;
 
-	// Probe for an empty slot
-	for( size_t i=0; i<PROBEDIST; i++ ) {
+	// Probe for an empty slot, a neighbourhood's worth at a time
+	uint dist = probe;
+	for( uint d=0; d<probe; d+=H ) {
 
-		int bucket_idx = (base_idx + i) & (map->S-1);
-		struct Bucket* bucket = &map->buckets[ bucket_idx ];
-		if( isempty(bucket) ) {
+		uint32 empty = match( &map->ctrl[ (base + d) & mask ], emptyCtrl );
+		if( empty ) {
+			dist = d + find_lsb_set( empty );
+			break;
+		}
 
-			do {
+	}
+	if( dist >= probe )
+		return -1;
 
-				bucket = &map->buckets[ bucket_idx ];
+	int i = hop( map, base, dist );
+	if( i < 0 )
+		return -1;
 
-				// Found a free bucket in the neighbourhood
-				int dist = bucket_idx - base_idx;
-				if( dist < 0 )
-					dist = map->S + dist;
+	map->slots[i] = *entry;
+	set_ctrl( map, i, fingerprint( entry->hash ) );
+	map->neighbourhood[base] |= 1U << ((i - base) & mask);
+	map->N++;
 
-				if( dist < H ) {
-					
-					base->neighbourhood |= (1U << dist);
-					bucket->key = key;
-					bucket->len = len;
-					bucket->value = value;
-					
-					map->N++;
-					return bucket;
+	return i;
+
+}
 
-				}
-				// Too far, try and pull it closer
-				bucket_idx = pull( map->buckets, map->S, bucket_idx );
+// Re-hash everything into a table of at least `S` slots
+static void expand( Map* map, uint S ) {
 
-			} while( bucket_idx > 0 );
+	Map old = *map;
 
-			// Fail
-			return NULL;
+	while( true ) {
 
+		alloc_table( map, S );
+
+		bool ok = true;
+		for( uint i=0; i<old.S && ok; i++ ) {
+			if( !isempty( &old, i ) )
+				ok = insert( map, &old.slots[i] ) >= 0;
 		}
 
+		if( ok )
+			break;
+
+		// Unlucky; some neighbourhood overflowed, so try again bigger
+		free_table( map );
+		S = 2 * S;
+
 	}
 
-	return NULL;
+	free_table( &old );
+
+}
+
+static void free_key( Map* map, struct Slot* slot ) {
+
+	if( slot->len > inlineKey )
+		zfree( map->Z, slot->key.ptr );
 
 }
 
@@ -245,23 +351,30 @@ static struct Bucket* put( Map* map, int len, const pointer key, pointer value )
 
 Map* new_Map( zone_p Z, int capacity ) {
 
-	// The initial number of buckets; must be a power of 2
-	const int defaultBuckets = 32;
+	// The initial number of slots; must be a power of 2
+	const uint defaultSlots = 2*H;
+
+	// Enough slots to hold `capacity` entries without growing
+	uint S = defaultSlots;
+	while( (uint64)S * maxLoadNum < (uint64)capacity * maxLoadDen )
+		S = 2 * S;
 
 	Map* map = zalloc( Z, sizeof(Map) );
-	map->Z       = Z;
-	map->N       = 0;
-	map->S       = ceil2u( capacity > 0 ? capacity : defaultBuckets );
-	map->buckets = zalloc( Z, map->S * sizeof(struct Bucket) );
-	memset( map->buckets, 0, map->S * sizeof(struct Bucket) );
+	map->Z = Z;
+	alloc_table( map, S );
 
 	return map;
 
 }
 
-void      destroy_Map( Map* map ) {
+void      delete_Map( Map* map ) {
+
+	for( uint i=0; i<map->S; i++ ) {
+		if( !isempty( map, i ) )
+			free_key( map, &map->slots[i] );
+	}
 
-	zfree( map->Z, map->buckets );
+	free_table( map );
 	zfree( map->Z, map );
 
 }
@@ -282,15 +395,14 @@ float       load_Map( const Map* map ) {
 
 pointer     lookup_Map( const Map* map, int len, const pointer key ) {
 
-	struct Bucket* node = lookup( map, len, key );
-	return (NULL == node) ? NULL : node->value;
+	int i = lookup( map, hash_key( len, key ), len, key );
+	return (i < 0) ? NULL : map->slots[i].value;
 
 }
 
 bool      contains_Map( const Map* map, int len, const pointer key ) {
 
-	struct Bucket* node = lookup( map, len, key );
-	return NULL != node;
+	return lookup( map, hash_key( len, key ), len, key ) >= 0;
 
 }
 
@@ -298,87 +410,96 @@ bool      contains_Map( const Map* map, int len, const pointer key ) {
 
 pointer     put_Map( Map* map, int len, const pointer key, pointer value ) {
 
-	struct Bucket* node = lookup( map, len, key );
+	uint32 hash = hash_key( len, key );
+	int    i    = lookup( map, hash, len, key );
 
 	// Replace
-	if( node ) {
-
-		pointer old = node->value;
+	if( i >= 0 ) {
 
-		node->key = key;
-		node->len = len;
-		node->value = value;
+		pointer old = map->slots[i].value;
+		map->slots[i].value = value;
 
 		return old;
 
 	}
 
 	// Insert new
-	node = put( map, len, key, value );
-	if( !node )
-		return NULL;
+	if( (uint64)(map->N + 1) * maxLoadDen > (uint64)map->S * maxLoadNum )
+		expand( map, 2 * map->S );
+
+	struct Slot entry = { .hash = hash, .len = len, .value = value };
+	if( len <= inlineKey )
+		memcpy( entry.key.bytes, key, len );
+	else
+		entry.key.ptr = memcpy( zalloc( map->Z, len ), key, len );
+
+	while( insert( map, &entry ) < 0 )
+		expand( map, 2 * map->S );
 	
-	return node->value;
+	return value;
 
 }
 
 pointer     remove_Map( Map* map, int len, const pointer key ) {
 
-	struct Bucket*  node = lookup( map, len, key );
+	uint32 hash = hash_key( len, key );
+	int    i    = lookup( map, hash, len, key );
 
-	if( !node )
+	if( i < 0 )
 		return NULL;
 
-	pointer old = node->value;
+	struct Slot* slot = &map->slots[i];
+	pointer      old  = slot->value;
+
+	const uint mask = map->S - 1;
+	const uint base = hash & mask;
 
-	node->key = NULL;
-	node->len = 0;
-	node->value = NULL;
+	map->neighbourhood[base] &= ~(1U << ((i - base) & mask));
+	set_ctrl( map, i, emptyCtrl );
+	free_key( map, slot );
+	map->N--;
 
 	return old;
 
 }
 
-pointer    first_Map( Map* map ) {
+// Returns the first used slot at or after `i`
+static pointer scan( Map* map, uint i ) {
 
-	return next_Map( map, map->buckets - 1 );
+	while( i < map->S && isempty( map, i ) )
+		i++;
 
-}
+	return i < map->S ? &map->slots[i] : NULL;
 
-pointer     next_Map( Map* map, pointer kv ) {
+}
 
-	struct Bucket* bucket = (struct Bucket*)kv;
-	struct Bucket* extent = map->buckets + map->S;
+pointer    first_Map( Map* map ) {
 
-	// Find next empty bucket
-	do {
+	return scan( map, 0 );
 
-		bucket++;
+}
 
-	} while( bucket < extent && isempty(bucket) );
+pointer     next_Map( Map* map, pointer kv ) {
 
-	if( bucket < extent )
-		return bucket;
-	
-	return NULL;
+	return scan( map, (struct Slot*)kv - map->slots + 1 );
 
 }
 
 pointer      key_Map( pointer kv ) {
 	
-	return ((struct Bucket*)kv)->key;
+	return slot_key( (struct Slot*)kv );
 
 }
 
 int     key_size_Map( pointer kv ) {
 
-	return ((struct Bucket*)kv)->len;
+	return ((struct Slot*)kv)->len;
 
 }
 
 pointer    value_Map( pointer kv ) {
 
-	return ((struct Bucket*)kv)->value;
+	return ((struct Slot*)kv)->value;
 
 }
 
@@ -388,6 +509,110 @@ pointer    value_Map( pointer kv ) {
 #include <stdlib.h>
 
 #include "mm.heap.h"
+#include "time.core.h"
+
+// Pull in the chained map under different names for the comparison
+#undef  __data_map_TEST__
+
+typedef struct Chained_Map Chained_Map;
+
+#define Map          Chained_Map
+#define new_Map      new_Chained_Map
+#define delete_Map   delete_Chained_Map
+#define size_Map     size_Chained_Map
+#define load_Map     load_Chained_Map
+#define lookup_Map   lookup_Chained_Map
+#define contains_Map contains_Chained_Map
+#define put_Map      put_Chained_Map
+#define remove_Map   remove_Chained_Map
+#define expand       chained_expand
+#define inc_load     chained_inc_load
+#define lookup       chained_lookup
+
+#include "data.map.chained.c"
+
+#undef Map
+#undef new_Map
+#undef delete_Map
+#undef size_Map
+#undef load_Map
+#undef lookup_Map
+#undef contains_Map
+#undef put_Map
+#undef remove_Map
+#undef expand
+#undef inc_load
+#undef lookup
+
+static bool verify( Map* M, int N, char** keys, int* values, int stride ) {
+
+	bool ok = true;
+	for( int i=0; i<N; i++ ) {
+
+		pointer value = lookup_Map( M, strlen(keys[i]), keys[i] );
+		pointer expected = (0 == i % stride) ? &values[i] : NULL;
+		if( value != expected ) {
+			printf(" FAIL: %s -> %p, expected %p\n", keys[i], value, expected);
+			ok = false;
+		}
+
+	}
+
+	return ok;
+
+}
+
+// Mimic r.scene.c: a few hundred buckets keyed by pointer-sized tags, and a
+// lot of lookups of them
+static void benchmark( int nTags, int nLookups ) {
+
+	pointer* tags  = malloc( nTags * sizeof(pointer) );
+	int*     order = malloc( nLookups * sizeof(int) );
+	for( int i=0; i<nTags; i++ )
+		tags[i] = malloc( 64 );
+	for( int i=0; i<nLookups; i++ )
+		order[i] = rand() % nTags;
+
+	Map*         M = new_Map( ZONE_heap, 1024 );
+	Chained_Map* C = new_Chained_Map( ZONE_heap, 1024 );
+
+	for( int i=0; i<nTags; i++ ) {
+		put_Map( M, sizeof(pointer), &tags[i], tags[i] );
+		put_Chained_Map( C, sizeof(pointer), &tags[i], tags[i] );
+	}
+
+	uint64 sum = 0;
+	usec_t timebase = microseconds();
+	for( int i=0; i<nLookups; i++ ) {
+		pointer tag = tags[ order[i] ];
+		sum += (uintptr_t)lookup_Map( M, sizeof(tag), &tag );
+	}
+	usec_t open_time = microseconds() - timebase;
+
+	timebase = microseconds();
+	for( int i=0; i<nLookups; i++ ) {
+		pointer tag = tags[ order[i] ];
+		sum -= (uintptr_t)lookup_Chained_Map( C, sizeof(tag), &tag );
+	}
+	usec_t chained_time = microseconds() - timebase;
+
+	if( 0 != sum )
+		printf(" FAIL: maps disagree\n");
+
+	printf("%6d tags, %d lookups: open %6.2f ns/lookup, chained %6.2f ns/lookup\n",
+	       nTags, nLookups,
+	       1000. * (double)open_time / nLookups,
+	       1000. * (double)chained_time / nLookups);
+
+	delete_Map( M );
+	delete_Chained_Map( C );
+
+	for( int i=0; i<nTags; i++ )
+		free( tags[i] );
+	free( tags );
+	free( order );
+
+}
 
 int main( int argc, char* argv[] ) {
 
@@ -395,15 +620,19 @@ int main( int argc, char* argv[] ) {
 
 	char** keys   = malloc( sizeof(char*) * N );
 	int*   values = malloc( sizeof(int) * N );
-	Map* M = new_Map( ZONE_heap, 1024*1024);
+
+	// Start small so that we exercise growth
+	Map* M = new_Map( ZONE_heap, 0 );
 
 	printf("Insert %d keys into map...\n", N);
 	for( int i=0; i<N; i++ ) {
 
-		int keyLength = (int)ceil(log10(1.0 + (double)i)) + 2.0;
+		// Every 7th key is too long to be kept inline
+		const char* fmt = 0 == i % 7 ? "%d.the.long.way.round" : "%d";
+		int keyLength = snprintf( NULL, 0, fmt, i ) + 1;
 		keys[i] = (char*)malloc( keyLength * sizeof(char) );
 		values[i] = i;
-		sprintf( keys[i], "%d", i );
+		sprintf( keys[i], fmt, i );
 
 		if( &values[i] != put_Map( M, strlen(keys[i]), keys[i], &values[i] ) )
 			fprintf(stderr, "FAILED to insert %s=%d\n", keys[i], values[i]);
@@ -412,16 +641,21 @@ int main( int argc, char* argv[] ) {
 
 	bool fail = false;
 	printf("Ok. Verifying key lookups...\n");
-	for( int i=0; i<N; i++ ) {
-
-		pointer value = lookup_Map( M, strlen(keys[i]), keys[i] );
-		if( value != &values[i] ) {
-			printf(" FAIL: 0x%x *(%p) != 0x%x *(%p)\n", 
-			       *(int*)value, value, values[i], &values[i]);
-			fail = true;
-		}
+	fail |= !verify( M, N, keys, values, 1 );
 
+	printf("Removing every other key...\n");
+	for( int i=1; i<N; i+=2 ) {
+		if( &values[i] != remove_Map( M, strlen(keys[i]), keys[i] ) )
+			fprintf(stderr, "FAILED to remove %s\n", keys[i]);
 	}
+	fail |= !verify( M, N, keys, values, 2 );
+	fail |= size_Map(M) != (uint)(N+1)/2;
+
+	printf("Putting them back...\n");
+	for( int i=1; i<N; i+=2 )
+		put_Map( M, strlen(keys[i]), keys[i], &values[i] );
+	fail |= !verify( M, N, keys, values, 1 );
+
 	if( fail ) 
 		printf("Oops; some lookups returned incorrect values.\n");
 	else
@@ -443,8 +677,23 @@ int main( int argc, char* argv[] ) {
 	printf("  S:    %d\n", M->S);
 	printf("  Load: %f\n", load_Map(M));
 
-	destroy_Map( M );
-	
+	delete_Map( M );
+
+	for( int i=0; i<N; i++ )
+		free( keys[i] );
+	free( keys );
+	free( values );
+
+	printf("\n");
+	for( int nTags=64; nTags<=64*1024; nTags*=8 )
+		benchmark( nTags, 4*1024*1024 );
+
+	if( fail || count != N ) {
+		printf("\nFAILED\n");
+		return 1;
+	}
+
+	printf("\nOk\n");
 	return 0;
 
 }
@@ -2,6 +2,7 @@
 
 #include "data.hash.h"
 #include "data.list.h"
+#include "data.list.mixin.h"
 #include "data.map.h"
 
 #include "mm.region.h"
@@ -109,7 +110,7 @@ Map* new_Map( zone_p Z, int initial_capacity ) {
 
 	Map* map = zalloc( Z, sizeof(Map) );
 	map->Z = Z;
-	map->R = region( Z, "data.map" );
+	map->R = region( "data.map" );
 	map->load       = 0.0f;
 	map->n          = 0;
 	map->s          = (initial_capacity > 0 ? initial_capacity : defaultBuckets);
@@ -120,7 +121,7 @@ Map* new_Map( zone_p Z, int initial_capacity ) {
 
 }
 
-void      destroy_Map( Map* map ) {
+void      delete_Map( Map* map ) {
 
 	rfree( map->R );
 	zfree( map->Z, map->buckets );
@@ -274,7 +275,7 @@ int main( int argc, char* argv ) {
 	printf("  S:    %d\n", M->s);
 	printf("  Load: %f\n", M->load);
 
-	destroy_Map( M );
+	delete_Map( M );
 	
 	return 0;
 
@@ -0,0 +1,465 @@
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "data.pool.h"
+#include "mm.region.h"
+
+#define align( alignment, sz ) \
+	( ((sz) + (alignment) - 1) & ~((alignment) - 1) )
+
+static inline Pool_Node* node_at( const Pool* pool, uint32 i ) {
+
+	return Pool_Node_item( at_Pool( pool, i ) );
+
+}
+
+// Double the capacity. The old array is left to the region, which bounds
+// the waste to the size of the array.
+static void grow( Pool* pool ) {
+
+	uint32 capacity = pool->capacity > 0 ? 2 * pool->capacity : poolMinCapacity;
+	uint8* items    = ralloc( pool->R, (size_t)capacity * pool->stride );
+
+	if( pool->used > 0 )
+		memcpy( items, pool->items, (size_t)pool->used * pool->stride );
+
+	pool->items    = items;
+	pool->capacity = capacity;
+
+}
+
+// Instantiation
+Pool*          new_Pool( region_p r, uint li_size ) {
+
+	region_p R = (NULL != r) ? r : region( "pool" );
+	Pool* pool = ralloc( R, sizeof(Pool) );
+
+	pool->R       = R;
+	pool->ownsR   = (NULL == r);
+	pool->li_size = li_size;
+
+	// Items of 16 bytes or more may hold vectors, so keep them 16-byte aligned
+	pool->stride  = align( li_size >= 16 ? 16 : 8, sizeof(Pool_Node) + li_size );
+
+	pool->head = pool->tail = nilPool;
+	pool->size = 0;
+
+	pool->free = nilPool;
+	pool->used = 0;
+
+	pool->capacity = 0;
+	pool->items    = NULL;
+
+	return pool;
+
+}
+
+void        delete_Pool( Pool* pool ) {
+
+	// Everything belongs to the region; a region of the pool's own making
+	// has nothing else in it
+	if( pool->ownsR )
+		rfree( pool->R );
+
+}
+
+pointer        new_Pool_item( Pool* pool ) {
+
+	Pool_Node* node;
+
+	if( nilPool != pool->free ) {
+
+		node = node_at( pool, pool->free );
+		pool->free = node->next;
+
+	} else {
+
+		if( pool->used == pool->capacity )
+			grow( pool );
+
+		uint32 i = pool->used++;
+
+		node = node_at( pool, i );
+		node->self = i;
+
+	}
+
+	node->prev = node->next = nilPool;
+	return node->value;
+
+}
+
+void          free_Pool_item( Pool* pool, pointer li ) {
+
+	Pool_Node* node = Pool_Node_item(li);
+
+	node->prev = nilPool;
+	node->next = pool->free;
+	pool->free = node->self;
+
+}
+
+// Functions
+uint          size_Pool( const Pool* pool ) {
+
+	return pool->size;
+
+}
+
+uint32       index_Pool( const Pool* pool, const pointer li ) {
+
+	(void)pool;
+	return Pool_Node_item(li)->self;
+
+}
+
+pointer       last_Pool( const Pool* pool ) {
+
+	return isempty_Pool(pool) ? NULL : at_Pool( pool, pool->tail );
+
+}
+
+pointer       prev_Pool( const Pool* pool, const pointer li ) {
+
+	uint32 prev = Pool_Node_item(li)->prev;
+	return nilPool == prev ? NULL : at_Pool( pool, prev );
+
+}
+
+// Mutators
+pointer  pop_front_Pool( Pool* pool ) {
+
+	if( isempty_Pool(pool) )
+		return NULL;
+
+	pointer front = at_Pool( pool, pool->head );
+	remove_Pool( pool, front );
+
+	return front;
+
+}
+
+pointer   pop_back_Pool( Pool* pool ) {
+
+	if( isempty_Pool(pool) )
+		return NULL;
+
+	pointer back = at_Pool( pool, pool->tail );
+	remove_Pool( pool, back );
+
+	return back;
+
+}
+
+void    push_front_Pool( Pool* pool, pointer li ) {
+
+	Pool_Node* node = Pool_Node_item(li);
+
+	node->prev = nilPool;
+	node->next = pool->head;
+
+	if( isempty_Pool(pool) )
+		pool->tail = node->self;
+	else
+		node_at( pool, pool->head )->prev = node->self;
+
+	pool->head = node->self;
+	pool->size++;
+
+}
+
+void     push_back_Pool( Pool* pool, pointer li ) {
+
+	Pool_Node* node = Pool_Node_item(li);
+
+	node->prev = pool->tail;
+	node->next = nilPool;
+
+	if( isempty_Pool(pool) )
+		pool->head = node->self;
+	else
+		node_at( pool, pool->tail )->next = node->self;
+
+	pool->tail = node->self;
+	pool->size++;
+
+}
+
+// Inserts `li' before `before'; at the back if `before' is NULL
+void insert_before_Pool( Pool* pool, pointer before, pointer li ) {
+
+	if( NULL == before ) {
+		push_back_Pool( pool, li );
+		return;
+	}
+
+	Pool_Node* succ = Pool_Node_item(before);
+	if( nilPool == succ->prev ) {
+		push_front_Pool( pool, li );
+		return;
+	}
+
+	Pool_Node* node = Pool_Node_item(li);
+	Pool_Node* pred = node_at( pool, succ->prev );
+
+	node->prev = pred->self;
+	node->next = succ->self;
+	pred->next = node->self;
+	succ->prev = node->self;
+
+	pool->size++;
+
+}
+
+void        remove_Pool( Pool* pool, pointer li ) {
+
+	Pool_Node* node = Pool_Node_item(li);
+
+	if( nilPool == node->prev )
+		pool->head = node->next;
+	else
+		node_at( pool, node->prev )->next = node->next;
+
+	if( nilPool == node->next )
+		pool->tail = node->prev;
+	else
+		node_at( pool, node->next )->prev = node->prev;
+
+	node->prev = node->next = nilPool;
+	pool->size--;
+
+}
+
+#ifdef __data_pool_TEST__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "data.list.h"
+#include "time.core.h"
+
+static volatile int64 sink;
+
+static uint32 pages_held( const char* name ) {
+
+	region_stats_t stats[64];
+	int n = region_MM_stats( 64, stats );
+
+	for( int i=0; i<n; i++ )
+		if( 0 == strcmp( stats[i].name, name ) )
+			return stats[i].pages;
+
+	return 0;
+
+}
+
+static void check( const Pool* P, const int* expected, int n ) {
+
+	assert( size_Pool(P) == (uint)n );
+	assert( (0 == n) == isempty_Pool(P) );
+
+	int i = 0;
+	for( int* it = first_Pool(P); it; it = next_Pool( P, it ) ) {
+		assert( i < n );
+		assert( *it == expected[i++] );
+	}
+	assert( i == n );
+
+	// ... and backwards
+	for( int* it = last_Pool(P); it; it = prev_Pool( P, it ) )
+		assert( *it == expected[--i] );
+	assert( 0 == i );
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	const int N = argc > 1 ? (int)strtol( argv[1], NULL, 10 ) : 100000;
+	const int M = 100;
+
+	region_p R = region( "data.pool.test" );
+
+	// Basic list operations
+	Pool* P = new_Pool( R, sizeof(int) );
+	check( P, NULL, 0 );
+	assert( NULL == pop_front_Pool(P) && NULL == pop_back_Pool(P) );
+
+	int* items[5];
+	for( int i=0; i<5; i++ ) {
+		items[i] = new_Pool_item( P );
+		*items[i] = i;
+		assert( (uint32)i == index_Pool( P, items[i] ) );
+		assert( items[i] == at_Pool( P, i ) );
+	}
+
+	push_back_Pool( P, items[1] );
+	push_back_Pool( P, items[3] );
+	push_front_Pool( P, items[0] );
+	insert_before_Pool( P, items[3], items[2] );
+	insert_before_Pool( P, NULL, items[4] );
+	check( P, (int[]){ 0, 1, 2, 3, 4 }, 5 );
+
+	int* node;
+	find__Pool( P, node, 3 == *node );
+	assert( node == items[3] );
+	find__Pool( P, node, 5 == *node );
+	assert( NULL == node );
+
+	remove_Pool( P, items[2] );
+	check( P, (int[]){ 0, 1, 3, 4 }, 4 );
+	assert( items[0] == pop_front_Pool( P ) );
+	assert( items[4] == pop_back_Pool( P ) );
+	check( P, (int[]){ 1, 3 }, 2 );
+
+	// Freed items are reused
+	free_Pool_item( P, items[2] );
+	assert( items[2] == new_Pool_item( P ) );
+
+	// Indices, links and alignment survive the pool growing
+	Pool* Q = new_Pool( R, 48 );
+	for( int i=0; i<N; i++ ) {
+		int* it = new_Pool_item( Q );
+		*it = i;
+		push_front_Pool( Q, it );
+		assert( 0 == ((uintptr_t)it & 15) );
+	}
+	assert( size_Pool(Q) == (uint)N );
+	for( int i=0; i<N; i++ )
+		assert( i == *(int*)at_Pool( Q, i ) );
+	int n = N;
+	for( int* it = first_Pool(Q); it; it = next_Pool( Q, it ) )
+		assert( --n == *it );
+	assert( 0 == n );
+
+	rcollect( R );
+
+	// A pool made without a region frees the one it made; a pool given a
+	// region leaves it be
+	Pool* O = new_Pool( NULL, 48 );
+	for( int i=0; i<N; i++ )
+		push_back_Pool( O, new_Pool_item( O ) );
+	assert( pages_held( "pool" ) > 0 );
+	delete_Pool( O );
+	assert( 0 == pages_held( "pool" ) );
+
+	Pool* S = new_Pool( R, sizeof(int) );
+	*(int*)new_Pool_item( S ) = 7;
+	delete_Pool( S );
+	int* after = ralloc( R, sizeof(int) );
+	*after = 7;
+	assert( pages_held( "data.pool.test" ) > 0 );
+
+	rcollect( R );
+
+	// Compare with List: build N items, walk them M times, then churn by
+	// removing and re-inserting items at random
+	int* order = malloc( N * sizeof(int) );
+	for( int i=0; i<N; i++ )
+		order[i] = rand() % N;
+
+	pointer* li = malloc( N * sizeof(pointer) );
+	usec_t timebase;
+	int64  sum;
+
+	// List
+	List* L = new_List( R, sizeof(int) );
+
+	timebase = microseconds();
+	for( int i=0; i<N; i++ ) {
+		li[i] = new_List_item( L );
+		*(int*)li[i] = i;
+		push_back_List( L, li[i] );
+	}
+	usec_t list_build = microseconds() - timebase;
+
+	timebase = microseconds();
+	sum = 0;
+	for( int m=0; m<M; m++ )
+		for( int* it = first_List(L); !istail_List(it); it = next_List(it) )
+			sum += *it;
+	sink = sum;
+	usec_t list_walk = microseconds() - timebase;
+
+	timebase = microseconds();
+	for( int i=0; i<N; i++ ) {
+		pointer it = li[ order[i] ];
+		remove_List( L, it );
+		free_List_item( L, it );
+		li[ order[i] ] = new_List_item( L );
+		*(int*)li[ order[i] ] = order[i];
+		insert_before_List( L, li[ order[N-1-i] ], li[ order[i] ] );
+	}
+	usec_t list_churn = microseconds() - timebase;
+
+	timebase = microseconds();
+	sum = 0;
+	for( int m=0; m<M; m++ )
+		for( int* it = first_List(L); !istail_List(it); it = next_List(it) )
+			sum += *it;
+	sink = sum;
+	usec_t list_walk2 = microseconds() - timebase;
+
+	rcollect( R );
+
+	// Pool; keep indices, since pointers move when the pool grows
+	P = new_Pool( R, sizeof(int) );
+	uint32* idx = malloc( N * sizeof(uint32) );
+
+	timebase = microseconds();
+	for( int i=0; i<N; i++ ) {
+		int* it = new_Pool_item( P );
+		*it = i;
+		push_back_Pool( P, it );
+		idx[i] = index_Pool( P, it );
+	}
+	usec_t pool_build = microseconds() - timebase;
+
+	timebase = microseconds();
+	sum = 0;
+	for( int m=0; m<M; m++ )
+		for( int* it = first_Pool(P); it; it = next_Pool( P, it ) )
+			sum += *it;
+	sink = sum;
+	usec_t pool_walk = microseconds() - timebase;
+
+	timebase = microseconds();
+	for( int i=0; i<N; i++ ) {
+		pointer it = at_Pool( P, idx[ order[i] ] );
+		remove_Pool( P, it );
+		free_Pool_item( P, it );
+		it = new_Pool_item( P );
+		*(int*)it = order[i];
+		idx[ order[i] ] = index_Pool( P, it );
+		insert_before_Pool( P, at_Pool( P, idx[ order[N-1-i] ] ), it );
+	}
+	usec_t pool_churn = microseconds() - timebase;
+
+	timebase = microseconds();
+	sum = 0;
+	for( int m=0; m<M; m++ )
+		for( int* it = first_Pool(P); it; it = next_Pool( P, it ) )
+			sum += *it;
+	sink = sum;
+	usec_t pool_walk2 = microseconds() - timebase;
+
+	assert( size_Pool(P) == (uint)N );
+
+	rfree( R );
+	free( idx );
+	free( li );
+	free( order );
+
+	printf("%d items, walked %d times\n\n", N, M);
+	printf("%6s %10s %10s %10s %10s\n", "", "build", "walk", "churn", "walk");
+	printf("%6s %8.3fms %8.3fms %8.3fms %8.3fms\n", "List",
+	       list_build / 1000.0, list_walk / 1000.0, list_churn / 1000.0, list_walk2 / 1000.0);
+	printf("%6s %8.3fms %8.3fms %8.3fms %8.3fms\n", "Pool",
+	       pool_build / 1000.0, pool_walk / 1000.0, pool_churn / 1000.0, pool_walk2 / 1000.0);
+
+	printf("\nOk\n");
+	return 0;
+
+}
+
+#endif
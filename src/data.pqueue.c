@@ -0,0 +1,266 @@
+#include <assert.h>
+#include <string.h>
+
+#include "data.pqueue.h"
+
+#define defaultCapacity 32
+
+#define arity 4
+
+#define parent( i ) \
+	( ((i) - 1) / arity )
+
+#define first_child( i ) \
+	( arity*(i) + 1 )
+
+// Strict ordering on (key, seq). Sequence numbers are compared by their
+// difference so that wrap-around doesn't break FIFO order among equal keys.
+static inline
+bool precedes( const Pqueue_Entry* a, const Pqueue_Entry* b ) {
+
+	if( a->key != b->key )
+		return a->key < b->key;
+
+	return (int32)(a->seq - b->seq) < 0;
+
+}
+
+static void expand( Pqueue* q ) {
+
+	q->v = zrealloc( q->Z,
+	                 q->v,
+	                 q->capacity * sizeof(Pqueue_Entry),
+	                 2 * q->capacity * sizeof(Pqueue_Entry) );
+	q->capacity = 2 * q->capacity;
+
+}
+
+// Move the hole at `i' up until `e' fits in it
+static void sift_up( Pqueue* q, int i, Pqueue_Entry e ) {
+
+	while( i > 0 ) {
+
+		int p = parent(i);
+		if( !precedes( &e, &q->v[p] ) )
+			break;
+
+		q->v[i] = q->v[p];
+		i = p;
+
+	}
+
+	q->v[i] = e;
+
+}
+
+// Move the hole at `i' down until `e' fits in it
+static void sift_down( Pqueue* q, int i, Pqueue_Entry e ) {
+
+	while( 1 ) {
+
+		int c = first_child(i);
+		if( c >= q->size )
+			break;
+
+		// Least of the (up to) `arity' children
+		int last  = c + arity < q->size ? c + arity : q->size;
+		int least = c;
+		for( int j=c+1; j<last; j++ ) {
+			if( precedes( &q->v[j], &q->v[least] ) )
+				least = j;
+		}
+
+		if( !precedes( &q->v[least], &e ) )
+			break;
+
+		q->v[i] = q->v[least];
+		i = least;
+
+	}
+
+	q->v[i] = e;
+
+}
+
+// Instantiation
+Pqueue*       new_Pqueue( zone_p zone, int capacity ) {
+
+	Pqueue* q = zalloc( zone, sizeof(Pqueue) );
+
+	q->Z = zone;
+	q->seq = 0;
+	q->size = 0;
+	q->capacity = (capacity > 0 ? capacity : defaultCapacity);
+
+	q->v = zalloc( zone, q->capacity * sizeof(Pqueue_Entry) );
+
+	return q;
+
+}
+
+void       delete_Pqueue( Pqueue* q ) {
+
+	zfree( q->Z, q->v );
+	zfree( q->Z, q );
+
+}
+
+// Functions
+uint         size_Pqueue( const Pqueue* q ) {
+
+	return q->size;
+
+}
+
+pointer     first_Pqueue( const Pqueue* q ) {
+
+	return q->size > 0 ? q->v[0].item : NULL;
+
+}
+
+uint32  first_key_Pqueue( const Pqueue* q ) {
+
+	assert( !isempty_Pqueue(q) );
+	return q->v[0].key;
+
+}
+
+// Predicates
+bool      isempty_Pqueue( const Pqueue* q ) {
+
+	return 0 == q->size;
+
+}
+
+// Mutators
+void         push_Pqueue( Pqueue* q, uint32 key, pointer item ) {
+
+	if( q->size == q->capacity )
+		expand(q);
+
+	Pqueue_Entry e = { .key = key, .seq = q->seq++, .item = item };
+	sift_up( q, q->size++, e );
+
+}
+
+pointer       pop_Pqueue( Pqueue* q ) {
+
+	if( isempty_Pqueue(q) )
+		return NULL;
+
+	pointer item = q->v[0].item;
+
+	// Fill the hole at the root with the last entry
+	if( --q->size > 0 )
+		sift_down( q, 0, q->v[q->size] );
+
+	return item;
+
+}
+
+pointer  pop_back_Pqueue( Pqueue* q ) {
+
+	if( isempty_Pqueue(q) )
+		return NULL;
+
+	return q->v[ --q->size ].item;
+
+}
+
+#ifdef __data_pqueue_TEST__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "data.list.h"
+#include "mm.heap.h"
+#include "time.core.h"
+
+struct item_s {
+
+	uint32 key;
+	int    order;
+
+};
+
+int main( int argc, char* argv[] ) {
+
+	const int N = argc > 1 ? (int)strtol( argv[1], NULL, 10 ) : 10000;
+	const int nKeys = 64;
+
+	struct item_s* items = malloc( N * sizeof(struct item_s) );
+	for( int i=0; i<N; i++ ) {
+		items[i].key   = rand() % nKeys;
+		items[i].order = i;
+	}
+
+	// Correctness: keys ascending, FIFO among equal keys
+	Pqueue* Q = new_Pqueue( ZONE_heap, 0 );
+
+	usec_t timebase = microseconds();
+	for( int i=0; i<N; i++ )
+		push_Pqueue( Q, items[i].key, &items[i] );
+
+	struct item_s* prev = NULL;
+	for( int i=0; i<N; i++ ) {
+
+		struct item_s* it = pop_Pqueue( Q );
+		assert( NULL != it );
+		assert( !prev
+		        || prev->key < it->key
+		        || (prev->key == it->key && prev->order < it->order) );
+		prev = it;
+
+	}
+	assert( isempty_Pqueue(Q) );
+	assert( NULL == pop_Pqueue(Q) );
+	usec_t pq_time = microseconds() - timebase;
+
+	// pop_back must leave a valid heap
+	for( int i=0; i<N; i++ )
+		push_Pqueue( Q, items[i].key, &items[i] );
+	for( int i=0; i<N/2; i++ )
+		pop_back_Pqueue( Q );
+
+	prev = NULL;
+	while( !isempty_Pqueue(Q) ) {
+
+		struct item_s* it = pop_Pqueue( Q );
+		assert( !prev || prev->key <= it->key );
+		prev = it;
+
+	}
+
+	delete_Pqueue( Q );
+
+	// Compare against the sorted-list insertion the job queues used to do
+	region_p R = region( "data.pqueue.test" );
+	List* L = new_List( R, sizeof(struct item_s) );
+
+	timebase = microseconds();
+	for( int i=0; i<N; i++ ) {
+
+		struct item_s* it = new_List_item( L );
+		*it = items[i];
+
+		struct item_s* node = NULL;
+		find__List( L, node, it->key < node->key );
+		insert_before_List( L, node, it );
+
+	}
+	while( !isempty_List(L) )
+		pop_front_List( L );
+	usec_t list_time = microseconds() - timebase;
+
+	rfree( R );
+	free( items );
+
+	printf("%d items, %d distinct keys\n", N, nKeys);
+	printf("Pqueue push+pop: %8.3f ms\n", (double)pq_time / 1000.0);
+	printf("List   push+pop: %8.3f ms\n", (double)list_time / 1000.0);
+	printf("\nOk\n");
+	return 0;
+
+}
+
+#endif
@@ -1,7 +1,9 @@
+#include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "data.ringbuf.h"
+#include "sync.atomic.h"
 
 struct ringbuf_s {
 	
@@ -111,11 +113,369 @@ int      read_RINGBUF( ringbuf_p ring, uint16 size, pointer dest ) {
 
 }
 
+pointer   read_span_RINGBUF( ringbuf_p ring, uint16* len ) {
+
+	int avail = available_RINGBUF( ring );
+	int contiguous = ring->buf_size - ring->readp;
+
+	*len = (uint16)(avail < contiguous ? avail : contiguous);
+	return &ring->buf[ ring->readp ];
+
+}
+
+void    commit_read_RINGBUF( ringbuf_p ring, uint16 len ) {
+
+	assert( len <= available_RINGBUF(ring) );
+
+	ring->readp = (ring->readp + len) % ring->buf_size;
+	ring->bytes_read += len;
+
+}
+
+pointer  write_span_RINGBUF( ringbuf_p ring, uint16* len ) {
+
+	int rem = remaining_RINGBUF( ring );
+	int contiguous = ring->buf_size - ring->writep;
+
+	*len = (uint16)(rem < contiguous ? rem : contiguous);
+	return &ring->buf[ ring->writep ];
+
+}
+
+void   commit_write_RINGBUF( ringbuf_p ring, uint16 len ) {
+
+	assert( len <= remaining_RINGBUF(ring) );
+
+	ring->writep = (ring->writep + len) % ring->buf_size;
+	ring->bytes_written += len;
+
+}
+
+// Lock-free rings ////////////////////////////////////////////////////////////
+
+#define cacheLineSize 64
+
+struct lfring_s {
+
+	lfringMode_e mode;
+	uint16       size;      // message size
+	uint32       mask;      // count - 1
+	uint32       stride;    // bytes per slot
+
+	// Keep the writers' and readers' positions on separate cache lines so
+	// the two sides don't keep stealing the line from each other.
+	byte         pad0[cacheLineSize];
+
+	uint32       tail;      // next position to write
+	uint32       head_seen; // SPSC: writer's last look at `head'
+
+	byte         pad1[cacheLineSize];
+
+	uint32       head;      // next position to read
+	uint32       tail_seen; // SPSC: reader's last look at `tail'
+
+	byte         pad2[cacheLineSize];
+
+	// SPSC: `size' bytes per slot
+	// MPMC: uint32 sequence number followed by `size' bytes per slot
+	byte         slots[];
+
+};
+
+#define slot( ring, pos ) \
+	( &(ring)->slots[ ((pos) & (ring)->mask) * (ring)->stride ] )
+
+#define slot_seq( ring, pos ) \
+	( *(uint32*)slot( (ring), (pos) ) )
+
+#define slot_data( ring, pos ) \
+	( slot( (ring), (pos) ) + sizeof(uint32) )
+
+static uint32 pow2_ceil( uint32 x ) {
+
+	uint32 n = 1;
+	while( n < x )
+		n <<= 1;
+
+	return n;
+
+}
+
+// Single producer, single consumer: each side owns one position and only
+// ever reads the other's.
+
+static int write_spsc( lfring_p ring, const pointer data, bool* was_empty ) {
+
+	uint32 pos = ring->tail;
+
+	if( pos - ring->head_seen > ring->mask ) {
+
+		ring->head_seen = atomic_load( ring->head );
+		if( pos - ring->head_seen > ring->mask )
+			return -1;
+
+	}
+
+	memcpy( slot(ring, pos), data, ring->size );
+	atomic_store( ring->tail, pos + 1 );
+
+	if( was_empty ) {
+		
+		atomic_fence();
+		*was_empty = (int32)(atomic_load( ring->head ) - pos) >= 0;
+
+	}
+
+	return ring->size;
+
+}
+
+static int read_spsc( lfring_p ring, pointer dest, bool* was_full ) {
+
+	uint32 pos = ring->head;
+
+	if( pos == ring->tail_seen ) {
+
+		ring->tail_seen = atomic_load( ring->tail );
+		if( pos == ring->tail_seen )
+			return -1;
+
+	}
+
+	memcpy( dest, slot(ring, pos), ring->size );
+	atomic_store( ring->head, pos + 1 );
+
+	if( was_full ) {
+
+		atomic_fence();
+		*was_full = (int32)(atomic_load( ring->tail ) - (pos + ring->mask + 1)) >= 0;
+
+	}
+
+	return ring->size;
+
+}
+
+// Multiple producers, multiple consumers. Slot `pos' may be written when its
+// sequence number equals `pos', and read once it equals `pos+1'. Writers and
+// readers claim positions by CAS on `tail' and `head' respectively.
+
+static int write_mpmc( lfring_p ring, const pointer data, bool* was_empty ) {
+
+	uint32 pos = atomic_load( ring->tail );
+
+	while( 1 ) {
+
+		int32 dif = (int32)(atomic_load( slot_seq(ring, pos) ) - pos);
+
+		if( 0 == dif ) {
+
+			if( atomic_cas( ring->tail, pos, pos + 1 ) )
+				break;
+			pos = atomic_load( ring->tail );
+
+		} else if( dif < 0 ) // Slot still holds an unread message
+			return -1;
+		else                 // Someone else claimed it; catch up
+			pos = atomic_load( ring->tail );
+
+	}
+
+	memcpy( slot_data(ring, pos), data, ring->size );
+	atomic_store( slot_seq(ring, pos), pos + 1 );
+
+	if( was_empty ) {
+
+		atomic_fence();
+		*was_empty = (int32)(atomic_load( ring->head ) - pos) >= 0;
+
+	}
+
+	return ring->size;
+
+}
+
+static int read_mpmc( lfring_p ring, pointer dest, bool* was_full ) {
+
+	uint32 pos = atomic_load( ring->head );
+
+	while( 1 ) {
+
+		int32 dif = (int32)(atomic_load( slot_seq(ring, pos) ) - (pos + 1));
+
+		if( 0 == dif ) {
+
+			if( atomic_cas( ring->head, pos, pos + 1 ) )
+				break;
+			pos = atomic_load( ring->head );
+
+		} else if( dif < 0 ) // Nothing written here yet
+			return -1;
+		else
+			pos = atomic_load( ring->head );
+
+	}
+
+	memcpy( dest, slot_data(ring, pos), ring->size );
+	atomic_store( slot_seq(ring, pos), pos + ring->mask + 1 );
+
+	if( was_full ) {
+
+		atomic_fence();
+		*was_full = (int32)(atomic_load( ring->tail ) - (pos + ring->mask + 1)) >= 0;
+
+	}
+
+	return ring->size;
+
+}
+
+lfring_p new_LFRING( lfringMode_e mode, uint16 size, uint16 count ) {
+
+	uint32 n = pow2_ceil( count > 0 ? count : 1 );
+	uint32 stride = (lfringMPMC == mode)
+		? (sizeof(uint32) + size + sizeof(uint32) - 1) & ~(sizeof(uint32) - 1)
+		: size;
+
+	lfring_p ring = (lfring_p)malloc( sizeof(lfring_t) + n * stride );
+	if( !ring )
+		return NULL;
+
+	memset( ring, 0, sizeof(lfring_t) + n * stride );
+
+	ring->mode   = mode;
+	ring->size   = size;
+	ring->mask   = n - 1;
+	ring->stride = stride;
+
+	if( lfringMPMC == mode ) {
+		for( uint32 i=0; i<n; i++ )
+			slot_seq(ring, i) = i;
+	}
+
+	return ring;
+
+}
+
+void destroy_LFRING( lfring_p ring ) {
+
+	free(ring);
+
+}
+
+int      write_LFRING( lfring_p ring, const pointer data, bool* was_empty ) {
+
+	return (lfringSPSC == ring->mode)
+		? write_spsc( ring, data, was_empty )
+		: write_mpmc( ring, data, was_empty );
+
+}
+
+int       read_LFRING( lfring_p ring, pointer dest, bool* was_full ) {
+
+	return (lfringSPSC == ring->mode)
+		? read_spsc( ring, dest, was_full )
+		: read_mpmc( ring, dest, was_full );
+
+}
+
+int  available_LFRING( lfring_p ring ) {
+
+	int n = (int32)(atomic_load( ring->tail ) - atomic_load( ring->head ));
+	return n < 0 ? 0 : n;
+
+}
+
+int  remaining_LFRING( lfring_p ring ) {
+
+	return (int)(ring->mask + 1) - available_LFRING( ring );
+
+}
+
+pointer   read_span_LFRING( lfring_p ring, int* count ) {
+
+	assert( lfringSPSC == ring->mode );
+
+	uint32 pos = ring->head;
+	uint32 contiguous = ring->mask + 1 - (pos & ring->mask);
+
+	ring->tail_seen = atomic_load( ring->tail );
+	uint32 avail = ring->tail_seen - pos;
+
+	*count = (int)(avail < contiguous ? avail : contiguous);
+	return slot(ring, pos);
+
+}
+
+void    commit_read_LFRING( lfring_p ring, int count, bool* was_full ) {
+
+	assert( lfringSPSC == ring->mode );
+	assert( (uint32)count <= ring->tail_seen - ring->head );
+
+	if( 0 == count ) {
+		if( was_full ) *was_full = false;
+		return;
+	}
+
+	uint32 first = ring->head;
+	atomic_store( ring->head, first + count );
+
+	if( was_full ) {
+
+		atomic_fence();
+		*was_full = (int32)(atomic_load( ring->tail ) - (first + ring->mask + 1)) >= 0;
+
+	}
+
+}
+
+pointer  write_span_LFRING( lfring_p ring, int* count ) {
+
+	assert( lfringSPSC == ring->mode );
+
+	uint32 pos = ring->tail;
+	uint32 contiguous = ring->mask + 1 - (pos & ring->mask);
+
+	ring->head_seen = atomic_load( ring->head );
+	uint32 rem = ring->mask + 1 - (pos - ring->head_seen);
+
+	*count = (int)(rem < contiguous ? rem : contiguous);
+	return slot(ring, pos);
+
+}
+
+void   commit_write_LFRING( lfring_p ring, int count, bool* was_empty ) {
+
+	assert( lfringSPSC == ring->mode );
+	assert( (uint32)count <= ring->mask + 1 - (ring->tail - ring->head_seen) );
+
+	if( 0 == count ) {
+		if( was_empty ) *was_empty = false;
+		return;
+	}
+
+	uint32 first = ring->tail;
+	atomic_store( ring->tail, first + count );
+
+	if( was_empty ) {
+
+		atomic_fence();
+		*was_empty = (int32)(atomic_load( ring->head ) - first) >= 0;
+
+	}
+
+}
+
 #ifdef __data_ringbuf_TEST__
 
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "sync.spinlock.h"
+#include "sync.thread.h"
+#include "time.core.h"
+
 void produce( ringbuf_p ring ) {
 
 	int i = rand() % 1000;
@@ -135,6 +495,148 @@ void consume( ringbuf_p ring ) {
 
 }
 
+// Contention benchmark ///////////////////////////////////////////////////////
+//
+// Producers write the values 1..N/P; once they are done, one 0 per consumer
+// is written to tell the consumers to stop. Consumers sum what they read, so
+// we can check nothing was lost or duplicated.
+
+enum { benchLocked = -1 };
+
+struct bench_s {
+
+	int        mode;      // benchLocked or an lfringMode_e
+
+	spinlock_t lock;
+	ringbuf_p  ring;
+	lfring_p   lfring;
+
+	uint32     per_producer;
+	uint64     sum;
+
+};
+
+static bool bench_write( struct bench_s* b, uint32 v ) {
+
+	if( benchLocked == b->mode ) {
+
+		lock_SPINLOCK( &b->lock );
+		int ret = write_RINGBUF( b->ring, sizeof(v), &v );
+		unlock_SPINLOCK( &b->lock );
+
+		return ret > 0;
+
+	}
+	return write_LFRING( b->lfring, &v, NULL ) > 0;
+
+}
+
+static bool bench_read( struct bench_s* b, uint32* v ) {
+
+	if( benchLocked == b->mode ) {
+
+		lock_SPINLOCK( &b->lock );
+		int ret = read_RINGBUF( b->ring, sizeof(*v), v );
+		unlock_SPINLOCK( &b->lock );
+
+		return ret > 0;
+
+	}
+	return read_LFRING( b->lfring, v, NULL ) > 0;
+
+}
+
+static int bench_producer( struct bench_s* b ) {
+
+	for( uint32 v=1; v<=b->per_producer; v++ ) {
+		while( !bench_write( b, v ) )
+			yield_THREAD();
+	}
+
+	return 0;
+
+}
+
+static int bench_consumer( struct bench_s* b ) {
+
+	uint64 sum = 0;
+	uint32 v;
+
+	while( 1 ) {
+
+		if( !bench_read( b, &v ) ) {
+			yield_THREAD();
+			continue;
+		}
+
+		if( 0 == v )
+			break;
+		sum += v;
+
+	}
+
+	atomic_add( b->sum, sum );
+	return 0;
+
+}
+
+static void bench( const char* name, int mode, int n_producers, int n_consumers, uint32 N ) {
+
+	const uint16 count = 1024;
+
+	struct bench_s b = {
+		.mode         = mode,
+		.per_producer = N / n_producers,
+		.sum          = 0
+	};
+
+	if( benchLocked == mode ) {
+		init_SPINLOCK( &b.lock );
+		b.ring = new_RINGBUF( sizeof(uint32), count );
+	} else
+		b.lfring = new_LFRING( mode, sizeof(uint32), count );
+
+	thread_t producers[ n_producers ];
+	thread_t consumers[ n_consumers ];
+
+	usec_t timebase = microseconds();
+
+	for( int i=0; i<n_consumers; i++ )
+		create_THREAD( &consumers[i], (threadfunc_f)bench_consumer, &b );
+	for( int i=0; i<n_producers; i++ )
+		create_THREAD( &producers[i], (threadfunc_f)bench_producer, &b );
+
+	for( int i=0; i<n_producers; i++ )
+		join_THREAD( &producers[i], NULL );
+
+	for( int i=0; i<n_consumers; i++ ) {
+		while( !bench_write( &b, 0 ) )
+			yield_THREAD();
+	}
+	for( int i=0; i<n_consumers; i++ )
+		join_THREAD( &consumers[i], NULL );
+
+	usec_t elapsed = microseconds() - timebase;
+
+	uint64 n = b.per_producer;
+	uint64 expected = (uint64)n_producers * n * (n + 1) / 2;
+	if( expected != b.sum )
+		printf("%s: checksum mismatch! expected %llu, got %llu\n", 
+		       name, (unsigned long long)expected, (unsigned long long)b.sum);
+
+	uint64 total = (uint64)n_producers * n;
+	printf("%-10s %2dP x %2dC %12.2f Mmsg/s\n", 
+	       name, n_producers, n_consumers, 
+	       (double)total / (double)elapsed);
+
+	if( benchLocked == mode ) {
+		destroy_SPINLOCK( &b.lock );
+		destroy_RINGBUF( b.ring );
+	} else
+		destroy_LFRING( b.lfring );
+
+}
+
 int main( int argc, char* argv[] ) {
 
 	// Use prime # to ensure we exercise all code paths
@@ -146,6 +648,119 @@ int main( int argc, char* argv[] ) {
 	}
 
 	destroy_RINGBUF(ring);
+
+	// Lock-free rings: fill, drain and check the transition flags
+	for( lfringMode_e mode=lfringSPSC; mode<=lfringMPMC; mode++ ) {
+
+		lfring_p lf = new_LFRING( mode, sizeof(int), 13 );
+		int n = remaining_LFRING(lf);
+		assert( 16 == n );
+
+		for( int round=0; round<3; round++ ) {
+
+			bool was_empty, was_full;
+			int ret, x;
+
+			for( int i=0; i<n; i++ ) {
+				ret = write_LFRING( lf, &i, &was_empty );
+				assert( sizeof(int) == ret );
+				assert( was_empty == (0 == i) );
+			}
+
+			x = -1;
+			ret = write_LFRING( lf, &x, NULL );
+			assert( ret < 0 );
+			assert( n == available_LFRING(lf) );
+
+			for( int i=0; i<n; i++ ) {
+				ret = read_LFRING( lf, &x, &was_full );
+				assert( sizeof(int) == ret );
+				assert( x == i );
+				assert( was_full == (0 == i) );
+			}
+
+			ret = read_LFRING( lf, &x, NULL );
+			assert( ret < 0 );
+
+		}
+
+		destroy_LFRING( lf );
+
+	}
+
+	// Spans: write and read in place across the wrap-around point
+	ring = new_RINGBUF( sizeof(char), 13 );
+	for( int round=0; round<10; round++ ) {
+
+		char   c = 0;
+		uint16 len;
+
+		for( int i=0; i<2; i++ ) {
+			char* span = write_span_RINGBUF( ring, &len );
+			for( int j=0; j<len; j++ )
+				span[j] = c++;
+			commit_write_RINGBUF( ring, len );
+		}
+		assert( 0 == remaining_RINGBUF(ring) );
+
+		// Consume a bit less than everything so the next round wraps
+		char x = 0;
+		for( int i=0; i<2; i++ ) {
+			char* span = read_span_RINGBUF( ring, &len );
+			for( int j=0; j<len; j++ )
+				assert( span[j] == x++ );
+			commit_read_RINGBUF( ring, len );
+		}
+		assert( 0 == available_RINGBUF(ring) );
+
+		char buf[5];
+		write_RINGBUF( ring, 5, "abcde" );
+		read_RINGBUF( ring, 5, buf );
+		assert( 0 == memcmp( buf, "abcde", 5 ) );
+
+	}
+	destroy_RINGBUF(ring);
+
+	lfring_p lf = new_LFRING( lfringSPSC, sizeof(int), 16 );
+	for( int round=0, v=0, w=0; round<10; round++ ) {
+
+		bool was_empty, was_full;
+		int  count;
+
+		int* span = write_span_LFRING( lf, &count );
+		assert( count > 0 );
+		for( int j=0; j<count; j++ )
+			span[j] = v++;
+		commit_write_LFRING( lf, count, &was_empty );
+		assert( was_empty );
+
+		span = read_span_LFRING( lf, &count );
+		assert( count > 0 );
+		int first = span[0];
+		assert( first == w );
+		commit_read_LFRING( lf, 1, &was_full );
+		w++;
+
+		// Drain the rest one at a time
+		int x;
+		while( read_LFRING( lf, &x, NULL ) > 0 )
+			assert( x == w++ );
+
+	}
+	destroy_LFRING( lf );
+
+	uint32 N = argc > 1 ? (uint32)strtol( argv[1], NULL, 10 ) : 1000000;
+
+	printf("\n%u messages of %zu bytes; ring of 1024\n\n", N, sizeof(uint32));
+	bench( "spinlock", benchLocked, 1, 1, N );
+	bench( "spsc",     lfringSPSC,  1, 1, N );
+	bench( "mpmc",     lfringMPMC,  1, 1, N );
+	for( int n=2; n<=4; n*=2 ) {
+		bench( "spinlock", benchLocked, n, n, N );
+		bench( "mpmc",     lfringMPMC,  n, n, N );
+	}
+
+	printf("\nOk\n");
 	return 0;
 
 }
@@ -130,21 +130,35 @@ static int detail_ev( const ev_t* ev, int maxlen, char* dst ) {
 
 // Echo job; This is the base-level `sink` installed at the bottom of each 
 // Ev_Channel *. It simply echoes the `detail` string of the event to stdout.
+//
+// Events are drained in batches of up to `echoBatch` per channel read; they 
+// are packed `ev_size` bytes apart in `evs`, so each is copied out into `ev`
+// before use.
+#define echoBatch 16
+
 define_job( void, ev_echo, 
 
-            ev_t ev;
-            char ev_desc[4092] ) {
+            ev_t  ev;
+            uint8 evs[echoBatch * sizeof(ev_t)];
+            int   count;
+            char  ev_desc[4092] ) {
 
 	begin_job;
 	
 	while(1) {
 
-		readch_buf( arg(source), arg(ev_size), &local(ev) );
+		readch_batch_buf( arg(source), arg(ev_size), echoBatch, local(evs), local(count) );
+
+		for( int i=0; i<local(count); i++ ) {
+
+			memcpy( &local(ev), &local(evs)[i * arg(ev_size)], arg(ev_size) );
+
+			if( detail_ev( &local(ev), sizeof(local(ev_desc)), local(ev_desc) ) > 0 )
+				trace( "% 8.4fs %s", 
+				       (double)local(ev).info.time / usec_perSecond, 
+				       local(ev_desc) );
 
-		if( detail_ev( &local(ev), sizeof(local(ev_desc)), local(ev_desc) ) > 0 )
-			trace( "% 8.4fs %s", 
-			       (double)local(ev).info.time / usec_perSecond, 
-			       local(ev_desc) );
+		}
 		
 	}
 	
@@ -185,9 +199,15 @@ int pump_Ev( uint32 tick ) {
 	// 3. Lookup event channel
 	// 4. Write it to the event channel's sink
 	// 5. Repeat until no more events in SDL queue
+	//
+	// Channels are flushed once per batch of SDL events rather than once per
+	// event, so a burst of input wakes each sink's reader at most once.
 	int total = 0;
 	while( true ) {
 
+		Channel* touched[ numEvents ];
+		int      ntouched = 0;
+
 		int count = SDL_PeepEvents(&events[0], numEvents, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
 		for( int i=0; i<count; i++ ) {
 
@@ -240,11 +260,18 @@ int pump_Ev( uint32 tick ) {
 				
 			} else {
 
-				flush_Channel(chan);
+				int j = 0;
+				while( j < ntouched && touched[j] != chan )
+					j++;
+				if( j == ntouched )
+					touched[ ntouched++ ] = chan;
 
 			}
 			
 		}
+		for( int j=0; j<ntouched; j++ )
+			flush_Channel( touched[j] );
+
 		if( !(count > 0) )
 			break;
 
@@ -281,7 +308,7 @@ Ev_Channel *open_Ev( ev_adaptor_p adaptor, ... ) {
 
 	// Initialize a new channel
 	static const int bufSize = 16;
-	Channel*         sink    = new_Channel( adaptor->ev_size, bufSize );
+	Channel*         sink    = new_Channel_mode( channelSPSC, adaptor->ev_size, bufSize );
 	Handle           echo_job;
 	devices[type].params.source  = sink;
 	devices[type].params.ev_size = adaptor->ev_size;
@@ -120,6 +120,11 @@ static char *slurp( const char *path ) {
 int main(int argc, char* argv[]) {
 	
 	region_p R = region("main");
+
+	// Log region memory usage every so many seconds, e.g. FLO_REGION_REPORT=10
+	const char* report = getenv( "FLO_REGION_REPORT" );
+	if( report )
+		region_MM_report_every( (usec_t)(atof( report ) * usec_perSecond) );
 	
 	add_Res_path( "file", "${PWD}/res" );
 	load_Res_spec( RES_SPEC );
@@ -244,7 +249,7 @@ int main(int argc, char* argv[]) {
 	typeof_Job_params( window_Ev_monitor ) window_params = { display, view.lens, windowEv };
 	submit_Job( 0, ioBound, NULL, (jobfunc_f)window_Ev_monitor, &window_params );
 
-	Channel *trackballSink = new_Channel( sizeof(ev_cursor_t), 2 );
+	Channel *trackballSink = new_Channel_mode( channelSPSC, sizeof(ev_cursor_t), 2 );
 	typeof_Job_params( cursor_Ev_trackball ) trackball_params = {
 		trackballSink,
 		.5f,
@@ -261,7 +266,7 @@ int main(int argc, char* argv[]) {
 	Handle muxJob = submit_Job( 0, ioBound, NULL, (jobfunc_f)button_Ev_mux, &mux_params );
 
 	// Start the render loop
-	Channel *clkSink = new_Channel( sizeof(float), 1 );
+	Channel *clkSink = new_Channel_mode( channelSPSC, sizeof(float), 1 );
 	Clock       *clk = new_Clock( R, 1.f/10.f, clkSink );
 
 	start_Clock( clk, 1.f );
@@ -294,6 +299,11 @@ int main(int argc, char* argv[]) {
 
 	shutdown_Jobs();
 
+	if( report ) {
+		region_MM_report_every( 0 );
+		region_MM_report();
+	}
+
 	rfree( R );
 	return 0;
 
@@ -307,7 +317,7 @@ define_job( void, window_Ev_monitor,
 
 	begin_job;
 
-	local(source)   = new_Channel( sizeof(ev_window_t), 16 );
+	local(source)   = new_Channel_mode( channelSPSC, sizeof(ev_window_t), 16 );
 	local(passthru) = push_Ev_sink( arg(evch), local(source) );
 
 	while( !quit_requested ) {
@@ -383,10 +393,10 @@ define_job( void, button_Ev_mux,
 
 	begin_job;
 
-	local(btnSource)   = new_Channel( sizeof(local(btnEv)), 2 );
+	local(btnSource)   = new_Channel_mode( channelSPSC, sizeof(local(btnEv)), 2 );
 	local(btnPassthru) = push_Ev_sink( arg(btnEvch), local(btnSource) );
 
-	local(crsrSource) = new_Channel( sizeof(local(crsrEv)), 2 );
+	local(crsrSource) = new_Channel_mode( channelSPSC, sizeof(local(crsrEv)), 2 );
 	local(crsrPassthru) = push_Ev_sink( arg(crsrEvch), local(crsrSource) );
 
 	local(muxOps)[0] = channelRead;
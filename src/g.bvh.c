@@ -0,0 +1,1025 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "core.features.h"
+#include "g.bvh.h"
+
+#define nullNode -1
+#define leafNode -1   // `left' of a leaf
+#define freeNode -2   // `left' of a node on the free list
+
+typedef struct {
+
+	AABB  box;        // World bounds
+
+	int32 parent;     // Next free node, on the free list
+	int32 left;
+	int32 right;
+	int32 pad;
+
+} node_t;
+
+typedef struct {
+
+	pointer tag;
+	Xform*  xf;
+	AABB    local;
+	bool    moved;
+
+} leaf_t;
+
+struct Bvh {
+
+	zone_p  Z;
+
+	int32   root;
+	int32   free;
+	int32   capacity;
+	uint    n_leaves;
+
+	node_t* nodes;
+	leaf_t* leaves;   // Parallel to nodes; only leaves use theirs
+
+	int32*  stack;    // For traversals; as deep as there are nodes
+	int32*  moved;
+	uint    n_moved;
+
+};
+
+// Boxes //////////////////////////////////////////////////////////////////////
+
+static inline float4 vabs( float4 v ) {
+
+	return (float4){ fabsf(v.x), fabsf(v.y), fabsf(v.z), fabsf(v.w) };
+
+}
+
+static inline AABB box_union( const AABB* a, const AABB* b ) {
+
+	return (AABB){
+		{ fminf( a->mins.x, b->mins.x ), fminf( a->mins.y, b->mins.y ), fminf( a->mins.z, b->mins.z ), 1.f },
+		{ fmaxf( a->maxs.x, b->maxs.x ), fmaxf( a->maxs.y, b->maxs.y ), fmaxf( a->maxs.z, b->maxs.z ), 1.f }
+	};
+
+}
+
+static inline float box_area( const AABB* a ) {
+
+	float dx = a->maxs.x - a->mins.x;
+	float dy = a->maxs.y - a->mins.y;
+	float dz = a->maxs.z - a->mins.z;
+
+	return 2.f * (dx*dy + dy*dz + dz*dx);
+
+}
+
+static inline bool box_equal( const AABB* a, const AABB* b ) {
+
+	return 0 == memcmp( a, b, sizeof(AABB) );
+
+}
+
+// The box around `local' once transformed by the world matrix of `xf'
+static AABB world_bounds( const leaf_t* leaf ) {
+
+	if( !leaf->xf )
+		return leaf->local;
+
+	const mat44* M = world_Xform( leaf->xf );
+
+	float4 c = vscale( 0.5f, vadd( leaf->local.mins, leaf->local.maxs ) );
+	float4 e = vscale( 0.5f, vsub( leaf->local.maxs, leaf->local.mins ) );
+
+	float4 wc = vadd( vadd( vscale( c.x, M->_1 ), vscale( c.y, M->_2 ) ),
+	                  vadd( vscale( c.z, M->_3 ), M->_4 ) );
+	float4 we = vadd( vadd( vscale( e.x, vabs( M->_1 ) ), vscale( e.y, vabs( M->_2 ) ) ),
+	                  vscale( e.z, vabs( M->_3 ) ) );
+
+	return (AABB){
+		{ wc.x - we.x, wc.y - we.y, wc.z - we.z, 1.f },
+		{ wc.x + we.x, wc.y + we.y, wc.z + we.z, 1.f }
+	};
+
+}
+
+// Nodes //////////////////////////////////////////////////////////////////////
+
+static inline bool is_leaf( const Bvh* bvh, int32 i ) {
+
+	return leafNode == bvh->nodes[i].left;
+
+}
+
+static void grow( Bvh* bvh ) {
+
+	int32 old = bvh->capacity;
+	int32 n   = old > 0 ? 2*old : 64;
+
+	bvh->nodes  = zrealloc( bvh->Z, bvh->nodes,  old * sizeof(node_t), n * sizeof(node_t) );
+	bvh->leaves = zrealloc( bvh->Z, bvh->leaves, old * sizeof(leaf_t), n * sizeof(leaf_t) );
+	bvh->stack  = zrealloc( bvh->Z, bvh->stack,  old * sizeof(int32),  n * sizeof(int32) );
+	bvh->moved  = zrealloc( bvh->Z, bvh->moved,  old * sizeof(int32),  n * sizeof(int32) );
+
+	// Thread the new nodes onto the free list
+	for( int32 i=old; i<n; i++ ) {
+		bvh->nodes[i].left   = freeNode;
+		bvh->nodes[i].parent = i+1 < n ? i+1 : bvh->free;
+		bvh->leaves[i].moved = false;
+	}
+	bvh->free     = old;
+	bvh->capacity = n;
+
+}
+
+static int32 alloc_node( Bvh* bvh ) {
+
+	if( nullNode == bvh->free )
+		grow( bvh );
+
+	int32 i   = bvh->free;
+	bvh->free = bvh->nodes[i].parent;
+
+	bvh->nodes[i].parent = nullNode;
+	bvh->nodes[i].left   = leafNode;
+	bvh->nodes[i].right  = nullNode;
+
+	return i;
+
+}
+
+static void free_node( Bvh* bvh, int32 i ) {
+
+	bvh->nodes[i].left   = freeNode;
+	bvh->nodes[i].parent = bvh->free;
+	bvh->free = i;
+
+}
+
+// Recomputes the boxes of `i' and its ancestors from their children, up to
+// the first that does not change
+static void refit_up( Bvh* bvh, int32 i ) {
+
+	node_t* nodes = bvh->nodes;
+
+	for( ; nullNode != i; i = nodes[i].parent ) {
+
+		AABB box = box_union( &nodes[ nodes[i].left ].box, &nodes[ nodes[i].right ].box );
+		if( box_equal( &box, &nodes[i].box ) )
+			break;
+		nodes[i].box = box;
+
+	}
+
+}
+
+// Puts `leaf' next to the node it adds the least area to (see Catto,
+// "Dynamic Bounding Volume Hierarchies", GDC 2019)
+static void insert_leaf( Bvh* bvh, int32 leaf ) {
+
+	if( nullNode == bvh->root ) {
+		bvh->root = leaf;
+		bvh->nodes[leaf].parent = nullNode;
+		return;
+	}
+
+	AABB  box = bvh->nodes[leaf].box;
+	int32 i   = bvh->root;
+
+	while( !is_leaf( bvh, i ) ) {
+
+		const node_t* n = &bvh->nodes[i];
+
+		AABB  merged = box_union( &n->box, &box );
+		float area   = box_area( &merged );
+
+		// Pairing with this node creates a parent of `area'; going lower
+		// grows this node's box, and every one below, by the difference
+		float cost    = 2.f * area;
+		float inherit = 2.f * (area - box_area( &n->box ));
+
+		float costs[2];
+		int32 kids[2] = { n->left, n->right };
+		for( int k=0; k<2; k++ ) {
+
+			const node_t* kid = &bvh->nodes[ kids[k] ];
+			AABB m = box_union( &kid->box, &box );
+
+			costs[k] = box_area( &m ) + inherit;
+			if( !is_leaf( bvh, kids[k] ) )
+				costs[k] -= box_area( &kid->box );
+
+		}
+
+		if( cost < costs[0] && cost < costs[1] )
+			break;
+
+		i = costs[0] < costs[1] ? kids[0] : kids[1];
+
+	}
+
+	int32 sibling = i;
+	int32 old     = bvh->nodes[sibling].parent;
+	int32 p       = alloc_node( bvh );
+
+	node_t* nodes = bvh->nodes;
+
+	nodes[p].parent = old;
+	nodes[p].left   = sibling;
+	nodes[p].right  = leaf;
+	nodes[p].box    = box_union( &nodes[sibling].box, &box );
+
+	nodes[sibling].parent = p;
+	nodes[leaf].parent    = p;
+
+	if( nullNode == old )
+		bvh->root = p;
+	else {
+		if( sibling == nodes[old].left )
+			nodes[old].left = p;
+		else
+			nodes[old].right = p;
+		refit_up( bvh, old );
+	}
+
+}
+
+static void remove_leaf( Bvh* bvh, int32 leaf ) {
+
+	node_t* nodes = bvh->nodes;
+
+	if( leaf == bvh->root ) {
+		bvh->root = nullNode;
+		return;
+	}
+
+	int32 p       = nodes[leaf].parent;
+	int32 g       = nodes[p].parent;
+	int32 sibling = leaf == nodes[p].left ? nodes[p].right : nodes[p].left;
+
+	nodes[sibling].parent = g;
+	if( nullNode == g )
+		bvh->root = sibling;
+	else {
+		if( p == nodes[g].left )
+			nodes[g].left = sibling;
+		else
+			nodes[g].right = sibling;
+		refit_up( bvh, g );
+	}
+
+	free_node( bvh, p );
+
+}
+
+// Instantiation //////////////////////////////////////////////////////////////
+
+Bvh*         new_Bvh( zone_p Z ) {
+
+	Bvh* bvh = zalloc( Z, sizeof(Bvh) );
+
+	bvh->Z        = Z;
+	bvh->root     = nullNode;
+	bvh->free     = nullNode;
+	bvh->capacity = 0;
+	bvh->n_leaves = 0;
+	bvh->nodes    = NULL;
+	bvh->leaves   = NULL;
+	bvh->stack    = NULL;
+	bvh->moved    = NULL;
+	bvh->n_moved  = 0;
+
+	return bvh;
+
+}
+
+void      delete_Bvh( Bvh* bvh ) {
+
+	if( bvh->capacity > 0 ) {
+		zfree( bvh->Z, bvh->nodes );
+		zfree( bvh->Z, bvh->leaves );
+		zfree( bvh->Z, bvh->stack );
+		zfree( bvh->Z, bvh->moved );
+	}
+
+	zfree( bvh->Z, bvh );
+
+}
+
+// Functions //////////////////////////////////////////////////////////////////
+
+uint        size_Bvh( const Bvh* bvh ) {
+
+	return bvh->n_leaves;
+
+}
+
+pointer      tag_Bvh( const Bvh* bvh, int32 leaf ) {
+
+	assert( is_leaf( bvh, leaf ) );
+	return bvh->leaves[leaf].tag;
+
+}
+
+const AABB* bounds_Bvh( const Bvh* bvh, int32 leaf ) {
+
+	assert( is_leaf( bvh, leaf ) );
+	return &bvh->nodes[leaf].box;
+
+}
+
+// Mutators ///////////////////////////////////////////////////////////////////
+
+int32     insert_Bvh( Bvh* bvh, pointer tag, const AABB* bounds, Xform* xf ) {
+
+	int32 i = alloc_node( bvh );
+
+	leaf_t* leaf = &bvh->leaves[i];
+	leaf->tag    = tag;
+	leaf->xf     = xf;
+	leaf->local  = *bounds;
+	leaf->moved  = false;
+
+	bvh->nodes[i].box = world_bounds( leaf );
+
+	insert_leaf( bvh, i );
+	bvh->n_leaves++;
+
+	return i;
+
+}
+
+void      remove_Bvh( Bvh* bvh, int32 leaf ) {
+
+	assert( is_leaf( bvh, leaf ) );
+
+	// Drop it from the moved leaves
+	if( bvh->leaves[leaf].moved ) {
+		for( uint i=0; i<bvh->n_moved; i++ )
+			if( leaf == bvh->moved[i] ) {
+				bvh->moved[i] = bvh->moved[ --bvh->n_moved ];
+				break;
+			}
+		bvh->leaves[leaf].moved = false;
+	}
+
+	remove_leaf( bvh, leaf );
+	free_node( bvh, leaf );
+	bvh->n_leaves--;
+
+}
+
+void        move_Bvh( Bvh* bvh, int32 leaf ) {
+
+	assert( is_leaf( bvh, leaf ) );
+
+	if( bvh->leaves[leaf].moved )
+		return;
+
+	bvh->leaves[leaf].moved = true;
+	bvh->moved[ bvh->n_moved++ ] = leaf;
+
+}
+
+void       refit_Bvh( Bvh* bvh ) {
+
+	for( uint i=0; i<bvh->n_moved; i++ ) {
+
+		int32 leaf = bvh->moved[i];
+
+		bvh->leaves[leaf].moved = false;
+		bvh->nodes[leaf].box    = world_bounds( &bvh->leaves[leaf] );
+
+		refit_up( bvh, bvh->nodes[leaf].parent );
+
+	}
+
+	bvh->n_moved = 0;
+
+}
+
+static inline float centroid( const Bvh* bvh, int32 i, int axis ) {
+
+	const float* lo = &bvh->nodes[i].box.mins.x;
+	const float* hi = &bvh->nodes[i].box.maxs.x;
+
+	return lo[axis] + hi[axis];
+
+}
+
+// Partitions `ids' around the k-th smallest centroid along `axis'
+static void select_median( const Bvh* bvh, int32* ids, int n, int k, int axis ) {
+
+	int lo = 0, hi = n-1;
+	while( lo < hi ) {
+
+		float pivot = centroid( bvh, ids[ (lo+hi) / 2 ], axis );
+
+		int i = lo, j = hi;
+		while( i <= j ) {
+
+			while( centroid( bvh, ids[i], axis ) < pivot ) i++;
+			while( centroid( bvh, ids[j], axis ) > pivot ) j--;
+
+			if( i <= j ) {
+				int32 t = ids[i]; ids[i] = ids[j]; ids[j] = t;
+				i++; j--;
+			}
+
+		}
+
+		if( k <= j )
+			hi = j;
+		else if( k >= i )
+			lo = i;
+		else
+			break;
+
+	}
+
+}
+
+static int32 build( Bvh* bvh, int32* ids, int n ) {
+
+	if( 1 == n )
+		return ids[0];
+
+	// Split at the median along the longest axis of the centroids
+	float lo[3], hi[3];
+	for( int a=0; a<3; a++ )
+		lo[a] = hi[a] = centroid( bvh, ids[0], a );
+
+	for( int i=1; i<n; i++ )
+		for( int a=0; a<3; a++ ) {
+			float c = centroid( bvh, ids[i], a );
+			lo[a] = fminf( lo[a], c );
+			hi[a] = fmaxf( hi[a], c );
+		}
+
+	int axis = 0;
+	for( int a=1; a<3; a++ )
+		if( hi[a] - lo[a] > hi[axis] - lo[axis] )
+			axis = a;
+
+	int m = n / 2;
+	select_median( bvh, ids, n, m, axis );
+
+	int32 left  = build( bvh, ids, m );
+	int32 right = build( bvh, ids + m, n - m );
+	int32 p     = alloc_node( bvh );
+
+	node_t* nodes = bvh->nodes;
+
+	nodes[p].left  = left;
+	nodes[p].right = right;
+	nodes[p].box   = box_union( &nodes[left].box, &nodes[right].box );
+
+	nodes[left].parent  = p;
+	nodes[right].parent = p;
+
+	return p;
+
+}
+
+void     rebuild_Bvh( Bvh* bvh ) {
+
+	// Keep the leaves, bring them up to date, and free everything else
+	int32* ids = bvh->moved;
+	int    n   = 0;
+
+	bvh->free    = nullNode;
+	bvh->n_moved = 0;
+
+	for( int32 i=bvh->capacity-1; i>=0; i-- ) {
+
+		if( is_leaf( bvh, i ) ) {
+
+			bvh->leaves[i].moved = false;
+			bvh->nodes[i].box    = world_bounds( &bvh->leaves[i] );
+			ids[n++] = i;
+
+		} else
+			free_node( bvh, i );
+
+	}
+
+	// The leaves keep their ids, and a tree over n leaves needs n-1 of
+	// the nodes just freed
+	bvh->root = n > 0 ? build( bvh, ids, n ) : nullNode;
+	if( n > 0 )
+		bvh->nodes[ bvh->root ].parent = nullNode;
+
+}
+
+// Frustum culling ////////////////////////////////////////////////////////////
+
+enum {
+
+	cullOutside    = -1,
+	cullIntersects =  0,
+	cullInside     =  1
+
+};
+
+// Up to eight planes, by component; unused planes are (0,0,0,1), which
+// everything is inside
+typedef struct {
+
+	float a[8], b[8], c[8], d[8];
+	float abs_a[8], abs_b[8], abs_c[8];
+
+} planes_t;
+
+static void pack_planes( planes_t* P, const float4* planes, int n ) {
+
+	assert( n <= 8 );
+
+	for( int i=0; i<8; i++ ) {
+
+		float4 p = i < n ? planes[i] : (float4){ 0.f, 0.f, 0.f, 1.f };
+
+		P->a[i] = p.x; P->abs_a[i] = fabsf( p.x );
+		P->b[i] = p.y; P->abs_b[i] = fabsf( p.y );
+		P->c[i] = p.z; P->abs_c[i] = fabsf( p.z );
+		P->d[i] = p.w;
+
+	}
+
+}
+
+// A box is outside a plane when its center is further behind it than its
+// extent reaches along the normal, and inside when it is further in front
+static inline int classify_scalar( const planes_t* P, const AABB* box ) {
+
+	float cx = box->mins.x + box->maxs.x, ex = box->maxs.x - box->mins.x;
+	float cy = box->mins.y + box->maxs.y, ey = box->maxs.y - box->mins.y;
+	float cz = box->mins.z + box->maxs.z, ez = box->maxs.z - box->mins.z;
+
+	int result = cullInside;
+	for( int i=0; i<8; i++ ) {
+
+		// Twice the distance and extent, which compare the same
+		float d = P->a[i]*cx + P->b[i]*cy + P->c[i]*cz + 2.f*P->d[i];
+		float r = P->abs_a[i]*ex + P->abs_b[i]*ey + P->abs_c[i]*ez;
+
+		if( d + r < 0.f )
+			return cullOutside;
+		if( d - r < 0.f )
+			result = cullIntersects;
+
+	}
+
+	return result;
+
+}
+
+#if defined( feature_AVX )
+
+static int classify( const planes_t* P, const AABB* box ) {
+
+	__m256 cx = _mm256_set1_ps( box->mins.x + box->maxs.x );
+	__m256 cy = _mm256_set1_ps( box->mins.y + box->maxs.y );
+	__m256 cz = _mm256_set1_ps( box->mins.z + box->maxs.z );
+	__m256 ex = _mm256_set1_ps( box->maxs.x - box->mins.x );
+	__m256 ey = _mm256_set1_ps( box->maxs.y - box->mins.y );
+	__m256 ez = _mm256_set1_ps( box->maxs.z - box->mins.z );
+
+	__m256 d = _mm256_add_ps( _mm256_mul_ps( _mm256_loadu_ps( P->a ), cx ),
+	                          _mm256_mul_ps( _mm256_loadu_ps( P->b ), cy ) );
+	d = _mm256_add_ps( d, _mm256_mul_ps( _mm256_loadu_ps( P->c ), cz ) );
+	d = _mm256_add_ps( d, _mm256_add_ps( _mm256_loadu_ps( P->d ), _mm256_loadu_ps( P->d ) ) );
+
+	__m256 r = _mm256_add_ps( _mm256_mul_ps( _mm256_loadu_ps( P->abs_a ), ex ),
+	                          _mm256_mul_ps( _mm256_loadu_ps( P->abs_b ), ey ) );
+	r = _mm256_add_ps( r, _mm256_mul_ps( _mm256_loadu_ps( P->abs_c ), ez ) );
+
+	__m256 zero = _mm256_setzero_ps();
+	if( _mm256_movemask_ps( _mm256_cmp_ps( _mm256_add_ps( d, r ), zero, _CMP_LT_OQ ) ) )
+		return cullOutside;
+	if( _mm256_movemask_ps( _mm256_cmp_ps( _mm256_sub_ps( d, r ), zero, _CMP_LT_OQ ) ) )
+		return cullIntersects;
+
+	return cullInside;
+
+}
+
+#elif defined( feature_SSE2 )
+
+static int classify( const planes_t* P, const AABB* box ) {
+
+	__m128 cx = _mm_set1_ps( box->mins.x + box->maxs.x );
+	__m128 cy = _mm_set1_ps( box->mins.y + box->maxs.y );
+	__m128 cz = _mm_set1_ps( box->mins.z + box->maxs.z );
+	__m128 ex = _mm_set1_ps( box->maxs.x - box->mins.x );
+	__m128 ey = _mm_set1_ps( box->maxs.y - box->mins.y );
+	__m128 ez = _mm_set1_ps( box->maxs.z - box->mins.z );
+
+	__m128 zero = _mm_setzero_ps();
+	int    intersects = 0;
+
+	// Two halves of four planes
+	for( int h=0; h<8; h+=4 ) {
+
+		__m128 d = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( P->a + h ), cx ),
+		                       _mm_mul_ps( _mm_loadu_ps( P->b + h ), cy ) );
+		d = _mm_add_ps( d, _mm_mul_ps( _mm_loadu_ps( P->c + h ), cz ) );
+		d = _mm_add_ps( d, _mm_add_ps( _mm_loadu_ps( P->d + h ), _mm_loadu_ps( P->d + h ) ) );
+
+		__m128 r = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( P->abs_a + h ), ex ),
+		                       _mm_mul_ps( _mm_loadu_ps( P->abs_b + h ), ey ) );
+		r = _mm_add_ps( r, _mm_mul_ps( _mm_loadu_ps( P->abs_c + h ), ez ) );
+
+		if( _mm_movemask_ps( _mm_cmplt_ps( _mm_add_ps( d, r ), zero ) ) )
+			return cullOutside;
+		intersects |= _mm_movemask_ps( _mm_cmplt_ps( _mm_sub_ps( d, r ), zero ) );
+
+	}
+
+	return intersects ? cullIntersects : cullInside;
+
+}
+
+#else
+
+#define classify classify_scalar
+
+#endif
+
+uint        cull_Bvh( Bvh* bvh, const float4* planes, int n_planes,
+                      pointer* tags, uint max ) {
+
+	if( nullNode == bvh->root )
+		return 0;
+
+	planes_t P;
+	pack_planes( &P, planes, n_planes );
+
+	const node_t* nodes = bvh->nodes;
+	int32*        stack = bvh->stack;
+	int           sp    = 0;
+	uint          n     = 0;
+
+	// Nodes wholly inside go back on the stack as -(i+1), so that their
+	// subtrees are taken without testing
+	stack[sp++] = bvh->root;
+	while( sp > 0 ) {
+
+		int32 i = stack[--sp];
+		bool  inside = i < 0;
+
+		if( inside )
+			i = -(i+1);
+		else {
+
+			int c = classify( &P, &nodes[i].box );
+			if( cullOutside == c )
+				continue;
+			inside = cullInside == c;
+
+		}
+
+		if( leafNode == nodes[i].left ) {
+
+			if( n < max )
+				tags[n] = bvh->leaves[i].tag;
+			n++;
+
+		} else if( inside ) {
+
+			stack[sp++] = -(nodes[i].right + 1);
+			stack[sp++] = -(nodes[i].left + 1);
+
+		} else {
+
+			stack[sp++] = nodes[i].right;
+			stack[sp++] = nodes[i].left;
+
+		}
+
+	}
+
+	return n;
+
+}
+
+// Ray queries ////////////////////////////////////////////////////////////////
+
+// Where the ray enters `box', if it does before `tmax'
+static inline bool ray_box( const AABB* box, float4 o, float4 inv, float tmax, float* t ) {
+
+	float tx1 = (box->mins.x - o.x) * inv.x, tx2 = (box->maxs.x - o.x) * inv.x;
+	float ty1 = (box->mins.y - o.y) * inv.y, ty2 = (box->maxs.y - o.y) * inv.y;
+	float tz1 = (box->mins.z - o.z) * inv.z, tz2 = (box->maxs.z - o.z) * inv.z;
+
+	float enter = fmaxf( fmaxf( fminf( tx1, tx2 ), fminf( ty1, ty2 ) ),
+	                     fmaxf( fminf( tz1, tz2 ), 0.f ) );
+	float leave = fminf( fminf( fmaxf( tx1, tx2 ), fmaxf( ty1, ty2 ) ),
+	                     fminf( fmaxf( tz1, tz2 ), tmax ) );
+
+	*t = enter;
+	return enter <= leave;
+
+}
+
+int32    raycast_Bvh( Bvh* bvh, float4 origin, float4 dir, float tmax, float* t ) {
+
+	if( nullNode == bvh->root )
+		return nullNode;
+
+	float4 inv = { 1.f / dir.x, 1.f / dir.y, 1.f / dir.z, 0.f };
+
+	const node_t* nodes = bvh->nodes;
+	int32*        stack = bvh->stack;
+	int           sp    = 0;
+
+	int32 hit  = nullNode;
+	float best = tmax;
+	float enter;
+
+	stack[sp++] = bvh->root;
+	while( sp > 0 ) {
+
+		int32 i = stack[--sp];
+
+		if( !ray_box( &nodes[i].box, origin, inv, best, &enter ) )
+			continue;
+
+		if( leafNode == nodes[i].left ) {
+			hit  = i;
+			best = enter;
+			continue;
+		}
+
+		// Nearer child on top
+		float tl, tr;
+		bool  l = ray_box( &nodes[ nodes[i].left ].box,  origin, inv, best, &tl );
+		bool  r = ray_box( &nodes[ nodes[i].right ].box, origin, inv, best, &tr );
+
+		if( l && r ) {
+			if( tl <= tr ) {
+				stack[sp++] = nodes[i].right;
+				stack[sp++] = nodes[i].left;
+			} else {
+				stack[sp++] = nodes[i].left;
+				stack[sp++] = nodes[i].right;
+			}
+		} else if( l )
+			stack[sp++] = nodes[i].left;
+		else if( r )
+			stack[sp++] = nodes[i].right;
+
+	}
+
+	if( nullNode != hit && t )
+		*t = best;
+
+	return hit;
+
+}
+
+#ifdef __g_bvh_TEST__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mm.heap.h"
+#include "time.core.h"
+
+static float frand( float lo, float hi ) {
+
+	return lo + (hi - lo) * (float)rand() / RAND_MAX;
+
+}
+
+// Every internal box holds its children, parents and children agree, the
+// leaves are where their transforms put them, and all of them are reached
+static uint check( Bvh* bvh, int32 i ) {
+
+	if( nullNode == i )
+		return 0;
+
+	const node_t* n = &bvh->nodes[i];
+	if( is_leaf( bvh, i ) ) {
+		AABB box = world_bounds( &bvh->leaves[i] );
+		assert( box_equal( &box, &n->box ) );
+		return 1;
+	}
+
+	for( int k=0; k<2; k++ ) {
+
+		int32 kid = k ? n->right : n->left;
+		const AABB* b = &bvh->nodes[kid].box;
+
+		assert( i == bvh->nodes[kid].parent );
+		assert( n->box.mins.x <= b->mins.x && b->maxs.x <= n->box.maxs.x );
+		assert( n->box.mins.y <= b->mins.y && b->maxs.y <= n->box.maxs.y );
+		assert( n->box.mins.z <= b->mins.z && b->maxs.z <= n->box.maxs.z );
+
+	}
+
+	return check( bvh, n->left ) + check( bvh, n->right );
+
+}
+
+static int compare_ptrs( const void* a, const void* b ) {
+
+	uintptr_t x = *(const uintptr_t*)a, y = *(const uintptr_t*)b;
+	return x < y ? -1 : x > y;
+
+}
+
+// Every leaf, tested alone against the planes
+static uint cull_brute( Bvh* bvh, const float4* planes, int n_planes, pointer* tags ) {
+
+	planes_t P;
+	pack_planes( &P, planes, n_planes );
+
+	uint n = 0;
+	for( int32 i=0; i<bvh->capacity; i++ )
+		if( is_leaf( bvh, i ) && cullOutside != classify_scalar( &P, &bvh->nodes[i].box ) )
+			tags[n++] = bvh->leaves[i].tag;
+
+	return n;
+
+}
+
+static void check_cull( Bvh* bvh, const float4* planes, pointer* a, pointer* b ) {
+
+	uint n = cull_Bvh( bvh, planes, 6, a, bvh->n_leaves );
+	uint m = cull_brute( bvh, planes, 6, b );
+
+	assert( n == m );
+	qsort( a, n, sizeof(pointer), compare_ptrs );
+	qsort( b, m, sizeof(pointer), compare_ptrs );
+	assert( 0 == memcmp( a, b, n * sizeof(pointer) ) );
+
+}
+
+static void check_rays( Bvh* bvh, int n ) {
+
+	for( int r=0; r<n; r++ ) {
+
+		float4 o   = { frand( -50.f, 50.f ), frand( -50.f, 50.f ), frand( -50.f, 50.f ), 1.f };
+		float4 dir = vnormal( (float4){ frand( -1.f, 1.f ), frand( -1.f, 1.f ), frand( -1.f, 1.f ), 0.f } );
+		float4 inv = { 1.f / dir.x, 1.f / dir.y, 1.f / dir.z, 0.f };
+
+		float best = 1000.f, t;
+		for( int32 i=0; i<bvh->capacity; i++ )
+			if( is_leaf( bvh, i ) && ray_box( &bvh->nodes[i].box, o, inv, best, &t ) )
+				best = t;
+
+		int32 hit = raycast_Bvh( bvh, o, dir, 1000.f, &t );
+		if( best < 1000.f ) {
+			assert( nullNode != hit );
+			assert( t == best );
+		} else
+			assert( nullNode == hit );
+
+	}
+
+}
+
+// A frustum at the origin looking down -z with a 90 degree field of view
+static void frustum( float4* planes, float far ) {
+
+	planes[0] = (float4){ -1.f,  0.f, -1.f, 0.f };
+	planes[1] = (float4){  1.f,  0.f, -1.f, 0.f };
+	planes[2] = (float4){  0.f, -1.f, -1.f, 0.f };
+	planes[3] = (float4){  0.f,  1.f, -1.f, 0.f };
+	planes[4] = (float4){  0.f,  0.f, -1.f, -1.f };
+	planes[5] = (float4){  0.f,  0.f,  1.f, far };
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	const int N = argc > 1 ? (int)strtol( argv[1], NULL, 10 ) : 100000;
+
+	region_p R    = region( "g.bvh.TEST" );
+	Xform*   root = new_Xform( R, NULL, NULL );
+
+	float4 planes[6];
+	frustum( planes, 300.f );
+
+	pointer* a = malloc( N * sizeof(pointer) );
+	pointer* b = malloc( N * sizeof(pointer) );
+
+	Xform** xfs    = malloc( N * sizeof(Xform*) );
+	int32*  leaves = malloc( N * sizeof(int32) );
+
+	for( int i=0; i<N; i++ ) {
+		float4 tr = { frand( -500.f, 500.f ), frand( -500.f, 500.f ), frand( -500.f, 500.f ), 1.f };
+		xfs[i] = new_Xform_qr_tr( R, root, NULL,
+		                          qaxis( (float4){ 0.f, 1.f, 0.f, frand( 0.f, 3.f ) } ), tr );
+	}
+
+	printf("%8s %8s %10s %10s %10s %10s %10s %10s\n",
+	       "leaves", "culled", "cull us", "brute us", "refit us", "rebuild us", "ray us", "insert us");
+
+	// Over scene sizes, the same objects
+	for( int n=1000; n<=N; n*=10 ) {
+
+		Bvh* bvh = new_Bvh( ZONE_heap );
+
+		usec_t timebase = microseconds();
+		for( int i=0; i<n; i++ ) {
+			float s = frand( 0.5f, 4.f );
+			AABB bounds = { { -s, -s, -s, 1.f }, { s, s, s, 1.f } };
+			leaves[i] = insert_Bvh( bvh, (pointer)(uintptr_t)(i+1), &bounds, xfs[i] );
+		}
+		usec_t t_insert = microseconds() - timebase;
+
+		assert( (uint)n == size_Bvh( bvh ) );
+		assert( (uint)n == check( bvh, bvh->root ) );
+		check_cull( bvh, planes, a, b );
+		check_rays( bvh, 100 );
+
+		// Move a tenth of them, and refit
+		for( int i=0; i<n; i+=10 ) {
+			translate_Xform( xfs[i], (float4){ frand( -20.f, 20.f ), frand( -20.f, 20.f ), 0.f, 0.f } );
+			move_Bvh( bvh, leaves[i] );
+			move_Bvh( bvh, leaves[i] );
+		}
+
+		// Bring the transforms up to date first; the refit is what is timed
+		world_Xform( root );
+
+		timebase = microseconds();
+		refit_Bvh( bvh );
+		usec_t t_refit = microseconds() - timebase;
+
+		assert( (uint)n == check( bvh, bvh->root ) );
+		check_cull( bvh, planes, a, b );
+
+		// Take out a quarter, some of them moved, and put them back
+		for( int i=0; i<n; i+=4 ) {
+			translate_Xform( xfs[i], (float4){ 1.f, 0.f, 0.f, 0.f } );
+			move_Bvh( bvh, leaves[i] );
+			remove_Bvh( bvh, leaves[i] );
+		}
+		assert( (uint)(n - (n+3)/4) == check( bvh, bvh->root ) );
+		refit_Bvh( bvh );
+
+		for( int i=0; i<n; i+=4 ) {
+			AABB bounds = { { -1.f, -1.f, -1.f, 1.f }, { 1.f, 1.f, 1.f, 1.f } };
+			leaves[i] = insert_Bvh( bvh, (pointer)(uintptr_t)(i+1), &bounds, xfs[i] );
+		}
+		assert( (uint)n == check( bvh, bvh->root ) );
+		check_cull( bvh, planes, a, b );
+
+		timebase = microseconds();
+		rebuild_Bvh( bvh );
+		usec_t t_rebuild = microseconds() - timebase;
+
+		assert( (uint)n == check( bvh, bvh->root ) );
+		check_cull( bvh, planes, a, b );
+		check_rays( bvh, 100 );
+
+		// Query costs
+		const int M = n < 100000 ? 100 : 20;
+		uint visible = 0;
+
+		timebase = microseconds();
+		for( int m=0; m<M; m++ )
+			visible = cull_Bvh( bvh, planes, 6, a, n );
+		usec_t t_cull = microseconds() - timebase;
+
+		timebase = microseconds();
+		for( int m=0; m<M; m++ )
+			cull_brute( bvh, planes, 6, b );
+		usec_t t_brute = microseconds() - timebase;
+
+		const int rays = 1000;
+		timebase = microseconds();
+		for( int r=0; r<rays; r++ ) {
+			float4 dir = vnormal( (float4){ frand( -1.f, 1.f ), frand( -1.f, 1.f ), frand( -1.f, 1.f ), 0.f } );
+			raycast_Bvh( bvh, (float4){ 0.f, 0.f, 0.f, 1.f }, dir, 1000.f, NULL );
+		}
+		usec_t t_ray = microseconds() - timebase;
+
+		printf("%8d %7.1f%% %10.1f %10.1f %10.1f %10.1f %10.2f %10.1f\n",
+		       n, 100.f * (n - visible) / n,
+		       (double)t_cull / M, (double)t_brute / M,
+		       (double)t_refit, (double)t_rebuild,
+		       (double)t_ray / rays, (double)t_insert);
+
+		// Remove everything
+		for( int i=0; i<n; i++ )
+			remove_Bvh( bvh, leaves[i] );
+		assert( 0 == size_Bvh( bvh ) && nullNode == bvh->root );
+		assert( 0 == cull_Bvh( bvh, planes, 6, a, n ) );
+		assert( nullNode == raycast_Bvh( bvh, (float4){ 0.f, 0.f, 0.f, 1.f }, xunit_VEC, 1.f, NULL ) );
+
+		delete_Bvh( bvh );
+
+	}
+
+	free( leaves ); free( xfs ); free( b ); free( a );
+	rfree( R );
+
+	printf("Ok\n");
+	return 0;
+
+}
+
+#endif
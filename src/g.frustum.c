@@ -0,0 +1,363 @@
+#include <assert.h>
+#include <math.h>
+
+#include "core.features.h"
+#include "g.frustum.h"
+
+// Gribb & Hartmann, "Fast Extraction of Viewing Frustum Planes from the
+// World-View-Projection Matrix": a point is inside when -w <= x,y,z <= w in
+// clip space, and each of those is a plane of rows of the matrix.
+Frustum   extract_Frustum( const mat44* M ) {
+
+	// Rows of the (column-major) matrix
+	float4 row[4];
+	const float* m = (const float*)M;
+	for( int r=0; r<4; r++ )
+		row[r] = (float4){ m[r], m[4+r], m[8+r], m[12+r] };
+
+	Frustum f;
+	f.planes[ frustumLeft ]   = vadd( row[3], row[0] );
+	f.planes[ frustumRight ]  = vsub( row[3], row[0] );
+	f.planes[ frustumBottom ] = vadd( row[3], row[1] );
+	f.planes[ frustumTop ]    = vsub( row[3], row[1] );
+	f.planes[ frustumNear ]   = vadd( row[3], row[2] );
+	f.planes[ frustumFar ]    = vsub( row[3], row[2] );
+
+	for( int i=0; i<6; i++ ) {
+		float4 p = f.planes[i];
+		float  l = sqrtf( p.x*p.x + p.y*p.y + p.z*p.z );
+		f.planes[i] = vscale( 1.f / l, p );
+	}
+
+	return f;
+
+}
+
+// A box is outside a plane when its center is further behind it than its
+// extent reaches along the normal, and inside when further in front. Both
+// are doubled, to work from the sums and differences of the corners.
+int8 classify_Frustum_AABB( const Frustum* f, const AABB* box ) {
+
+	float cx = box->mins.x + box->maxs.x, ex = box->maxs.x - box->mins.x;
+	float cy = box->mins.y + box->maxs.y, ey = box->maxs.y - box->mins.y;
+	float cz = box->mins.z + box->maxs.z, ez = box->maxs.z - box->mins.z;
+
+	int8 result = frustumInside;
+	for( int i=0; i<6; i++ ) {
+
+		float4 p = f->planes[i];
+
+		float d = p.x*cx + p.y*cy + p.z*cz + (p.w + p.w);
+		float r = fabsf(p.x)*ex + fabsf(p.y)*ey + fabsf(p.z)*ez;
+
+		if( d + r < 0.f )
+			return frustumOutside;
+		if( d - r < 0.f )
+			result = frustumIntersects;
+
+	}
+
+	return result;
+
+}
+
+static void classify_scalar( const Frustum* f, const AABB_SoA* boxes,
+                             uint first, uint n, int8* out ) {
+
+	for( uint i=first; i<first+n; i++ ) {
+
+		AABB box = {
+			{ boxes->min_x[i], boxes->min_y[i], boxes->min_z[i], 1.f },
+			{ boxes->max_x[i], boxes->max_y[i], boxes->max_z[i], 1.f }
+		};
+		out[i-first] = classify_Frustum_AABB( f, &box );
+
+	}
+
+}
+
+#if defined( feature_AVX )
+
+#define lanes 8
+
+static uint classify_lanes( const Frustum* f, const AABB_SoA* boxes,
+                            uint first, uint n, int8* out ) {
+
+	__m256 a[6], b[6], c[6], d[6], abs_a[6], abs_b[6], abs_c[6];
+	for( int p=0; p<6; p++ ) {
+
+		float4 pl = f->planes[p];
+
+		a[p] = _mm256_set1_ps( pl.x ); abs_a[p] = _mm256_set1_ps( fabsf(pl.x) );
+		b[p] = _mm256_set1_ps( pl.y ); abs_b[p] = _mm256_set1_ps( fabsf(pl.y) );
+		c[p] = _mm256_set1_ps( pl.z ); abs_c[p] = _mm256_set1_ps( fabsf(pl.z) );
+		d[p] = _mm256_set1_ps( pl.w + pl.w );
+
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+
+	uint i = first;
+	for( ; i + lanes <= first + n; i += lanes ) {
+
+		__m256 min_x = _mm256_loadu_ps( boxes->min_x + i ), max_x = _mm256_loadu_ps( boxes->max_x + i );
+		__m256 min_y = _mm256_loadu_ps( boxes->min_y + i ), max_y = _mm256_loadu_ps( boxes->max_y + i );
+		__m256 min_z = _mm256_loadu_ps( boxes->min_z + i ), max_z = _mm256_loadu_ps( boxes->max_z + i );
+
+		__m256 cx = _mm256_add_ps( min_x, max_x ), ex = _mm256_sub_ps( max_x, min_x );
+		__m256 cy = _mm256_add_ps( min_y, max_y ), ey = _mm256_sub_ps( max_y, min_y );
+		__m256 cz = _mm256_add_ps( min_z, max_z ), ez = _mm256_sub_ps( max_z, min_z );
+
+		__m256 outside = zero, intersects = zero;
+		for( int p=0; p<6; p++ ) {
+
+			__m256 dist = _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( a[p], cx ),
+			                                                           _mm256_mul_ps( b[p], cy ) ),
+			                                            _mm256_mul_ps( c[p], cz ) ),
+			                             d[p] );
+			__m256 r    = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( abs_a[p], ex ),
+			                                            _mm256_mul_ps( abs_b[p], ey ) ),
+			                             _mm256_mul_ps( abs_c[p], ez ) );
+
+			outside    = _mm256_or_ps( outside,    _mm256_cmp_ps( _mm256_add_ps( dist, r ), zero, _CMP_LT_OQ ) );
+			intersects = _mm256_or_ps( intersects, _mm256_cmp_ps( _mm256_sub_ps( dist, r ), zero, _CMP_LT_OQ ) );
+
+		}
+
+		// Outside implies intersecting; each takes one off inside
+		int mo = _mm256_movemask_ps( outside );
+		int mi = _mm256_movemask_ps( intersects );
+		for( int j=0; j<lanes; j++ )
+			out[ i - first + j ] = (int8)(frustumInside - ((mi >> j) & 1) - ((mo >> j) & 1));
+
+	}
+
+	return i - first;
+
+}
+
+#elif defined( feature_SSE2 )
+
+#define lanes 4
+
+static uint classify_lanes( const Frustum* f, const AABB_SoA* boxes,
+                            uint first, uint n, int8* out ) {
+
+	__m128 a[6], b[6], c[6], d[6], abs_a[6], abs_b[6], abs_c[6];
+	for( int p=0; p<6; p++ ) {
+
+		float4 pl = f->planes[p];
+
+		a[p] = _mm_set1_ps( pl.x ); abs_a[p] = _mm_set1_ps( fabsf(pl.x) );
+		b[p] = _mm_set1_ps( pl.y ); abs_b[p] = _mm_set1_ps( fabsf(pl.y) );
+		c[p] = _mm_set1_ps( pl.z ); abs_c[p] = _mm_set1_ps( fabsf(pl.z) );
+		d[p] = _mm_set1_ps( pl.w + pl.w );
+
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+
+	uint i = first;
+	for( ; i + lanes <= first + n; i += lanes ) {
+
+		__m128 min_x = _mm_loadu_ps( boxes->min_x + i ), max_x = _mm_loadu_ps( boxes->max_x + i );
+		__m128 min_y = _mm_loadu_ps( boxes->min_y + i ), max_y = _mm_loadu_ps( boxes->max_y + i );
+		__m128 min_z = _mm_loadu_ps( boxes->min_z + i ), max_z = _mm_loadu_ps( boxes->max_z + i );
+
+		__m128 cx = _mm_add_ps( min_x, max_x ), ex = _mm_sub_ps( max_x, min_x );
+		__m128 cy = _mm_add_ps( min_y, max_y ), ey = _mm_sub_ps( max_y, min_y );
+		__m128 cz = _mm_add_ps( min_z, max_z ), ez = _mm_sub_ps( max_z, min_z );
+
+		__m128 outside = zero, intersects = zero;
+		for( int p=0; p<6; p++ ) {
+
+			__m128 dist = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( a[p], cx ),
+			                                                  _mm_mul_ps( b[p], cy ) ),
+			                                      _mm_mul_ps( c[p], cz ) ),
+			                          d[p] );
+			__m128 r    = _mm_add_ps( _mm_add_ps( _mm_mul_ps( abs_a[p], ex ),
+			                                      _mm_mul_ps( abs_b[p], ey ) ),
+			                          _mm_mul_ps( abs_c[p], ez ) );
+
+			outside    = _mm_or_ps( outside,    _mm_cmplt_ps( _mm_add_ps( dist, r ), zero ) );
+			intersects = _mm_or_ps( intersects, _mm_cmplt_ps( _mm_sub_ps( dist, r ), zero ) );
+
+		}
+
+		// Outside implies intersecting; each takes one off inside
+		int mo = _mm_movemask_ps( outside );
+		int mi = _mm_movemask_ps( intersects );
+		for( int j=0; j<lanes; j++ )
+			out[ i - first + j ] = (int8)(frustumInside - ((mi >> j) & 1) - ((mo >> j) & 1));
+
+	}
+
+	return i - first;
+
+}
+
+#else
+
+static uint classify_lanes( const Frustum* f, const AABB_SoA* boxes,
+                            uint first, uint n, int8* out ) {
+
+	return 0;
+
+}
+
+#endif
+
+void     classify_Frustum( const Frustum* f, const AABB_SoA* boxes,
+                           uint first, uint n, int8* out ) {
+
+	uint done = classify_lanes( f, boxes, first, n, out );
+	classify_scalar( f, boxes, first + done, n - done, out + done );
+
+}
+
+#ifdef __g_frustum_TEST__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "time.core.h"
+
+static float frand( float lo, float hi ) {
+
+	return lo + (hi - lo) * (float)rand() / RAND_MAX;
+
+}
+
+// By the corners: outside when all are behind one plane, inside when all
+// are in front of every plane
+static int8 classify_corners( const Frustum* f, const AABB* box ) {
+
+	bool inside = true;
+	for( int i=0; i<6; i++ ) {
+
+		int behind = 0;
+		for( int k=0; k<8; k++ ) {
+
+			float4 p = {
+				k & 1 ? box->maxs.x : box->mins.x,
+				k & 2 ? box->maxs.y : box->mins.y,
+				k & 4 ? box->maxs.z : box->mins.z,
+				1.f
+			};
+			if( vdot( f->planes[i], p ) < 0.f )
+				behind++;
+
+		}
+
+		if( 8 == behind )
+			return frustumOutside;
+		if( behind > 0 )
+			inside = false;
+
+	}
+
+	return inside ? frustumInside : frustumIntersects;
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	const uint N = argc > 1 ? (uint)strtol( argv[1], NULL, 10 ) : 1000000;
+
+	// Looking down -z from (0,0,10), 90 degrees across, near 1 and far 100
+	mat44 proj = mfrustum( -1.f, 1.f, -1.f, 1.f, 1.f, 100.f );
+	mat44 view = mtranslation( (float4){ 0.f, 0.f, -10.f, 1.f } );
+	mat44 vp   = mmul( proj, view );
+
+	Frustum f = extract_Frustum( &vp );
+
+	// The planes are where they should be
+	float4 eye = { 0.f, 0.f, 10.f, 1.f };
+	assert( fabsf( vdot( f.planes[ frustumNear ], (float4){ 0.f, 0.f, 9.f, 1.f } ) ) < 1e-4f );
+	assert( fabsf( vdot( f.planes[ frustumFar ],  (float4){ 0.f, 0.f, -90.f, 1.f } ) ) < 1e-3f );
+	assert( vdot( f.planes[ frustumNear ], eye ) < 0.f );
+	assert( fabsf( vdot( f.planes[ frustumLeft ],  (float4){ -5.f, 0.f, 5.f, 1.f } ) ) < 1e-4f );
+	assert( fabsf( vdot( f.planes[ frustumTop ],   (float4){ 0.f, 5.f, 5.f, 1.f } ) ) < 1e-4f );
+	for( int i=0; i<6; i++ )
+		assert( vdot( f.planes[i], (float4){ 0.f, 0.f, -10.f, 1.f } ) > 0.f );
+
+	AABB in  = { { -1.f, -1.f, -11.f, 1.f }, { 1.f, 1.f, -9.f, 1.f } };
+	AABB out = { { -1.f, -1.f,  11.f, 1.f }, { 1.f, 1.f, 12.f, 1.f } };
+	AABB cut = { { -1.f, -1.f,   5.f, 1.f }, { 1.f, 1.f, 12.f, 1.f } };
+	assert( frustumInside     == classify_Frustum_AABB( &f, &in ) );
+	assert( frustumOutside    == classify_Frustum_AABB( &f, &out ) );
+	assert( frustumIntersects == classify_Frustum_AABB( &f, &cut ) );
+
+	// Random boxes, some around the frustum's edges; an odd count leaves a
+	// tail for the scalar code
+	const uint n = N | 1;
+	float* soa = malloc( 6 * n * sizeof(float) );
+	AABB_SoA boxes = { soa, soa + n, soa + 2*n, soa + 3*n, soa + 4*n, soa + 5*n };
+
+	for( uint i=0; i<n; i++ ) {
+
+		float x = frand( -120.f, 120.f ), y = frand( -120.f, 120.f ), z = frand( -120.f, 20.f );
+		float s = frand( 0.f, 1.f ) < 0.1f ? frand( 0.f, 50.f ) : frand( 0.f, 4.f );
+
+		soa[i]       = x - s; soa[3*n + i] = x + s;
+		soa[n + i]   = y - s; soa[4*n + i] = y + s;
+		soa[2*n + i] = z - s; soa[5*n + i] = z + s;
+
+	}
+
+	int8* simd = malloc( n );
+	int8* ref  = malloc( n );
+
+	classify_Frustum( &f, &boxes, 0, n, simd );
+	classify_scalar( &f, &boxes, 0, n, ref );
+
+	uint counts[3] = { 0 }, disagree = 0;
+	for( uint i=0; i<n; i++ ) {
+
+		assert( simd[i] == ref[i] );
+		counts[ ref[i] + 1 ]++;
+
+		AABB box = {
+			{ boxes.min_x[i], boxes.min_y[i], boxes.min_z[i], 1.f },
+			{ boxes.max_x[i], boxes.max_y[i], boxes.max_z[i], 1.f }
+		};
+		if( classify_corners( &f, &box ) != ref[i] )
+			disagree++;
+
+	}
+
+	// Runs not starting on a lane boundary agree too
+	classify_Frustum( &f, &boxes, 3, n - 3, simd );
+	for( uint i=3; i<n; i++ )
+		assert( simd[i-3] == ref[i] );
+
+	// Corner tests round differently; the odd box right on a plane may go
+	// either way
+	assert( disagree <= n / 100000 + 1 );
+
+	const int M = 10;
+	usec_t timebase;
+
+	timebase = microseconds();
+	for( int m=0; m<M; m++ )
+		classify_Frustum( &f, &boxes, 0, n, simd );
+	usec_t t_simd = microseconds() - timebase;
+
+	timebase = microseconds();
+	for( int m=0; m<M; m++ )
+		classify_scalar( &f, &boxes, 0, n, ref );
+	usec_t t_scalar = microseconds() - timebase;
+
+	printf("%u boxes: %u inside, %u intersecting, %u outside (%u on a plane)\n",
+	       n, counts[2], counts[1], counts[0], disagree);
+	printf("kernel %7.2f ns/box\n", 1000.0 * t_simd / M / n);
+	printf("scalar %7.2f ns/box\n", 1000.0 * t_scalar / M / n);
+
+	free( ref ); free( simd ); free( soa );
+
+	printf("Ok\n");
+	return 0;
+
+}
+
+#endif
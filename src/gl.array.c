@@ -7,6 +7,7 @@
 
 #include "gl.array.h"
 #include "gl.attrib.h"
+#include "gl.cache.h"
 #include "gl.util.h"
 
 // Vertex arrays //////////////////////////////////////////////////////////////
@@ -56,7 +57,7 @@ Varray *new_Varray_indexed( int n, Vindex *index, Vattrib *vattribs[] ) {
 	va->n  = n;
 
 	// Bind + enable vertex attribute arrays
-	glBindVertexArray( id ); check_GL_error;
+	bind_varray_Glcache( id );
 	for( int i=0; i<n; i++ ) {
 
 		va->attribs[i] = vattribs[i];
@@ -79,7 +80,48 @@ Varray *new_Varray_indexed( int n, Vindex *index, Vattrib *vattribs[] ) {
 		check_GL_error;
 	}
 
-	glBindVertexArray( 0 ); check_GL_error;
+	bind_varray_Glcache( 0 );
+	return va;
+
+}
+
+Varray* new_Varray_interleaved( Vattrib* storage, int n, const Vfield fields[], Vindex* index ) {
+
+	GLuint id; glGenVertexArrays( 1, &id ); check_GL_error;
+	if( 0 == id )
+		return NULL;
+
+	Varray* va = malloc( sizeof(Varray) + sizeof(Vattrib*) );
+	if( !va )
+		return NULL;
+
+	va->id         = id;
+	va->n          = 1;
+	va->attribs[0] = storage;
+
+	// Every field reads the one buffer, at its own offset into the vertex
+	bind_varray_Glcache( id );
+	glBindBuffer( GL_ARRAY_BUFFER, storage->id ); check_GL_error;
+	for( int i=0; i<n; i++ ) {
+
+		glEnableVertexAttribArray( i ); check_GL_error;
+		glVertexAttribPointer( i,
+		                       fields[i].size,
+		                       fields[i].type,
+		                       fields[i].normalize,
+		                       storage->stride,
+		                       (GLvoid*)(intptr_t)fields[i].offset );
+		check_GL_error;
+
+	}
+
+	va->index = index;
+	if( index ) {
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, index->id );
+		check_GL_error;
+	}
+
+	bind_varray_Glcache( 0 );
 	return va;
 
 }
@@ -89,6 +131,7 @@ void     delete_Varray( Varray* varray ) {
 	assert( NULL != varray );
 	
 	glDeleteVertexArrays( 1, &varray->id );
+	forget_varray_Glcache( varray->id );
 	for( int i=0; i<varray->n; i++ )
 		delete_Vattrib( varray->attribs[i] );
 	
@@ -99,7 +142,7 @@ void     delete_Varray( Varray* varray ) {
 
 void draw_Varray( Varray* varray, GLenum mode, GLint first, GLsizei count ) {
 
-	glBindVertexArray( varray->id ); check_GL_error;
+	bind_varray_Glcache( varray->id );
 	glDrawArrays( mode, first, count ); check_GL_error;
 	
 }
@@ -109,14 +152,38 @@ void draw_Varray_indexed( Vindex* index, Varray* varray,
                           GLsizeiptr first, 
                           GLsizei count ) {
 	
-	glBindVertexArray( varray->id ); check_GL_error;
+	bind_varray_Glcache( varray->id );
 	if( index != varray->index ) {
 		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, index->id ); check_GL_error;
 		varray->index = index;
 	}
-	glDrawElements( mode, count, GL_UNSIGNED_INT, (GLvoid*)first ); check_GL_error;
+	glDrawElements( mode, count, index->type, (GLvoid*)first ); check_GL_error;
 
-	glBindVertexArray( 0 ); check_GL_error;
+	bind_varray_Glcache( 0 );
 	
 }
 
+void bind_Varray( Varray* varray ) {
+
+	bind_varray_Glcache( varray ? varray->id : 0 );
+
+}
+
+void draw_bound_Varray( GLenum mode, GLint first, GLsizei count ) {
+
+	glDrawArrays( mode, first, count ); check_GL_error;
+
+}
+
+void draw_bound_Varray_indexed( Vindex* index, Varray* varray,
+                                GLenum mode,
+                                GLsizeiptr first,
+                                GLsizei count ) {
+
+	if( index != varray->index ) {
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, index->id ); check_GL_error;
+		varray->index = index;
+	}
+	glDrawElements( mode, count, index->type, (GLvoid*)first ); check_GL_error;
+
+}
@@ -0,0 +1,749 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "data.map.h"
+#include "gl.cache.h"
+#include "gl.util.h"
+#include "mm.heap.h"
+
+#if defined( __gl_cache_TEST__ )
+
+// The test runs without a context; the GL calls are recorded instead
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "gl.shader.h"
+#include "mm.region.h"
+#include "r.state.h"
+
+static int  n_calls;
+static char calls[256][128];
+
+static void record( const char* fmt, ... ) {
+
+	va_list args;
+	va_start( args, fmt );
+	vsnprintf( calls[ n_calls++ % 256 ], sizeof(calls[0]), fmt, args );
+	va_end( args );
+
+}
+
+#undef glEnable
+#undef glDisable
+#undef glBlendFuncSeparate
+#undef glBlendEquationSeparate
+#undef glBlendColor
+#undef glDepthFunc
+#undef glDepthMask
+#undef glDepthRange
+#undef glStencilFuncSeparate
+#undef glStencilOpSeparate
+#undef glClearColor
+#undef glClearDepth
+#undef glClearStencil
+#undef glUseProgram
+#undef glBindVertexArray
+
+#define glEnable( cap )                    record( "glEnable %x", cap )
+#define glDisable( cap )                   record( "glDisable %x", cap )
+#define glBlendFuncSeparate( a, b, c, d )  record( "glBlendFuncSeparate %x %x %x %x", a, b, c, d )
+#define glBlendEquationSeparate( a, b )    record( "glBlendEquationSeparate %x %x", a, b )
+#define glBlendColor( r, g, b, a )         record( "glBlendColor %g %g %g %g", r, g, b, a )
+#define glDepthFunc( f )                   record( "glDepthFunc %x", f )
+#define glDepthMask( m )                   record( "glDepthMask %d", m )
+#define glDepthRange( n, f )               record( "glDepthRange %g %g", n, f )
+#define glStencilFuncSeparate( s, f, r, m ) \
+	record( "glStencilFuncSeparate %x %x %d %x", s, f, r, m )
+#define glStencilOpSeparate( s, a, b, c )  record( "glStencilOpSeparate %x %x %x %x", s, a, b, c )
+#define glClearColor( r, g, b, a )         record( "glClearColor %g %g %g %g", r, g, b, a )
+#define glClearDepth( d )                  record( "glClearDepth %g", d )
+#define glClearStencil( s )                record( "glClearStencil %d", s )
+#define glUseProgram( p )                  record( "glUseProgram %u", p )
+#define glBindVertexArray( va )            record( "glBindVertexArray %u", va )
+
+#endif
+
+// Which values of the shadow are known
+enum {
+
+	validBlend        = 1 << 0,
+	validDepthTest    = 1 << 1,
+	validStencilTest  = 1 << 2,
+
+	validBlendFunc    = 1 << 3,
+	validBlendEq      = 1 << 4,
+	validBlendColor   = 1 << 5,
+
+	validDepthFunc    = 1 << 6,
+	validDepthMask    = 1 << 7,
+	validDepthRange   = 1 << 8,
+
+	validStencilFunc  = 1 << 9,   // Front; back is the next bit up
+	validStencilOp    = 1 << 11,
+
+	validClearColor   = 1 << 13,
+	validClearDepth   = 1 << 14,
+	validClearStencil = 1 << 15,
+
+	validProgram      = 1 << 16,
+	validVarray       = 1 << 17
+
+};
+
+// The uniforms of a program, by location; size 0 is unknown
+typedef struct {
+
+	uint  size;
+	byte* value;
+
+} uniform_t;
+
+typedef struct {
+
+	GLuint     id;
+
+	int        n;
+	uniform_t* uniforms;
+
+} program_t;
+
+static struct {
+
+	uint32     valid;
+
+	bool       caps[3];
+
+	GLenum     blend_func[4];
+	GLenum     blend_eq[2];
+	float4     blend_color;
+
+	GLenum     depth_func;
+	bool       depth_mask;
+	double     depth_range[2];
+
+	struct {
+		GLenum func;
+		GLint  ref;
+		GLuint mask;
+		GLenum op[3];
+	}          stencil[2];
+
+	float4     clear_color;
+	double     clear_depth;
+	GLint      clear_stencil;
+
+	GLuint     program;
+	GLuint     varray;
+
+	Map*       programs;  // program_t of each program with uniforms set
+	program_t* current;   // of `program', if any yet
+
+	Glcache_stats stats;
+
+} cache;
+
+// Counts a set of a state value, and whether it changes anything; the
+// value is known from here on
+static bool changed( uint32 bit, bool same ) {
+
+	if( (cache.valid & bit) && same ) {
+		cache.stats.state_skipped++;
+		return false;
+	}
+
+	cache.valid |= bit;
+	cache.stats.state_issued++;
+	return true;
+
+}
+
+static void delete_program( program_t* pgm ) {
+
+	for( int i=0; i<pgm->n; i++ )
+		free( pgm->uniforms[i].value );
+	free( pgm->uniforms );
+	free( pgm );
+
+}
+
+// Functions //////////////////////////////////////////////////////////////////
+
+void          reset_Glcache( void ) {
+
+	cache.valid   = 0;
+	cache.current = NULL;
+
+	if( cache.programs ) {
+
+		for( pointer kv=first_Map( cache.programs );
+		     NULL != kv;
+		     kv = next_Map( cache.programs, kv ) )
+			delete_program( value_Map( kv ) );
+
+		delete_Map( cache.programs );
+		cache.programs = NULL;
+
+	}
+
+}
+
+void          stats_Glcache( Glcache_stats* stats ) {
+
+	*stats = cache.stats;
+
+}
+
+void    clear_stats_Glcache( void ) {
+
+	memset( &cache.stats, 0, sizeof(cache.stats) );
+
+}
+
+// Capabilities and fixed function state //////////////////////////////////////
+
+void         enable_Glcache( GLenum cap, bool enabled ) {
+
+	int i;
+	switch( cap ) {
+	case GL_BLEND:        i = 0; break;
+	case GL_DEPTH_TEST:   i = 1; break;
+	case GL_STENCIL_TEST: i = 2; break;
+	default:              i = -1; break;
+	}
+
+	if( i >= 0 ) {
+
+		if( !changed( validBlend << i, cache.caps[i] == enabled ) )
+			return;
+		cache.caps[i] = enabled;
+
+	} else
+		cache.stats.state_issued++;
+
+	if( enabled )
+		glEnable( cap );
+	else
+		glDisable( cap );
+	check_GL_error;
+
+}
+
+void     blend_func_Glcache( GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha ) {
+
+	GLenum func[4] = { srcRGB, dstRGB, srcAlpha, dstAlpha };
+	if( !changed( validBlendFunc, 0 == memcmp( func, cache.blend_func, sizeof(func) ) ) )
+		return;
+
+	memcpy( cache.blend_func, func, sizeof(func) );
+	glBlendFuncSeparate( srcRGB, dstRGB, srcAlpha, dstAlpha ); check_GL_error;
+
+}
+
+void blend_equation_Glcache( GLenum modeRGB, GLenum modeAlpha ) {
+
+	if( !changed( validBlendEq, modeRGB == cache.blend_eq[0] && modeAlpha == cache.blend_eq[1] ) )
+		return;
+
+	cache.blend_eq[0] = modeRGB;
+	cache.blend_eq[1] = modeAlpha;
+	glBlendEquationSeparate( modeRGB, modeAlpha ); check_GL_error;
+
+}
+
+void    blend_color_Glcache( float4 color ) {
+
+	if( !changed( validBlendColor, 0 == memcmp( &color, &cache.blend_color, sizeof(color) ) ) )
+		return;
+
+	cache.blend_color = color;
+	glBlendColor( color.x, color.y, color.z, color.w ); check_GL_error;
+
+}
+
+void     depth_func_Glcache( GLenum func ) {
+
+	if( !changed( validDepthFunc, func == cache.depth_func ) )
+		return;
+
+	cache.depth_func = func;
+	glDepthFunc( func ); check_GL_error;
+
+}
+
+void     depth_mask_Glcache( bool mask ) {
+
+	if( !changed( validDepthMask, mask == cache.depth_mask ) )
+		return;
+
+	cache.depth_mask = mask;
+	glDepthMask( mask ? GL_TRUE : GL_FALSE ); check_GL_error;
+
+}
+
+void    depth_range_Glcache( double znear, double zfar ) {
+
+	if( !changed( validDepthRange, znear == cache.depth_range[0] && zfar == cache.depth_range[1] ) )
+		return;
+
+	cache.depth_range[0] = znear;
+	cache.depth_range[1] = zfar;
+	glDepthRange( znear, zfar ); check_GL_error;
+
+}
+
+void   stencil_func_Glcache( GLenum face, GLenum func, GLint ref, GLuint mask ) {
+
+	assert( GL_FRONT == face || GL_BACK == face );
+	int i = GL_BACK == face;
+
+	if( !changed( validStencilFunc << i,
+	              func == cache.stencil[i].func
+	              && ref == cache.stencil[i].ref
+	              && mask == cache.stencil[i].mask ) )
+		return;
+
+	cache.stencil[i].func = func;
+	cache.stencil[i].ref  = ref;
+	cache.stencil[i].mask = mask;
+	glStencilFuncSeparate( face, func, ref, mask ); check_GL_error;
+
+}
+
+void     stencil_op_Glcache( GLenum face, GLenum sfail, GLenum dpfail, GLenum dppass ) {
+
+	assert( GL_FRONT == face || GL_BACK == face );
+	int i = GL_BACK == face;
+
+	if( !changed( validStencilOp << i,
+	              sfail == cache.stencil[i].op[0]
+	              && dpfail == cache.stencil[i].op[1]
+	              && dppass == cache.stencil[i].op[2] ) )
+		return;
+
+	cache.stencil[i].op[0] = sfail;
+	cache.stencil[i].op[1] = dpfail;
+	cache.stencil[i].op[2] = dppass;
+	glStencilOpSeparate( face, sfail, dpfail, dppass ); check_GL_error;
+
+}
+
+void    clear_color_Glcache( float4 color ) {
+
+	if( !changed( validClearColor, 0 == memcmp( &color, &cache.clear_color, sizeof(color) ) ) )
+		return;
+
+	cache.clear_color = color;
+	glClearColor( color.x, color.y, color.z, color.w ); check_GL_error;
+
+}
+
+void    clear_depth_Glcache( double depth ) {
+
+	if( !changed( validClearDepth, depth == cache.clear_depth ) )
+		return;
+
+	cache.clear_depth = depth;
+	glClearDepth( depth ); check_GL_error;
+
+}
+
+void  clear_stencil_Glcache( GLint stencil ) {
+
+	if( !changed( validClearStencil, stencil == cache.clear_stencil ) )
+		return;
+
+	cache.clear_stencil = stencil;
+	glClearStencil( stencil ); check_GL_error;
+
+}
+
+// Bindings ///////////////////////////////////////////////////////////////////
+
+void    use_program_Glcache( GLuint program ) {
+
+	if( (cache.valid & validProgram) && program == cache.program ) {
+		cache.stats.programs_skipped++;
+		return;
+	}
+
+	cache.valid  |= validProgram;
+	cache.program = program;
+	cache.current = cache.programs
+		? lookup_Map( cache.programs, sizeof(program), &program )
+		: NULL;
+
+	cache.stats.programs_issued++;
+	glUseProgram( program ); check_GL_error;
+
+}
+
+void    bind_varray_Glcache( GLuint varray ) {
+
+	if( (cache.valid & validVarray) && varray == cache.varray ) {
+		cache.stats.varrays_skipped++;
+		return;
+	}
+
+	cache.valid |= validVarray;
+	cache.varray = varray;
+
+	cache.stats.varrays_issued++;
+	glBindVertexArray( varray ); check_GL_error;
+
+}
+
+// Uniforms ///////////////////////////////////////////////////////////////////
+
+bool        uniform_Glcache( GLint loc, uint size, const void* value ) {
+
+	// GL ignores inactive uniforms
+	if( loc < 0 ) {
+		cache.stats.uniforms_skipped++;
+		return false;
+	}
+
+	// Without a known program there is nothing to compare against
+	if( !(cache.valid & validProgram) || 0 == cache.program ) {
+		cache.stats.uniforms_issued++;
+		return true;
+	}
+
+	program_t* pgm = cache.current;
+	if( !pgm ) {
+
+		if( !cache.programs )
+			cache.programs = new_Map( ZONE_heap, 64 );
+
+		pgm = calloc( 1, sizeof(program_t) );
+		pgm->id = cache.program;
+		put_Map( cache.programs, sizeof(pgm->id), &pgm->id, pgm );
+
+		cache.current = pgm;
+
+	}
+
+	if( loc >= pgm->n ) {
+
+		int n = pgm->n > 0 ? pgm->n : 8;
+		while( n <= loc )
+			n *= 2;
+
+		pgm->uniforms = realloc( pgm->uniforms, n * sizeof(uniform_t) );
+		memset( pgm->uniforms + pgm->n, 0, (n - pgm->n) * sizeof(uniform_t) );
+		pgm->n = n;
+
+	}
+
+	uniform_t* u = &pgm->uniforms[ loc ];
+	if( size == u->size && 0 == memcmp( value, u->value, size ) ) {
+		cache.stats.uniforms_skipped++;
+		return false;
+	}
+
+	if( size != u->size ) {
+		u->value = realloc( u->value, size );
+		u->size  = size;
+	}
+	memcpy( u->value, value, size );
+
+	cache.stats.uniforms_issued++;
+	return true;
+
+}
+
+// Deletion ///////////////////////////////////////////////////////////////////
+
+void forget_program_Glcache( GLuint program ) {
+
+	if( cache.programs ) {
+
+		program_t* pgm = remove_Map( cache.programs, sizeof(program), &program );
+		if( pgm ) {
+			if( pgm == cache.current )
+				cache.current = NULL;
+			delete_program( pgm );
+		}
+
+	}
+
+	// A program deleted while in use stays in use until another is
+	// bound, but its id may come back
+	if( program == cache.program )
+		cache.valid &= ~validProgram;
+
+}
+
+void  forget_varray_Glcache( GLuint varray ) {
+
+	// Deleting the bound vertex array binds 0
+	if( (cache.valid & validVarray) && varray == cache.varray )
+		cache.varray = 0;
+
+}
+
+#ifdef __gl_cache_TEST__
+
+static void expect( int n, ... ) {
+
+	va_list args;
+	va_start( args, n );
+
+	if( n != n_calls ) {
+		fprintf( stderr, "expected %d calls, recorded %d:\n", n, n_calls );
+		for( int i=0; i<n_calls; i++ )
+			fprintf( stderr, "\t%s\n", calls[i] );
+		abort();
+	}
+
+	for( int i=0; i<n; i++ ) {
+		const char* call = va_arg( args, const char* );
+		if( 0 != strcmp( call, calls[i] ) ) {
+			fprintf( stderr, "expected '%s', recorded '%s'\n", call, calls[i] );
+			abort();
+		}
+	}
+
+	va_end( args );
+	n_calls = 0;
+
+}
+
+// Other modules call GL directly: check_GL_error asks GL itself, so this
+// definition stands in for libGL's, and the uniform loaders are GLEW's
+// pointers, aimed at recorders below
+static int n_error_checks;
+
+GLenum GLAPIENTRY glGetError( void ) {
+
+	n_error_checks++;
+	return GL_NO_ERROR;
+
+}
+
+static void GLAPIENTRY record_uniform1iv( GLint loc, GLsizei count, const GLint* v ) {
+	record( "glUniform1iv %d %d %d", loc, count, v[0] );
+}
+
+static void GLAPIENTRY record_uniform4fv( GLint loc, GLsizei count, const GLfloat* v ) {
+	record( "glUniform4fv %d %d %g %g %g %g", loc, count, v[0], v[1], v[2], v[3] );
+}
+
+static void test_apply_Rstate( void ) {
+
+	reset_Glcache();
+
+	Rstate rs = {
+		.blend   = { true, blendSrcAlpha, blendInvSrcAlpha, blendOne, blendZero,
+		             funcAdd, funcAdd, { 0.f, 0.f, 0.f, 0.f } },
+		.clear   = { { 0.f, 0.f, 0.f, 1.f }, 1.0, 0 },
+		.depth   = { true, true, funcLess, 0.0, 1.0 },
+		.stencil = { false }
+	};
+
+	apply_Rstate( &rs );
+	expect( 12, "glEnable be2",
+	            "glBlendFuncSeparate 302 303 1 0",
+	            "glBlendEquationSeparate 8006 8006",
+	            "glBlendColor 0 0 0 0",
+	            "glClearColor 0 0 0 1",
+	            "glClearDepth 1",
+	            "glClearStencil 0",
+	            "glEnable b71",
+	            "glDepthFunc 201",
+	            "glDepthMask 1",
+	            "glDepthRange 0 1",
+	            "glDisable b90" );
+
+	// Applying the same state again is free
+	apply_Rstate( &rs );
+	expect( 0 );
+
+	// Only what changed goes through
+	rs.blend.enabled = false;
+	rs.depth.func    = funcLequal;
+	apply_Rstate( &rs );
+	expect( 2, "glDisable be2", "glDepthFunc 203" );
+
+	// Blending comes back with the function it had
+	rs.blend.enabled = true;
+	apply_Rstate( &rs );
+	expect( 1, "glEnable be2" );
+
+	reset_Glcache();
+
+}
+
+static void test_load_Program_uniforms( void ) {
+
+	reset_Glcache();
+
+	region_p R = region( "gl.cache.test" );
+
+	Shader_Param params[] = {
+		{ "color",   3, { GL_FLOAT_VEC4, shFloat, sizeof(GLfloat), { 1, 4 }, 1 } },
+		{ "texture", 7, { GL_SAMPLER_2D, shSampler2d, sizeof(GLint), { 1, 1 }, 1 } }
+	};
+
+	Shader_Arg* args = alloc_Shader_argv( R, 2, params );
+	Program     a    = { .id = 12 },
+	            b    = { .id = 13 };
+
+	glUniform1iv = record_uniform1iv;
+	glUniform4fv = record_uniform4fv;
+
+	use_Program( &a, args );
+	expect( 3, "glUseProgram 12", "glUniform4fv 3 1 0 0 0 1", "glUniform1iv 7 1 0" );
+
+	use_Program( &a, args );
+	load_Program_uniforms( args );
+	expect( 0 );
+
+	// A changed value is sent, an unchanged one is not
+	float red[4] = { 1.f, 0.f, 0.f, 1.f };
+	set_Shader_Arg( args, red );
+	load_Program_uniforms( args );
+	expect( 1, "glUniform4fv 3 1 1 0 0 1" );
+
+	// Another program has uniforms of its own
+	use_Program( &b, args );
+	expect( 3, "glUseProgram 13", "glUniform4fv 3 1 1 0 0 1", "glUniform1iv 7 1 0" );
+
+	use_Program( &a, args );
+	expect( 1, "glUseProgram 12" );
+
+	rfree( R );
+	reset_Glcache();
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	Glcache_stats stats;
+
+	// Everything goes to GL while unknown, then only changes do
+	enable_Glcache( GL_BLEND, true );
+	blend_func_Glcache( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ZERO );
+	depth_range_Glcache( 0.0, 1.0 );
+	expect( 3, "glEnable be2", "glBlendFuncSeparate 302 303 1 0", "glDepthRange 0 1" );
+
+	enable_Glcache( GL_BLEND, true );
+	blend_func_Glcache( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ZERO );
+	depth_range_Glcache( 0.0, 1.0 );
+	expect( 0 );
+
+	enable_Glcache( GL_BLEND, false );
+	blend_func_Glcache( GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ZERO );
+	expect( 2, "glDisable be2", "glBlendFuncSeparate 1 303 1 0" );
+
+	// Capabilities are shadowed apart
+	enable_Glcache( GL_DEPTH_TEST, false );
+	enable_Glcache( GL_DEPTH_TEST, false );
+	enable_Glcache( GL_BLEND, false );
+	expect( 1, "glDisable b71" );
+
+	// Unshadowed capabilities always go through
+	enable_Glcache( GL_CULL_FACE, true );
+	enable_Glcache( GL_CULL_FACE, true );
+	expect( 2, "glEnable b44", "glEnable b44" );
+
+	// Front and back stencil state are kept apart
+	stencil_func_Glcache( GL_FRONT, GL_LESS, 1, 0xff );
+	stencil_func_Glcache( GL_BACK, GL_LESS, 1, 0xff );
+	stencil_func_Glcache( GL_FRONT, GL_LESS, 1, 0xff );
+	stencil_op_Glcache( GL_BACK, GL_KEEP, GL_KEEP, GL_REPLACE );
+	stencil_op_Glcache( GL_BACK, GL_KEEP, GL_KEEP, GL_REPLACE );
+	expect( 3, "glStencilFuncSeparate 404 201 1 ff",
+	           "glStencilFuncSeparate 405 201 1 ff",
+	           "glStencilOpSeparate 405 1e00 1e00 1e01" );
+
+	clear_color_Glcache( (float4){ 0.f, 0.f, 0.f, 1.f } );
+	clear_color_Glcache( (float4){ 0.f, 0.f, 0.f, 1.f } );
+	clear_depth_Glcache( 1.0 );
+	clear_depth_Glcache( 1.0 );
+	clear_stencil_Glcache( 0 );
+	clear_stencil_Glcache( 0 );
+	expect( 3, "glClearColor 0 0 0 1", "glClearDepth 1", "glClearStencil 0" );
+
+	// Bindings
+	use_program_Glcache( 3 );
+	use_program_Glcache( 3 );
+	bind_varray_Glcache( 7 );
+	bind_varray_Glcache( 7 );
+	bind_varray_Glcache( 0 );
+	expect( 3, "glUseProgram 3", "glBindVertexArray 7", "glBindVertexArray 0" );
+
+	// Uniforms are shadowed by value, per program
+	float m[16] = { 1.f }, v[4] = { 1.f, 2.f, 3.f, 4.f };
+
+	assert( uniform_Glcache( 0, sizeof(m), m ) );
+	assert( uniform_Glcache( 5, sizeof(v), v ) );
+	assert( !uniform_Glcache( 0, sizeof(m), m ) );
+	assert( !uniform_Glcache( 5, sizeof(v), v ) );
+	assert( !uniform_Glcache( -1, sizeof(v), v ) );
+
+	v[2] = 0.f;
+	assert( uniform_Glcache( 5, sizeof(v), v ) );
+	assert( !uniform_Glcache( 5, sizeof(v), v ) );
+
+	use_program_Glcache( 4 );
+	assert( uniform_Glcache( 5, sizeof(v), v ) );
+	assert( !uniform_Glcache( 5, sizeof(v), v ) );
+
+	use_program_Glcache( 3 );
+	assert( !uniform_Glcache( 0, sizeof(m), m ) );
+	assert( !uniform_Glcache( 5, sizeof(v), v ) );
+	expect( 2, "glUseProgram 4", "glUseProgram 3" );
+
+	// A deleted program forgets its uniforms, and its id may be reused
+	forget_program_Glcache( 3 );
+	use_program_Glcache( 3 );
+	assert( uniform_Glcache( 0, sizeof(m), m ) );
+	expect( 1, "glUseProgram 3" );
+
+	// Deleting the bound vertex array binds 0
+	bind_varray_Glcache( 9 );
+	forget_varray_Glcache( 9 );
+	bind_varray_Glcache( 0 );
+	expect( 1, "glBindVertexArray 9" );
+
+	// Counts
+	stats_Glcache( &stats );
+	assert( 3 + 2 + 1 + 2 + 3 + 3 == stats.state_issued );
+	assert( 3 + 2 + 2 + 3 == stats.state_skipped );
+	assert( 4 == stats.programs_issued && 1 == stats.programs_skipped );
+	assert( 3 == stats.varrays_issued && 2 == stats.varrays_skipped );
+	assert( 5 == stats.uniforms_issued && 7 == stats.uniforms_skipped );
+
+	clear_stats_Glcache();
+	stats_Glcache( &stats );
+	assert( 0 == stats.state_issued && 0 == stats.uniforms_skipped );
+
+	// After a reset everything goes to GL again
+	reset_Glcache();
+	enable_Glcache( GL_BLEND, false );
+	use_program_Glcache( 4 );
+	assert( uniform_Glcache( 5, sizeof(v), v ) );
+	expect( 2, "glDisable be2", "glUseProgram 4" );
+
+	// Without a program, uniforms always go through
+	reset_Glcache();
+	assert( uniform_Glcache( 5, sizeof(v), v ) );
+	assert( uniform_Glcache( 5, sizeof(v), v ) );
+
+	reset_Glcache();
+
+	test_apply_Rstate();
+	test_load_Program_uniforms();
+
+	// Every call that went through was checked, without a context
+#if defined( feature_DEBUG )
+	assert( 0 < n_error_checks );
+#endif
+
+	printf("Ok\n");
+	return 0;
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include <SDL_video.h>
 
 #include "core.log.h"
+#include "gl.cache.h"
 #include "gl.context.h"
 #include "gl.display.h"
 
@@ -54,6 +55,9 @@ int         bind_Glcontext( Display* dpy, Glcontext gl ) {
 	if( ret < 0 )
 		error("bind_Glcontext failed: %s", SDL_GetError());
 
+	// The shadowed state was that of another context, if any
+	reset_Glcache();
+
 	return ret;
 
 }
@@ -5,6 +5,7 @@
 //
 #include "core.log.h"
 #include "core.types.h"
+#include "gl.cache.h"
 #include "gl.shader.h"
 #include "gl.util.h"
 #include "mm.region.h"
@@ -568,6 +569,7 @@ Program* build_Program( const char* name,
 void      delete_Program( Program* pgm ) {
 
 	glDeleteProgram(pgm->id); check_GL_error;
+	forget_program_Glcache( pgm->id );
 
 	if( pgm->attribs ) {
 		for( int i=0; i<pgm->n_attribs; i++ )
@@ -671,6 +673,10 @@ void          load_Program_uniforms( Shader_Arg* argv ) {
 		GLint      location = arg->loc;
 		GLsizei       count = arg->type.count;
 
+		// Already loaded with this value?
+		if( !uniform_Glcache( location, sizeof_Shade_Type( arg->type ), value ) )
+			continue;
+
 		switch( arg->type.glType ) {
 
 		case GL_BOOL:
@@ -762,11 +768,11 @@ void          load_Program_uniforms( Shader_Arg* argv ) {
 void           use_Program( Program* pgm, Shader_Arg* uniforms ) {
 
 	if( NULL == pgm ) {
-		glUseProgram( 0 ); check_GL_error;
+		use_program_Glcache( 0 );
 		return;
 	}
 
-	glUseProgram( pgm->id ); check_GL_error;
+	use_program_Glcache( pgm->id );
 	if( uniforms )
 		load_Program_uniforms( uniforms );
 
@@ -38,6 +38,7 @@ int    sizeof_GLtype( GLenum type ) {
 
 	case GL_SHORT:
 	case GL_UNSIGNED_SHORT:
+	case GL_HALF_FLOAT:
 		return 2;
 
 	case GL_INT:
@@ -49,7 +50,7 @@ int    sizeof_GLtype( GLenum type ) {
 		return 8;
 
 	default:
-		assert( 0 && "`type' must be one of: GL_BYTE, GL_UNSIGNED_BYTE, GL_SHORT, GL_UNSIGNED_SHORT, GL_INT, GL_UNSIGNED_INT, GL_FLOAT, GL_DOUBLE" );
+		assert( 0 && "`type' must be one of: GL_BYTE, GL_UNSIGNED_BYTE, GL_SHORT, GL_UNSIGNED_SHORT, GL_HALF_FLOAT, GL_INT, GL_UNSIGNED_INT, GL_FLOAT, GL_DOUBLE" );
 		break;
 	}
 
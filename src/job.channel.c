@@ -2,7 +2,7 @@
 #include <string.h>
 
 #include "core.log.h"
-#include "data.list.h"
+#include "data.pool.h"
 #include "data.ringbuf.h"
 #include "job.channel.h"
 #include "job.queue.h"
@@ -10,13 +10,17 @@
 
 struct Channel {
 
-	region_p   R;
-	spinlock_t lock;
+	region_p      R;
+	spinlock_t    lock;
+
+	Pool*         readq;
+	Pool*         writeq;
 
-	List*      readq;
-	List*      writeq;
+	channelMode_e mode;
+	uint16        size;
 
-	ringbuf_p  ring;
+	ringbuf_p     ring;    // channelLocked
+	lfring_p      lfring;  // channelSPSC, channelMPMC
 
 };
 
@@ -50,12 +54,97 @@ static void poll( spinlock_t* lock, Channel* chan ) {
 
 }
 
+// Lock-free channels only take the lock to sleep on or wake up a waitqueue.
+// A job re-tries under the lock before it goes to sleep, and wakeups are also
+// done under the lock, so no wakeup can slip in between the two.
+//
+// `lock' is the lock to take for wakeups, or NULL if the caller holds it.
+
+// Try to write up to `n' messages to a lock-free channel. Wakes a reader if
+// the channel was empty, and passes the baton to the next blocked writer if 
+// there is still room. Returns the number of messages written.
+static int try_writev_lf( spinlock_t* lock, Channel* chan, uint16 size, int n, const pointer data ) {
+
+	assert( size == chan->size );
+
+	bool any_empty = false;
+	int  i;
+
+	for( i=0; i<n; i++ ) {
+
+		bool was_empty;
+		if( write_LFRING( chan->lfring, data + i*size, &was_empty ) < 0 )
+			break;
+		any_empty |= was_empty;
+
+	}
+
+	if( 0 == i )
+		return channelBlocked;
+
+	if( any_empty )
+		flush( lock, chan );
+	if( !isempty_Pool(chan->writeq) && remaining_LFRING(chan->lfring) > 0 )
+		poll( lock, chan );
+
+	return i;
+
+}
+
+// Try to read up to `n' messages from a lock-free channel. Wakes a writer if
+// the channel was full, and passes the baton to the next blocked reader if 
+// there is more to read. Returns the number of messages read.
+static int try_readv_lf( spinlock_t* lock, Channel* chan, uint16 size, int n, pointer dest ) {
+
+	assert( size == chan->size );
+
+	bool any_full = false;
+	int  i;
+
+	for( i=0; i<n; i++ ) {
+
+		bool was_full;
+		if( read_LFRING( chan->lfring, dest + i*size, &was_full ) < 0 )
+			break;
+		any_full |= was_full;
+
+	}
+
+	if( 0 == i )
+		return channelBlocked;
+
+	if( any_full )
+		poll( lock, chan );
+	if( !isempty_Pool(chan->readq) && available_LFRING(chan->lfring) > 0 )
+		flush( lock, chan );
+
+	return i;
+
+}
+
+static int try_write_lf( spinlock_t* lock, Channel* chan, uint16 size, const pointer data ) {
+
+	int ret = try_writev_lf( lock, chan, size, 1, data );
+	return channelBlocked == ret ? ret : size;
+
+}
+
+static int try_read_lf( spinlock_t* lock, Channel* chan, uint16 size, pointer dest ) {
+
+	int ret = try_readv_lf( lock, chan, size, 1, dest );
+	return channelBlocked == ret ? ret : size;
+
+}
+
 // Try to write `size` bytes to channel from 'data`; returns channelBlocked if
 // not enough bytes left in buffer; returns `size` on success
 //
 // Assume `chan` is appropriately locked by caller
 static int try_write( Channel* chan, uint16 size, const pointer data ) {
 
+	if( channelLocked != chan->mode )
+		return try_write_lf( NULL, chan, size, data );
+
 	int ret = write_RINGBUF(chan->ring, size, data);
 	if( ret < 0 ) {
 		flush( NULL, chan ); // Force a flush since we're full
@@ -76,6 +165,9 @@ static int try_write( Channel* chan, uint16 size, const pointer data ) {
 // Assume `chan` is appropriately locked by caller
 static int try_read( Channel* chan, uint16 size, pointer dest ) {
 
+	if( channelLocked != chan->mode )
+		return try_read_lf( NULL, chan, size, dest );
+
 	int ret = read_RINGBUF( chan->ring, size, dest );
 	if( ret < 0 ) {
 		poll( NULL, chan ); // Poll writers, we're empty
@@ -90,10 +182,72 @@ static int try_read( Channel* chan, uint16 size, pointer dest ) {
 
 }
 
+// Try to write up to `n' messages of `size' bytes; returns channelBlocked if
+// there is not room for even one; otherwise the number of messages written.
+//
+// Assume `chan` is appropriately locked by caller
+static int try_writev( Channel* chan, uint16 size, int n, const pointer data ) {
+
+	if( channelLocked != chan->mode )
+		return try_writev_lf( NULL, chan, size, n, data );
+
+	int k = remaining_RINGBUF(chan->ring) / size;
+	if( k > n )
+		k = n;
+
+	if( 0 == k ) {
+		flush( NULL, chan ); // Force a flush since we're full
+		return channelBlocked;
+	}
+
+	write_RINGBUF( chan->ring, k*size, data );
+
+	// Automatic flush once we've filled the buffer
+	if( 0 == remaining_RINGBUF(chan->ring) )
+		flush( NULL, chan );
+
+	return k;
+
+}
+
+// Try to read up to `n' messages of `size' bytes; returns channelBlocked if
+// not even one is available; otherwise the number of messages read.
+//
+// Assume `chan` is appropriately locked by caller
+static int try_readv( Channel* chan, uint16 size, int n, pointer dest ) {
+
+	if( channelLocked != chan->mode )
+		return try_readv_lf( NULL, chan, size, n, dest );
+
+	int k = available_RINGBUF(chan->ring) / size;
+	if( k > n )
+		k = n;
+
+	if( 0 == k ) {
+		poll( NULL, chan ); // Poll writers, we're empty
+		return channelBlocked;
+	}
+
+	read_RINGBUF( chan->ring, k*size, dest );
+
+	// Automatic poll once we've consumed the buffer
+	if( 0 == available_RINGBUF(chan->ring) )
+		poll( NULL, chan );
+
+	return k;
+
+}
+
 // Public API /////////////////////////////////////////////////////////////////
 
 Channel*       new_Channel( uint16 size, uint16 count ) {
 
+	return new_Channel_mode( channelLocked, size, count );
+
+}
+
+Channel*  new_Channel_mode( channelMode_e mode, uint16 size, uint16 count ) {
+
 	region_p R = region( "job.channel::new_Channel" );
 	Channel* chan = ralloc( R, sizeof(Channel) );
 
@@ -103,11 +257,28 @@ Channel*       new_Channel( uint16 size, uint16 count ) {
 	}
 	chan->R = R;
 
-	chan->readq = new_List( R, sizeof(Job) );
-	chan->writeq = new_List( R, sizeof(Job) );
+	chan->readq = new_Pool( R, sizeof(Handle) );
+	chan->writeq = new_Pool( R, sizeof(Handle) );
+
+	chan->mode = mode;
+	chan->size = size;
+
+	chan->ring = NULL;
+	chan->lfring = NULL;
+
+	switch( mode ) {
+	case channelLocked:
+		chan->ring = new_RINGBUF( size, count );
+		break;
+	case channelSPSC:
+		chan->lfring = new_LFRING( lfringSPSC, size, count );
+		break;
+	case channelMPMC:
+		chan->lfring = new_LFRING( lfringMPMC, size, count );
+		break;
+	}
 
-	chan->ring = new_RINGBUF( size, count );
-	if( !chan->ring ) {
+	if( !chan->ring && !chan->lfring ) {
 		destroy_SPINLOCK(&chan->lock);
 		rfree( chan->R );
 
@@ -122,13 +293,23 @@ void       destroy_Channel( Channel* chan ) {
 
 	// TODO: What action to take if there are blocked jobs on chan?
 	destroy_SPINLOCK( &chan->lock );
-	destroy_RINGBUF( chan->ring );
+	if( chan->ring )
+		destroy_RINGBUF( chan->ring );
+	if( chan->lfring )
+		destroy_LFRING( chan->lfring );
 	rfree( chan->R );
 
 }
 
 int          write_Channel( Job* job, Channel* chan, uint16 size, const pointer data ) {
 
+	// Lock-free fast path; if it fails we retry below under the lock
+	if( channelLocked != chan->mode ) {
+		int ret = try_write_lf( &chan->lock, chan, size, data );
+		if( channelBlocked != ret )
+			return ret;
+	}
+
 	lock_SPINLOCK( &chan->lock );
 
 	int ret = try_write( chan, size, data );
@@ -142,6 +323,9 @@ int          write_Channel( Job* job, Channel* chan, uint16 size, const pointer
 
 int      try_write_Channel( Channel* chan, uint16 size, const pointer data ) {
 
+	if( channelLocked != chan->mode )
+		return try_write_lf( &chan->lock, chan, size, data );
+
 	lock_SPINLOCK( &chan->lock );
 	int ret = try_write( chan, size, data );
 	unlock_SPINLOCK( &chan->lock );
@@ -152,6 +336,13 @@ int      try_write_Channel( Channel* chan, uint16 size, const pointer data ) {
 
 int           read_Channel( Job* job, Channel* chan, uint16 size, pointer dest ) {
 
+	// Lock-free fast path; if it fails we retry below under the lock
+	if( channelLocked != chan->mode ) {
+		int ret = try_read_lf( &chan->lock, chan, size, dest );
+		if( channelBlocked != ret )
+			return ret;
+	}
+
 	lock_SPINLOCK( &chan->lock );
 
 	int ret = try_read( chan, size, dest );
@@ -165,6 +356,9 @@ int           read_Channel( Job* job, Channel* chan, uint16 size, pointer dest )
 
 int       try_read_Channel( Channel* chan, uint16 size, pointer dest ) {
 
+	if( channelLocked != chan->mode )
+		return try_read_lf( &chan->lock, chan, size, dest );
+
 	lock_SPINLOCK( &chan->lock );
 	int ret = try_read( chan, size, dest );
 	unlock_SPINLOCK( &chan->lock );
@@ -173,6 +367,152 @@ int       try_read_Channel( Channel* chan, uint16 size, pointer dest ) {
 	
 }
 
+int         writev_Channel( Job* job, Channel* chan, uint16 size, int n, const pointer data ) {
+
+	// Lock-free fast path; if it fails we retry below under the lock
+	if( channelLocked != chan->mode ) {
+		int ret = try_writev_lf( &chan->lock, chan, size, n, data );
+		if( channelBlocked != ret )
+			return ret;
+	}
+
+	lock_SPINLOCK( &chan->lock );
+
+	int ret = try_writev( chan, size, n, data );
+	if( channelBlocked == ret )
+		sleep_waitqueue_Job( NULL, &chan->writeq, job );
+
+	unlock_SPINLOCK( &chan->lock );
+
+	return ret;
+
+}
+
+int     try_writev_Channel( Channel* chan, uint16 size, int n, const pointer data ) {
+
+	if( channelLocked != chan->mode )
+		return try_writev_lf( &chan->lock, chan, size, n, data );
+
+	lock_SPINLOCK( &chan->lock );
+	int ret = try_writev( chan, size, n, data );
+	unlock_SPINLOCK( &chan->lock );
+
+	return ret;
+
+}
+
+int          readv_Channel( Job* job, Channel* chan, uint16 size, int n, pointer dest ) {
+
+	// Lock-free fast path; if it fails we retry below under the lock
+	if( channelLocked != chan->mode ) {
+		int ret = try_readv_lf( &chan->lock, chan, size, n, dest );
+		if( channelBlocked != ret )
+			return ret;
+	}
+
+	lock_SPINLOCK( &chan->lock );
+
+	int ret = try_readv( chan, size, n, dest );
+	if( channelBlocked == ret )
+		sleep_waitqueue_Job( NULL, &chan->readq, job );
+
+	unlock_SPINLOCK( &chan->lock );
+
+	return ret;
+
+}
+
+int      try_readv_Channel( Channel* chan, uint16 size, int n, pointer dest ) {
+
+	if( channelLocked != chan->mode )
+		return try_readv_lf( &chan->lock, chan, size, n, dest );
+
+	lock_SPINLOCK( &chan->lock );
+	int ret = try_readv( chan, size, n, dest );
+	unlock_SPINLOCK( &chan->lock );
+
+	return ret;
+
+}
+
+pointer begin_read_Channel( Channel* chan, uint16* len ) {
+
+	if( channelLocked == chan->mode ) {
+
+		lock_SPINLOCK( &chan->lock );
+		return read_span_RINGBUF( chan->ring, len );
+
+	}
+
+	int count;
+	pointer span = read_span_LFRING( chan->lfring, &count );
+	*len = (uint16)(count * chan->size);
+
+	return span;
+
+}
+
+void      end_read_Channel( Channel* chan, uint16 len ) {
+
+	if( channelLocked == chan->mode ) {
+
+		commit_read_RINGBUF( chan->ring, len );
+		if( 0 == available_RINGBUF(chan->ring) )
+			poll( NULL, chan );
+
+		unlock_SPINLOCK( &chan->lock );
+		return;
+
+	}
+
+	assert( 0 == len % chan->size );
+
+	bool was_full;
+	commit_read_LFRING( chan->lfring, len / chan->size, &was_full );
+	if( was_full )
+		poll( &chan->lock, chan );
+
+}
+
+pointer begin_write_Channel( Channel* chan, uint16* len ) {
+
+	if( channelLocked == chan->mode ) {
+
+		lock_SPINLOCK( &chan->lock );
+		return write_span_RINGBUF( chan->ring, len );
+
+	}
+
+	int count;
+	pointer span = write_span_LFRING( chan->lfring, &count );
+	*len = (uint16)(count * chan->size);
+
+	return span;
+
+}
+
+void      end_write_Channel( Channel* chan, uint16 len ) {
+
+	if( channelLocked == chan->mode ) {
+
+		commit_write_RINGBUF( chan->ring, len );
+		if( 0 == remaining_RINGBUF(chan->ring) )
+			flush( NULL, chan );
+
+		unlock_SPINLOCK( &chan->lock );
+		return;
+
+	}
+
+	assert( 0 == len % chan->size );
+
+	bool was_empty;
+	commit_write_LFRING( chan->lfring, len / chan->size, &was_empty );
+	if( was_empty )
+		flush( &chan->lock, chan );
+
+}
+
 void         flush_Channel( Channel* chan ) {
 
 	// When called through public interface we pass the lock
@@ -18,6 +18,11 @@ declare_job( int, fib_consumer,
              unsigned N;
              Channel* in );
 
+declare_job( int, fib_batch_consumer,
+
+             unsigned N;
+             Channel* in );
+
 define_job( unsigned long long, fibonacci,
 
             unsigned long long n_1;
@@ -63,6 +68,25 @@ define_job( int, fib_consumer,
 	end_job;
 }
 
+define_job( int, fib_batch_consumer,
+
+            unsigned i;
+            int count;
+            unsigned long long fib[4] ) {
+
+	begin_job;
+
+	for( local(i) = 0; local(i)<arg(N); ) {
+
+		readch_batch( arg(in), local(fib), 4, local(count) );
+		for( int j=0; j<local(count); j++, local(i)++ )
+			printf("fib(%d) = %llu  (batch of %d)\n", local(i), local(fib)[j], local(count));
+		
+	}
+
+	end_job;
+}
+
 define_job( int, fib_producer,
 
             unsigned i;
@@ -133,6 +157,22 @@ int main( int argc, char* argv[] ) {
 	usec_t elapsed = end - begin;
 	printf("\nTotal time:     %5.2f sec\n", (double)elapsed / usec_perSecond);
 
+	// Again, but the consumer drains the channel several messages at a time
+	printf("\nBatched reads from a lock-free channel:\n\n");
+
+	Channel* batch_chan = new_Channel_mode( channelSPSC, sizeof(unsigned long long), 4 );
+	c_params.in   = batch_chan;
+	p_params.out  = batch_chan;
+
+	cons = submit_Job( 0, ioBound, &c_ret, (jobfunc_f)fib_batch_consumer, &c_params);
+	prod = submit_Job( 0, ioBound, &p_ret, (jobfunc_f)fib_producer, &p_params);
+
+	lock_MUTEX(&mutex);
+	while( join_deadline_Job( 0, &mutex, &cond ) < 0 );
+	unlock_MUTEX(&mutex);
+
+	destroy_Channel( batch_chan );
+
 	shutdown_Jobs();
 	return 0;
 }
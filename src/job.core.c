@@ -4,12 +4,13 @@
 #include "control.swap.h"
 #include "core.log.h"
 #include "data.handle.h"
-#include "data.list.h"
+#include "data.pqueue.h"
 #include "job.control.h"
 #include "job.core.h"
 #include "job.fibre.h"
 #include "job.histogram.h"
 #include "job.queue.h"
+#include "mm.heap.h"
 #include "sync.condition.h"
 #include "sync.mutex.h"
 #include "sync.spinlock.h"
@@ -30,18 +31,16 @@ struct job_worker_s {
 static bool job_queue_running = false;
 static int schedule_work( struct job_worker_s* self ) {
 
-	region_p pool = region( "job.core::schedule_work" );
+	if( 0 > init_Job_queue_thread(self->id) )
+		fatal0("init_Job_queue_thread(self->id) < 0");
 
-	if( 0 > init_Job_queue_thread(self) )
-		fatal0("init_Job_queue_thread(self) < 0");
-
-	List *running = new_List( pool, sizeof(Job) );
-	List *expired = new_List( pool, sizeof(Job) );
+	Pqueue *running = new_Pqueue( ZONE_heap, 0 );
+	Pqueue *expired = new_Pqueue( ZONE_heap, 0 );
 
 	while( job_queue_running ) {
 
 		// Check for new work; wait for up to 1 sec if we lack existing work
-		Job* job = dequeue_Job( isempty_List(running)
+		Job* job = dequeue_Job( isempty_Pqueue(running)
 		                        ? usec_perSecond 
 		                        : 0 );
 		if( job ) {
@@ -49,18 +48,16 @@ static int schedule_work( struct job_worker_s* self ) {
 			// All jobs should be waiting when they come off the front queue
 			assert( jobWaiting == job->status );
 
-			// Insert it into the runqueue at the appropriate place
-			Job* insert_pt = NULL;
-			find__List( running, insert_pt, job->deadline < insert_pt->deadline );
-			insert_before_List( running, insert_pt, job );
+			// Insert it into the runqueue
+			push_Pqueue( running, job->deadline, job );
 
 		} 
 
 		// Run a timeslice
-		while( !isempty_List(running) ) {
+		while( !isempty_Pqueue(running) ) {
 
 			// Take first job from runqueue
-			job = pop_front_List( running );
+			job = pop_Pqueue( running );
 
 			assert( jobWaiting == job->status );
 
@@ -88,32 +85,26 @@ static int schedule_work( struct job_worker_s* self ) {
 
 			// Implement state transition
 			switch( ret ) {
-			case jobRunning: { // job yielded to allow higher prio processes to go
-
-				Job *insert_pt;
+			case jobRunning: // job yielded to allow higher prio processes to go
 
 				job->status = jobWaiting;
-				find__List( running, insert_pt, job->deadline < insert_pt->deadline );
-				insert_before_List( running, insert_pt, job );
+				push_Pqueue( running, job->deadline, job );
 				break;
-			}
+
 			case jobBlocked: // job is blocked on a waitqueue; release our lock
 				trace( "Job %p:%x.%u is blocked", job, job->id, job->deadline );
 				unlock_SPINLOCK( &job->lock );
 				break;
 
 			case jobWaiting:   // the job is polling a condition; expire it
-			case jobYielded: { // or has relinquished its run status
-
-				Job *insert_pt;
+			case jobYielded:   // or has relinquished its run status
 
 				trace( "Job %p:%x.%u is waiting", job, job->id, job->deadline );
 
 				job->status = jobWaiting;
-				find__List( expired, insert_pt, job->deadline < insert_pt->deadline );
-				insert_before_List( expired, insert_pt, job );
+				push_Pqueue( expired, job->deadline, job );
 				break;
-			}
+
 			case jobExited: // the thread called exit_job(); notify and free
 			case jobDone:   // the thread function finished; notify and free
 				
@@ -134,11 +125,12 @@ static int schedule_work( struct job_worker_s* self ) {
 		}
 
 		// Move on to next timeslice
-		swap( List*, running, expired );
+		swap( Pqueue*, running, expired );
 
 	}
 
-	rfree( pool );
+	delete_Pqueue( running );
+	delete_Pqueue( expired );
 	return 0;
 
 }
@@ -148,12 +140,13 @@ static int schedule_work( struct job_worker_s* self ) {
 static int                  n_workers;
 static struct job_worker_s* workers;
 
-int   init_Jobs( int n_workers ) {
+int   init_Jobs( int count ) {
 
-	if( init_Job_queue() < 0 )
+	if( init_Job_queue(count) < 0 )
 		return -1;
 	job_queue_running = true;
 
+	n_workers = count;
 	workers = calloc( n_workers, sizeof(struct job_worker_s) );
 
 	for( int i=0; i<n_workers; i++ ) {
@@ -165,6 +158,7 @@ int   init_Jobs( int n_workers ) {
 		                         &workers[i] );
 		if( ret < 0 ) {
 			job_queue_running = false;
+			wakeup_Job_queue();
 			for( int j=0; j<i; j++ ) 
 				join_THREAD( &workers[j].thread, NULL );
 			return ret;
@@ -179,11 +173,18 @@ int   init_Jobs( int n_workers ) {
 void             shutdown_Jobs(void) {
 
 	job_queue_running = false;
+	wakeup_Job_queue();
 
 	for( int i=0; i<n_workers; i++ ) {
 		join_THREAD( &workers[i].thread, NULL );
 	}
 
+	free( workers );
+	workers = NULL;
+	n_workers = 0;
+
+	shutdown_Job_queue();
+
 }
 
 Handle submit_Job( uint32     deadline, 
@@ -247,9 +248,59 @@ int   join_deadline_Job( uint32 deadline, mutex_t* mutex, condition_t* signal )
 
 }
 
+// Latches ////////////////////////////////////////////////////////////////////
+
+int      init_Job_Latch( Job_Latch* latch ) {
+
+	latch->pending = 0;
+	if( 0 != init_MUTEX( &latch->mutex ) )
+		return -1;
+
+	return 0 == init_CONDITION( &latch->done ) ? 0 : -1;
+
+}
+
+int   destroy_Job_Latch( Job_Latch* latch ) {
+
+	assert( 0 == latch->pending );
+	destroy_CONDITION( &latch->done );
+	return 0 == destroy_MUTEX( &latch->mutex ) ? 0 : -1;
+
+}
+
+void      add_Job_Latch( Job_Latch* latch, int n ) {
+
+	lock_MUTEX( &latch->mutex );
+	latch->pending += n;
+	unlock_MUTEX( &latch->mutex );
+
+}
+
+// Counting down under the mutex keeps the waiter from seeing zero, and
+// destroying the latch, before the last arrival is done with it
+void   arrive_Job_Latch( Job_Latch* latch ) {
+
+	lock_MUTEX( &latch->mutex );
+	assert( latch->pending > 0 );
+	if( 0 == --latch->pending )
+		broadcast_CONDITION( &latch->done );
+	unlock_MUTEX( &latch->mutex );
+
+}
+
+void     wait_Job_Latch( Job_Latch* latch ) {
+
+	lock_MUTEX( &latch->mutex );
+	while( latch->pending > 0 )
+		wait_CONDITION( &latch->done, &latch->mutex );
+	unlock_MUTEX( &latch->mutex );
+
+}
+
 #ifdef __job_core_TEST__
 
 #include <stdlib.h>
+#include <string.h>
 #include "job.control.h"
 
 declare_job( unsigned long long, fibonacci,
@@ -293,10 +344,152 @@ define_job( unsigned long long, fibonacci,
 	end_job;
 }
 
+// Number of jobs spawned to compute fib(n) the way `fibonacci' does
+static unsigned long long count_fibonacci_jobs( long n ) {
+
+	unsigned long long a = 1, b = 1; // jobs(0), jobs(1)
+	for( long i=2; i<=n; i++ ) {
+		unsigned long long c = 1 + a + b;
+		a = b; b = c;
+	}
+	return b;
+
+}
+
+static usec_t run_fibonacci( long n, unsigned long long* fib_n, 
+                             mutex_t* mutex, condition_t* cond ) {
+
+	typeof_Job_params(fibonacci) params = { n };
+
+	usec_t timebase = microseconds();
+	submit_Job( n, cpuBound, fib_n, (jobfunc_f)fibonacci, &params);
+
+	lock_MUTEX(mutex);
+	while( join_deadline_Job( (uint32)n, mutex, cond ) < 0 );
+	unlock_MUTEX(mutex);
+
+	return microseconds() - timebase;
+
+}
+
+// Benchmark mode: run the fibonacci test with 1, 2, 4, ... `max_threads' 
+// workers and report job throughput for each worker count.
+static int benchmark( int max_threads, long n ) {
+
+	mutex_t mutex; init_MUTEX(&mutex);
+	condition_t cond; init_CONDITION(&cond);
+
+	const int sampleSize = 5;
+	const unsigned long long n_jobs = count_fibonacci_jobs(n);
+	double base_rate = 0.0;
+
+	printf("fib(%ld): %llu jobs per run, %d runs per worker count\n\n", 
+	       n, n_jobs, sampleSize);
+	printf("%8s %12s %14s %8s\n", "workers", "avg (sec)", "jobs/sec", "speedup");
+
+	for( int n_threads=1; n_threads <= max_threads; ) {
+
+		init_Jobs( n_threads );
+
+		usec_t totaltime = 0;
+		for( int i=0; i<sampleSize; i++ ) {
+			unsigned long long fib_n;
+			totaltime += run_fibonacci( n, &fib_n, &mutex, &cond );
+		}
+
+		shutdown_Jobs();
+
+		double avg  = (double)totaltime / sampleSize / usec_perSecond;
+		double rate = (double)n_jobs / avg;
+		if( 1 == n_threads )
+			base_rate = rate;
+
+		printf("%8d %12.4f %14.0f %7.2fx\n", n_threads, avg, rate, 
+		       base_rate > 0.0 ? rate / base_rate : 0.0);
+
+		// Powers of two, and always finish with `max_threads'
+		if( n_threads < max_threads && 2*n_threads > max_threads )
+			n_threads = max_threads;
+		else
+			n_threads *= 2;
+
+	}
+
+	return 0;
+
+}
+
+// A batch of jobs joined with a latch, twice over, and an empty batch
+declare_job( void, count_up, Job_Latch* latch; volatile int* count );
+
+define_job( void, count_up, uint32 unused ) {
+
+	begin_job;
+
+	__sync_add_and_fetch( arg(count), 1 );
+	arrive_Job_Latch( arg(latch) );
+
+	end_job;
+
+}
+
+static void run_latch( void ) {
+
+	enum { n = 64 };
+
+	Job_Latch latch; init_Job_Latch( &latch );
+	typeof_Job_params(count_up) params[n];
+	volatile int count = 0;
+
+	wait_Job_Latch( &latch );
+
+	for( int round=1; round<=2; round++ ) {
+
+		add_Job_Latch( &latch, n );
+		for( int i=0; i<n; i++ ) {
+			params[i] = (typeof_Job_params(count_up)){ &latch, &count };
+			submit_Job( 0, cpuBound, NULL, (jobfunc_f)count_up, &params[i] );
+		}
+
+		wait_Job_Latch( &latch );
+		assert( round * n == count );
+
+	}
+
+	destroy_Job_Latch( &latch );
+
+	// The waiter frees the latch as soon as it is woken, while the job
+	// that woke it may still be returning from arrive
+	for( int round=0; round<1000; round++ ) {
+
+		Job_Latch* heap = malloc( sizeof(Job_Latch) );
+		init_Job_Latch( heap );
+		add_Job_Latch( heap, 1 );
+
+		params[0] = (typeof_Job_params(count_up)){ heap, &count };
+		submit_Job( 0, cpuBound, NULL, (jobfunc_f)count_up, &params[0] );
+
+		wait_Job_Latch( heap );
+		destroy_Job_Latch( heap );
+		free( heap );
+
+	}
+	assert( 2 * n + 1000 == count );
+
+	printf("Latch joined 2 x %d jobs, then 1000 x 1\n", n);
+
+}
+
 int main( int argc, char* argv[] ) {
 
+	bool bench = ( argc > 1 && 0 == strcmp( argv[1], "-b" ) );
+	if( bench ) {
+		argc--; argv++;
+	}
+
 	if( argc < 3 ) {
-		fprintf(stderr, "usage: %s <n_workers> <nth fibonacci # to calculate>\n", argv[0]);
+		fprintf(stderr, "usage: %s [-b] <n_workers> <nth fibonacci # to calculate>\n", argv[0]);
+		fprintf(stderr, "  -b  benchmark throughput for 1, 2, 4, ... n_workers\n");
 		return 1;
 	}
 
@@ -307,6 +500,10 @@ int main( int argc, char* argv[] ) {
 		fprintf(stderr, "Must be greater than or equal to 0.\n");
 		return 1;
 	}
+
+	if( bench )
+		return benchmark( n_threads, n );
+
 	printf("sizeof(jobclass_e) = %zu\n", sizeof(jobclass_e));
 	printf("sizeof(jobstatus_e) = %zu\n", sizeof(jobstatus_e));
 	printf("sizeof(fibre_t) = %zu\n", sizeof(fibre_t));
@@ -325,22 +522,14 @@ int main( int argc, char* argv[] ) {
 	for( int i=0; i<sampleSize; i++ ) {
 
 		unsigned long long fib_n; 
-		typeof_Job_params(fibonacci) params = { n };
-
-		usec_t timebase = microseconds();
-		submit_Job( n, cpuBound, &fib_n, (jobfunc_f)fibonacci, &params);
-				
-		lock_MUTEX(&mutex);
-		while( join_deadline_Job( (uint32)n, &mutex, &cond ) < 0 );
-		unlock_MUTEX(&mutex);
-		
-		usec_t jobend = microseconds();
-		usec_t elapsed = jobend - timebase;
+		usec_t elapsed = run_fibonacci( n, &fib_n, &mutex, &cond );
 		printf("The %lluth fibonacci number is %lld (job completed in %5.2f sec)\n", (unsigned long long)n, fib_n, (double)elapsed / usec_perSecond);
 
 		totaltime += elapsed;
 	}
 
+	run_latch();
+
 	shutdown_Jobs();
 
 	printf("\n");
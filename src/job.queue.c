@@ -1,10 +1,12 @@
 #include <assert.h>
 #include <stddef.h>
+#include <stdlib.h>
 
 #include "core.features.h"
 #include "control.maybe.h"
 #include "core.log.h"
 #include "data.list.h"
+#include "data.pqueue.h"
 #include "job.histogram.h"
 #include "job.queue.h"
 #include "mm.heap.h"
@@ -14,20 +16,45 @@
 #include "sync.spinlock.h"
 
 // Job queue //////////////////////////////////////////////////////////////////
+//
+// Every worker owns a local run queue which receives the jobs spawned or woken
+// on that worker. Idle workers steal from the local queues of busy ones. The
+// global queue only receives jobs submitted from threads that are not workers
+// (e.g. the main thread), so in the common case of jobs spawning jobs no two
+// workers contend on the same lock.
+
+struct worker_queue_s {
+
+	spinlock_t  lock;
+	Pqueue*     local;    // Jobs spawned/woken on this worker; may be stolen
+
+	spinlock_t  sticky_lock;
+	Pqueue*     sticky;   // Jobs that must run on this worker; never stolen
+
+};
+
+// Check the global queue first once every so many dequeues, so that a
+// worker kept busy by its own local queue cannot starve global submissions
+#define globalQueuePeriod 61
 
 static region_p    job_pool = NULL;
 
 static List*       free_job_list;
 static spinlock_t  free_job_lock;
 
-static List*       job_queue;
+static Pqueue*     job_queue;
 static spinlock_t  job_queue_lock;
 
 static mutex_t     job_queue_mutex;
 static condition_t job_queue_signal;
+static int         idle_workers = 0;
+
+static int                    n_worker_queues = 0;
+static struct worker_queue_s* worker_queues = NULL;
 
-static threadlocal List*       sticky_queue;
-static threadlocal spinlock_t  sticky_queue_lock;
+static threadlocal int                    worker_id = -1;
+static threadlocal struct worker_queue_s* worker_queue = NULL;
+static threadlocal uint                   dequeue_ticks = 0;
 
 static uint32 alloc_id() {
 
@@ -56,16 +83,92 @@ static uint32 init_job( Job* job,
 	job->status = jobNew;
 	job->cancelled = false;
 
-	job->waitqueue = new_List( job->R, sizeof(Handle) );
-	assert( isempty_List(job->waitqueue) );
+	job->waitqueue = new_Pool( job->R, sizeof(Handle) );
+	assert( isempty_Pool(job->waitqueue) );
 	
 	return job->id;
 
 }
 
+// Pop the earliest deadline (or back) of `queue` under `lock`. The job is now
+// part of the runqueue of the calling worker, so lock it up before releasing
+// the queue.
+static Job* pop_locked( spinlock_t* lock, Pqueue* queue, bool back ) {
+
+	lock_SPINLOCK( lock );
+
+	Job* job = back ? pop_back_Pqueue( queue ) : pop_Pqueue( queue );
+	if( job )
+		lock_SPINLOCK( &job->lock );
+
+	unlock_SPINLOCK( lock );
+
+	return job;
+
+}
+
+// Steal from the other workers' local queues. We take from the back, i.e. a
+// leaf of the heap, leaving the most urgent work with its owner.
+static Job* steal( void ) {
+
+	for( int i=1; i<n_worker_queues; i++ ) {
+
+		struct worker_queue_s* victim = 
+			&worker_queues[ (worker_id + i) % n_worker_queues ];
+
+		if( isempty_Pqueue(victim->local) )
+			continue;
+
+		Job* job = pop_locked( &victim->lock, victim->local, true );
+		if( job ) {
+			trace( "STEAL 0x%x:%x", (unsigned)job, job->id );
+			return job;
+		}
+
+	}
+
+	return NULL;
+
+}
+
+// Returns true if there is any job that could be dequeued by this thread. 
+// Called with job_queue_mutex held, so it must not take any queue locks: a
+// thief holding a queue lock may be waiting on a job lock whose owner is 
+// waiting on the mutex in notify(). Peeking is enough; see notify().
+static bool pending( void ) {
+
+	if( !isempty_Pqueue( job_queue ) )
+		return true;
+
+	for( int i=0; i<n_worker_queues; i++ ) {
+
+		if( !isempty_Pqueue( worker_queues[i].local ) )
+			return true;
+
+	}
+
+	return false;
+
+}
+
+// Wake up one idle worker, if there are any
+static void notify( void ) {
+
+	// Make sure the insert is visible before we look at `idle_workers'; pairs
+	// with the increment in dequeue_Job.
+	__sync_synchronize();
+	if( 0 == idle_workers )
+		return;
+
+	lock_MUTEX( &job_queue_mutex );
+	signal_CONDITION( &job_queue_signal );
+	unlock_MUTEX( &job_queue_mutex );
+
+}
+
 // Public API /////////////////////////////////////////////////////////////////
 
-int init_Job_queue(void) {
+int init_Job_queue( int n_workers ) {
 
 	if( !job_pool ) {
 		
@@ -84,19 +187,74 @@ int init_Job_queue(void) {
 		if( !job_pool )
 			return -1;
 
-		job_queue     = new_List( job_pool, sizeof(Job) );
+		job_queue     = new_Pqueue( ZONE_heap, 0 );
 		free_job_list = new_List( job_pool, sizeof(Job) );
 
-		return ret;
 	}
+
+	// Per-worker queues; allocated up front so workers never need to touch
+	// a shared region when they start up.
+	assert( NULL == worker_queues );
+
+	worker_queues = calloc( n_workers, sizeof(struct worker_queue_s) );
+	if( !worker_queues )
+		return -1;
+
+	for( int i=0; i<n_workers; i++ ) {
+
+		struct worker_queue_s* wq = &worker_queues[i];
+
+		wq->local  = new_Pqueue( ZONE_heap, 0 );
+		wq->sticky = new_Pqueue( ZONE_heap, 0 );
+
+		int ret = init_SPINLOCK( &wq->lock );
+		ret = maybe(ret, < 0, init_SPINLOCK( &wq->sticky_lock ));
+
+		if( ret < 0 )
+			return ret;
+
+		n_worker_queues = i+1;
+
+	}
+
 	return 0;
 
 }
 
-int init_Job_queue_thread( pointer thread ) {
+int init_Job_queue_thread( int id ) {
+
+	assert( id >= 0 && id < n_worker_queues );
+
+	worker_id    = id;
+	worker_queue = &worker_queues[id];
+	dequeue_ticks = 0;
+
+	return 0;
+
+}
+
+void wakeup_Job_queue( void ) {
+
+	lock_MUTEX( &job_queue_mutex );
+	broadcast_CONDITION( &job_queue_signal );
+	unlock_MUTEX( &job_queue_mutex );
+
+}
+
+void shutdown_Job_queue( void ) {
+
+	for( int i=0; i<n_worker_queues; i++ ) {
+
+		destroy_SPINLOCK( &worker_queues[i].lock );
+		destroy_SPINLOCK( &worker_queues[i].sticky_lock );
+		delete_Pqueue( worker_queues[i].local );
+		delete_Pqueue( worker_queues[i].sticky );
+
+	}
 
-	sticky_queue = new_List( job_pool, sizeof(Job) );
-	return init_SPINLOCK( &sticky_queue_lock );
+	free( worker_queues );
+	worker_queues   = NULL;
+	n_worker_queues = 0;
 
 }
 
@@ -106,15 +264,24 @@ void  insert_Job( Job* job ) {
 	assert( jobBlocked == job->status || jobCancelled == job->status || jobNew == job->status );
 	trace( "INSERT 0x%x:%x", (unsigned)job, job->id );
 
-	List*      queue = job_queue;
+	Pqueue*    queue = job_queue;
 	spinlock_t* lock = &job_queue_lock;
 
-	// If we are running in a worker thread and the job is sticky
-	// insert it on the threadlocal queue
-	if( NULL != sticky_queue && stickyJob == job->jobclass ) {
+	// If we are running in a worker thread the job goes on our local queue,
+	// or if the job is sticky, on the queue nobody can steal from
+	if( NULL != worker_queue ) {
 
-		queue = sticky_queue;
-		lock  = &sticky_queue_lock;
+		if( stickyJob == job->jobclass ) {
+
+			queue = worker_queue->sticky;
+			lock  = &worker_queue->sticky_lock;
+
+		} else {
+
+			queue = worker_queue->local;
+			lock  = &worker_queue->lock;
+
+		}
 
 	}
 
@@ -124,31 +291,16 @@ void  insert_Job( Job* job ) {
 	// prevents further inserts
 	job->status = jobWaiting;
 
-	// Empty queue
-	if( isempty_List(queue) ) {
-		// Interleave the lock so that if someone enters queue_wait
-		// at the same time we get here, we make sure they receive 
-		// the broadcast
-		lock_MUTEX( &job_queue_mutex );
-
-		push_front_List( queue, job );
-
-		unlock_SPINLOCK( lock );
-
-		// Signal anyone waiting for jobs
-		broadcast_CONDITION( &job_queue_signal );
-		unlock_MUTEX( &job_queue_mutex );
-
-		return;
-	}
-
-	Job* node = NULL;
-
-	find__List( queue, node, job->deadline < node->deadline );
-	insert_before_List( queue, node, job );
+	bool was_empty = isempty_Pqueue( queue );
+	push_Pqueue( queue, job->deadline, job );
 
 	unlock_SPINLOCK( lock );
 
+	// Wake someone up when the queue goes from empty to non-empty; nobody
+	// else can run our sticky jobs, so in that case there's no one to wake
+	if( was_empty && (NULL == worker_queue || queue != worker_queue->sticky) )
+		notify();
+
 }
 
 Handle alloc_Job( uint32 deadline, jobclass_e jobclass, void* result_p, jobfunc_f run, void* params ) {
@@ -191,7 +343,7 @@ void free_Job( Job* job ) {
 
 	job->id = 0;
 	assert( jobDone == job->status );
-	assert( isempty_List(job->waitqueue) );
+	assert( isempty_Pool(job->waitqueue) );
 	rcollect( job->R );
 
 	lock_SPINLOCK( &free_job_lock );
@@ -207,35 +359,47 @@ Job* dequeue_Job( usec_t timeout ) {
 	Job* job = NULL;
 
 	// Check any jobs on our sticky (threadlocal) queue
-	lock_SPINLOCK( &sticky_queue_lock );
-	Job* stickyJob = pop_front_List( sticky_queue );
-	unlock_SPINLOCK( &sticky_queue_lock );
+	if( worker_queue && !isempty_Pqueue(worker_queue->sticky) )
+		job = pop_locked( &worker_queue->sticky_lock, worker_queue->sticky, false );
+
+	if( NULL != job )
+		return job;
+
+	// Every so often look at the global queue first, for fairness
+	bool global_first = ( 0 == ++dequeue_ticks % globalQueuePeriod );
+
+	if( global_first || NULL == worker_queue ) 
+		job = pop_locked( &job_queue_lock, job_queue, false );
 
-	if( NULL != stickyJob )
-		return stickyJob;
+	// Then our own local queue
+	if( NULL == job && NULL != worker_queue )
+		job = pop_locked( &worker_queue->lock, worker_queue->local, false );
 
-	// Check the global queue
-	lock_SPINLOCK( &job_queue_lock );
-	job = pop_front_List( job_queue );
+	// Then the global queue
+	if( NULL == job && !global_first && NULL != worker_queue )
+		job = pop_locked( &job_queue_lock, job_queue, false );
+
+	// Finally try stealing from someone else
+	if( NULL == job && NULL != worker_queue )
+		job = steal();
 
 	if( NULL == job && 0 != timeout ) {
-		
+
 		lock_MUTEX( &job_queue_mutex );
-		// Interleave the lock so that no one can change job_queue between 
-		// the time we check NULL above and here
-		unlock_SPINLOCK( &job_queue_lock );
-		
-		timed_wait_CONDITION( timeout, &job_queue_signal, &job_queue_mutex );
+
+		// Advertise that we are idle, then check once more; anyone inserting
+		// from here on will see us and signal.
+		__sync_fetch_and_add( &idle_workers, 1 );
+
+		if( !pending() )
+			timed_wait_CONDITION( timeout, &job_queue_signal, &job_queue_mutex );
+
+		__sync_fetch_and_sub( &idle_workers, 1 );
 		unlock_MUTEX( &job_queue_mutex );
-		
+
 		// Now try again, but don't wait (we already have)
 		return dequeue_Job( 0 );
-		
-	} else {
-		if( job ) // The job is now part of the runqueue, lock it up
-			lock_SPINLOCK( &job->lock );
 
-		unlock_SPINLOCK( &job_queue_lock );
 	}
 
 	return job;
@@ -248,10 +412,15 @@ void wakeup_waitqueue_Job( spinlock_t* wq_lock, Waitqueue* waitqueue ) {
 	
 	if( wq_lock ) lock_SPINLOCK( wq_lock );
 
-	Handle* hdl = pop_front_List( *(waitqueue) );
+	Handle* hdl = pop_front_Pool( *(waitqueue) );
 
 	while( hdl ) {
 
+		// Copy the handle out and recycle its slot
+		Handle h = *hdl;
+		free_Pool_item( *(waitqueue), hdl );
+		hdl = &h;
+
 		Job* job = deref_Handle(Job,*hdl);
 		
 		lock_SPINLOCK( &job->lock );
@@ -273,7 +442,7 @@ void wakeup_waitqueue_Job( spinlock_t* wq_lock, Waitqueue* waitqueue ) {
 		
 		unlock_SPINLOCK( &job->lock );
 				
-		hdl = pop_front_List( *(waitqueue) );
+		hdl = pop_front_Pool( *(waitqueue) );
 
 	}
 
@@ -295,7 +464,7 @@ void sleep_waitqueue_Job( spinlock_t* wq_lock, Waitqueue* waitqueue, Job* waitin
 	                  uint32) );
 
 	// Make a handle to the waiting job
-	Handle* handle = new_List_item( *(waitqueue) );
+	Handle* handle = new_Pool_item( *(waitqueue) );
 
 	*handle = mk_Handle(waiting);
 
@@ -303,7 +472,7 @@ void sleep_waitqueue_Job( spinlock_t* wq_lock, Waitqueue* waitqueue, Job* waitin
 	waiting->status = jobBlocked;
 
 	// Push onto the waitqueue
-	push_back_List( *(waitqueue), handle );
+	push_back_Pool( *(waitqueue), handle );
 
 	if( wq_lock ) unlock_SPINLOCK( wq_lock );
 
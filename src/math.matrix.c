@@ -94,6 +94,164 @@ printf_arginfo_MAT44(const struct printf_info* info, size_t n, int* argtypes) {
 
 #endif // defined( feature_GLIBC )
 
+// Array kernels
+void mtransform_n( float4* dst, const mat44* m, const float4* v, int n ) {
+
+	int i = 0;
+
+#if defined(feature_AVX)
+
+	__m256 m1 = _mm256_broadcast_ps( (const __m128*)&m->_1 );
+	__m256 m2 = _mm256_broadcast_ps( (const __m128*)&m->_2 );
+	__m256 m3 = _mm256_broadcast_ps( (const __m128*)&m->_3 );
+	__m256 m4 = _mm256_broadcast_ps( (const __m128*)&m->_4 );
+
+	// Two vectors at a time
+	for( ; i+2 <= n; i+=2 ) {
+
+		__m256 c = _mm256_loadu_ps( &v[i].x );
+
+		__m256 p = _mm256_mul_ps( m1, _mm256_permute_ps( c, _MM_SHUFFLE(0,0,0,0) ) );
+		p = _mm256_add_ps( p, _mm256_mul_ps( m2, _mm256_permute_ps( c, _MM_SHUFFLE(1,1,1,1) ) ) );
+		p = _mm256_add_ps( p, _mm256_mul_ps( m3, _mm256_permute_ps( c, _MM_SHUFFLE(2,2,2,2) ) ) );
+		p = _mm256_add_ps( p, _mm256_mul_ps( m4, _mm256_permute_ps( c, _MM_SHUFFLE(3,3,3,3) ) ) );
+
+		_mm256_storeu_ps( &dst[i].x, p );
+
+	}
+
+#endif
+
+#if defined(feature_SSE2)
+
+	for( ; i<n; i++ )
+		_mm_storeu_ps( &dst[i].x, mtransform_SSE( m, load_FLOAT4(&v[i]) ) );
+
+#else
+
+	for( ; i<n; i++ )
+		dst[i] = mtransform( *m, v[i] );
+
+#endif
+
+}
+
+void      mmul_n( mat44* dst, const mat44* a, const mat44* b, int n ) {
+
+	for( int i=0; i<n; i++ ) {
+
+#if defined(feature_AVX)
+
+		__m256 m1 = _mm256_broadcast_ps( (const __m128*)&a[i]._1 );
+		__m256 m2 = _mm256_broadcast_ps( (const __m128*)&a[i]._2 );
+		__m256 m3 = _mm256_broadcast_ps( (const __m128*)&a[i]._3 );
+		__m256 m4 = _mm256_broadcast_ps( (const __m128*)&a[i]._4 );
+
+		for( int j=0; j<16; j+=8 ) {
+
+			__m256 c = _mm256_loadu_ps( &b[i]._1.x + j );
+
+			__m256 p = _mm256_mul_ps( m1, _mm256_permute_ps( c, _MM_SHUFFLE(0,0,0,0) ) );
+			p = _mm256_add_ps( p, _mm256_mul_ps( m2, _mm256_permute_ps( c, _MM_SHUFFLE(1,1,1,1) ) ) );
+			p = _mm256_add_ps( p, _mm256_mul_ps( m3, _mm256_permute_ps( c, _MM_SHUFFLE(2,2,2,2) ) ) );
+			p = _mm256_add_ps( p, _mm256_mul_ps( m4, _mm256_permute_ps( c, _MM_SHUFFLE(3,3,3,3) ) ) );
+
+			_mm256_storeu_ps( &dst[i]._1.x + j, p );
+
+		}
+
+#elif defined(feature_SSE2)
+
+		// Both loaded before anything is stored, in case dst is a or b
+		__m128 c1 = load_FLOAT4( &b[i]._1 ), c2 = load_FLOAT4( &b[i]._2 );
+		__m128 c3 = load_FLOAT4( &b[i]._3 ), c4 = load_FLOAT4( &b[i]._4 );
+		mat44 m = a[i];
+
+		_mm_storeu_ps( &dst[i]._1.x, mtransform_SSE( &m, c1 ) );
+		_mm_storeu_ps( &dst[i]._2.x, mtransform_SSE( &m, c2 ) );
+		_mm_storeu_ps( &dst[i]._3.x, mtransform_SSE( &m, c3 ) );
+		_mm_storeu_ps( &dst[i]._4.x, mtransform_SSE( &m, c4 ) );
+
+#else
+
+		dst[i] = mmul( a[i], b[i] );
+
+#endif
+
+	}
+
+}
+
+void   qmatrix_n( mat44* dst, const float4* q, int n ) {
+
+	int i = 0;
+
+#if defined(feature_SSE2)
+
+	// Four quaternions at a time, transposed so that each of x, y, z and w
+	// is a vector
+	const __m128 one = _mm_set1_ps( 1.f );
+	const __m128 two = _mm_set1_ps( 2.f );
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 w4 = _mm_set_ps( 1.f, 0.f, 0.f, 0.f );
+
+	for( ; i+4 <= n; i+=4 ) {
+
+		__m128 x = load_FLOAT4( &q[i] );
+		__m128 y = load_FLOAT4( &q[i+1] );
+		__m128 z = load_FLOAT4( &q[i+2] );
+		__m128 w = load_FLOAT4( &q[i+3] );
+		_MM_TRANSPOSE4_PS( x, y, z, w );
+
+		__m128 x2 = _mm_mul_ps( two, x );
+		__m128 y2 = _mm_mul_ps( two, y );
+		__m128 z2 = _mm_mul_ps( two, z );
+
+		__m128 xx = _mm_mul_ps( x2, x ), yy = _mm_mul_ps( y2, y ), zz = _mm_mul_ps( z2, z );
+		__m128 xy = _mm_mul_ps( x2, y ), xz = _mm_mul_ps( x2, z ), yz = _mm_mul_ps( y2, z );
+		__m128 xw = _mm_mul_ps( x2, w ), yw = _mm_mul_ps( y2, w ), zw = _mm_mul_ps( z2, w );
+
+		// Rows of these are the columns of the four matrices
+		__m128 a1 = _mm_sub_ps( _mm_sub_ps( one, yy ), zz );
+		__m128 a2 = _mm_add_ps( xy, zw );
+		__m128 a3 = _mm_sub_ps( xz, yw );
+		__m128 a4 = zero;
+
+		__m128 b1 = _mm_sub_ps( xy, zw );
+		__m128 b2 = _mm_sub_ps( _mm_sub_ps( one, xx ), zz );
+		__m128 b3 = _mm_add_ps( yz, xw );
+		__m128 b4 = zero;
+
+		__m128 c1 = _mm_add_ps( xz, yw );
+		__m128 c2 = _mm_sub_ps( yz, xw );
+		__m128 c3 = _mm_sub_ps( _mm_sub_ps( one, xx ), yy );
+		__m128 c4 = zero;
+
+		_MM_TRANSPOSE4_PS( a1, a2, a3, a4 );
+		_MM_TRANSPOSE4_PS( b1, b2, b3, b4 );
+		_MM_TRANSPOSE4_PS( c1, c2, c3, c4 );
+
+		_mm_storeu_ps( &dst[i]._1.x, a1 ); _mm_storeu_ps( &dst[i]._2.x, b1 );
+		_mm_storeu_ps( &dst[i]._3.x, c1 ); _mm_storeu_ps( &dst[i]._4.x, w4 );
+
+		_mm_storeu_ps( &dst[i+1]._1.x, a2 ); _mm_storeu_ps( &dst[i+1]._2.x, b2 );
+		_mm_storeu_ps( &dst[i+1]._3.x, c2 ); _mm_storeu_ps( &dst[i+1]._4.x, w4 );
+
+		_mm_storeu_ps( &dst[i+2]._1.x, a3 ); _mm_storeu_ps( &dst[i+2]._2.x, b3 );
+		_mm_storeu_ps( &dst[i+2]._3.x, c3 ); _mm_storeu_ps( &dst[i+2]._4.x, w4 );
+
+		_mm_storeu_ps( &dst[i+3]._1.x, a4 ); _mm_storeu_ps( &dst[i+3]._2.x, b4 );
+		_mm_storeu_ps( &dst[i+3]._3.x, c4 ); _mm_storeu_ps( &dst[i+3]._4.x, w4 );
+
+	}
+
+#endif
+
+	for( ; i<n; i++ )
+		dst[i] = qmatrix( q[i] );
+
+}
+
 // Constants
 const mat44 identity_MAT44 = {
   ._1 = { 1.f, 0.f, 0.f, 0.f },
@@ -119,6 +277,148 @@ void init_printf_MAT44(void) {
 
 #ifdef __math_matrix_TEST__
 
+#include <assert.h>
+#include <string.h>
+
+#include "time.core.h"
+
+static bool near4( float4 a, float4 b ) {
+
+	return fabsf( a.x - b.x ) < 1e-4f && fabsf( a.y - b.y ) < 1e-4f
+		&& fabsf( a.z - b.z ) < 1e-4f && fabsf( a.w - b.w ) < 1e-4f;
+
+}
+
+static bool near44( const mat44* a, const mat44* b ) {
+
+	return near4( a->_1, b->_1 ) && near4( a->_2, b->_2 )
+		&& near4( a->_3, b->_3 ) && near4( a->_4, b->_4 );
+
+}
+
+static float frand( void ) {
+
+	return 2.f * (float)rand() / RAND_MAX - 1.f;
+
+}
+
+static float4 vrand( void ) {
+
+	return (float4){ frand(), frand(), frand(), frand() };
+
+}
+
+// Millions of operations per second
+static double mops( int n, int reps, usec_t elapsed ) {
+
+	return elapsed > 0 ? (double)n * reps / (double)elapsed : 0.;
+
+}
+
+static void benchmark( int n, int reps ) {
+
+	float4* v  = malloc( n * sizeof(float4) );
+	float4* q  = malloc( n * sizeof(float4) );
+	float4* vo = malloc( n * sizeof(float4) );
+	mat44*  a  = malloc( n * sizeof(mat44) );
+	mat44*  b  = malloc( n * sizeof(mat44) );
+	mat44*  mo = malloc( n * sizeof(mat44) );
+
+	for( int i=0; i<n; i++ ) {
+		v[i] = vrand();
+		q[i] = vnormal( vrand() );
+		a[i] = (mat44){ vrand(), vrand(), vrand(), vrand() };
+		b[i] = (mat44){ vrand(), vrand(), vrand(), vrand() };
+	}
+
+	// The kernels agree with the scalar operators
+	mtransform_n( vo, &a[0], v, n );
+	for( int i=0; i<n; i++ )
+		assert( near4( vo[i], mtransform( a[0], v[i] ) ) );
+
+	mmul_n( mo, a, b, n );
+	for( int i=0; i<n; i++ ) {
+		mat44 m = mmul( a[i], b[i] );
+		mat44 mv = mmulv( &a[i], &b[i] );
+		assert( near44( &mo[i], &m ) && near44( &mv, &m ) );
+	}
+
+	qmul_n( vo, q, v, n );
+	for( int i=0; i<n; i++ )
+		assert( near4( vo[i], qmul( q[i], v[i] ) ) );
+
+	qmatrix_n( mo, q, n );
+	for( int i=0; i<n; i++ ) {
+		mat44 m = qmatrix( q[i] );
+		assert( near44( &mo[i], &m ) );
+	}
+
+	// In place
+	memcpy( mo, a, n * sizeof(mat44) );
+	mmul_n( mo, mo, b, n );
+	for( int i=0; i<n; i++ ) {
+		mat44 m = mmul( a[i], b[i] );
+		assert( near44( &mo[i], &m ) );
+	}
+
+	// Throughput of the operators applied one at a time, against the kernels
+	usec_t t0, t1, t2;
+
+	printf("\n%d elements x %d; millions of operations per second\n\n", n, reps);
+	printf("%12s %10s %10s\n", "", "scalar", "SIMD _n");
+
+	t0 = microseconds();
+	for( int r=0; r<reps; r++ )
+		for( int i=0; i<n; i++ )
+			vo[i] = mtransform( a[r & 7], v[i] );
+	t1 = microseconds();
+	for( int r=0; r<reps; r++ )
+		mtransform_n( vo, &a[r & 7], v, n );
+	t2 = microseconds();
+	printf("%12s %10.1f %10.1f\n", "mtransform", mops( n, reps, t1 - t0 ), mops( n, reps, t2 - t1 ));
+
+	t0 = microseconds();
+	for( int r=0; r<reps; r++ )
+		for( int i=0; i<n; i++ )
+			mo[i] = mmul( a[i], b[i] );
+	t1 = microseconds();
+	for( int r=0; r<reps; r++ )
+		mmul_n( mo, a, b, n );
+	t2 = microseconds();
+	printf("%12s %10.1f %10.1f\n", "mmul", mops( n, reps, t1 - t0 ), mops( n, reps, t2 - t1 ));
+
+	t0 = microseconds();
+	for( int r=0; r<reps; r++ )
+		for( int i=0; i<n; i++ )
+			mo[i] = mmulv( &a[i], &b[i] );
+	t1 = microseconds();
+	printf("%12s %10.1f %10s\n", "mmulv", mops( n, reps, t1 - t0 ), "-");
+
+	t0 = microseconds();
+	for( int r=0; r<reps; r++ )
+		for( int i=0; i<n; i++ )
+			vo[i] = qmul( q[i], v[i] );
+	t1 = microseconds();
+	for( int r=0; r<reps; r++ )
+		qmul_n( vo, q, v, n );
+	t2 = microseconds();
+	printf("%12s %10.1f %10.1f\n", "qmul", mops( n, reps, t1 - t0 ), mops( n, reps, t2 - t1 ));
+
+	t0 = microseconds();
+	for( int r=0; r<reps; r++ )
+		for( int i=0; i<n; i++ )
+			mo[i] = qmatrix( q[i] );
+	t1 = microseconds();
+	for( int r=0; r<reps; r++ )
+		qmatrix_n( mo, q, n );
+	t2 = microseconds();
+	printf("%12s %10.1f %10.1f\n", "qmatrix", mops( n, reps, t1 - t0 ), mops( n, reps, t2 - t1 ));
+
+	free( v ); free( q ); free( vo );
+	free( a ); free( b ); free( mo );
+
+}
+
 int main(int argc, char* argv[]) {
 	
 	init_printf_MAT44();
@@ -174,6 +474,9 @@ int main(int argc, char* argv[]) {
 	printf("q% 4.2V ~ aa% 4.2V\n", &qY, &Y);
 	printf("q% 4.2V ~ aa% 4.2V\n", &qZ, &Z);
 
+	benchmark( 4096, argc > 1 ? (int)strtol( argv[1], NULL, 10 ) : 1000 );
+
+	printf("\nOk\n");
 	return 0;
 }
 
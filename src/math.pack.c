@@ -0,0 +1,267 @@
+#include <string.h>
+
+#include "math.pack.h"
+
+// Half floats ////////////////////////////////////////////////////////////////
+
+uint16  pack_half( float f ) {
+
+	uint32 x; memcpy( &x, &f, sizeof(x) );
+
+	uint32 sign = (x >> 16) & 0x8000;
+	uint32 absx = x & 0x7fffffff;
+
+	// Too big for a half, or infinite, or NaN
+	if( absx >= 0x47800000 )
+		return (uint16)( sign | ( absx > 0x7f800000 ? 0x7e00 : 0x7c00 ) );
+
+	// A subnormal half, or zero: adding 0.5 lines the mantissa bits up
+	// with those of the half, the FPU doing the rounding
+	if( absx < 0x38800000 ) {
+
+		float a; memcpy( &a, &absx, sizeof(a) );
+		a += 0.5f;
+
+		uint32 r; memcpy( &r, &a, sizeof(r) );
+		return (uint16)( sign | ( r - 0x3f000000 ) );
+
+	}
+
+	// Rebias the exponent, and round the mantissa to nearest even; carries
+	// into the exponent are right, up to the infinity
+	uint32 odd = (absx >> 13) & 1;
+	absx += ( (uint32)(15 - 127) << 23 ) + 0xfff + odd;
+
+	return (uint16)( sign | (absx >> 13) );
+
+}
+
+float unpack_half( uint16 h ) {
+
+	uint32 sign = (uint32)(h & 0x8000) << 16;
+	uint32 exp  = (h >> 10) & 0x1f;
+	uint32 mant = h & 0x3ff;
+	uint32 x;
+
+	if( 0 == exp ) {
+
+		float f = (float)mant * 0x1p-24f;
+		return sign ? -f : f;
+
+	} else if( 0x1f == exp )
+		x = sign | 0x7f800000 | (mant << 13);
+	else
+		x = sign | ( (exp + 127 - 15) << 23 ) | (mant << 13);
+
+	float f; memcpy( &f, &x, sizeof(f) );
+	return f;
+
+}
+
+// Octahedral normals /////////////////////////////////////////////////////////
+
+static inline float sign_not_zero( float f ) {
+
+	return f < 0.f ? -1.f : 1.f;
+
+}
+
+// The point of the upper octahedron, folded, that `n' projects to
+static void oct_project( float4 n, float* u, float* v ) {
+
+	float l1 = fabsf( n.x ) + fabsf( n.y ) + fabsf( n.z );
+	float x  = l1 > 0.f ? n.x / l1 : 0.f;
+	float y  = l1 > 0.f ? n.y / l1 : 0.f;
+
+	if( n.z < 0.f ) {
+
+		float fx = ( 1.f - fabsf( y ) ) * sign_not_zero( x );
+		float fy = ( 1.f - fabsf( x ) ) * sign_not_zero( y );
+		x = fx;
+		y = fy;
+
+	}
+
+	*u = x;
+	*v = y;
+
+}
+
+static float4 oct_unproject( float x, float y ) {
+
+	float4 n = { x, y, 1.f - fabsf( x ) - fabsf( y ), 0.f };
+
+	if( n.z < 0.f ) {
+
+		float fx = ( 1.f - fabsf( n.y ) ) * sign_not_zero( n.x );
+		float fy = ( 1.f - fabsf( n.x ) ) * sign_not_zero( n.y );
+		n.x = fx;
+		n.y = fy;
+
+	}
+
+	float l = sqrtf( n.x*n.x + n.y*n.y + n.z*n.z );
+	return (float4){ n.x / l, n.y / l, n.z / l, 0.f };
+
+}
+
+void    pack_oct16( float4 n, int16 out[2] ) {
+
+	float u, v;
+	oct_project( n, &u, &v );
+
+	// Try rounding each coordinate both ways. They are compared by distance
+	// rather than dot product, which is too near 1 to tell them apart
+	float fu = floorf( u * 32767.f ), fv = floorf( v * 32767.f );
+	float best = 5.f;
+
+	for( int i=0; i<4; i++ ) {
+
+		float qu = fu + (float)(i & 1);
+		float qv = fv + (float)(i >> 1);
+		if( qu > 32767.f || qv > 32767.f )
+			continue;
+
+		int16  q[2] = { (int16)qu, (int16)qv };
+		float4 d    = vsub( unpack_oct16( q ), n );
+		float  e    = d.x*d.x + d.y*d.y + d.z*d.z;
+
+		if( e < best ) {
+			best   = e;
+			out[0] = q[0];
+			out[1] = q[1];
+		}
+
+	}
+
+}
+
+float4 unpack_oct16( const int16 in[2] ) {
+
+	return oct_unproject( unpack_snorm16( in[0] ), unpack_snorm16( in[1] ) );
+
+}
+
+#ifdef __math_pack_TEST__
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static float frand( float lo, float hi ) {
+
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	// Every half survives the round trip, NaNs as NaNs
+	for( uint32 h=0; h<0x10000; h++ ) {
+
+		float f = unpack_half( (uint16)h );
+		if( isnan( f ) )
+			assert( isnan( unpack_half( pack_half( f ) ) ) );
+		else
+			assert( pack_half( f ) == h );
+
+	}
+
+	assert( 0x3c00 == pack_half( 1.f ) );
+	assert( 0xc000 == pack_half( -2.f ) );
+	assert( 0x7bff == pack_half( 65504.f ) );
+	assert( 0x7c00 == pack_half( 65520.f ) );      // Rounds up to infinity
+	assert( 0x7c00 == pack_half( 1e9f ) );
+	assert( 0x0001 == pack_half( 0x1p-24f ) );
+	assert( 0x0000 == pack_half( 0x1p-26f ) );
+	assert( 0x8000 == pack_half( -0.f ) );
+	assert( 0x3c00 == pack_half( 1.f + 0x1p-11f ) ); // A tie, to even
+	assert( 0x3c02 == pack_half( 1.f + 3*0x1p-11f ) );
+
+	// Half: relative error at most 2^-11 over the normal range, absolute
+	// error at most 2^-25 below it
+	float max_half = 0.f;
+	for( int i=0; i<1000000; i++ ) {
+
+		float f = ldexpf( frand( -1.f, 1.f ), (rand() % 40) - 24 );
+		float g = unpack_half( pack_half( f ) );
+
+		if( fabsf( f ) >= 0x1p-14f ) {
+			float e = fabsf( g - f ) / fabsf( f );
+			assert( e <= 0x1p-11f );
+			if( e > max_half ) max_half = e;
+		} else
+			assert( fabsf( g - f ) <= 0x1p-25f );
+
+	}
+
+	// Normalized: absolute error at most half a step, ends exact
+	float max_unorm = 0.f, max_snorm = 0.f;
+	for( int i=0; i<1000000; i++ ) {
+
+		float f = frand( 0.f, 1.f );
+		float e = fabsf( unpack_unorm16( pack_unorm16( f ) ) - f );
+		assert( e <= 0.5f / 65535.f + 1e-7f );
+		if( e > max_unorm ) max_unorm = e;
+
+		f = frand( -1.f, 1.f );
+		e = fabsf( unpack_snorm16( pack_snorm16( f ) ) - f );
+		assert( e <= 0.5f / 32767.f + 1e-7f );
+		if( e > max_snorm ) max_snorm = e;
+
+	}
+
+	assert( 0 == pack_unorm16( -1.f ) && 65535 == pack_unorm16( 2.f ) );
+	assert( 1.f == unpack_unorm16( pack_unorm16( 1.f ) ) );
+	assert( -1.f == unpack_snorm16( pack_snorm16( -1.f ) ) );
+	assert( -1.f == unpack_snorm16( -32768 ) );
+
+	// Octahedral: unit length out, within a small angle of the normal in,
+	// axes and the seam below exact enough
+	float max_angle = 0.f;
+	for( int i=0; i<1000000; i++ ) {
+
+		float4 n;
+		do
+			n = (float4){ frand( -1.f, 1.f ), frand( -1.f, 1.f ), frand( -1.f, 1.f ), 0.f };
+		while( vlength2( n ) < 1e-4f || vlength2( n ) > 1.f );
+		n = vscale( 1.f / sqrtf( vlength2( n ) ), n );
+
+		int16  q[2];
+		pack_oct16( n, q );
+		float4 d = unpack_oct16( q );
+
+		assert( fabsf( vlength2( d ) - 1.f ) < 1e-5f );
+
+		// In doubles; acosf of a float dot product is no better than 3e-4
+		double cx = (double)n.y*d.z - (double)n.z*d.y;
+		double cy = (double)n.z*d.x - (double)n.x*d.z;
+		double cz = (double)n.x*d.y - (double)n.y*d.x;
+		double dot = (double)n.x*d.x + (double)n.y*d.y + (double)n.z*d.z;
+		float  angle = (float)atan2( sqrt( cx*cx + cy*cy + cz*cz ), dot );
+		if( angle > max_angle ) max_angle = angle;
+
+	}
+	assert( max_angle < 1e-4f );
+
+	const float4 axes[] = {
+		{ 1.f, 0.f, 0.f, 0.f }, { -1.f, 0.f, 0.f, 0.f },
+		{ 0.f, 1.f, 0.f, 0.f }, { 0.f, -1.f, 0.f, 0.f },
+		{ 0.f, 0.f, 1.f, 0.f }, { 0.f, 0.f, -1.f, 0.f }
+	};
+	for( int i=0; i<6; i++ ) {
+		int16  q[2];
+		pack_oct16( axes[i], q );
+		float4 d = unpack_oct16( q );
+		assert( d.x*axes[i].x + d.y*axes[i].y + d.z*axes[i].z > 1.f - 1e-6f );
+	}
+
+	printf( "max errors: half %.3g (relative), unorm16 %.3g, snorm16 %.3g, oct16 %.3g rad\n",
+	        max_half, max_unorm, max_snorm, max_angle );
+
+	printf("Ok\n");
+	return 0;
+
+}
+
+#endif
@@ -65,6 +65,50 @@ printf_arginfo_FLOAT4(const struct printf_info* info, size_t n, int* argtypes) {
 
 #endif // defined( feature_GLIBC )
 
+// Array kernels
+#if defined(feature_AVX)
+
+// Two quaternions at once, one per 128-bit lane. Each component of q
+// weights a permutation of r, with signs flipped.
+static inline __m256 qmul_AVX( __m256 q, __m256 r ) {
+
+	const __m256 sx = _mm256_set_ps( -0.f,  0.f, -0.f,  0.f, -0.f,  0.f, -0.f,  0.f );
+	const __m256 sy = _mm256_set_ps( -0.f, -0.f,  0.f,  0.f, -0.f, -0.f,  0.f,  0.f );
+	const __m256 sz = _mm256_set_ps( -0.f,  0.f,  0.f, -0.f, -0.f,  0.f,  0.f, -0.f );
+
+	__m256 rx = _mm256_xor_ps( _mm256_permute_ps( r, _MM_SHUFFLE(0,1,2,3) ), sx );
+	__m256 ry = _mm256_xor_ps( _mm256_permute_ps( r, _MM_SHUFFLE(1,0,3,2) ), sy );
+	__m256 rz = _mm256_xor_ps( _mm256_permute_ps( r, _MM_SHUFFLE(2,3,0,1) ), sz );
+
+	__m256 p = _mm256_mul_ps( _mm256_permute_ps( q, _MM_SHUFFLE(3,3,3,3) ), r );
+	p = _mm256_add_ps( p, _mm256_mul_ps( _mm256_permute_ps( q, _MM_SHUFFLE(0,0,0,0) ), rx ) );
+	p = _mm256_add_ps( p, _mm256_mul_ps( _mm256_permute_ps( q, _MM_SHUFFLE(1,1,1,1) ), ry ) );
+	p = _mm256_add_ps( p, _mm256_mul_ps( _mm256_permute_ps( q, _MM_SHUFFLE(2,2,2,2) ), rz ) );
+
+	return p;
+
+}
+
+#endif
+
+void qmul_n( float4* dst, const float4* q, const float4* r, int n ) {
+
+	int i = 0;
+
+#if defined(feature_AVX)
+
+	for( ; i+2 <= n; i+=2 )
+		_mm256_storeu_ps( &dst[i].x, qmul_AVX( _mm256_loadu_ps( &q[i].x ),
+		                                       _mm256_loadu_ps( &r[i].x ) ) );
+
+#endif
+
+	// With SSE alone, this is as fast as the shuffling it takes by hand
+	for( ; i<n; i++ )
+		dst[i] = qmul( q[i], r[i] );
+
+}
+
 // Constants
 const float4 origin_PT = { 0.f, 0.f, 0.f, 1.f };
 const float4 zero_VEC = { 0.f, 0.f, 0.f, 0.f };
@@ -7,33 +7,153 @@
 #include "mm.heap.h"
 #include "mm.region.h"
 #include "sync.atomic.h"
+#include "sync.once.h"
 #include "sync.spinlock.h"
+#include "sync.thread.h"
+#include "time.core.h"
+
+#if defined( feature_POSIX )
+#include <sys/mman.h>
+#endif
 
 static const int pageSize    = 64 * 1024;
 static const int allocAlign  = 64;
 
+// Pages come in size classes of pageSize << cls. Each thread caches up to 
+// `cacheMax' free pages of each class; past that, `batchSize' of them are 
+// handed to a global depot in one go, and a thread with an empty cache takes
+// a whole batch back. The depot holds at most `depotMax' batches per class;
+// anything beyond that goes back to the system, so the amount of idle memory
+// stays bounded no matter which threads allocate and which ones free.
+#define pageClasses 5
+
+static const int cacheMax    = 32;
+static const int batchSize   = 16;
+static const int depotMax    = 16;
+
+// Allocations too big for the largest page class get their own mapping,
+// marked with this class, and go straight back to the system on rcollect.
+#define directClass 0xffff
+
+// With huge pages enabled, pages of the smallest class are carved out of 
+// 2 MiB aligned arenas advised as transparent huge pages. The first page of
+// each arena holds its header; the arena is unmapped once all of the others
+// have been released to the system.
+static const int hugeSize    = 2 * 1024 * 1024;
+
+struct arena {
+
+	volatile uint32 released;
+
+};
+
 struct page{
 
 	uint  pp;
+	uint16 cls;
+	uint16 count;       // Length of the batch headed by this page, in the depot
+	size_t size;        // Bytes mapped, for directClass
+
+	struct page* batch; // Next batch, in the depot
 	slist_mixin( struct page );
 
 };
 
+// Statistics, shared by all regions with the same name. Page counts change
+// rarely and are kept here; the per-allocation counters are kept per thread
+// (see struct thread_counters) and summed up when asked for, and this only
+// holds the totals of threads that have since exited.
+struct name_stats {
+
+	const char* name;
+	int         id;     // Index into thread counters; -1 if out of slots
+
+	volatile uint32 pages;
+	volatile uint32 peak_pages;
+
+	volatile uint64 requested;
+	volatile uint64 wasted;
+	volatile uint32 collects;
+
+	struct name_stats* next;
+
+};
+
+struct counters {
+
+	uint64 requested;
+	uint64 wasted;
+	uint32 collects;
+
+};
+
+#define statsMax 256
+
+struct thread_counters {
+
+	struct counters c[statsMax];
+
+	struct thread_counters* next;
+
+};
+
 struct region_s {
 
 	char*    name;
+	struct name_stats* stats;
 
 	struct page* first;
 	struct page* last;
 
+	struct page* large; // Oversize allocations, one per page
+
+};
+
+struct page_cache {
+
+	struct page* pages[pageClasses];
+	int          count[pageClasses];
+
+};
+
+struct page_depot {
+
+	volatile int lock;
+
+	struct page* batches;
+	int          count;
+
 };
 
-static threadlocal struct page* freelist = NULL;
+static threadlocal struct page_cache cache;
+static struct page_depot             depot[pageClasses];
+
+static volatile uint32               system_pages = 0; // In units of pageSize
+static volatile uint32               system_peak  = 0;
+
+static bool                          hugepages    = false;
+
+#define statsBuckets 64
+
+static volatile int                  stats_lock = 0;
+static struct name_stats*            stats[statsBuckets];
+static struct name_stats*            stats_by_id[statsMax];
+static int                           stats_count = 0;
+
+static struct thread_counters*       all_counters = NULL;
+static threadlocal 
+struct thread_counters*              counters     = NULL;
+
+static thread_t                      reporter;
+static volatile bool                 reporting    = false;
+static usec_t                        report_period;
+
+static pthread_key_t                 cache_key;
 
 // Internal APIs //////////////////////////////////////////////////////////////
 
 #define align( alignment, sz )	  \
-	( (sz) <= (alignment) ) ? (alignment) : (sz) + (alignment) - ((sz)&((alignment)-1))
+	( ( (sz) <= (alignment) ) ? (alignment) : ((sz) + (alignment) - 1) & ~((size_t)(alignment) - 1) )
 
 // Ref: http://graphics.stanford.edu/~seander/bithacks.html
 static inline 
@@ -51,39 +171,506 @@ unsigned nearest_pow2( unsigned x ) {
 
 }
 
-static struct page* alloc_page( void ) {
+// The depot and stats table are only touched when moving whole batches or
+// creating regions, so a plain test-and-set lock is plenty; it also needs no
+// initialization, which matters since regions are used before anything else.
+static inline 
+void acquire( volatile int* lock ) {
+
+	while( !atomic_cas( *lock, 0, 1 ) )
+		;
+
+}
+
+static inline
+void release( volatile int* lock ) {
+
+	atomic_store( *lock, 0 );
+
+}
+
+// Raise `*peak' to at least `x'
+static inline
+void raise_peak( volatile uint32* peak, uint32 x ) {
+
+	uint32 old = *peak;
+	while( x > old && !atomic_cas( *peak, old, x ) )
+		old = *peak;
+
+}
+
+#if defined( feature_POSIX )
+
+static pointer map_memory( size_t len ) {
+
+	pointer m = mmap( NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+	return MAP_FAILED == m ? NULL : m;
+
+}
+
+static void unmap_memory( pointer m, size_t len ) {
+
+	munmap( m, len );
+
+}
+
+static void advise_hugepages( pointer m, size_t len ) {
+
+#if defined( MADV_HUGEPAGE )
+	if( madvise( m, len, MADV_HUGEPAGE ) < 0 )
+		warning( "region: madvise(MADV_HUGEPAGE) failed for %zu bytes", len );
+#endif
+
+}
+
+#else
+
+static pointer map_memory( size_t len ) {
+
+	return malloc( len );
+
+}
+
+static void unmap_memory( pointer m, size_t len ) {
+
+	free( m );
+
+}
+
+static void advise_hugepages( pointer m, size_t len ) {
+}
+
+#endif
+
+// Map a new arena; returns its first free page and puts the rest in the
+// calling thread's cache, which must be empty.
+static struct page* alloc_arena( void ) {
+
+	const int n = hugeSize / pageSize;
+
+	// Over-allocate so that we can trim to an aligned range
+	uint8* m = map_memory( 2 * hugeSize );
+	if( !m )
+		return NULL;
+
+	uint8* base = (uint8*)( ((uintptr_t)m + hugeSize - 1) & ~(uintptr_t)(hugeSize - 1) );
+	if( base > m )
+		unmap_memory( m, base - m );
+	if( base + hugeSize < m + 2 * hugeSize )
+		unmap_memory( base + hugeSize, (m + 2 * hugeSize) - (base + hugeSize) );
+
+	advise_hugepages( base, hugeSize );
+
+	struct arena* arena = (struct arena*)base;
+	arena->released = 0;
+
+	raise_peak( &system_peak, atomic_add( system_pages, n ) );
+
+	for( int i=n-1; i>1; i-- ) {
+
+		struct page* pg = (struct page*)(base + i*pageSize);
+		pg->cls = 0;
+		slist_push_front( cache.pages[0], pg );
+		cache.count[0]++;
+
+	}
+
+	struct page* pg = (struct page*)(base + pageSize);
+	pg->cls = 0;
+	return pg;
+
+}
+
+static void release_arena_page( struct page* pg ) {
+
+	const int n = hugeSize / pageSize;
+
+	struct arena* arena = (struct arena*)( (uintptr_t)pg & ~(uintptr_t)(hugeSize - 1) );
+	if( n - 1 == atomic_add( arena->released, 1 ) ) {
+
+		unmap_memory( arena, hugeSize );
+		atomic_add( system_pages, -n );
+
+	}
+
+}
+
+static void release_pages( struct page* pg ) {
+
+	while( pg ) {
+
+		struct page* next = slist_next(pg);
+
+		if( 0 == pg->cls && hugepages ) {
+
+			release_arena_page( pg );
+
+		} else {
+
+			atomic_add( system_pages, -(1 << pg->cls) );
+			free( pg );
+
+		}
+
+		pg = next;
+
+	}
+
+}
+
+// Hand a chain of `count' pages to the depot, or back to the system if the
+// depot is already full.
+static void put_batch( int cls, struct page* batch, int count ) {
+
+	batch->count = count;
+
+	acquire( &depot[cls].lock );
+	if( depot[cls].count < depotMax ) {
+
+		batch->batch = depot[cls].batches;
+		depot[cls].batches = batch;
+		depot[cls].count++;
+		batch = NULL;
+
+	}
+	release( &depot[cls].lock );
+
+	release_pages( batch );
+
+}
+
+static struct page* get_batch( int cls, int* count ) {
+
+	acquire( &depot[cls].lock );
+
+	struct page* batch = depot[cls].batches;
+	if( batch ) {
+		depot[cls].batches = batch->batch;
+		depot[cls].count--;
+	}
+
+	release( &depot[cls].lock );
+
+	*count = batch ? batch->count : 0;
+	return batch;
+
+}
+
+// Return the calling thread's cached pages to the depot
+static void flush_cache( void ) {
+
+	for( int cls=0; cls<pageClasses; cls++ ) {
+
+		if( cache.pages[cls] )
+			put_batch( cls, cache.pages[cls], cache.count[cls] );
+
+		cache.pages[cls] = NULL;
+		cache.count[cls] = 0;
+
+	}
+
+}
+
+// Fold the calling thread's counters into the per-name totals
+static void retire_counters( void ) {
+
+	if( !counters )
+		return;
+
+	acquire( &stats_lock );
+
+	struct thread_counters** link = &all_counters;
+	while( *link != counters )
+		link = &(*link)->next;
+	*link = counters->next;
+
+	for( int i=0; i<stats_count; i++ ) {
+
+		struct name_stats* st = stats_by_id[i];
+		atomic_add( st->requested, counters->c[i].requested );
+		atomic_add( st->wasted,    counters->c[i].wasted );
+		atomic_add( st->collects,  counters->c[i].collects );
+
+	}
+
+	release( &stats_lock );
+
+	free( counters );
+	counters = NULL;
+
+}
+
+static void thread_exit( void* unused ) {
+
+	flush_cache();
+	retire_counters();
+
+}
+
+static void create_cache_key( void ) {
+
+	pthread_key_create( &cache_key, thread_exit );
+
+}
+
+// Called when the calling thread starts caching pages or counting, so that
+// they are handed back when it exits
+static void register_cache( void ) {
+
+	once( create_cache_key );
+	if( NULL == pthread_getspecific( cache_key ) )
+		pthread_setspecific( cache_key, &cache );
+
+}
+
+static struct page* alloc_page( int cls ) {
 
 	struct page* pg = NULL;
 
 	trace0("alloc_page()");
 
-	if( NULL == freelist ) {		
+	if( NULL == cache.pages[cls] ) {
+
+		cache.pages[cls] = get_batch( cls, &cache.count[cls] );
+		register_cache();
+
+	}
+
+	if( NULL == cache.pages[cls] ) {		
 
 		trace0("alloc_page: no free pages, allocate new one");
 
-		pg = (struct page*)malloc( pageSize  );
-		if( !pg )
-			return NULL;
-		
-		pg->pp = align( allocAlign, sizeof(struct page) );
-		slist_next(pg) = NULL;
-		
+		if( 0 == cls && hugepages ) {
+
+			pg = alloc_arena();
+			if( !pg )
+				return NULL;
+
+		} else {
+
+			pg = (struct page*)malloc( pageSize << cls );
+			if( !pg )
+				return NULL;
+
+			pg->cls = cls;
+			raise_peak( &system_peak, atomic_add( system_pages, 1 << cls ) );
+
+		}
+
 	} else {
 		
-		slist_pop_front( freelist, pg );
-		pg->pp = align( allocAlign, sizeof(struct page) );
+		slist_pop_front( cache.pages[cls], pg );
+		cache.count[cls]--;
 
 	}
 
-	trace("alloc_page: return 0x%x", (uint)pg);
+	pg->pp = align( allocAlign, sizeof(struct page) );
+	slist_next(pg) = NULL;
+
+	trace("alloc_page: return %p", pg);
 	return pg;
 
 }
 
 static void free_page( struct page* pg ) {
 
-	trace("free_page(0x%x)", (uint)pg);
-	slist_push_front( freelist, pg );
+	trace("free_page(%p)", pg);
+
+	int cls = pg->cls;
+	if( NULL == cache.pages[cls] )
+		register_cache();
+
+	slist_push_front( cache.pages[cls], pg );
+	if( ++cache.count[cls] <= cacheMax )
+		return;
+
+	// Split a batch off the front of the cache and hand it to the depot
+	struct page* batch = cache.pages[cls];
+	struct page* last  = batch;
+	for( int i=1; i<batchSize; i++ )
+		last = slist_next(last);
+
+	cache.pages[cls]  = slist_next(last);
+	cache.count[cls] -= batchSize;
+	slist_next(last)  = NULL;
+
+	put_batch( cls, batch, batchSize );
+
+}
+
+// Allocate a page big enough to hold `sz' bytes past its header
+static struct page* alloc_large( size_t sz ) {
+
+	size_t total = align( allocAlign, sizeof(struct page) ) + sz;
+
+	int cls = 0;
+	while( cls < pageClasses && ((size_t)pageSize << cls) < total )
+		cls++;
+
+	if( cls < pageClasses )
+		return alloc_page( cls );
+
+	// Too big for any class; map it directly
+	size_t len = (total + pageSize - 1) & ~(size_t)(pageSize - 1);
+
+	struct page* pg = map_memory( len );
+	if( !pg )
+		return NULL;
+
+	if( hugepages && len >= hugeSize )
+		advise_hugepages( pg, len );
+
+	pg->cls  = directClass;
+	pg->size = len;
+	pg->pp   = align( allocAlign, sizeof(struct page) );
+	slist_next(pg) = NULL;
+
+	raise_peak( &system_peak, atomic_add( system_pages, len / pageSize ) );
+
+	return pg;
+
+}
+
+static void free_large( struct page* pg ) {
+
+	if( directClass != pg->cls ) {
+
+		free_page( pg );
+		return;
+
+	}
+
+	atomic_add( system_pages, -(int)(pg->size / pageSize) );
+	unmap_memory( pg, pg->size );
+
+}
+
+// Size of a page in units of pageSize, for the stats
+static int page_units( const struct page* pg ) {
+
+	return directClass == pg->cls ? (int)(pg->size / pageSize) : 1 << pg->cls;
+
+}
+
+static struct name_stats* lookup_stats( const char* name ) {
+
+	uint32 h = 5381;
+	for( const char* c=name; *c; c++ )
+		h = 33*h + (uint8)*c;
+
+	struct name_stats** bucket = &stats[ h % statsBuckets ];
+
+	acquire( &stats_lock );
+
+	struct name_stats* st = *bucket;
+	while( st && 0 != strcmp( st->name, name ) )
+		st = st->next;
+
+	if( !st ) {
+
+		st = malloc( sizeof(struct name_stats) + strlen(name) + 1 );
+		st->name = strcpy( (char*)st + sizeof(struct name_stats), name );
+		st->pages = st->peak_pages = 0;
+		st->requested = st->wasted = 0;
+		st->collects = 0;
+		st->next = *bucket;
+		*bucket = st;
+
+		st->id = -1;
+		if( stats_count < statsMax ) {
+			st->id = stats_count++;
+			stats_by_id[ st->id ] = st;
+		}
+
+	}
+
+	release( &stats_lock );
+
+	return st;
+
+}
+
+static void add_pages( region_p R, int n ) {
+
+	raise_peak( &R->stats->peak_pages, atomic_add( R->stats->pages, n ) );
+
+}
+
+static struct counters* thread_counters( region_p R ) {
+
+	if( R->stats->id < 0 )
+		return NULL;
+
+	if( !counters ) {
+
+		counters = calloc( 1, sizeof(struct thread_counters) );
+
+		acquire( &stats_lock );
+		counters->next = all_counters;
+		all_counters = counters;
+		release( &stats_lock );
+
+		register_cache();
+
+	}
+
+	return &counters->c[ R->stats->id ];
+
+}
+
+static void count_alloc( region_p R, size_t sz, size_t aligned_sz ) {
+
+	struct counters* c = thread_counters( R );
+	if( c ) {
+
+		c->requested += sz;
+		c->wasted    += aligned_sz - sz;
+
+	} else {
+
+		atomic_add( R->stats->requested, sz );
+		atomic_add( R->stats->wasted, aligned_sz - sz );
+
+	}
+
+}
+
+static void count_collect( region_p R ) {
+
+	struct counters* c = thread_counters( R );
+	if( c )
+		c->collects++;
+	else
+		atomic_add( R->stats->collects, 1 );
+
+}
+
+static int compare_peak( const void* a, const void* b ) {
+
+	const region_stats_t* x = a;
+	const region_stats_t* y = b;
+
+	return (int)y->peak_pages - (int)x->peak_pages;
+
+}
+
+static int report_loop( void* unused ) {
+
+	static const usec_t slice = 100000;
+
+	usec_t last = microseconds();
+	while( reporting ) {
+
+		sleep_THREAD( slice );
+
+		if( microseconds() - last >= report_period ) {
+			region_MM_report();
+			last = microseconds();
+		}
+
+	}
+
+	return 0;
 
 }
 
@@ -99,25 +686,43 @@ region_p region( const char* name ) {
 	R->name = (pointer)R + sizeof(region_t);
 
 	strcpy( R->name, name );
+	R->stats = lookup_stats( name );
 	R->first = R->last = NULL;
+	R->large = NULL;
 
 	return R;
 
 }
 
-pointer  ralloc( region_p R, uint16 sz ) {
+pointer  ralloc( region_p R, size_t sz ) {
 	
-	uint16 aligned_sz = align( allocAlign, sz );
-	assert( aligned_sz <= pageSize );
+	size_t aligned_sz = align( allocAlign, sz );
+	count_alloc( R, sz, aligned_sz );
+
+	// Oversize; give it a page of its own
+	if( aligned_sz > pageSize - align( allocAlign, sizeof(struct page) ) ) {
+
+		struct page* pg = alloc_large( sz );
+		if( !pg )
+			return NULL;
+
+		slist_push_front( R->large, pg );
+		add_pages( R, page_units(pg) );
+
+		return (pointer)pg + pg->pp;
+
+	}
 
 	// Allocate a new page if needed
 	if( !R->last ) {
 
-		R->first = R->last = alloc_page( );
+		R->first = R->last = alloc_page( 0 );
+		add_pages( R, 1 );
 
 	} else if( R->last->pp + aligned_sz > pageSize ) {
 
-		struct page* next = alloc_page( );
+		struct page* next = alloc_page( 0 );
+		add_pages( R, 1 );
 		R->last->next = next;
 		R->last = next;
 
@@ -133,7 +738,8 @@ pointer  ralloc( region_p R, uint16 sz ) {
 
 pointer  rallocpg( region_p R ) {
 
-	return alloc_page( );
+	add_pages( R, 1 );
+	return alloc_page( 0 );
 
 }
 
@@ -141,7 +747,8 @@ void     rfreepg( region_p R, const pointer pg ) {
 
 	struct page* page = (struct page*)pg;
 
-	page->next = NULL;
+	page->cls = 0; // rallocpg pages are whole, the header may be overwritten
+	add_pages( R, -1 );
 	free_page( page );
 
 }
@@ -149,16 +756,31 @@ void     rfreepg( region_p R, const pointer pg ) {
 void     rcollect( region_p R ) {
 
 	trace("rcollect(%s)", R->name);
+	count_collect( R );
 
 	// Free region pages
+	int n = 0;
 	struct page* pg = R->first;
 	while( pg ) {
 		struct page* next = slist_next(pg);
 		free_page( pg );
 		pg = next;
+		n++;
+	}
+
+	// And oversize allocations
+	pg = R->large;
+	while( pg ) {
+		struct page* next = slist_next(pg);
+		n += page_units(pg);
+		free_large( pg );
+		pg = next;
 	}
 
+	add_pages( R, -n );
+
 	R->first = R->last = NULL;
+	R->large = NULL;
 
 }
 
@@ -169,14 +791,202 @@ void     rfree( region_p R ) {
 
 }
 
+int      region_MM_init( void ) {
+
+	register_cache();
+	return 0;
+
+}
+
+int      region_MM_hugepages( bool enable ) {
+
+	if( enable == hugepages )
+		return 0;
+
+	// Pages already handed out were allocated the other way
+	if( system_pages > 0 )
+		return -1;
+
+#if !defined( feature_POSIX ) || !defined( MADV_HUGEPAGE )
+	if( enable )
+		return -1;
+#endif
+
+	hugepages = enable;
+	return 0;
+
+}
+
+void     region_MM_shutdown( void ) {
+
+	flush_cache();
+
+	for( int cls=0; cls<pageClasses; cls++ ) {
+
+		int count;
+		struct page* batch;
+		while( NULL != (batch = get_batch( cls, &count )) )
+			release_pages( batch );
+
+	}
+
+}
+
+int      region_MM_stats( int max, region_stats_t* dst ) {
+
+	acquire( &stats_lock );
+
+	int n = 0;
+	for( int i=0; i<statsBuckets; i++ ) {
+
+		for( struct name_stats* st = stats[i]; st; st = st->next ) {
+
+			if( n == max )
+				break;
+
+			region_stats_t* s = &dst[n++];
+			s->name       = st->name;
+			s->pages      = st->pages;
+			s->peak_pages = st->peak_pages;
+			s->requested  = st->requested;
+			s->wasted     = st->wasted;
+			s->collects   = st->collects;
+
+			// Counters of live threads are read without synchronization;
+			// they may be slightly stale, but never torn on a 64-bit target
+			if( st->id < 0 )
+				continue;
+
+			for( struct thread_counters* tc = all_counters; tc; tc = tc->next ) {
+
+				s->requested += tc->c[ st->id ].requested;
+				s->wasted    += tc->c[ st->id ].wasted;
+				s->collects  += tc->c[ st->id ].collects;
+
+			}
+
+		}
+
+	}
+
+	release( &stats_lock );
+
+	return n;
+
+}
+
+void     region_MM_report( void ) {
+
+	info( "region: %u KiB from system, peak %u KiB",
+	      system_pages * (pageSize / 1024),
+	      system_peak * (pageSize / 1024) );
+
+	region_stats_t stats[ statsMax ];
+	int n = region_MM_stats( statsMax, stats );
+
+	qsort( stats, n, sizeof(region_stats_t), compare_peak );
+
+	info( "region: %-32s %6s %6s %12s %6s %8s", 
+	      "name", "pages", "peak", "KiB allocd", "waste", "collects" );
+
+	for( int i=0; i<n; i++ ) {
+
+		region_stats_t* st = &stats[i];
+		double waste = st->requested > 0 
+			? 100. * (double)st->wasted / (double)(st->requested + st->wasted) 
+			: 0.;
+
+		info( "region: %-32s %6u %6u %12llu %5.1f%% %8u",
+		      st->name, st->pages, st->peak_pages, 
+		      (unsigned long long)(st->requested / 1024),
+		      waste, st->collects );
+
+	}
+
+}
+
+int      region_MM_report_every( usec_t period ) {
+
+	if( reporting ) {
+
+		reporting = false;
+		join_THREAD( &reporter, NULL );
+
+	}
+
+	if( 0 == period )
+		return 0;
+
+	report_period = period;
+	reporting = true;
+	if( 0 != create_THREAD( &reporter, report_loop, NULL ) ) {
+
+		reporting = false;
+		return -1;
+
+	}
+
+	return 0;
+
+}
+
 #ifdef __mm_region_TEST__
 
 #include <stdio.h>
 
+// Cross-thread test: one thread fills regions, another frees them
+#define handoffRounds 2000
+#define handoffPages  8
+
+static region_p volatile handoff = NULL;
+
+static int fill_regions( void* arg ) {
+
+	for( int i=0; i<handoffRounds; i++ ) {
+
+		region_p R = region( "mm.region.test::handoff" );
+		for( int j=0; j<handoffPages; j++ )
+			ralloc( R, pageSize / 2 );  // One page each
+
+		while( !atomic_cas( handoff, NULL, R ) )
+			yield_THREAD();
+
+	}
+
+	return 0;
+
+}
+
+static int free_regions( void* arg ) {
+
+	for( int i=0; i<handoffRounds; i++ ) {
+
+		region_p R;
+		while( NULL == (R = atomic_load( handoff )) )
+			yield_THREAD();
+
+		atomic_store( handoff, NULL );
+		rfree( R );
+
+	}
+
+	return 0;
+
+}
+
 int main( int argc, char* argv[] ) {
 
 	const int REPS = 1024;
 	const char* TEST = "TEST";
+	set_LOG_level( logInfo );
+
+	// -h: back pages with huge pages
+	bool huge = argc > 1 && 0 == strcmp( argv[1], "-h" );
+	if( huge && region_MM_hugepages( true ) < 0 ) {
+		warning0( "huge pages not supported; skipping" );
+		huge = false;
+	}
+
 	region_p R = region( TEST );
 	
 	int length = strlen(TEST);
@@ -185,8 +995,8 @@ int main( int argc, char* argv[] ) {
 		(void)p;
 	}
 
-	info0( "Freeing region" );
-	rfree( R );
+	info0( "Collecting region" );
+	rcollect( R );
 	
 	info0( "Running test again; pages should be allocated in reverse order from above." );
 	for( int i=0; i<REPS; i++ ) {
@@ -194,13 +1004,70 @@ int main( int argc, char* argv[] ) {
 		(void)p;
 	}
 
-	// Now try allocating more than a page
-	uint size = pageSize + 1;
-	pointer chunk = ralloc( R, size );
-	info( "Allocated chunk: %p, size=%d", chunk, size );
+	// Now try allocating more than a page; one that fits a larger page class
+	// and one that has to be mapped directly
+	size_t sizes[] = { pageSize + 1, 3 * hugeSize + 1 };
+	for( int i=0; i<2; i++ ) {
+
+		uint8* chunk = ralloc( R, sizes[i] );
+		assert( NULL != chunk );
+		memset( chunk, 0xa5, sizes[i] );
+		info( "Allocated chunk: %p, size=%zu", chunk, sizes[i] );
+
+	}
+
+	// Small allocations carry on in the current page
+	pointer p = ralloc( R, length+1 );
+	assert( (uint8*)p > (uint8*)R->last && (uint8*)p < (uint8*)R->last + pageSize );
+
+	uint32 held = R->stats->pages;
+	rcollect( R );
+	info( "Collected %u pages", held - R->stats->pages );
+	assert( 0 == R->stats->pages );
 
 	rfree( R );
 
+	// Pages freed on one thread must find their way back to the other
+	thread_t filler, freer;
+	create_THREAD( &filler, fill_regions, NULL );
+	create_THREAD( &freer, free_regions, NULL );
+	join_THREAD( &filler, NULL );
+	join_THREAD( &freer, NULL );
+
+	// Per-thread caches plus depot plus two regions in flight
+	uint32 bound = 2 * (cacheMax + handoffPages) + depotMax * batchSize + 2 * handoffPages;
+
+	// Huge pages are released a whole arena at a time, and the chunks above
+	if( huge )
+		bound = 2 * bound + (3 * hugeSize + 1) / pageSize + 1;
+
+	region_MM_report();
+	info( "%d regions of %d pages handed between threads; peak %u pages, bound %u",
+	      handoffRounds, handoffPages, system_peak, bound );
+	assert( system_peak <= bound );
+
+	// Both threads have exited; their counters must have been kept
+	region_stats_t st[ statsMax ];
+	int n = region_MM_stats( statsMax, st );
+	int i = 0;
+	while( i < n && 0 != strcmp( st[i].name, "mm.region.test::handoff" ) )
+		i++;
+	assert( i < n );
+	assert( handoffRounds == st[i].collects );
+	assert( (uint64)handoffRounds * handoffPages * (pageSize / 2) == st[i].requested );
+	assert( 0 == st[i].pages && st[i].peak_pages <= 2 * handoffPages ); // Two in flight
+
+	// Periodic reports
+	region_MM_report_every( 200000 );
+	sleep_THREAD( 300000 );
+	region_MM_report_every( 0 );
+
+	region_MM_shutdown();
+	info( "after shutdown: %u pages held", system_pages );
+
+	printf("\nOk\n");
+	return 0;
+
 }
 
 #endif
@@ -340,6 +340,14 @@ parse_p qstring( parse_p P, char** s ) {
 	}
 	advance(P);
 
+	// string() wants at least one character
+	if( !eof(P) && isquot(*P->pos) ) {
+		advance(P);
+		if( s )
+			*s = strdup( "" );
+		return P;
+	}
+
 	P = string( P, isquot, s );
 	if( parsok(P) )
 		advance(P);
@@ -565,6 +573,38 @@ parse_error_p parserri( parse_p P, int ierr ) {
 
 #ifdef __parse_core_TEST__
 
+#include <assert.h>
+
+static void test_qstring( void ) {
+
+	char* s = NULL;
+
+	// Empty, then not, back to back
+	parse_p P = new_string_PARSE( "\"\"\"abc\" x" );
+	assert( parsok( qstring( P, &s ) ) && 0 == strcmp( s, "" ) && 2 == P->col );
+	free( s );
+	assert( parsok( qstring( P, &s ) ) && 0 == strcmp( s, "abc" ) && 7 == P->col );
+	free( s );
+	s = NULL;
+	assert( !parsok( qstring( P, &s ) ) && NULL == s );
+	destroy_PARSE( P );
+
+	// An empty string needs no result
+	P = new_string_PARSE( "\"\"" );
+	assert( parsok( qstring( P, NULL ) ) && parseof( P ) );
+	destroy_PARSE( P );
+
+	// Unterminated
+	P = new_string_PARSE( "\"abc" );
+	assert( !parsok( qstring( P, &s ) ) && NULL == s );
+	destroy_PARSE( P );
+
+	P = new_string_PARSE( "\"" );
+	assert( !parsok( qstring( P, &s ) ) );
+	destroy_PARSE( P );
+
+}
+
 int main( int argc, char* argv[] ) {
 
 	const char* s = " [section] \n  \"var\"=12 \n2.5 + \"foo\"";
@@ -592,6 +632,10 @@ int main( int argc, char* argv[] ) {
 
 	destroy_PARSE(P);
 
+	test_qstring();
+	printf("Ok\n");
+	return 0;
+
 }
 
 #endif
@@ -370,7 +370,7 @@ int main( int argc, char* argv[] ) {
 	
 	float       step = strtof( argv[2], NULL );
 	region_p       R = region( "time.clock.test" );
-	Channel*    sink = new_Channel( sizeof(float), 1 );
+	Channel*    sink = new_Channel_mode( channelSPSC, sizeof(float), 1 );
 	Clock*       clk = new_Clock( R, step, sink );
 
 	// Start the sink
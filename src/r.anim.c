@@ -0,0 +1,630 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.log.h"
+#include "job.control.h"
+#include "r.anim.h"
+#include "res.io.h"
+
+#define r_animVersion 1
+
+declare_job( int, anim_chunk,
+
+             Anim_Batch*    batch;
+             Anim_Instance* instances;
+             uint32         n );
+
+struct Anim_Batch {
+
+	Anim_Instance* instances;
+	uint32         n;
+
+	uint32         n_chunks;
+	typeof_Job_params(anim_chunk)* params;
+
+	Job_Latch      pending;
+
+};
+
+// Quantization ///////////////////////////////////////////////////////////////
+
+static inline int16 quantize_snorm( float x ) {
+
+	x = x < -1.f ? -1.f : x > 1.f ? 1.f : x;
+	return (int16)lrintf( x * 32767.f );
+
+}
+
+static inline uint16 quantize_unorm( float x ) {
+
+	x = x < 0.f ? 0.f : x > 1.f ? 1.f : x;
+	return (uint16)lrintf( x * 65535.f );
+
+}
+
+static inline float4 decode_q( const Anim_Key* key ) {
+
+	const float s = 1.f / 32767.f;
+	return (float4){ s * key->q[0], s * key->q[1], s * key->q[2], s * key->q[3] };
+
+}
+
+static inline float4 decode_p( const Anim_Joint* joint, const Anim_Key* key ) {
+
+	return (float4){ joint->p_min.x + joint->p_scale.x * key->p[0],
+	                 joint->p_min.y + joint->p_scale.y * key->p[1],
+	                 joint->p_min.z + joint->p_scale.z * key->p[2],
+	                 0.f };
+
+}
+
+static inline float unit( float x, float min, float scale ) {
+
+	return scale > 0.f ? (x - min) / (65535.f * scale) : 0.f;
+
+}
+
+// Instantiation //////////////////////////////////////////////////////////////
+
+static Anim* alloc_Anim( uint32 n_joints, uint32 n_frames ) {
+
+	Anim* anim = malloc( sizeof(Anim) );
+
+	anim->n_joints = n_joints;
+	anim->n_frames = n_frames;
+
+	anim->joints = calloc( n_joints, sizeof(Anim_Joint) );
+	anim->keys   = calloc( (size_t)n_joints * n_frames, sizeof(Anim_Key) );
+	anim->bounds = calloc( 2 * n_frames, sizeof(float4) );
+
+	return anim;
+
+}
+
+Anim*             new_Anim( uint32 n_joints, uint32 n_frames, float frame_rate,
+                            const char** names, const int32* parents,
+                            const float4* p, const float4* q,
+                            const float4* bounds ) {
+
+	assert( n_frames > 0 );
+
+	Anim* anim = alloc_Anim( n_joints, n_frames );
+	anim->frame_rate = frame_rate;
+
+	if( bounds )
+		memcpy( anim->bounds, bounds, 2 * n_frames * sizeof(float4) );
+
+	for( uint32 j=0; j<n_joints; j++ ) {
+
+		Anim_Joint* joint = &anim->joints[j];
+
+		assert( parents[j] < (int32)j );
+		joint->name   = strdup( names[j] );
+		joint->parent = parents[j];
+
+		// The range each component of the position moves over
+		float4 min = p[j], max = p[j];
+		for( uint32 f=1; f<n_frames; f++ ) {
+
+			float4 pf = p[ f*n_joints + j ];
+
+			min = (float4){ fminf( min.x, pf.x ), fminf( min.y, pf.y ), fminf( min.z, pf.z ), 0.f };
+			max = (float4){ fmaxf( max.x, pf.x ), fmaxf( max.y, pf.y ), fmaxf( max.z, pf.z ), 0.f };
+
+		}
+
+		joint->p_min   = (float4){ min.x, min.y, min.z, 0.f };
+		joint->p_scale = (float4){ (max.x - min.x) / 65535.f,
+		                           (max.y - min.y) / 65535.f,
+		                           (max.z - min.z) / 65535.f,
+		                           0.f };
+
+		float4 prev = { 0.f, 0.f, 0.f, 1.f };
+		for( uint32 f=0; f<n_frames; f++ ) {
+
+			Anim_Key* key = &anim->keys[ f*n_joints + j ];
+			float4    pf  = p[ f*n_joints + j ];
+			float4    qf  = qversor( q[ f*n_joints + j ] );
+
+			// Keep to the hemisphere of the last frame, so that neighbouring
+			// keys interpolate the short way round
+			if( f > 0 && vdot( qf, prev ) < 0.f )
+				qf = vneg( qf );
+			prev = qf;
+
+			key->q[0] = quantize_snorm( qf.x );
+			key->q[1] = quantize_snorm( qf.y );
+			key->q[2] = quantize_snorm( qf.z );
+			key->q[3] = quantize_snorm( qf.w );
+
+			key->p[0] = quantize_unorm( unit( pf.x, min.x, joint->p_scale.x ) );
+			key->p[1] = quantize_unorm( unit( pf.y, min.y, joint->p_scale.y ) );
+			key->p[2] = quantize_unorm( unit( pf.z, min.z, joint->p_scale.z ) );
+			key->p[3] = 0;
+
+		}
+
+	}
+
+	return anim;
+
+}
+
+void           delete_Anim( Anim* anim ) {
+
+	for( uint32 j=0; j<anim->n_joints; j++ )
+		free( (char*)anim->joints[j].name );
+
+	free( anim->joints );
+	free( anim->keys );
+	free( anim->bounds );
+	free( anim );
+
+}
+
+// Resource I/O ///////////////////////////////////////////////////////////////
+
+void            write_Anim( pointer res, FILE *outp ) {
+
+	Anim *anim = (Anim*)res;
+
+	write_Res_uint32( outp, r_animVersion );
+	write_Res_uint32( outp, anim->n_joints );
+	write_Res_uint32( outp, anim->n_frames );
+	write_Res_float( outp, anim->frame_rate );
+
+	for( uint32 j=0; j<anim->n_joints; j++ ) {
+
+		Anim_Joint *joint = &anim->joints[j];
+
+		write_Res_string( outp, joint->name );
+		write_Res_int32( outp, joint->parent );
+		write_Res_float4( outp, joint->p_min );
+		write_Res_float4( outp, joint->p_scale );
+
+	}
+
+	write_Res_buf( outp, 2 * anim->n_frames * sizeof(float4), anim->bounds );
+	write_Res_buf( outp, (size_t)anim->n_joints * anim->n_frames * sizeof(Anim_Key), anim->keys );
+
+}
+
+pointer         *read_Anim( FILE *inp ) {
+
+	uint32_t version; read_Res_uint32( inp, &version );
+	if( version != r_animVersion ) {
+		error("Version mis-match: expected %u, found %u", r_animVersion, version );
+		return NULL;
+	}
+
+	uint32_t n_joints, n_frames;
+	read_Res_uint32( inp, &n_joints );
+	read_Res_uint32( inp, &n_frames );
+
+	if( 0 == n_frames ) {
+		error0("Animation has no frames");
+		return NULL;
+	}
+
+	Anim *anim = alloc_Anim( n_joints, n_frames );
+	read_Res_float( inp, &anim->frame_rate );
+
+	for( uint32 j=0; j<n_joints; j++ ) {
+
+		Anim_Joint *joint = &anim->joints[j];
+
+		read_Res_string( inp, (char**)&joint->name );
+		read_Res_int32( inp, &joint->parent );
+		read_Res_float4( inp, &joint->p_min );
+		read_Res_float4( inp, &joint->p_scale );
+
+		// Sampling poses a joint after its parent
+		if( joint->parent < -1 || joint->parent >= (int32)j ) {
+			error("Joint %u has parent %d, not one before it", j, joint->parent );
+			delete_Anim( anim );
+			return NULL;
+		}
+
+	}
+
+	size_t sz_bounds = 2 * n_frames * sizeof(float4);
+	size_t sz_keys   = (size_t)n_joints * n_frames * sizeof(Anim_Key);
+
+	if( sz_bounds != read_Res_buf( inp, sz_bounds, anim->bounds )
+	    || sz_keys != read_Res_buf( inp, sz_keys, anim->keys ) ) {
+
+		error("Truncated animation: expected %zu bytes of frames", sz_bounds + sz_keys );
+		delete_Anim( anim );
+		return NULL;
+
+	}
+
+	return (pointer)anim;
+
+}
+
+// Sampling ///////////////////////////////////////////////////////////////////
+
+float        duration_Anim( const Anim* anim ) {
+
+	return anim->n_frames / anim->frame_rate;
+
+}
+
+void           decode_Anim( const Anim* anim, uint32 frame, uint32 joint,
+                            float4* p, float4* q ) {
+
+	assert( frame < anim->n_frames && joint < anim->n_joints );
+
+	const Anim_Key* key = &anim->keys[ frame * anim->n_joints + joint ];
+
+	*p = decode_p( &anim->joints[joint], key );
+	*q = decode_q( key );
+
+}
+
+void           sample_Anim( const Anim* anim, float t, Skel_Joint* pose ) {
+
+	float  f     = fmodf( t * anim->frame_rate, (float)anim->n_frames );
+	if( f < 0.f )
+		f += anim->n_frames;
+
+	uint32 f0    = (uint32)f;
+	if( f0 >= anim->n_frames )
+		f0 = anim->n_frames - 1;
+
+	uint32 f1    = f0 + 1 < anim->n_frames ? f0 + 1 : 0;
+	float  alpha = f - (float)f0;
+
+	const Anim_Key* k0 = &anim->keys[ f0 * anim->n_joints ];
+	const Anim_Key* k1 = &anim->keys[ f1 * anim->n_joints ];
+
+	for( uint32 j=0; j<anim->n_joints; j++ ) {
+
+		const Anim_Joint* joint = &anim->joints[j];
+
+		float4 p0 = decode_p( joint, &k0[j] ), p1 = decode_p( joint, &k1[j] );
+
+		float4 p  = vadd( p0, vscale( alpha, vsub( p1, p0 ) ) );
+		float4 q  = qslerp( decode_q( &k0[j] ), decode_q( &k1[j] ), alpha );
+
+		// Into the space of the skeleton
+		if( joint->parent >= 0 ) {
+
+			const Skel_Joint* parent = &pose[ joint->parent ];
+
+			p = vadd( parent->p, qrot( parent->qr, p ) );
+			q = qversor( qmul( parent->qr, q ) );
+
+		}
+
+		pose[j].p  = (float4){ p.x, p.y, p.z, 1.f };
+		pose[j].qr = q;
+
+	}
+
+}
+
+void sample_Anim_instances( Anim_Instance* instances, uint32 n ) {
+
+	for( uint32 i=0; i<n; i++ )
+		sample_Anim( instances[i].anim, instances[i].t, instances[i].pose );
+
+}
+
+// Batches ////////////////////////////////////////////////////////////////////
+
+define_job( int, anim_chunk,
+
+            uint32 unused ) {
+
+	begin_job;
+
+	sample_Anim_instances( arg(instances), arg(n) );
+
+	// The last chunk wakes up join_Anim_Batch
+	arrive_Job_Latch( &arg(batch)->pending );
+
+	end_job;
+
+}
+
+Anim_Batch*  new_Anim_Batch( region_p R, Anim_Instance* instances, uint32 n ) {
+
+	Anim_Batch* batch = ralloc( R, sizeof(Anim_Batch) );
+
+	batch->instances = instances;
+	batch->n         = n;
+	batch->n_chunks  = (n + animBatchSize - 1) / animBatchSize;
+	batch->params    = ralloc( R, (batch->n_chunks > 0 ? batch->n_chunks : 1)
+	                              * sizeof(typeof_Job_params(anim_chunk)) );
+
+	init_Job_Latch( &batch->pending );
+
+	return batch;
+
+}
+
+void      delete_Anim_Batch( Anim_Batch* batch ) {
+
+	destroy_Job_Latch( &batch->pending );
+
+}
+
+int       submit_Anim_Batch( Anim_Batch* batch, uint32 deadline ) {
+
+	assert( 0 == batch->pending.pending );
+	add_Job_Latch( &batch->pending, (int)batch->n_chunks );
+
+	for( uint32 i=0; i<batch->n_chunks; i++ ) {
+
+		uint32 first = i * animBatchSize;
+		uint32 n     = batch->n - first < animBatchSize ? batch->n - first : animBatchSize;
+
+		batch->params[i] = (typeof_Job_params(anim_chunk)){
+			batch, batch->instances + first, n
+		};
+
+		submit_Job( deadline, cpuBound, NULL, (jobfunc_f)anim_chunk, &batch->params[i] );
+
+	}
+
+	return (int)batch->n_chunks;
+
+}
+
+void        join_Anim_Batch( Anim_Batch* batch ) {
+
+	wait_Job_Latch( &batch->pending );
+
+}
+
+#ifdef __r_anim_TEST__
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "time.core.h"
+
+static float frand( float lo, float hi ) {
+
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+
+}
+
+// Compose local poses into skeleton space, in floats
+static void reference( uint32 n_joints, const int32* parents,
+                       const float4* p, const float4* q, Skel_Joint* pose ) {
+
+	for( uint32 j=0; j<n_joints; j++ ) {
+
+		float4 pj = p[j], qj = qversor( q[j] );
+		pj.w = 0.f;
+
+		if( parents[j] >= 0 ) {
+			const Skel_Joint* parent = &pose[ parents[j] ];
+			pj = vadd( parent->p, qrot( parent->qr, pj ) );
+			qj = qversor( qmul( parent->qr, qj ) );
+		}
+
+		pose[j].p  = (float4){ pj.x, pj.y, pj.z, 1.f };
+		pose[j].qr = qj;
+
+	}
+
+}
+
+static float posediff( const Skel_Joint* a, const Skel_Joint* b, uint32 n ) {
+
+	float d = 0.f;
+	for( uint32 j=0; j<n; j++ ) {
+
+		float4 dp = vsub( a[j].p, b[j].p );
+		// q and -q are the same rotation
+		float  dq = 1.f - fabsf( vdot( a[j].qr, b[j].qr ) );
+
+		d = fmaxf( d, fmaxf( sqrtf( vlength2( dp ) ), dq ) );
+
+	}
+	return d;
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	const uint32 n_joints    = 64;
+	const uint32 n_frames    = 120;
+	const uint32 n_instances = argc > 1 ? (uint32)strtol( argv[1], NULL, 10 ) : 1000;
+
+	// slerp
+	float4 qa = qaxis( (float4){ 0.f, 0.f, 1.f, 0.f } );
+	float4 qb = qaxis( (float4){ 0.f, 0.f, 1.f, 2.f } );
+	float4 qm = qaxis( (float4){ 0.f, 0.f, 1.f, 1.f } );
+	assert( 1.f - vdot( qslerp( qa, qb, 0.5f ), qm ) < 1e-6f );
+	assert( 1.f - vdot( qslerp( qa, vneg(qb), 0.5f ), qm ) < 1e-6f );
+	assert( 1.f - vdot( qslerp( qa, qb, 1.f ), qb ) < 1e-6f );
+
+	// A tree of joints swinging about random axes
+	const char** names   = malloc( n_joints * sizeof(char*) );
+	int32*       parents = malloc( n_joints * sizeof(int32) );
+	float4*      p       = malloc( n_joints * n_frames * sizeof(float4) );
+	float4*      q       = malloc( n_joints * n_frames * sizeof(float4) );
+
+	for( uint32 j=0; j<n_joints; j++ ) {
+
+		char* name = malloc( 16 );
+		sprintf( name, "joint%u", j );
+		names[j]   = name;
+		parents[j] = 0 == j ? -1 : (int32)j - 1 - rand() % (j < 4 ? j : 4);
+
+		float4 axis  = vnormal( (float4){ frand(-1.f,1.f), frand(-1.f,1.f), frand(-1.f,1.f), 0.f } );
+		float4 base  = { frand(-2.f,2.f), frand(-2.f,2.f), frand(-2.f,2.f), 1.f };
+		float  speed = frand( 0.5f, 3.f );
+
+		for( uint32 f=0; f<n_frames; f++ ) {
+
+			float a = speed * sinf( 2.f * (float)M_PI * f / n_frames );
+			axis.w  = a;
+
+			q[ f*n_joints + j ] = qaxis( axis );
+			p[ f*n_joints + j ] = vadd( base, (float4){ 0.1f * a, 0.f, -0.2f * a, 0.f } );
+
+		}
+
+	}
+
+	Anim* anim = new_Anim( n_joints, n_frames, 24.f, names, parents, p, q, NULL );
+
+	// Keys decode to what went in, and neighbouring quaternions agree in sign
+	for( uint32 f=0; f<n_frames; f++ )
+		for( uint32 j=0; j<n_joints; j++ ) {
+
+			float4 dp, dq;
+			decode_Anim( anim, f, j, &dp, &dq );
+
+			const Anim_Joint* joint = &anim->joints[j];
+			float tol = fmaxf( joint->p_scale.x, fmaxf( joint->p_scale.y, joint->p_scale.z ) ) + 1e-6f;
+
+			float4 d = vsub( dp, p[ f*n_joints + j ] );
+			assert( fabsf(d.x) <= tol && fabsf(d.y) <= tol && fabsf(d.z) <= tol );
+			assert( 1.f - fabsf( vdot( qversor(dq), q[ f*n_joints + j ] ) ) < 1e-6f );
+
+			if( f > 0 ) {
+				float4 pp, pq;
+				decode_Anim( anim, f-1, j, &pp, &pq );
+				assert( vdot( pq, dq ) >= 0.f );
+			}
+
+		}
+
+	// Round trip through the resource format
+	FILE* fp = tmpfile();
+	write_Anim( anim, fp );
+	long sz = ftell( fp );
+	rewind( fp );
+	Anim* copy = (Anim*)read_Anim( fp );
+	fclose( fp );
+
+	assert( copy && copy->n_joints == n_joints && copy->n_frames == n_frames );
+	assert( copy->frame_rate == anim->frame_rate );
+	assert( 0 == memcmp( copy->keys, anim->keys, n_joints * n_frames * sizeof(Anim_Key) ) );
+	for( uint32 j=0; j<n_joints; j++ ) {
+		assert( 0 == strcmp( copy->joints[j].name, anim->joints[j].name ) );
+		assert( copy->joints[j].parent == anim->joints[j].parent );
+	}
+	delete_Anim( copy );
+
+	// A parent after its child, or no frames at all, don't read
+	int32 parent = anim->joints[1].parent;
+	anim->joints[1].parent = 1;
+	fp = tmpfile();
+	write_Anim( anim, fp );
+	rewind( fp );
+	assert( !read_Anim( fp ) );
+	fclose( fp );
+	anim->joints[1].parent = parent;
+
+	anim->n_frames = 0;
+	fp = tmpfile();
+	write_Anim( anim, fp );
+	rewind( fp );
+	assert( !read_Anim( fp ) );
+	fclose( fp );
+	anim->n_frames = n_frames;
+
+	// On a frame the pose is the frame's; between frames, the slerp of the
+	// two. The tolerance covers quantization, compounded down the tree.
+	Skel_Joint* pose = calloc( n_joints, sizeof(Skel_Joint) );
+	Skel_Joint* ref  = calloc( n_joints, sizeof(Skel_Joint) );
+	float4*     lp   = malloc( n_joints * sizeof(float4) );
+	float4*     lq   = malloc( n_joints * sizeof(float4) );
+
+	for( uint32 f=0; f<n_frames; f+=7 ) {
+
+		sample_Anim( anim, f / anim->frame_rate, pose );
+		reference( n_joints, parents, &p[ f*n_joints ], &q[ f*n_joints ], ref );
+		assert( posediff( pose, ref, n_joints ) < 2e-3f );
+
+		uint32 g = (f + 1) % n_frames;
+		for( uint32 j=0; j<n_joints; j++ ) {
+			lp[j] = vadd( vscale( 0.75f, p[ f*n_joints + j ] ), vscale( 0.25f, p[ g*n_joints + j ] ) );
+			lq[j] = qslerp( q[ f*n_joints + j ], q[ g*n_joints + j ], 0.25f );
+		}
+
+		sample_Anim( anim, (f + 0.25f) / anim->frame_rate, pose );
+		reference( n_joints, parents, lp, lq, ref );
+		assert( posediff( pose, ref, n_joints ) < 2e-3f );
+
+	}
+
+	// Time wraps around
+	Skel_Joint* wrap = calloc( n_joints, sizeof(Skel_Joint) );
+	sample_Anim( anim, 0.3f, pose );
+	sample_Anim( anim, 0.3f + 2.f * duration_Anim(anim), wrap );
+	assert( posediff( pose, wrap, n_joints ) < 1e-4f );
+	sample_Anim( anim, 0.3f - duration_Anim(anim), wrap );
+	assert( posediff( pose, wrap, n_joints ) < 1e-4f );
+
+	// Batches agree with sampling one instance at a time
+	init_Jobs( (int)sysconf( _SC_NPROCESSORS_ONLN ) );
+
+	region_p R = region( "r.anim.test" );
+
+	Anim_Instance* instances = ralloc( R, n_instances * sizeof(Anim_Instance) );
+	Skel_Joint*    poses     = ralloc( R, n_instances * n_joints * sizeof(Skel_Joint) );
+	Skel_Joint*    serial    = ralloc( R, n_instances * n_joints * sizeof(Skel_Joint) );
+
+	for( uint32 i=0; i<n_instances; i++ )
+		instances[i] = (Anim_Instance){ anim, frand( 0.f, 10.f ), &serial[ i*n_joints ] };
+	sample_Anim_instances( instances, n_instances );
+
+	for( uint32 i=0; i<n_instances; i++ )
+		instances[i].pose = &poses[ i*n_joints ];
+
+	Anim_Batch* batch = new_Anim_Batch( R, instances, n_instances );
+	submit_Anim_Batch( batch, 1 );
+	join_Anim_Batch( batch );
+	assert( 0 == memcmp( poses, serial, n_instances * n_joints * sizeof(Skel_Joint) ) );
+
+	// Benchmark
+	const int frames = 20;
+	usec_t timebase;
+
+	timebase = microseconds();
+	for( int f=0; f<frames; f++ ) {
+		for( uint32 i=0; i<n_instances; i++ )
+			instances[i].t += 1.f / 60.f;
+		sample_Anim_instances( instances, n_instances );
+	}
+	usec_t t_serial = microseconds() - timebase;
+
+	timebase = microseconds();
+	for( int f=0; f<frames; f++ ) {
+		for( uint32 i=0; i<n_instances; i++ )
+			instances[i].t += 1.f / 60.f;
+		submit_Anim_Batch( batch, 2 + f );
+		join_Anim_Batch( batch );
+	}
+	usec_t t_batch = microseconds() - timebase;
+
+	size_t raw = (size_t)n_joints * n_frames * 2 * sizeof(float4);
+	printf("%u joints, %u frames: %zu bytes of keys (%zu as float4s), %ld written\n",
+	       n_joints, n_frames, (size_t)n_joints * n_frames * sizeof(Anim_Key), raw, sz);
+	printf("%u instances, %d frames\n\n", n_instances, frames);
+	printf("%8s %10.1f Kinstances/s %8.1f Mjoints/s\n", "serial",
+	       1000. * n_instances * frames / t_serial, (double)n_instances * frames * n_joints / t_serial);
+	printf("%8s %10.1f Kinstances/s %8.1f Mjoints/s\n", "batch",
+	       1000. * n_instances * frames / t_batch, (double)n_instances * frames * n_joints / t_batch);
+
+	delete_Anim_Batch( batch );
+	shutdown_Jobs();
+	delete_Anim( anim );
+
+	printf("\nOk\n");
+	return 0;
+
+}
+
+#endif
@@ -0,0 +1,380 @@
+#include <assert.h>
+#include <string.h>
+
+#include "r.cmdbuf.h"
+
+// Recording and null ops /////////////////////////////////////////////////////
+
+static void record_program( pointer ctx, Program* pgm, Shader_Arg* argv ) {
+
+	push_Cmd_Buffer( (Cmd_Buffer*)ctx, cmdProgram, pgm, argv );
+
+}
+
+static void record_uniforms( pointer ctx, Shader_Arg* argv ) {
+
+	push_Cmd_Buffer( (Cmd_Buffer*)ctx, cmdUniforms, argv, NULL );
+
+}
+
+static void record_varray( pointer ctx, Varray* varray ) {
+
+	push_Cmd_Buffer( (Cmd_Buffer*)ctx, cmdVarray, varray, NULL );
+
+}
+
+static void record_draw( pointer ctx, Drawable* dr ) {
+
+	push_Cmd_Buffer( (Cmd_Buffer*)ctx, cmdDraw, dr, NULL );
+
+}
+
+const Draw_Ops record_Draw_Ops = {
+
+	record_program,
+	record_uniforms,
+	record_varray,
+	record_draw
+
+};
+
+static void null_program( pointer ctx, Program* pgm, Shader_Arg* argv ) { }
+static void null_uniforms( pointer ctx, Shader_Arg* argv ) { }
+static void null_varray( pointer ctx, Varray* varray ) { }
+static void null_draw( pointer ctx, Drawable* dr ) { }
+
+const Draw_Ops null_Draw_Ops = {
+
+	null_program,
+	null_uniforms,
+	null_varray,
+	null_draw
+
+};
+
+// Instantiation //////////////////////////////////////////////////////////////
+
+static void reserve( Cmd_Buffer* buf, uint capacity ) {
+
+	if( capacity <= buf->capacity )
+		return;
+
+	uint n = buf->capacity > 0 ? buf->capacity : 64;
+	while( n < capacity )
+		n *= 2;
+
+	buf->cmds = zrealloc( buf->Z, buf->cmds,
+	                      buf->capacity * sizeof(Draw_Cmd), n * sizeof(Draw_Cmd) );
+	buf->capacity = n;
+
+}
+
+Cmd_Buffer*     new_Cmd_Buffer( zone_p Z, uint capacity ) {
+
+	Cmd_Buffer* buf = zalloc( Z, sizeof(Cmd_Buffer) );
+
+	buf->Z        = Z;
+	buf->size     = 0;
+	buf->capacity = 0;
+	buf->cmds     = NULL;
+
+	reserve( buf, capacity );
+
+	return buf;
+
+}
+
+void         delete_Cmd_Buffer( Cmd_Buffer* buf ) {
+
+	if( buf->cmds )
+		zfree( buf->Z, buf->cmds );
+	zfree( buf->Z, buf );
+
+}
+
+// Functions //////////////////////////////////////////////////////////////////
+
+uint           size_Cmd_Buffer( const Cmd_Buffer* buf ) {
+
+	return buf->size;
+
+}
+
+void         replay_Cmd_Buffer( const Cmd_Buffer* buf,
+                                const Draw_Ops* ops, pointer ctx ) {
+
+	const Draw_Cmd* cmd = buf->cmds;
+	const Draw_Cmd* end = buf->cmds + buf->size;
+
+	for( ; cmd < end; cmd++ )
+		switch( cmd->op ) {
+
+			case cmdProgram:
+				ops->program( ctx, (Program*)cmd->a, (Shader_Arg*)cmd->b );
+				break;
+
+			case cmdUniforms:
+				ops->uniforms( ctx, (Shader_Arg*)cmd->a );
+				break;
+
+			case cmdVarray:
+				ops->varray( ctx, (Varray*)cmd->a );
+				break;
+
+			case cmdDraw:
+				ops->draw( ctx, (Drawable*)cmd->a );
+				break;
+
+			default:
+				assert( false );
+
+		}
+
+}
+
+// Mutators ///////////////////////////////////////////////////////////////////
+
+void          clear_Cmd_Buffer( Cmd_Buffer* buf ) {
+
+	buf->size = 0;
+
+}
+
+void           push_Cmd_Buffer( Cmd_Buffer* buf, cmdOp_e op, pointer a, pointer b ) {
+
+	if( buf->size == buf->capacity )
+		reserve( buf, buf->size + 1 );
+
+	buf->cmds[ buf->size++ ] = (Draw_Cmd){ op, 0, a, b };
+
+}
+
+void         record_Cmd_Buffer( Cmd_Buffer* buf,
+                                const Draw_List* list,
+                                uint first, uint n,
+                                Draw_Stats* stats ) {
+
+	// Roughly a draw and a vertex array per item, once sorted
+	reserve( buf, buf->size + 2*n + 1 );
+
+	submit_Draw_List_range( list, first, n, &record_Draw_Ops, buf, stats );
+
+}
+
+#ifdef __r_cmdbuf_TEST__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "job.control.h"
+#include "mm.heap.h"
+#include "time.core.h"
+
+// Tracing ops: every call goes into a running hash of the sequence, so
+// that a replay can be compared with submitting the list directly. That
+// each draw sees its own state is r.drawlist's to test
+typedef struct {
+
+	uint64      hash;
+	uint        calls;
+	uint        draws;
+
+} trace_t;
+
+static void mix( trace_t* c, uint64 op, pointer p ) {
+
+	c->hash = ( c->hash ^ ( op + (uint64)(uintptr_t)p ) ) * 0x100000001b3ULL;
+	c->calls++;
+
+}
+
+static void trace_program( pointer ctx, Program* pgm, Shader_Arg* argv ) {
+	mix( ctx, cmdProgram, pgm );
+}
+
+static void trace_uniforms( pointer ctx, Shader_Arg* argv ) {
+	mix( ctx, cmdUniforms, argv );
+}
+
+static void trace_varray( pointer ctx, Varray* varray ) {
+	mix( ctx, cmdVarray, varray );
+}
+
+static void trace_draw( pointer ctx, Drawable* dr ) {
+	((trace_t*)ctx)->draws++;
+	mix( ctx, cmdDraw, dr );
+}
+
+static const Draw_Ops trace_Draw_Ops = { trace_program, trace_uniforms, trace_varray, trace_draw };
+
+// Records a slice of a list, as the passes of a frame are
+declare_job( int, record_slice,
+
+             Cmd_Buffer*      buf;
+             const Draw_List* list;
+             uint             first;
+             uint             n;
+             Draw_Stats*      stats;
+             Job_Latch*       recorded );
+
+define_job( int, record_slice,
+
+            uint32 unused ) {
+
+	begin_job;
+
+	clear_Cmd_Buffer( arg(buf) );
+	record_Cmd_Buffer( arg(buf), arg(list), arg(first), arg(n), arg(stats) );
+
+	arrive_Job_Latch( arg(recorded) );
+
+	end_job;
+
+}
+
+static Job_Latch recorded;
+
+static void record_slices( const Draw_List* list, uint n_slices, Cmd_Buffer** bufs,
+                           Draw_Stats* stats, typeof_Job_params(record_slice)* params ) {
+
+	uint N     = size_Draw_List( list );
+	uint slice = (N + n_slices - 1) / n_slices;
+
+	add_Job_Latch( &recorded, (int)n_slices );
+	for( uint i=0; i<n_slices; i++ ) {
+
+		uint first = i * slice < N ? i * slice : N;
+		uint n     = N - first < slice ? N - first : slice;
+
+		memset( &stats[i], 0, sizeof(Draw_Stats) );
+		params[i] = (typeof_Job_params(record_slice)){
+			bufs[i], list, first, n, &stats[i], &recorded
+		};
+		submit_Job( 1, cpuBound, NULL, (jobfunc_f)record_slice, &params[i] );
+
+	}
+
+	wait_Job_Latch( &recorded );
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	const uint N = argc > 1 ? (uint)strtol( argv[1], NULL, 10 ) : 100000;
+
+	enum { n_programs = 4, n_argvs = 64, n_varrays = 256, n_slices = 8 };
+
+	init_Jobs( (int)sysconf( _SC_NPROCESSORS_ONLN ) );
+	init_Job_Latch( &recorded );
+
+	// Only the addresses matter
+	static uint8 programs[ n_programs ], argvs[ n_argvs ], varrays[ n_varrays ];
+
+	Drawable*  drs  = malloc( N * sizeof(Drawable) );
+	Draw_List* list = new_Draw_List( ZONE_heap, N );
+
+	for( uint i=0; i<N; i++ ) {
+
+		drs[i].geo = (Varray*)&varrays[ rand() % n_varrays ];
+		push_Draw_List( list, (Program*)&programs[ rand() % n_programs ], NULL, &drs[i],
+		                (Shader_Arg*)&argvs[ rand() % n_argvs ],
+		                (float)rand() / RAND_MAX * 1000.f );
+
+	}
+	sort_Draw_List( list );
+
+	// Replaying a recording makes the very calls submitting would
+	trace_t    direct = { 0 }, replayed = { 0 };
+	Draw_Stats s_direct = { 0 }, s_recorded = { 0 };
+
+	submit_Draw_List( list, &trace_Draw_Ops, &direct, &s_direct );
+
+	Cmd_Buffer* buf = new_Cmd_Buffer( ZONE_heap, 0 );
+	record_Cmd_Buffer( buf, list, 0, N, &s_recorded );
+	replay_Cmd_Buffer( buf, &trace_Draw_Ops, &replayed );
+
+	assert( N == direct.draws && N == replayed.draws );
+	assert( direct.calls == size_Cmd_Buffer( buf ) );
+	assert( direct.calls == replayed.calls && direct.hash == replayed.hash );
+	assert( 0 == memcmp( &s_direct, &s_recorded, sizeof(Draw_Stats) ) );
+
+	// Slices recorded by jobs and replayed in order make the same draws,
+	// binding little more than the whole list would
+	Cmd_Buffer* bufs[ n_slices ];
+	Draw_Stats  stats[ n_slices ];
+	typeof_Job_params(record_slice) params[ n_slices ];
+
+	for( uint i=0; i<n_slices; i++ )
+		bufs[i] = new_Cmd_Buffer( ZONE_heap, 0 );
+
+	record_slices( list, n_slices, bufs, stats, params );
+
+	trace_t sliced = { 0 };
+	uint64  programs_sliced = 0;
+	for( uint i=0; i<n_slices; i++ ) {
+		replay_Cmd_Buffer( bufs[i], &trace_Draw_Ops, &sliced );
+		programs_sliced += stats[i].programs;
+	}
+
+	assert( N == sliced.draws );
+	assert( programs_sliced <= s_direct.programs + n_slices );
+
+	// Recording into a cleared buffer starts it over; empty ranges record
+	// nothing
+	clear_Cmd_Buffer( buf );
+	record_Cmd_Buffer( buf, list, N, 0, NULL );
+	assert( 0 == size_Cmd_Buffer( buf ) );
+
+	// Benchmark: submit directly, record on this thread, record in jobs,
+	// replay through the null backend
+	const int M = 20;
+	usec_t timebase;
+
+	timebase = microseconds();
+	for( int m=0; m<M; m++ )
+		submit_Draw_List( list, &null_Draw_Ops, NULL, NULL );
+	usec_t t_submit = microseconds() - timebase;
+
+	timebase = microseconds();
+	for( int m=0; m<M; m++ ) {
+		clear_Cmd_Buffer( buf );
+		record_Cmd_Buffer( buf, list, 0, N, NULL );
+	}
+	usec_t t_record = microseconds() - timebase;
+
+	timebase = microseconds();
+	for( int m=0; m<M; m++ )
+		record_slices( list, n_slices, bufs, stats, params );
+	usec_t t_jobs = microseconds() - timebase;
+
+	timebase = microseconds();
+	for( int m=0; m<M; m++ )
+		for( uint i=0; i<n_slices; i++ )
+			replay_Cmd_Buffer( bufs[i], &null_Draw_Ops, NULL );
+	usec_t t_replay = microseconds() - timebase;
+
+	printf("%u draws, %u commands, %d slices, %ld cpus\n\n",
+	       N, size_Cmd_Buffer( buf ), n_slices, sysconf( _SC_NPROCESSORS_ONLN ));
+	printf("%-8s %8.3f ms\n", "submit", t_submit / 1000.0 / M);
+	printf("%-8s %8.3f ms %8.1f Mcmds/s\n", "record", t_record / 1000.0 / M,
+	       (double)size_Cmd_Buffer( buf ) * M / t_record);
+	printf("%-8s %8.3f ms\n", "jobs", t_jobs / 1000.0 / M);
+	printf("%-8s %8.3f ms %8.1f Mcmds/s\n", "replay", t_replay / 1000.0 / M,
+	       (double)size_Cmd_Buffer( buf ) * M / t_replay);
+
+	for( uint i=0; i<n_slices; i++ )
+		delete_Cmd_Buffer( bufs[i] );
+	delete_Cmd_Buffer( buf );
+	delete_Draw_List( list );
+	destroy_Job_Latch( &recorded );
+	free( drs );
+
+	shutdown_Jobs();
+
+	printf("\nOk\n");
+	return 0;
+
+}
+
+#endif
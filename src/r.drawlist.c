@@ -0,0 +1,584 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "r.drawlist.h"
+
+#define keyProgramShift  56
+#define keyUniformShift  40
+#define keyVarrayShift   24
+
+#define keyProgramMask   0xffULL
+#define keyUniformMask   0xffffULL
+#define keyVarrayMask    0xffffULL
+#define keyDepthMask     0xffffffULL
+
+#define initialStates    64
+#define noId             0xffffffffU
+
+// GL ops /////////////////////////////////////////////////////////////////////
+
+static void gl_program( pointer ctx, Program* pgm, Shader_Arg* argv ) {
+
+	use_Program( pgm, argv );
+
+}
+
+static void gl_uniforms( pointer ctx, Shader_Arg* argv ) {
+
+	load_Program_uniforms( argv );
+
+}
+
+static void gl_varray( pointer ctx, Varray* varray ) {
+
+	bind_Varray( varray );
+
+}
+
+static void gl_draw( pointer ctx, Drawable* dr ) {
+
+	if( dr->els )
+		draw_bound_Varray_indexed( dr->els, dr->geo, dr->mode, 0, dr->count );
+	else
+		draw_bound_Varray( dr->mode, 0, dr->count );
+
+}
+
+const Draw_Ops gl_Draw_Ops = {
+
+	gl_program,
+	gl_uniforms,
+	gl_varray,
+	gl_draw
+
+};
+
+// Instantiation //////////////////////////////////////////////////////////////
+
+static void init_ids( Draw_List* list, Draw_Ids* ids ) {
+
+	ids->map     = new_Map( list->Z, initialStates );
+	ids->last    = NULL;
+	ids->last_id = noId;
+
+}
+
+static void reserve( Draw_List* list, uint capacity ) {
+
+	if( capacity <= list->capacity )
+		return;
+
+	uint n = list->capacity > 0 ? list->capacity : 64;
+	while( n < capacity )
+		n *= 2;
+
+	list->items   = zrealloc( list->Z, list->items,
+	                          list->capacity * sizeof(Draw_Item), n * sizeof(Draw_Item) );
+	list->keys    = zrealloc( list->Z, list->keys,
+	                          list->capacity * sizeof(Draw_Key), n * sizeof(Draw_Key) );
+
+	// Nothing to keep in the scratch keys
+	if( list->scratch )
+		zfree( list->Z, list->scratch );
+	list->scratch = zalloc( list->Z, n * sizeof(Draw_Key) );
+
+	list->capacity = n;
+
+}
+
+Draw_List*     new_Draw_List( zone_p Z, uint capacity ) {
+
+	Draw_List* list = zalloc( Z, sizeof(Draw_List) );
+
+	list->Z        = Z;
+	list->size     = 0;
+	list->capacity = 0;
+	list->items    = NULL;
+	list->keys     = NULL;
+	list->scratch  = NULL;
+
+	init_ids( list, &list->programs );
+	init_ids( list, &list->uniforms );
+	init_ids( list, &list->varrays );
+
+	if( capacity > 0 ) {
+
+		list->items    = zalloc( Z, capacity * sizeof(Draw_Item) );
+		list->keys     = zalloc( Z, capacity * sizeof(Draw_Key) );
+		list->scratch  = zalloc( Z, capacity * sizeof(Draw_Key) );
+		list->capacity = capacity;
+
+	}
+
+	return list;
+
+}
+
+void        delete_Draw_List( Draw_List* list ) {
+
+	if( list->capacity > 0 ) {
+		zfree( list->Z, list->items );
+		zfree( list->Z, list->keys );
+		zfree( list->Z, list->scratch );
+	}
+
+	delete_Map( list->programs.map );
+	delete_Map( list->uniforms.map );
+	delete_Map( list->varrays.map );
+
+	zfree( list->Z, list );
+
+}
+
+// Functions //////////////////////////////////////////////////////////////////
+
+uint          size_Draw_List( const Draw_List* list ) {
+
+	return list->size;
+
+}
+
+uint64     key_Draw_List_item( uint32 pgm, uint32 argv, uint32 varray,
+                               float depth ) {
+
+	// Non-negative floats order as their bits do
+	uint32 bits;
+	if( !(depth > 0.f) )
+		depth = 0.f;
+	memcpy( &bits, &depth, sizeof(bits) );
+
+	return ( ((uint64)pgm    & keyProgramMask) << keyProgramShift )
+		| ( ((uint64)argv   & keyUniformMask) << keyUniformShift )
+		| ( ((uint64)varray & keyVarrayMask)  << keyVarrayShift )
+		| ( (uint64)(bits >> 7) & keyDepthMask );
+
+}
+
+// Mutators ///////////////////////////////////////////////////////////////////
+
+// Starts the ids of a field over once it has given out more than it holds
+static void reset_ids( Draw_List* list, Draw_Ids* ids, uint64 mask ) {
+
+	if( size_Map( ids->map ) <= mask + 1 )
+		return;
+
+	delete_Map( ids->map );
+	init_ids( list, ids );
+
+}
+
+static uint32 state_id( Draw_Ids* ids, const void* state ) {
+
+	if( state == ids->last && noId != ids->last_id )
+		return ids->last_id;
+
+	uint32  n  = size_Map( ids->map );
+	pointer id = lookup_Map( ids->map, sizeof(state), (pointer)&state );
+	if( !id )
+		put_Map( ids->map, sizeof(state), (pointer)&state, (pointer)(uintptr_t)( n + 1 ) );
+
+	ids->last    = state;
+	ids->last_id = id ? (uint32)( (uintptr_t)id - 1 ) : n;
+	return ids->last_id;
+
+}
+
+void         clear_Draw_List( Draw_List* list ) {
+
+	list->size = 0;
+
+	reset_ids( list, &list->programs, keyProgramMask );
+	reset_ids( list, &list->uniforms, keyUniformMask );
+	reset_ids( list, &list->varrays,  keyVarrayMask );
+
+}
+
+void          push_Draw_List( Draw_List* list,
+                              Program* pgm, Shader_Arg* pgm_argv,
+                              Drawable* draw, Shader_Arg* argv,
+                              float depth ) {
+
+	reserve( list, list->size + 1 );
+
+	uint i = list->size++;
+
+	uint64 key = key_Draw_List_item( state_id( &list->programs, pgm ),
+	                                 state_id( &list->uniforms, argv ),
+	                                 state_id( &list->varrays,  draw->geo ),
+	                                 depth );
+
+	list->items[i] = (Draw_Item){ pgm, pgm_argv, draw, argv };
+	list->keys[i]  = (Draw_Key){ key, i, 0 };
+
+}
+
+void          sort_Draw_List( Draw_List* list ) {
+
+	const uint n = list->size;
+	if( n < 2 )
+		return;
+
+	// Histograms of all eight bytes in one pass
+	uint32 counts[8][256];
+	memset( counts, 0, sizeof(counts) );
+
+	for( uint i=0; i<n; i++ ) {
+		uint64 k = list->keys[i].key;
+		for( int b=0; b<8; b++ )
+			counts[b][ (k >> (8*b)) & 0xff ]++;
+	}
+
+	Draw_Key* src = list->keys;
+	Draw_Key* dst = list->scratch;
+
+	for( int b=0; b<8; b++ ) {
+
+		// Every key has the same byte here; nothing to do
+		uint64 byte = (src[0].key >> (8*b)) & 0xff;
+		if( counts[b][byte] == n )
+			continue;
+
+		uint32 ofs[256];
+		uint32 sum = 0;
+		for( int d=0; d<256; d++ ) {
+			ofs[d] = sum;
+			sum   += counts[b][d];
+		}
+
+		for( uint i=0; i<n; i++ )
+			dst[ ofs[ (src[i].key >> (8*b)) & 0xff ]++ ] = src[i];
+
+		Draw_Key* t = src; src = dst; dst = t;
+
+	}
+
+	// Keep the sorted keys in `keys'
+	if( src != list->keys ) {
+		list->scratch = list->keys;
+		list->keys    = src;
+	}
+
+}
+
+void        submit_Draw_List( const Draw_List* list,
+                              const Draw_Ops* ops, pointer ctx,
+                              Draw_Stats* stats ) {
+
+	submit_Draw_List_range( list, 0, list->size, ops, ctx, stats );
+
+}
+
+void  submit_Draw_List_range( const Draw_List* list,
+                              uint first, uint n,
+                              const Draw_Ops* ops, pointer ctx,
+                              Draw_Stats* stats ) {
+
+	assert( first + n <= list->size );
+
+	Draw_Stats s = { 0 };
+
+	Program*    pgm    = NULL;
+	Shader_Arg* argv   = NULL;
+	Varray*     varray = NULL;
+	bool        bound  = false;   // pgm and argv are meaningful
+
+	for( uint i=first; i<first+n; i++ ) {
+
+		const Draw_Item* item = nth_Draw_List( list, i );
+
+		if( !bound || item->pgm != pgm ) {
+
+			ops->program( ctx, item->pgm, item->pgm_argv );
+			pgm = item->pgm;
+			s.programs++;
+
+			// Uniforms are state of the program bound
+			ops->uniforms( ctx, item->argv );
+			argv = item->argv;
+			s.uniforms++;
+
+			bound = true;
+
+		} else {
+
+			s.programs_skipped++;
+
+			if( item->argv != argv ) {
+				ops->uniforms( ctx, item->argv );
+				argv = item->argv;
+				s.uniforms++;
+			} else
+				s.uniforms_skipped++;
+
+		}
+
+		if( item->draw->geo != varray ) {
+			varray = item->draw->geo;
+			ops->varray( ctx, varray );
+			s.varrays++;
+		} else
+			s.varrays_skipped++;
+
+		ops->draw( ctx, item->draw );
+		s.draws++;
+
+	}
+
+	if( varray )
+		ops->varray( ctx, NULL );
+
+	if( stats ) {
+		stats->draws            += s.draws;
+		stats->programs         += s.programs;
+		stats->uniforms         += s.uniforms;
+		stats->varrays          += s.varrays;
+		stats->programs_skipped += s.programs_skipped;
+		stats->uniforms_skipped += s.uniforms_skipped;
+		stats->varrays_skipped  += s.varrays_skipped;
+	}
+
+}
+
+#ifdef __r_drawlist_TEST__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mm.heap.h"
+#include "time.core.h"
+
+// CPU-side ops, counting what they are asked to do
+static struct {
+
+	Program*    pgm;
+	Shader_Arg* argv;
+	Varray*     varray;
+
+	uint        draws;
+	uint        changes;
+
+} cpu;
+
+static void cpu_program( pointer ctx, Program* pgm, Shader_Arg* argv ) {
+	(void)argv;
+	if( pgm != cpu.pgm ) cpu.changes++;
+	cpu.pgm = pgm;
+}
+
+static void cpu_uniforms( pointer ctx, Shader_Arg* argv ) {
+	if( argv != cpu.argv ) cpu.changes++;
+	cpu.argv = argv;
+}
+
+static void cpu_varray( pointer ctx, Varray* varray ) {
+	cpu.varray = varray;
+}
+
+static void cpu_draw( pointer ctx, Drawable* dr ) {
+	// The state asked for is the state the draw was pushed with
+	assert( dr->geo == cpu.varray );
+	cpu.draws++;
+}
+
+static const Draw_Ops cpu_Draw_Ops = { cpu_program, cpu_uniforms, cpu_varray, cpu_draw };
+
+// Each fake draw knows the program and uniforms it was pushed with
+typedef struct {
+
+	Drawable    dr;
+	Program*    pgm;
+	Shader_Arg* argv;
+
+} fake_t;
+
+static int compare_keys( const void* a, const void* b ) {
+
+	uint64 x = ((const Draw_Key*)a)->key, y = ((const Draw_Key*)b)->key;
+	return x < y ? -1 : x > y;
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	const uint N = argc > 1 ? (uint)strtol( argv[1], NULL, 10 ) : 100000;
+
+	enum { n_programs = 4, n_argvs = 64, n_varrays = 256 };
+
+	// Only the addresses matter
+	static uint8 programs[ n_programs ], argvs[ n_argvs ], varrays[ n_varrays ];
+
+	fake_t*    fakes = malloc( N * sizeof(fake_t) );
+	float*     depth = malloc( N * sizeof(float) );
+	Draw_List* list  = new_Draw_List( ZONE_heap, 0 );
+
+	for( uint i=0; i<N; i++ ) {
+
+		fakes[i].dr.geo = (Varray*)&varrays[ rand() % n_varrays ];
+		fakes[i].pgm    = (Program*)&programs[ rand() % n_programs ];
+		fakes[i].argv   = (Shader_Arg*)&argvs[ rand() % n_argvs ];
+		depth[i]        = (float)rand() / RAND_MAX * 1000.f;
+
+		push_Draw_List( list, fakes[i].pgm, NULL, &fakes[i].dr, fakes[i].argv, depth[i] );
+
+	}
+	assert( size_Draw_List(list) == N );
+
+	// Depth orders as the floats do
+	assert( key_Draw_List_item( 0, 0, 0, 1.f ) < key_Draw_List_item( 0, 0, 0, 1.5f ) );
+	assert( key_Draw_List_item( 0, 0, 0, -1.f ) == key_Draw_List_item( 0, 0, 0, 0.f ) );
+
+	// Keep the pushed keys, to unsort with later
+	Draw_Key* pushed = malloc( N * sizeof(Draw_Key) );
+	memcpy( pushed, list->keys, N * sizeof(Draw_Key) );
+
+	// Draw everything unsorted, for comparison
+	Draw_Stats unsorted = { 0 };
+	submit_Draw_List( list, &cpu_Draw_Ops, NULL, &unsorted );
+	assert( N == cpu.draws );
+
+	// Sorting agrees with qsort, and keeps every item once
+	Draw_Key* expected = malloc( N * sizeof(Draw_Key) );
+	memcpy( expected, list->keys, N * sizeof(Draw_Key) );
+	qsort( expected, N, sizeof(Draw_Key), compare_keys );
+
+	sort_Draw_List( list );
+
+	uint8* seen = calloc( N, 1 );
+	for( uint i=0; i<N; i++ ) {
+		assert( list->keys[i].key == expected[i].key );
+		assert( !seen[ list->keys[i].item ] );
+		seen[ list->keys[i].item ] = 1;
+		if( i > 0 )
+			assert( list->keys[i-1].key <= list->keys[i].key );
+	}
+
+	// Within a vertex array, draws go front to back
+	for( uint i=1; i<N; i++ ) {
+		Draw_Item* a = nth_Draw_List( list, i-1 );
+		Draw_Item* b = nth_Draw_List( list, i );
+		if( a->pgm == b->pgm && a->argv == b->argv && a->draw->geo == b->draw->geo )
+			assert( depth[ (fake_t*)a->draw - fakes ] <= depth[ (fake_t*)b->draw - fakes ] );
+	}
+
+	// Sorted, every program is bound once and every uniform set once per
+	// program, and each draw still sees its own state
+	memset( &cpu, 0, sizeof(cpu) );
+	Draw_Stats sorted = { 0 };
+	submit_Draw_List( list, &cpu_Draw_Ops, NULL, &sorted );
+
+	assert( N == cpu.draws && N == sorted.draws );
+	assert( sorted.programs + sorted.programs_skipped == N );
+	assert( sorted.uniforms + sorted.uniforms_skipped == N );
+	assert( sorted.varrays  + sorted.varrays_skipped == N );
+	assert( sorted.programs <= n_programs );
+	assert( sorted.uniforms <= n_programs * n_argvs );
+	assert( sorted.varrays < unsorted.varrays );
+
+	// Sorting an already sorted list changes nothing; an empty one is fine
+	Draw_Key* before = malloc( N * sizeof(Draw_Key) );
+	memcpy( before, list->keys, N * sizeof(Draw_Key) );
+	sort_Draw_List( list );
+	for( uint i=0; i<N; i++ )
+		assert( before[i].key == list->keys[i].key );
+
+	clear_Draw_List( list );
+	sort_Draw_List( list );
+	submit_Draw_List( list, &cpu_Draw_Ops, NULL, NULL );
+
+	// Ids outlive a clear, until a field has had more states than it holds
+	{
+		static uint8 many[ 300 ];
+		Draw_List* ids = new_Draw_List( ZONE_heap, 0 );
+		Drawable   dr  = { .geo = (Varray*)&varrays[0] };
+
+		push_Draw_List( ids, (Program*)&many[0], NULL, &dr, NULL, 0.f );
+		push_Draw_List( ids, (Program*)&many[1], NULL, &dr, NULL, 0.f );
+		clear_Draw_List( ids );
+
+		push_Draw_List( ids, (Program*)&many[1], NULL, &dr, NULL, 0.f );
+		assert( key_Draw_List_item( 1, 0, 0, 0.f ) == ids->keys[0].key );
+
+		for( int i=0; i<300; i++ )
+			push_Draw_List( ids, (Program*)&many[i], NULL, &dr, NULL, 0.f );
+		clear_Draw_List( ids );
+
+		push_Draw_List( ids, (Program*)&many[299], NULL, &dr, NULL, 0.f );
+		assert( key_Draw_List_item( 0, 0, 0, 0.f ) == ids->keys[0].key );
+
+		delete_Draw_List( ids );
+	}
+
+	// Benchmark: key, sort
+	const int M = 20;
+	usec_t timebase;
+
+	timebase = microseconds();
+	for( int m=0; m<M; m++ ) {
+		clear_Draw_List( list );
+		for( uint i=0; i<N; i++ )
+			push_Draw_List( list, fakes[i].pgm, NULL, &fakes[i].dr, fakes[i].argv, depth[i] );
+	}
+	usec_t t_push = microseconds() - timebase;
+
+	usec_t t_radix = 0, t_qsort = 0;
+	for( int m=0; m<M; m++ ) {
+
+		memcpy( expected, list->keys, N * sizeof(Draw_Key) );
+
+		timebase = microseconds();
+		qsort( expected, N, sizeof(Draw_Key), compare_keys );
+		t_qsort += microseconds() - timebase;
+
+		timebase = microseconds();
+		sort_Draw_List( list );
+		t_radix += microseconds() - timebase;
+
+		// Unsort again for the next round
+		memcpy( list->keys, pushed, N * sizeof(Draw_Key) );
+
+	}
+
+	// Pushed a state at a time, as a scene does
+	fake_t* grouped = malloc( N * sizeof(fake_t) );
+	float*  gdepth  = malloc( N * sizeof(float) );
+	sort_Draw_List( list );
+	for( uint i=0; i<N; i++ ) {
+		grouped[i] = fakes[ list->keys[i].item ];
+		gdepth[i]  = depth[ list->keys[i].item ];
+	}
+
+	timebase = microseconds();
+	for( int m=0; m<M; m++ ) {
+		clear_Draw_List( list );
+		for( uint i=0; i<N; i++ )
+			push_Draw_List( list, grouped[i].pgm, NULL, &grouped[i].dr, grouped[i].argv, gdepth[i] );
+	}
+	usec_t t_grouped = microseconds() - timebase;
+
+	printf("%u draws: %d programs, %d uniform sets, %d vertex arrays\n\n",
+	       N, n_programs, n_argvs, n_varrays);
+	printf("%10s %10s %10s %10s\n", "", "programs", "uniforms", "varrays");
+	printf("%10s %10llu %10llu %10llu\n", "unsorted",
+	       (unsigned long long)unsorted.programs, (unsigned long long)unsorted.uniforms,
+	       (unsigned long long)unsorted.varrays);
+	printf("%10s %10llu %10llu %10llu\n", "sorted",
+	       (unsigned long long)sorted.programs, (unsigned long long)sorted.uniforms,
+	       (unsigned long long)sorted.varrays);
+	printf("%10s %10llu %10llu %10llu\n\n", "skipped",
+	       (unsigned long long)sorted.programs_skipped, (unsigned long long)sorted.uniforms_skipped,
+	       (unsigned long long)sorted.varrays_skipped);
+	printf("push  %8.3f ms\n", t_push / 1000.0 / M);
+	printf("  grouped %4.3f ms\n", t_grouped / 1000.0 / M);
+	printf("radix %8.3f ms\n", t_radix / 1000.0 / M);
+	printf("qsort %8.3f ms\n", t_qsort / 1000.0 / M);
+
+	delete_Draw_List( list );
+	free( grouped ); free( gdepth ); free( pushed ); free( before ); free( seen ); free( expected ); free( depth ); free( fakes );
+
+	printf("\nOk\n");
+	return 0;
+
+}
+
+#endif
@@ -1,9 +1,21 @@
 #include "core.log.h"
+#include "mm.heap.h"
 #include "r.frame.h"
 #include "r.scene.h"
 #include "time.core.h"
 #include "sync.thread.h"
 
+declare_job( int, record_Rpass,
+
+             Rpipeline *pipe;
+             Rpass     *pass );
+
+struct Rpass_Job {
+
+	typeof_Job_params(record_Rpass) params;
+
+};
+
 Rpass *  new_Rpass( int id, 
                     Scene *sc,     predicate_f cull, 
                     Program *proc, Shader_Arg *argv,
@@ -14,10 +26,16 @@ Rpass *  new_Rpass( int id,
 	pass->id     = id;
 	pass->sc     = sc;
 	pass->cull   = cull;
+	pass->frustum = NULL;
+	pass->depth  = NULL;
 	pass->proc   = proc;
 	pass->argv   = argv;
 	pass->rstate = *rstate;
 
+	pass->drawlist = new_Draw_List( ZONE_heap, 1024 );
+	pass->cmds     = new_Cmd_Buffer( ZONE_heap, 2048 );
+	memset( &pass->stats, 0, sizeof(pass->stats) );
+
     return pass;
 
 }
@@ -45,6 +63,12 @@ Rpipeline    *new_Rpipeline( clearMask mask, int passc, Rpass *passv[] ) {
 		return NULL;
 
 	pipe->mask = mask;
+	memset( &pipe->stats, 0, sizeof(pipe->stats) );
+
+	pipe->deadline = 0;
+	pipe->jobs     = malloc( passc * sizeof(Rpass_Job) );
+	init_Job_Latch( &pipe->recorded );
+
 	pipe->passc = passc;
 	memcpy( &pipe->passv[0], &passv[0], passc * sizeof(Rpass*) );
 
@@ -54,8 +78,14 @@ Rpipeline    *new_Rpipeline( clearMask mask, int passc, Rpass *passv[] ) {
 
 void destroy_Rpipeline( Rpipeline *pipe ) {
 
-	for( int i=0; i<pipe->passc; i++ )
+	for( int i=0; i<pipe->passc; i++ ) {
+		delete_Cmd_Buffer( pipe->passv[ i ]->cmds );
+		delete_Draw_List( pipe->passv[ i ]->drawlist );
 		free( pipe->passv[ i ] );
+	}
+
+	destroy_Job_Latch( &pipe->recorded );
+	free( pipe->jobs );
 	free( pipe );
 
 
@@ -65,17 +95,36 @@ void render_Frame( Rpipeline *rpipe, float t0, float t, float dt ) {
     
 	trace( "RENDER: t0=%9.5f\tt=%9.5f\tdt=%9.5f ", t0, t, dt );
 
+	memset( &rpipe->stats, 0, sizeof(rpipe->stats) );
+
+	// Record every pass at once...
+	add_Job_Latch( &rpipe->recorded, (*rpipe).passc );
+	for( int pass=0; pass<(*rpipe).passc; pass++ ) {
+
+		rpipe->jobs[pass].params = (typeof_Job_params(record_Rpass)){ rpipe, (*rpipe).passv[pass] };
+		submit_Job( rpipe->deadline, cpuBound, NULL, (jobfunc_f)record_Rpass, &rpipe->jobs[pass].params );
+
+	}
+
+	wait_Job_Latch( &rpipe->recorded );
+
+	// ...and replay them in order
 	glClear( rpipe->mask );
 	for( int pass=0; pass<(*rpipe).passc; pass++ ) {
         
 		Rpass* rpass = (*rpipe).passv[pass];
 
 		apply_Rstate( &(*rpass).rstate );
-		use_Program( (*rpass).proc, (*rpass).argv );
-		draw_Scene( t0, t, dt, 
-		            (*rpass).sc,
-		            (*rpass).id,
-		            (*rpass).cull );
+		replay_Cmd_Buffer( (*rpass).cmds, &gl_Draw_Ops, NULL );
+
+		rpipe->stats.draws            += (*rpass).stats.draws;
+		rpipe->stats.programs         += (*rpass).stats.programs;
+		rpipe->stats.uniforms         += (*rpass).stats.uniforms;
+		rpipe->stats.varrays          += (*rpass).stats.varrays;
+		rpipe->stats.programs_skipped += (*rpass).stats.programs_skipped;
+		rpipe->stats.uniforms_skipped += (*rpass).stats.uniforms_skipped;
+		rpipe->stats.varrays_skipped  += (*rpass).stats.varrays_skipped;
+
 	}
 	
 }
@@ -128,3 +177,45 @@ void render_Frame_loop( Display *dpy, Channel *clk, Rpipeline *(*sync)(pointer),
 	}
 
 }
+
+// Jobs ///////////////////////////////////////////////////////////////////////
+
+define_job( int, record_Rpass,
+
+            uint32 unused ) {
+
+	begin_job;
+
+	Rpass* rpass = arg(pass);
+
+	clear_Draw_List( (*rpass).drawlist );
+	if( (*rpass).frustum )
+		collect_Scene_frustum( (*rpass).sc,
+		                       (*rpass).id,
+		                       (*rpass).frustum,
+		                       (*rpass).depth,
+		                       (*rpass).proc,
+		                       (*rpass).argv,
+		                       (*rpass).drawlist );
+	else
+		collect_Scene( (*rpass).sc,
+		               (*rpass).id,
+		               (*rpass).cull,
+		               (*rpass).depth,
+		               (*rpass).proc,
+		               (*rpass).argv,
+		               (*rpass).drawlist );
+	sort_Draw_List( (*rpass).drawlist );
+
+	memset( &(*rpass).stats, 0, sizeof((*rpass).stats) );
+	clear_Cmd_Buffer( (*rpass).cmds );
+	record_Cmd_Buffer( (*rpass).cmds, (*rpass).drawlist,
+	                   0, size_Draw_List( (*rpass).drawlist ),
+	                   &(*rpass).stats );
+
+	// The last pass recorded wakes up render_Frame
+	arrive_Job_Latch( &arg(pipe)->recorded );
+
+	end_job;
+
+}
@@ -2,14 +2,17 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "control.maybe.h"
 #include "control.minmax.h"
 #include "core.log.h"
 #include "core.types.h"
 #include "gl.attrib.h"
 #include "gl.index.h"
+#include "mm.heap.h"
 #include "res.core.h"
 #include "res.io.h"
 #include "r.mesh.h"
+#include "r.meshopt.h"
 
 #define r_meshVersion 3
 
@@ -81,140 +84,124 @@ pointer      *read_Mesh( FILE *inp ) {
 
 }
 
-void          dump_Mesh_info( Mesh *mesh ) {
+// The Mesh itself, pointers cleared, then an array per pointer. Mapping
+// sets the four pointers and touches nothing else. Fields are copied one
+// by one, so that padding is written as zeroes and the same mesh always
+// packs to the same bytes
+void          pack_Mesh( pointer res, Res_Pack *pack ) {
 
-	info( "\tvertices :  %d", mesh->n_verts );
-	info( "\ttexcoords:  %d", mesh->n_uvs );
-	info( "\tnormals  :  %d", mesh->n_normals );
-	info( "\tfaces    :  %d", mesh->n_tris );
-	info( "\tmins     :  %6.2f %6.2f %6.2f", 
-	      mesh->bounds.mins.x, mesh->bounds.mins.y, mesh->bounds.mins.z );
-	info( "\tmaxs     :  %6.2f %6.2f %6.2f", 
-	      mesh->bounds.maxs.x, mesh->bounds.maxs.y, mesh->bounds.maxs.z );
+	Mesh *mesh = (Mesh*)res;
+	Mesh *head = add_Res_Pack( pack, "mesh", sizeof(Mesh), 1, NULL );
 
-}
+	head->n_verts   = mesh->n_verts;
+	head->n_uvs     = mesh->n_uvs;
+	head->n_normals = mesh->n_normals;
+	head->n_tris    = mesh->n_tris;
+	head->bounds    = mesh->bounds;
 
-static void compute_normals( float *np, float *verts, int n_tris, Mesh_Vertex *tris ) {
+	add_Res_Pack( pack, "vert", 3 * sizeof(float), mesh->n_verts, mesh->verts );
+	add_Res_Pack( pack, "uv  ", 2 * sizeof(float), mesh->n_uvs, mesh->uvs );
+	add_Res_Pack( pack, "norm", 3 * sizeof(float), mesh->n_normals, mesh->normals );
+	add_Res_Pack( pack, "tris", 3 * sizeof(Mesh_Vertex), mesh->n_tris, mesh->tris );
 
-	assert( np );
-	assert( verts );
-	assert( n_tris > 0 );
-	assert( tris );
+}
 
-	for( int i=0; i<n_tris; i++ ) {
+pointer        map_Mesh( const Res_Map *map ) {
 
-		float4 v0, v1, v2;
+	uint64 n_mesh, n_verts, n_uvs, n_normals, n_tris;
 
-		v0.x = verts[ 3*tris[3*i + 0].v + 0 ];
-		v0.y = verts[ 3*tris[3*i + 0].v + 1 ];
-		v0.z = verts[ 3*tris[3*i + 0].v + 2 ];
-		v0.w = 1.f;
+	Mesh *mesh = section_Res_Map( map, "mesh", sizeof(Mesh), &n_mesh );
+	if( !mesh || 1 != n_mesh ) {
+		error0( "Mapped mesh has no header, or one of another version" );
+		return NULL;
+	}
 
-		v1.x = verts[ 3*tris[3*i + 1].v + 0 ];
-		v1.y = verts[ 3*tris[3*i + 1].v + 1 ];
-		v1.z = verts[ 3*tris[3*i + 1].v + 2 ];
-		v1.w = 1.f;
+	mesh->verts   = section_Res_Map( map, "vert", 3 * sizeof(float), &n_verts );
+	mesh->uvs     = section_Res_Map( map, "uv  ", 2 * sizeof(float), &n_uvs );
+	mesh->normals = section_Res_Map( map, "norm", 3 * sizeof(float), &n_normals );
+	mesh->tris    = section_Res_Map( map, "tris", 3 * sizeof(Mesh_Vertex), &n_tris );
 
-		v2.x = verts[ 3*tris[3*i + 2].v + 0 ];
-		v2.y = verts[ 3*tris[3*i + 2].v + 1 ];
-		v2.z = verts[ 3*tris[3*i + 2].v + 2 ];
-		v2.w = 1.f;
+	if( !mesh->verts || !mesh->uvs || !mesh->normals || !mesh->tris
+	    || n_verts != mesh->n_verts || n_uvs != mesh->n_uvs
+	    || n_normals != mesh->n_normals || n_tris != mesh->n_tris ) {
+		error0( "Mapped mesh is missing arrays, or they are the wrong size" );
+		return NULL;
+	}
+
+	info0( "Mapped mesh:" );
+	dump_Mesh_info( mesh );
 
-		float4 u = vsub( v1, v0 );
-		float4 v = vsub( v2, v0 );
+	return (pointer)mesh;
 
-		float4 n = vnormal( vcross( u, v ) );
+}
 
-		for( int j=0; j<3; j++ ) {
-			np[ 3*(3*i + j) + 0 ] = n.x;
-			np[ 3*(3*i + j) + 1 ] = n.y;
-			np[ 3*(3*i + j) + 2 ] = n.z;
-		}
+void          dump_Mesh_info( Mesh *mesh ) {
 
-	}
+	info( "\tvertices :  %d", mesh->n_verts );
+	info( "\ttexcoords:  %d", mesh->n_uvs );
+	info( "\tnormals  :  %d", mesh->n_normals );
+	info( "\tfaces    :  %d", mesh->n_tris );
+	info( "\tmins     :  %6.2f %6.2f %6.2f", 
+	      mesh->bounds.mins.x, mesh->bounds.mins.y, mesh->bounds.mins.z );
+	info( "\tmaxs     :  %6.2f %6.2f %6.2f", 
+	      mesh->bounds.maxs.x, mesh->bounds.maxs.y, mesh->bounds.maxs.z );
 
 }
 
-static void copy_tris( int n_tris, Mesh_Vertex *tris, 
-                       float *dst_v, float *src_v,
-                       float *dst_uv, float *src_uv,
-                       float *dst_n, float *src_n ) {
+Drawable *drawable_Mesh( region_p R, Mesh *mesh ) {
 
-	assert( n_tris > 0 );
-	assert( tris );
-	assert( dst_v ); assert( src_v );
-	assert( dst_uv ); assert( src_uv );
-	assert( dst_n ); assert( src_n );
-	
-	for( int i=0; i<n_tris; i++ ) {
+	Vformat fmt = define_Vformat( vposFloat, vuvFloat, vnormalFloat );
+	return drawable_Mesh_as( R, mesh, &fmt );
 
-		// Verts
-		dst_v[ 3*(3*i+0) + 0 ] = src_v[ 3*tris[3*i+0].v + 0 ];
-		dst_v[ 3*(3*i+0) + 1 ] = src_v[ 3*tris[3*i+0].v + 1 ];
-		dst_v[ 3*(3*i+0) + 2 ] = src_v[ 3*tris[3*i+0].v + 2 ];
+}
 
-		dst_v[ 3*(3*i+1) + 0 ] = src_v[ 3*tris[3*i+1].v + 0 ];
-		dst_v[ 3*(3*i+1) + 1 ] = src_v[ 3*tris[3*i+1].v + 1 ];
-		dst_v[ 3*(3*i+1) + 2 ] = src_v[ 3*tris[3*i+1].v + 2 ];
+Drawable *drawable_Mesh_as( region_p R, Mesh *mesh, Vformat *fmt ) {
 
-		dst_v[ 3*(3*i+2) + 0 ] = src_v[ 3*tris[3*i+2].v + 0 ];
-		dst_v[ 3*(3*i+2) + 1 ] = src_v[ 3*tris[3*i+2].v + 1 ];
-		dst_v[ 3*(3*i+2) + 2 ] = src_v[ 3*tris[3*i+2].v + 2 ];
+	Mesh_Opt_Stats stats;
+	Mesh_Indexed*  opt = optimize_Mesh( ZONE_heap, mesh, &stats );
 
-		// UVs
-		dst_uv[ 2*(3*i+0) + 0 ] = src_uv[ 2*tris[3*i+0].uv + 0 ];
-		dst_uv[ 2*(3*i+0) + 1 ] = src_uv[ 2*tris[3*i+0].uv + 1 ];
+	info( "drawable_Mesh: %u corners -> %u vertices, ACMR %.3f -> %.3f, %d bytes a vertex",
+	      stats.corners, stats.verts, stats.acmr_welded, stats.acmr, fmt->stride );
 
-		dst_uv[ 2*(3*i+1) + 0 ] = src_uv[ 2*tris[3*i+1].uv + 0 ];
-		dst_uv[ 2*(3*i+1) + 1 ] = src_uv[ 2*tris[3*i+1].uv + 1 ];
+	fit_Vformat( fmt, &mesh->bounds, opt->n_verts, opt->uvs );
 
-		dst_uv[ 2*(3*i+2) + 0 ] = src_uv[ 2*tris[3*i+2].uv + 0 ];
-		dst_uv[ 2*(3*i+2) + 1 ] = src_uv[ 2*tris[3*i+2].uv + 1 ];
+	// 16-bit indices when they will do
+	bool   shorts = opt->n_verts <= 0x10000;
+	uint32 n      = 3 * opt->n_tris;
 
-		// Normals
-		dst_n[ 3*(3*i+0) + 0 ] = src_n[ 3*tris[3*i+0].n + 0 ];
-		dst_n[ 3*(3*i+0) + 1 ] = src_n[ 3*tris[3*i+0].n + 1 ];
-		dst_n[ 3*(3*i+0) + 2 ] = src_n[ 3*tris[3*i+0].n + 2 ];
+	Vindex  *tris  = new_Vindex( shorts ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT );
+	pointer  trip  = maybe( (pointer)tris, == NULL, alloc_Vindex( tris, staticDraw, n ) );
+	pointer  verts = maybe( trip, == NULL, zalloc( ZONE_heap, (size_t)opt->n_verts * fmt->stride ) );
 
-		dst_n[ 3*(3*i+1) + 0 ] = src_n[ 3*tris[3*i+1].n + 0 ];
-		dst_n[ 3*(3*i+1) + 1 ] = src_n[ 3*tris[3*i+1].n + 1 ];
-		dst_n[ 3*(3*i+1) + 2 ] = src_n[ 3*tris[3*i+1].n + 2 ];
+	if( !verts ) {
 
-		dst_n[ 3*(3*i+2) + 0 ] = src_n[ 3*tris[3*i+2].n + 0 ];
-		dst_n[ 3*(3*i+2) + 1 ] = src_n[ 3*tris[3*i+2].n + 1 ];
-		dst_n[ 3*(3*i+2) + 2 ] = src_n[ 3*tris[3*i+2].n + 2 ];
+		maybe( tris, == NULL, delete_Vindex(tris) );
+		delete_Mesh_Indexed( opt );
+
+		return NULL;
 
 	}
 
-}
+	encode_Vformat( fmt, opt->n_verts, opt->verts, opt->uvs, opt->normals, verts );
 
-Drawable *drawable_Mesh( region_p R, Mesh *mesh ) {
+	if( shorts )
+		for( uint32 i=0; i<n; i++ )
+			((uint16*)trip)[i] = (uint16)opt->tris[i];
+	else
+		memcpy( trip, opt->tris, n * sizeof(uint32) );
 
-	Vattrib *verts   = new_Vattrib( "pos", 3, GL_FLOAT, GL_FALSE );
-	Vattrib *normals = (NULL == verts  ) ? NULL : new_Vattrib( "n", 3, GL_FLOAT, GL_FALSE );
-	Vattrib *texcs   = (NULL == normals) ? NULL : new_Vattrib( "uv", 2, GL_FLOAT, GL_FALSE );
-	
-	float *vp = alloc_Vattrib( verts, staticDraw, 3*mesh->n_tris );
-	float *np = alloc_Vattrib( normals, staticDraw, 3*mesh->n_tris );
-	float *tp = alloc_Vattrib( texcs, staticDraw, 3*mesh->n_tris );
+	flush_Vindex( tris );
 
-	if( !vp || !np || !tp ) {
+	Varray* varray = new_Varray_Vformat( fmt, opt->n_verts, verts, tris );
 
-		delete_Vattrib(verts);
-		delete_Vattrib(texcs);
-		delete_Vattrib(normals);
+	zfree( ZONE_heap, verts );
+	delete_Mesh_Indexed( opt );
 
+	if( !varray ) {
+		delete_Vindex( tris );
 		return NULL;
-
 	}
 
-	copy_tris( mesh->n_tris, mesh->tris, vp, mesh->verts, tp, mesh->uvs, np, mesh->normals );
-	if( !(mesh->n_normals > 0) )
-		compute_normals( np, mesh->verts, mesh->n_tris, mesh->tris );
-
-	flush_Vattrib( verts );
-	flush_Vattrib( texcs );
-	flush_Vattrib( normals );
+	return new_Drawable_indexed( R, n, tris, varray, drawTris );
 
-	return new_Drawable( R, 3*mesh->n_tris, define_Varray( 3, verts, texcs, normals ), drawTris );
 }
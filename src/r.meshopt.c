@@ -0,0 +1,645 @@
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "data.hash64.h"
+#include "r.meshopt.h"
+#include "sync.once.h"
+
+// Forsyth's scoring constants
+#define cacheDecayPower   1.5f
+#define lastTriScore      0.75f
+#define valenceBoostScale 2.0f
+#define valenceBoostPower 0.5f
+
+// Welding ////////////////////////////////////////////////////////////////////
+
+// The values of a corner: position, texcoord, normal
+typedef struct {
+
+	float v[8];
+
+} corner_t;
+
+static float4 face_normal( const Mesh* mesh, int32 t ) {
+
+	const float* p0 = &mesh->verts[ 3*mesh->tris[ 3*t + 0 ].v ];
+	const float* p1 = &mesh->verts[ 3*mesh->tris[ 3*t + 1 ].v ];
+	const float* p2 = &mesh->verts[ 3*mesh->tris[ 3*t + 2 ].v ];
+
+	float4 u = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2], 0.f };
+	float4 v = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2], 0.f };
+	float4 n = vcross( u, v );
+
+	return vlength2( n ) > 0.f ? vnormal( n ) : n;
+
+}
+
+static corner_t get_corner( const Mesh* mesh, int32 t, int j, float4 fn ) {
+
+	const Mesh_Vertex* mv = &mesh->tris[ 3*t + j ];
+	corner_t c;
+
+	memcpy( &c.v[0], &mesh->verts[ 3*mv->v ], 3 * sizeof(float) );
+
+	if( mesh->n_uvs > 0 )
+		memcpy( &c.v[3], &mesh->uvs[ 2*mv->uv ], 2 * sizeof(float) );
+	else
+		c.v[3] = c.v[4] = 0.f;
+
+	if( mesh->n_normals > 0 )
+		memcpy( &c.v[5], &mesh->normals[ 3*mv->n ], 3 * sizeof(float) );
+	else {
+		c.v[5] = fn.x; c.v[6] = fn.y; c.v[7] = fn.z;
+	}
+
+	// -0 and 0 weld
+	for( int k=0; k<8; k++ )
+		c.v[k] += 0.f;
+
+	return c;
+
+}
+
+static bool same_corner( const Mesh_Indexed* out, uint32 i, const corner_t* c ) {
+
+	return 0 == memcmp( &out->verts[3*i],   &c->v[0], 3 * sizeof(float) )
+	    && 0 == memcmp( &out->uvs[2*i],     &c->v[3], 2 * sizeof(float) )
+	    && 0 == memcmp( &out->normals[3*i], &c->v[5], 3 * sizeof(float) );
+
+}
+
+Mesh_Indexed*          weld_Mesh( zone_p Z, const Mesh* mesh ) {
+
+	uint32 n_tris  = mesh->n_tris > 0 ? (uint32)mesh->n_tris : 0;
+	uint32 corners = 3 * n_tris;
+
+	Mesh_Indexed* out = zalloc( Z, sizeof(Mesh_Indexed) );
+
+	out->Z       = Z;
+	out->n_verts = 0;
+	out->verts   = zalloc( Z, (corners > 0 ? corners : 1) * 3 * sizeof(float) );
+	out->uvs     = zalloc( Z, (corners > 0 ? corners : 1) * 2 * sizeof(float) );
+	out->normals = zalloc( Z, (corners > 0 ? corners : 1) * 3 * sizeof(float) );
+	out->n_tris  = n_tris;
+	out->tris    = zalloc( Z, (corners > 0 ? corners : 1) * sizeof(uint32) );
+
+	// Open addressing, at most half full; slots hold vertex + 1
+	uint32 capacity = 16;
+	while( capacity < 2 * corners )
+		capacity *= 2;
+
+	uint32* slots = zalloc( Z, capacity * sizeof(uint32) );
+	memset( slots, 0, capacity * sizeof(uint32) );
+
+	for( uint32 t=0; t<n_tris; t++ ) {
+
+		float4 fn = mesh->n_normals > 0 ? (float4){ 0.f, 0.f, 0.f, 0.f } : face_normal( mesh, t );
+
+		for( int j=0; j<3; j++ ) {
+
+			corner_t c = get_corner( mesh, t, j, fn );
+			uint32   h = (uint32)hash64( c.v, sizeof(c.v), 0 ) & (capacity - 1);
+
+			while( slots[h] && !same_corner( out, slots[h] - 1, &c ) )
+				h = (h + 1) & (capacity - 1);
+
+			if( !slots[h] ) {
+
+				uint32 i = out->n_verts++;
+
+				memcpy( &out->verts[3*i],   &c.v[0], 3 * sizeof(float) );
+				memcpy( &out->uvs[2*i],     &c.v[3], 2 * sizeof(float) );
+				memcpy( &out->normals[3*i], &c.v[5], 3 * sizeof(float) );
+
+				slots[h] = i + 1;
+
+			}
+
+			out->tris[ 3*t + j ] = slots[h] - 1;
+
+		}
+	}
+
+	zfree( Z, slots );
+
+	// Give back what welding saved
+	if( out->n_verts > 0 && out->n_verts < corners ) {
+
+		out->verts   = zrealloc( Z, out->verts,   corners * 3 * sizeof(float), out->n_verts * 3 * sizeof(float) );
+		out->uvs     = zrealloc( Z, out->uvs,     corners * 2 * sizeof(float), out->n_verts * 2 * sizeof(float) );
+		out->normals = zrealloc( Z, out->normals, corners * 3 * sizeof(float), out->n_verts * 3 * sizeof(float) );
+
+	}
+
+	return out;
+
+}
+
+void         delete_Mesh_Indexed( Mesh_Indexed* mesh ) {
+
+	zfree( mesh->Z, mesh->verts );
+	zfree( mesh->Z, mesh->uvs );
+	zfree( mesh->Z, mesh->normals );
+	zfree( mesh->Z, mesh->tris );
+	zfree( mesh->Z, mesh );
+
+}
+
+Mesh_Indexed*      optimize_Mesh( zone_p Z, const Mesh* mesh, Mesh_Opt_Stats* stats ) {
+
+	Mesh_Indexed* out = weld_Mesh( Z, mesh );
+
+	if( stats ) {
+		stats->corners     = 3 * out->n_tris;
+		stats->verts       = out->n_verts;
+		stats->acmr_welded = acmr_Mesh_Indexed( out, meshoptCacheSize );
+	}
+
+	order_Mesh_Indexed_tris( out );
+	order_Mesh_Indexed_verts( out );
+
+	if( stats )
+		stats->acmr = acmr_Mesh_Indexed( out, meshoptCacheSize );
+
+	return out;
+
+}
+
+// Functions //////////////////////////////////////////////////////////////////
+
+float            acmr_Mesh_Indexed( const Mesh_Indexed* mesh, uint cache_size ) {
+
+	if( 0 == mesh->n_tris )
+		return 0.f;
+
+	// A vertex is in the FIFO while fewer than cache_size misses have
+	// happened since its own
+	uint32* stamp  = zalloc( mesh->Z, (mesh->n_verts > 0 ? mesh->n_verts : 1) * sizeof(uint32) );
+	uint32  misses = 0;
+
+	memset( stamp, 0, mesh->n_verts * sizeof(uint32) );
+
+	for( uint32 i=0; i<3*mesh->n_tris; i++ ) {
+
+		uint32 v = mesh->tris[i];
+		if( stamp[v] && misses - stamp[v] < cache_size )
+			continue;
+
+		stamp[v] = ++misses;
+
+	}
+
+	zfree( mesh->Z, stamp );
+
+	return (float)misses / mesh->n_tris;
+
+}
+
+// Ordering ///////////////////////////////////////////////////////////////////
+
+#define valenceTableSize 32
+
+static float cache_scores[ meshoptCacheSize ];
+static float valence_scores[ valenceTableSize ];
+
+static void init_scores( void ) {
+
+	// The last triangle's vertices score the same, so that the next
+	// triangle does not just depend on the order they came in
+	for( int i=0; i<meshoptCacheSize; i++ )
+		cache_scores[i] = i < 3 ? lastTriScore
+		                        : powf( 1.f - (float)(i - 3) / (meshoptCacheSize - 3), cacheDecayPower );
+
+	// Finish off vertices with few triangles left, rather than leave them
+	// to be transformed again later
+	valence_scores[0] = 0.f;
+	for( int i=1; i<valenceTableSize; i++ )
+		valence_scores[i] = valenceBoostScale * powf( (float)i, -valenceBoostPower );
+
+}
+
+static float vertex_score( int32 pos, uint32 valence ) {
+
+	if( 0 == valence )
+		return -1.f;
+
+	float score = pos >= 0 ? cache_scores[pos] : 0.f;
+
+	return score + ( valence < valenceTableSize ? valence_scores[valence]
+	                 : valenceBoostScale * powf( (float)valence, -valenceBoostPower ) );
+
+}
+
+void       order_Mesh_Indexed_tris( Mesh_Indexed* mesh ) {
+
+	zone_p Z = mesh->Z;
+	uint32 V = mesh->n_verts;
+	uint32 N = mesh->n_tris;
+
+	if( N < 2 )
+		return;
+
+	once( init_scores );
+
+	// The triangles of each vertex; the first live[v] of them are still to
+	// be emitted
+	uint32* first = zalloc( Z, (V + 1) * sizeof(uint32) );
+	uint32* live  = zalloc( Z, V * sizeof(uint32) );
+	uint32* adj   = zalloc( Z, 3 * N * sizeof(uint32) );
+
+	memset( live, 0, V * sizeof(uint32) );
+	for( uint32 i=0; i<3*N; i++ )
+		live[ mesh->tris[i] ]++;
+
+	first[0] = 0;
+	for( uint32 v=0; v<V; v++ )
+		first[v+1] = first[v] + live[v];
+
+	memset( live, 0, V * sizeof(uint32) );
+	for( uint32 i=0; i<3*N; i++ ) {
+		uint32 v = mesh->tris[i];
+		adj[ first[v] + live[v]++ ] = i / 3;
+	}
+
+	int32*  pos    = zalloc( Z, V * sizeof(int32) );
+	float*  vscore = zalloc( Z, V * sizeof(float) );
+	float*  tscore = zalloc( Z, N * sizeof(float) );
+	uint8*  added  = zalloc( Z, N );
+	uint32* out    = zalloc( Z, 3 * N * sizeof(uint32) );
+
+	for( uint32 v=0; v<V; v++ ) {
+		pos[v]    = -1;
+		vscore[v] = vertex_score( -1, live[v] );
+	}
+
+	for( uint32 t=0; t<N; t++ ) {
+		const uint32* tri = &mesh->tris[3*t];
+		tscore[t] = vscore[ tri[0] ] + vscore[ tri[1] ] + vscore[ tri[2] ];
+		added[t]  = 0;
+	}
+
+	// The cache as it was and as it will be, with room for a triangle more
+	uint32 cache[ meshoptCacheSize + 3 ], next[ meshoptCacheSize + 3 ];
+	uint32 n_cache = 0;
+
+	int64  best   = 0;
+	uint32 cursor = 0;     // No triangle before it is left
+
+	for( uint32 k=0; k<N; k++ ) {
+
+		// Nothing in the cache has triangles left; start anew at the first
+		// triangle not emitted
+		if( best < 0 ) {
+			while( added[cursor] )
+				cursor++;
+			best = cursor;
+		}
+
+		const uint32* tri = &mesh->tris[ 3*best ];
+
+		memcpy( &out[3*k], tri, 3 * sizeof(uint32) );
+		added[best] = 1;
+
+		// Its vertices lose a triangle
+		for( int j=0; j<3; j++ ) {
+
+			uint32  v = tri[j];
+			uint32* a = &adj[ first[v] ];
+
+			for( uint32 i=0; i<live[v]; i++ )
+				if( a[i] == (uint32)best ) {
+					a[i] = a[ live[v] - 1 ];
+					a[ live[v] - 1 ] = (uint32)best;
+					live[v]--;
+					break;
+				}
+
+		}
+
+		// Its vertices go to the front of the cache
+		uint32 n_next = 0;
+		for( int j=0; j<3; j++ ) {
+
+			// Degenerate triangles repeat vertices
+			uint32 i = 0;
+			while( i < n_next && next[i] != tri[j] )
+				i++;
+			if( i == n_next )
+				next[ n_next++ ] = tri[j];
+
+		}
+
+		for( uint32 i=0; i<n_cache; i++ ) {
+
+			uint32 v = cache[i];
+			if( v == tri[0] || v == tri[1] || v == tri[2] )
+				continue;
+			next[ n_next++ ] = v;
+
+		}
+
+		// Whatever falls off the end leaves the cache
+		for( uint32 i=meshoptCacheSize; i<n_next; i++ )
+			pos[ next[i] ] = -1;
+
+		for( uint32 i=0; i<n_next; i++ ) {
+
+			uint32 v = next[i];
+			if( i < meshoptCacheSize )
+				pos[v] = (int32)i;
+
+			float  s = vertex_score( pos[v], live[v] );
+			float  d = s - vscore[v];
+			vscore[v] = s;
+
+			const uint32* a = &adj[ first[v] ];
+			for( uint32 l=0; l<live[v]; l++ )
+				tscore[ a[l] ] += d;
+
+		}
+
+		n_cache = n_next < meshoptCacheSize ? n_next : meshoptCacheSize;
+		memcpy( cache, next, n_cache * sizeof(uint32) );
+
+		// The best of the triangles of the vertices in the cache
+		best = -1;
+		float best_score = -1.f;
+		for( uint32 i=0; i<n_cache; i++ ) {
+
+			uint32        v = cache[i];
+			const uint32* a = &adj[ first[v] ];
+
+			for( uint32 l=0; l<live[v]; l++ )
+				if( tscore[ a[l] ] > best_score ) {
+					best_score = tscore[ a[l] ];
+					best       = a[l];
+				}
+
+		}
+
+	}
+
+	memcpy( mesh->tris, out, 3 * N * sizeof(uint32) );
+
+	zfree( Z, out );
+	zfree( Z, added );
+	zfree( Z, tscore );
+	zfree( Z, vscore );
+	zfree( Z, pos );
+	zfree( Z, adj );
+	zfree( Z, live );
+	zfree( Z, first );
+
+}
+
+void      order_Mesh_Indexed_verts( Mesh_Indexed* mesh ) {
+
+	zone_p Z = mesh->Z;
+	uint32 V = mesh->n_verts;
+
+	if( 0 == V )
+		return;
+
+	uint32* remap = zalloc( Z, V * sizeof(uint32) );
+	memset( remap, 0xff, V * sizeof(uint32) );
+
+	uint32 n = 0;
+	for( uint32 i=0; i<3*mesh->n_tris; i++ ) {
+
+		uint32 v = mesh->tris[i];
+		if( 0xffffffff == remap[v] )
+			remap[v] = n++;
+		mesh->tris[i] = remap[v];
+
+	}
+
+	// Vertices no triangle uses go last
+	for( uint32 v=0; v<V; v++ )
+		if( 0xffffffff == remap[v] )
+			remap[v] = n++;
+
+	float* verts   = zalloc( Z, V * 3 * sizeof(float) );
+	float* uvs     = zalloc( Z, V * 2 * sizeof(float) );
+	float* normals = zalloc( Z, V * 3 * sizeof(float) );
+
+	for( uint32 v=0; v<V; v++ ) {
+
+		uint32 r = remap[v];
+
+		memcpy( &verts[3*r],   &mesh->verts[3*v],   3 * sizeof(float) );
+		memcpy( &uvs[2*r],     &mesh->uvs[2*v],     2 * sizeof(float) );
+		memcpy( &normals[3*r], &mesh->normals[3*v], 3 * sizeof(float) );
+
+	}
+
+	zfree( Z, mesh->verts );
+	zfree( Z, mesh->uvs );
+	zfree( Z, mesh->normals );
+	zfree( Z, remap );
+
+	mesh->verts   = verts;
+	mesh->uvs     = uvs;
+	mesh->normals = normals;
+
+}
+
+#ifdef __r_meshopt_TEST__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mm.heap.h"
+#include "time.core.h"
+
+// A side x side grid of quads in the xy plane, sharing positions, texcoords
+// and (if `with_normals') a normal, its triangles shuffled
+static Mesh* grid( int side, bool with_normals ) {
+
+	int n = side + 1;
+
+	Mesh* mesh = calloc( 1, sizeof(Mesh) );
+
+	mesh->n_verts   = n * n;
+	mesh->n_uvs     = n * n;
+	mesh->n_normals = with_normals ? 1 : 0;
+	mesh->n_tris    = 2 * side * side;
+
+	mesh->verts   = malloc( 3 * mesh->n_verts * sizeof(float) );
+	mesh->uvs     = malloc( 2 * mesh->n_uvs * sizeof(float) );
+	mesh->normals = malloc( 3 * sizeof(float) );
+	mesh->tris    = malloc( 3 * mesh->n_tris * sizeof(Mesh_Vertex) );
+
+	mesh->normals[0] = 0.f; mesh->normals[1] = 0.f; mesh->normals[2] = 1.f;
+
+	for( int y=0; y<n; y++ )
+		for( int x=0; x<n; x++ ) {
+			int i = y*n + x;
+			mesh->verts[3*i+0] = (float)x;
+			mesh->verts[3*i+1] = (float)y;
+			mesh->verts[3*i+2] = 0.f;
+			mesh->uvs[2*i+0]   = (float)x / side;
+			mesh->uvs[2*i+1]   = (float)y / side;
+		}
+
+	int t = 0;
+	for( int y=0; y<side; y++ )
+		for( int x=0; x<side; x++ ) {
+
+			int a = y*n + x, b = a + 1, c = a + n, d = c + 1;
+			int q[6] = { a, b, d, a, d, c };
+
+			for( int j=0; j<6; j++, t++ )
+				mesh->tris[t] = (Mesh_Vertex){ q[j], q[j], 0 };
+
+		}
+
+	// Shuffle whole triangles
+	for( int i=mesh->n_tris-1; i>0; i-- ) {
+
+		int j = rand() % (i + 1);
+		Mesh_Vertex tmp[3];
+
+		memcpy( tmp, &mesh->tris[3*i], sizeof(tmp) );
+		memcpy( &mesh->tris[3*i], &mesh->tris[3*j], sizeof(tmp) );
+		memcpy( &mesh->tris[3*j], tmp, sizeof(tmp) );
+
+	}
+
+	return mesh;
+
+}
+
+static void free_grid( Mesh* mesh ) {
+
+	free( mesh->verts ); free( mesh->uvs ); free( mesh->normals ); free( mesh->tris );
+	free( mesh );
+
+}
+
+// Triangles as the positions of their corners, starting at the least
+// corner so that rotations compare equal
+static uint64 tri_hash( const float* p0, const float* p1, const float* p2 ) {
+
+	const float* c[3] = { p0, p1, p2 };
+
+	int r = 0;
+	for( int j=1; j<3; j++ )
+		if( memcmp( c[j], c[r], 3 * sizeof(float) ) < 0 )
+			r = j;
+
+	float v[9];
+	for( int j=0; j<3; j++ )
+		memcpy( &v[3*j], c[ (r + j) % 3 ], 3 * sizeof(float) );
+
+	return hash64( v, sizeof(v), 0 );
+
+}
+
+static int compare_u64( const void* a, const void* b ) {
+
+	uint64 x = *(const uint64*)a, y = *(const uint64*)b;
+	return x < y ? -1 : x > y;
+
+}
+
+static void check_same_tris( const Mesh* mesh, const Mesh_Indexed* out ) {
+
+	uint32  N = out->n_tris;
+	uint64* a = malloc( N * sizeof(uint64) );
+	uint64* b = malloc( N * sizeof(uint64) );
+
+	assert( (int32)N == mesh->n_tris );
+
+	for( uint32 t=0; t<N; t++ ) {
+
+		a[t] = tri_hash( &mesh->verts[ 3*mesh->tris[3*t+0].v ],
+		                 &mesh->verts[ 3*mesh->tris[3*t+1].v ],
+		                 &mesh->verts[ 3*mesh->tris[3*t+2].v ] );
+		b[t] = tri_hash( &out->verts[ 3*out->tris[3*t+0] ],
+		                 &out->verts[ 3*out->tris[3*t+1] ],
+		                 &out->verts[ 3*out->tris[3*t+2] ] );
+
+	}
+
+	qsort( a, N, sizeof(uint64), compare_u64 );
+	qsort( b, N, sizeof(uint64), compare_u64 );
+	assert( 0 == memcmp( a, b, N * sizeof(uint64) ) );
+
+	free( a ); free( b );
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	const int side = argc > 1 ? (int)strtol( argv[1], NULL, 10 ) : 128;
+
+	for( int with_normals=1; with_normals>=0; with_normals-- ) {
+
+		Mesh* mesh = grid( side, with_normals );
+
+		// Welding leaves one vertex per grid point, the plane being flat
+		Mesh_Indexed* welded = weld_Mesh( ZONE_heap, mesh );
+		assert( welded->n_verts == (uint32)mesh->n_verts );
+		check_same_tris( mesh, welded );
+		for( uint32 v=0; v<welded->n_verts; v++ )
+			assert( fabsf( welded->normals[3*v+2] - 1.f ) < 1e-3f );
+		delete_Mesh_Indexed( welded );
+
+		Mesh_Opt_Stats stats;
+
+		usec_t timebase = microseconds();
+		Mesh_Indexed* opt = optimize_Mesh( ZONE_heap, mesh, &stats );
+		usec_t t_opt = microseconds() - timebase;
+
+		check_same_tris( mesh, opt );
+
+		// Vertices are numbered in the order they are first used
+		uint32 seen = 0;
+		for( uint32 i=0; i<3*opt->n_tris; i++ ) {
+			assert( opt->tris[i] <= seen );
+			if( opt->tris[i] == seen )
+				seen++;
+		}
+		assert( seen == opt->n_verts );
+
+		assert( stats.corners == 3 * (uint32)mesh->n_tris );
+		assert( stats.verts == (uint32)mesh->n_verts );
+		assert( stats.acmr_welded > 1.f );
+		assert( stats.acmr < 0.8f );
+
+		printf( "%s normals: %u tris, %u corners -> %u verts; ACMR %.3f -> %.3f; %.2f ms\n",
+		        with_normals ? "with" : "face",
+		        opt->n_tris, stats.corners, stats.verts,
+		        stats.acmr_welded, stats.acmr, t_opt / 1000.0 );
+
+		delete_Mesh_Indexed( opt );
+		free_grid( mesh );
+
+	}
+
+	// Corners that only share some values do not weld
+	{
+		float verts[] = { 0,0,0, 1,0,0, 0,1,0 };
+		float uvs[]   = { 0,0, 1,0, 0,1, 0.5f,0.5f };
+		float ns[]    = { 0,0,1 };
+
+		Mesh_Vertex tris[] = { {0,0,0}, {1,1,0}, {2,2,0},
+		                       {0,3,0}, {1,1,0}, {2,2,0} };
+
+		Mesh mesh = { 3, 4, 1, verts, uvs, ns, 2, tris };
+
+		Mesh_Indexed* m = weld_Mesh( ZONE_heap, &mesh );
+		assert( 4 == m->n_verts );
+		assert( m->tris[1] == m->tris[4] && m->tris[2] == m->tris[5] );
+		assert( m->tris[0] != m->tris[3] );
+		assert( 2.f == acmr_Mesh_Indexed( m, meshoptCacheSize ) );
+		delete_Mesh_Indexed( m );
+	}
+
+	printf("Ok\n");
+	return 0;
+
+}
+
+#endif
@@ -22,6 +22,11 @@ struct Scene {
 	region_p R;
 	Map     *buckets;
 
+	// World bounds of the buckets given them, by component
+	uint     n_bounds;
+	uint     bounds_capacity;
+	float   *bounds[6];
+
 };
 
 struct Bucket {
@@ -29,6 +34,8 @@ struct Bucket {
 	Vector   *visuals;
 	Visual   *freelist;
 
+	int32     slot;      // In the bounds, or -1
+
 };
 
 static const int hashSize   = 1024;
@@ -41,10 +48,93 @@ Scene*  new_Scene( region_p R ) {
 	sc->R       = R;
 	sc->buckets = new_Map( ZONE_heap, hashSize );
 
+	sc->n_bounds        = 0;
+	sc->bounds_capacity = 0;
+	for( int i=0; i<6; i++ )
+		sc->bounds[i] = NULL;
+
 	return sc;
 
 }
 
+static struct Bucket* get_bucket( Scene* sc, pointer tag ) {
+
+	struct Bucket* bucket = lookup_Map( sc->buckets, 
+	                                    sizeof( tag ),
+	                                    &tag );
+	if( NULL == bucket ) {
+
+		// Create a new bucket
+		bucket = ralloc( sc->R, sizeof(struct Bucket) );
+		
+		bucket->visuals  = new_Vector( ZONE_heap, sizeof(Visual), bucketSize );
+		bucket->freelist = NULL;
+		bucket->slot     = -1;
+
+		put_Map( sc->buckets, sizeof(tag), &tag, bucket );
+
+	}
+
+	return bucket;
+
+}
+
+// Classifies the bounds of every bucket that has them against `f', into
+// an array for the caller to free; the scene itself is left untouched, so
+// several passes may collect from it at once
+static int8* classify_bounds( const Scene* sc, const Frustum* f ) {
+
+	AABB_SoA boxes = {
+		sc->bounds[0], sc->bounds[1], sc->bounds[2],
+		sc->bounds[3], sc->bounds[4], sc->bounds[5]
+	};
+
+	int8* classes = zalloc( ZONE_heap, sc->n_bounds > 0 ? sc->n_bounds : 1 );
+	classify_Frustum( f, &boxes, 0, sc->n_bounds, classes );
+
+	return classes;
+
+}
+
+static inline bool visible_bucket( const int8* classes, const struct Bucket* bucket ) {
+
+	return bucket->slot < 0 || frustumOutside != classes[ bucket->slot ];
+
+}
+
+static void draw_bucket( struct Bucket* bucket, uint32 pass ) {
+
+	for( int i=0; i<size_Vector(bucket->visuals); i++ ) {
+
+		Visual* vis = (Visual*)nth_Vector( bucket->visuals, i );
+
+		// Does the visual participate in this pass?
+		if( !(vis->mask & pass) )
+			continue;
+
+		draw_Drawable( vis->draw, vis->argv );
+
+	}
+
+}
+
+static void collect_bucket( struct Bucket* bucket, uint32 pass, float z,
+                            Program* pgm, Shader_Arg* pgm_argv, Draw_List* list ) {
+
+	for( int i=0; i<size_Vector(bucket->visuals); i++ ) {
+
+		Visual* vis = (Visual*)nth_Vector( bucket->visuals, i );
+
+		// Unlinked visuals have no drawable
+		if( !(vis->mask & pass) || NULL == vis->draw )
+			continue;
+
+		push_Draw_List( list, pgm, pgm_argv, vis->draw, vis->argv, z );
+
+	}
+
+}
+
 void   draw_Scene( float t0, float t, float dt, Scene* sc, uint32 pass, predicate_f cull ) {
 
 	// 1. For each bucket
@@ -59,17 +149,117 @@ void   draw_Scene( float t0, float t, float dt, Scene* sc, uint32 pass, predicat
 			continue;
 
 		// 3. Render each drawable in the bucket
-		for( int i=0; i<size_Vector(bucket->visuals); i++ ) {
+		draw_bucket( bucket, pass );
 
-			Visual* vis = (Visual*)nth_Vector( bucket->visuals, i );
+	}
 
-			// Does the visual participate in this pass?
-			if( !(vis->mask & pass) )
-				continue;
+}
 
-			draw_Drawable( vis->draw, vis->argv );
+void collect_Scene( Scene       *sc,
+                    uint32       pass,
+                    predicate_f  cull,
+                    depth_f      depth,
+                    Program     *pgm,
+                    Shader_Arg  *pgm_argv,
+                    Draw_List   *list ) {
 
-		}
+	for( pointer kv=first_Map( sc->buckets );
+	     NULL != kv;
+	     kv = next_Map( sc->buckets, kv ) ) {
+
+		struct Bucket* bucket = (struct Bucket*)value_Map(kv);
+
+		if( cull( key_Map(kv) ) )
+			continue;
+
+		// The visuals of a bucket share its tag, and so its depth
+		float z = depth ? depth( key_Map(kv) ) : 0.f;
+
+		collect_bucket( bucket, pass, z, pgm, pgm_argv, list );
+
+	}
+
+}
+
+void    draw_Scene_frustum( float t0, float t, float dt,
+                            Scene* sc, uint32 pass, const Frustum* f ) {
+
+	int8* classes = classify_bounds( sc, f );
+
+	for( pointer kv=first_Map( sc->buckets );
+	     NULL != kv;
+	     kv = next_Map( sc->buckets, kv ) ) {
+
+		struct Bucket* bucket = (struct Bucket*)value_Map(kv);
+		if( visible_bucket( classes, bucket ) )
+			draw_bucket( bucket, pass );
+
+	}
+
+	zfree( ZONE_heap, classes );
+
+}
+
+void collect_Scene_frustum( Scene         *sc,
+                            uint32         pass,
+                            const Frustum *f,
+                            depth_f        depth,
+                            Program       *pgm,
+                            Shader_Arg    *pgm_argv,
+                            Draw_List     *list ) {
+
+	int8* classes = classify_bounds( sc, f );
+
+	for( pointer kv=first_Map( sc->buckets );
+	     NULL != kv;
+	     kv = next_Map( sc->buckets, kv ) ) {
+
+		struct Bucket* bucket = (struct Bucket*)value_Map(kv);
+		if( !visible_bucket( classes, bucket ) )
+			continue;
+
+		float z = depth ? depth( key_Map(kv) ) : 0.f;
+
+		collect_bucket( bucket, pass, z, pgm, pgm_argv, list );
+
+	}
+
+	zfree( ZONE_heap, classes );
+
+}
+
+void    draw_Scene_visible( float t0, float t, float dt,
+                            Scene* sc, uint32 pass,
+                            const pointer* tags, uint n ) {
+
+	for( uint i=0; i<n; i++ ) {
+
+		struct Bucket* bucket = lookup_Map( sc->buckets, sizeof(tags[i]), (pointer)&tags[i] );
+		if( bucket )
+			draw_bucket( bucket, pass );
+
+	}
+
+}
+
+void collect_Scene_visible( Scene       *sc,
+                            uint32       pass,
+                            const pointer* tags,
+                            uint         n,
+                            depth_f      depth,
+                            Program     *pgm,
+                            Shader_Arg  *pgm_argv,
+                            Draw_List   *list ) {
+
+	for( uint i=0; i<n; i++ ) {
+
+		struct Bucket* bucket = lookup_Map( sc->buckets, sizeof(tags[i]), (pointer)&tags[i] );
+		if( !bucket )
+			continue;
+
+		float z = depth ? depth( (pointer)&tags[i] ) : 0.f;
+
+		collect_bucket( bucket, pass, z, pgm, pgm_argv, list );
 
 	}
 
@@ -81,20 +271,7 @@ Visual* link_Scene( Scene*      sc,
                     Drawable*   dr, 
                     Shader_Arg* argv ) {
 
-	struct Bucket* bucket = lookup_Map( sc->buckets, 
-	                                    sizeof( tag ),
-	                                    &tag );
-	if( NULL == bucket ) {
-
-		// Create a new bucket
-		bucket = ralloc( sc->R, sizeof(struct Bucket) );
-		
-		bucket->visuals  = new_Vector( ZONE_heap, sizeof(Visual), bucketSize );
-		bucket->freelist = NULL;
-
-		put_Map( sc->buckets, sizeof(tag), &tag, bucket );
-
-	}
+	struct Bucket* bucket = get_bucket( sc, tag );
 
 	// Stick it in the bucket
 	Visual* vis = NULL;
@@ -116,6 +293,40 @@ Visual* link_Scene( Scene*      sc,
 
 }
 
+void   bound_Scene( Scene* sc, pointer tag, const AABB* bounds ) {
+
+	struct Bucket* bucket = get_bucket( sc, tag );
+
+	if( bucket->slot < 0 ) {
+
+		if( sc->n_bounds == sc->bounds_capacity ) {
+
+			uint old = sc->bounds_capacity;
+			uint n   = old > 0 ? 2*old : 64;
+
+			for( int i=0; i<6; i++ )
+				sc->bounds[i] = zrealloc( ZONE_heap, sc->bounds[i],
+				                          old * sizeof(float), n * sizeof(float) );
+
+			sc->bounds_capacity = n;
+
+		}
+
+		bucket->slot = sc->n_bounds++;
+
+	}
+
+	int32 i = bucket->slot;
+
+	sc->bounds[0][i] = bounds->mins.x;
+	sc->bounds[1][i] = bounds->mins.y;
+	sc->bounds[2][i] = bounds->mins.z;
+	sc->bounds[3][i] = bounds->maxs.x;
+	sc->bounds[4][i] = bounds->maxs.y;
+	sc->bounds[5][i] = bounds->maxs.z;
+
+}
+
 void unlink_Scene( Scene* sc, Visual* vis ) {
 
 	assert( NULL != sc && NULL != vis );
@@ -0,0 +1,527 @@
+#include <assert.h>
+#include <string.h>
+
+#include "job.control.h"
+#include "r.sched.h"
+#include "sync.condition.h"
+#include "sync.mutex.h"
+
+declare_job( int, rsched_prepare,
+
+             Rsched* sched;
+             uint    slot );
+
+typedef enum {
+
+	slotFree,
+	slotPreparing,
+	slotReady,
+	slotRendering
+
+} slotState_e;
+
+typedef struct Rsched_slot Rsched_slot;
+struct Rsched_slot {
+
+	slotState_e state;
+	int64       frame;
+	usec_t      started;       // When the update stage began
+
+	typeof_Job_params(rsched_prepare) params;
+
+};
+
+struct Rsched {
+
+	uint          depth;
+	pointer       snapshots[ rschedMaxDepth ];
+	Rsched_slot   slots[ rschedMaxDepth ];
+
+	rschedStage_f stages[ rschedStages ];
+	pointer       arg;
+	uint32        deadline;
+
+	int64         next_prepare;
+	int64         next_render;
+	int64         end;           // No frame from here on is rendered
+
+	bool          running;
+	bool          preparing;     // A prepare job is in flight
+
+	mutex_t       mutex;
+	condition_t   changed;
+
+	Rsched_stats  stats;
+	usec_t        presented;     // When the last frame was
+
+};
+
+static void record( Rsched_timing* t, usec_t dt ) {
+
+	t->count ++;
+	t->last   = dt;
+	t->total += dt;
+	if( dt > t->max )
+		t->max = dt;
+
+}
+
+// Runs `stage' of `frame', timing it into `dt'
+static bool run_stage( Rsched* sched, rschedStage_e stage, int64 frame,
+                       pointer snapshot, usec_t* dt ) {
+
+	if( !sched->stages[stage] ) {
+		*dt = 0;
+		return true;
+	}
+
+	usec_t t0 = microseconds();
+	bool   ok = sched->stages[stage]( sched->arg, frame, snapshot );
+	*dt = microseconds() - t0;
+
+	return ok;
+
+}
+
+// Starts preparing the next frame if its snapshot is free. Called with the
+// mutex held.
+static void try_prepare( Rsched* sched ) {
+
+	if( !sched->running || sched->preparing || sched->next_prepare >= sched->end )
+		return;
+
+	uint         i    = (uint)( sched->next_prepare % sched->depth );
+	Rsched_slot* slot = &sched->slots[i];
+
+	if( slotFree != slot->state )
+		return;
+
+	slot->state   = slotPreparing;
+	slot->frame   = sched->next_prepare ++;
+	slot->params  = (typeof_Job_params(rsched_prepare)){ sched, i };
+
+	sched->preparing = true;
+	submit_Job( sched->deadline, cpuBound, NULL, (jobfunc_f)rsched_prepare, &slot->params );
+
+}
+
+// Instantiation
+Rsched*       new_Rsched( region_p R,
+                          uint depth,
+                          pointer snapshots[],
+                          rschedStage_f stages[ rschedStages ],
+                          pointer arg,
+                          uint32 deadline ) {
+
+	assert( depth >= 1 && depth <= rschedMaxDepth );
+
+	Rsched* sched = ralloc( R, sizeof(Rsched) );
+	memset( sched, 0, sizeof(Rsched) );
+
+	sched->depth    = depth;
+	sched->arg      = arg;
+	sched->deadline = deadline;
+	sched->end      = INT64_MAX;
+
+	for( uint i=0; i<depth; i++ ) {
+		sched->snapshots[i]   = snapshots[i];
+		sched->slots[i].state = slotFree;
+	}
+
+	memcpy( sched->stages, stages, sizeof(sched->stages) );
+
+	init_MUTEX( &sched->mutex );
+	init_CONDITION( &sched->changed );
+
+	return sched;
+
+}
+
+void       delete_Rsched( Rsched* sched ) {
+
+	stop_Rsched( sched );
+
+	destroy_CONDITION( &sched->changed );
+	destroy_MUTEX( &sched->mutex );
+
+}
+
+void        start_Rsched( Rsched* sched ) {
+
+	lock_MUTEX( &sched->mutex );
+
+	sched->running = true;
+	try_prepare( sched );
+
+	unlock_MUTEX( &sched->mutex );
+
+}
+
+int64      render_Rsched( Rsched* sched ) {
+
+	usec_t t0 = microseconds();
+
+	lock_MUTEX( &sched->mutex );
+
+	Rsched_slot* slot = &sched->slots[ sched->next_render % sched->depth ];
+	while( true ) {
+
+		if( sched->next_render >= sched->end )
+			goto ended;
+		if( slotReady == slot->state )
+			break;
+		if( !sched->running && !sched->preparing )
+			goto ended;
+
+		wait_CONDITION( &sched->changed, &sched->mutex );
+
+	}
+
+	slot->state = slotRendering;
+	record( &sched->stats.waiting, microseconds() - t0 );
+
+	unlock_MUTEX( &sched->mutex );
+
+	// The snapshot is ours until the slot is freed
+	int64   frame    = slot->frame;
+	pointer snapshot = sched->snapshots[ frame % sched->depth ];
+	usec_t  dt[2];
+
+	bool ok = run_stage( sched, rschedRender, frame, snapshot, &dt[0] )
+	       && run_stage( sched, rschedPresent, frame, snapshot, &dt[1] );
+
+	usec_t now = microseconds();
+
+	lock_MUTEX( &sched->mutex );
+
+	if( ok ) {
+
+		record( &sched->stats.stages[rschedRender], dt[0] );
+		record( &sched->stats.stages[rschedPresent], dt[1] );
+		record( &sched->stats.latency, now - slot->started );
+		if( sched->presented )
+			record( &sched->stats.frame, now - sched->presented );
+		sched->presented = now;
+
+	} else if( sched->end > frame + 1 )
+		sched->end = frame + 1;
+
+	slot->state = slotFree;
+	sched->next_render ++;
+
+	try_prepare( sched );
+	broadcast_CONDITION( &sched->changed );
+
+	unlock_MUTEX( &sched->mutex );
+
+	return ok ? frame : -1;
+
+ended:
+	unlock_MUTEX( &sched->mutex );
+	return -1;
+
+}
+
+void         stop_Rsched( Rsched* sched ) {
+
+	lock_MUTEX( &sched->mutex );
+
+	sched->running = false;
+	while( sched->preparing )
+		wait_CONDITION( &sched->changed, &sched->mutex );
+
+	if( sched->end > sched->next_render )
+		sched->end = sched->next_render;
+
+	broadcast_CONDITION( &sched->changed );
+
+	unlock_MUTEX( &sched->mutex );
+
+}
+
+void        stats_Rsched( Rsched* sched, Rsched_stats* stats ) {
+
+	lock_MUTEX( &sched->mutex );
+	*stats = sched->stats;
+	unlock_MUTEX( &sched->mutex );
+
+}
+
+// Jobs ///////////////////////////////////////////////////////////////////////
+
+define_job( int, rsched_prepare,
+
+            uint32 unused ) {
+
+	begin_job;
+
+	Rsched*      sched    = arg(sched);
+	Rsched_slot* slot     = &sched->slots[ arg(slot) ];
+	pointer      snapshot = sched->snapshots[ arg(slot) ];
+	usec_t       dt[3]    = { 0, 0, 0 };
+
+	slot->started = microseconds();
+
+	bool ok = run_stage( sched, rschedUpdate, slot->frame, snapshot, &dt[0] )
+	       && run_stage( sched, rschedTransform, slot->frame, snapshot, &dt[1] )
+	       && run_stage( sched, rschedCull, slot->frame, snapshot, &dt[2] );
+
+	lock_MUTEX( &sched->mutex );
+
+	if( ok ) {
+
+		for( int i=rschedUpdate; i<=rschedCull; i++ )
+			record( &sched->stats.stages[i], dt[i] );
+		slot->state = slotReady;
+
+	} else {
+
+		// The frames before this one are all ready by now
+		slot->state = slotFree;
+		if( sched->end > slot->frame )
+			sched->end = slot->frame;
+
+	}
+
+	sched->preparing = false;
+
+	try_prepare( sched );
+	broadcast_CONDITION( &sched->changed );
+
+	unlock_MUTEX( &sched->mutex );
+
+	end_job;
+
+}
+
+#ifdef __r_sched_TEST__
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "sync.thread.h"
+
+#define N_VALUES 64
+
+// The state the prepare stages work on, and what they hand to rendering
+typedef struct {
+
+	int64 frame;
+	int32 values[ N_VALUES ];
+
+} World;
+
+typedef struct {
+
+	World         world;
+	int64         stop_at;      // update fails at this frame
+	usec_t        sleep[ rschedStages ];
+
+	volatile int  in_flight;    // Updated but not yet presented
+	volatile int  max_in_flight;
+	int64         rendered;     // The next frame expected by render
+
+} Test;
+
+static void busy( const Test* t, rschedStage_e stage ) {
+
+	if( t->sleep[stage] )
+		sleep_THREAD( t->sleep[stage] );
+
+}
+
+static bool update( pointer arg, int64 frame, pointer snapshot ) {
+
+	Test* t = arg;
+
+	if( frame == t->stop_at )
+		return false;
+
+	int n = __sync_add_and_fetch( &t->in_flight, 1 );
+	if( n > t->max_in_flight )
+		t->max_in_flight = n;
+
+	// Only ever touched by one prepare job at a time, in frame order
+	assert( t->world.frame == frame );
+	t->world.frame = frame + 1;
+	for( int i=0; i<N_VALUES; i++ )
+		t->world.values[i] = (int32)( frame * N_VALUES + i );
+
+	busy( t, rschedUpdate );
+	return true;
+
+}
+
+static bool transform( pointer arg, int64 frame, pointer snapshot ) {
+
+	Test* t = arg;
+
+	for( int i=0; i<N_VALUES; i++ )
+		t->world.values[i] *= 2;
+
+	busy( t, rschedTransform );
+	return true;
+
+}
+
+static bool cull( pointer arg, int64 frame, pointer snapshot ) {
+
+	Test*  t = arg;
+	World* s = snapshot;
+
+	s->frame = frame;
+	memcpy( s->values, t->world.values, sizeof(s->values) );
+
+	busy( t, rschedCull );
+	return true;
+
+}
+
+static bool render( pointer arg, int64 frame, pointer snapshot ) {
+
+	Test*        t = arg;
+	const World* s = snapshot;
+
+	assert( frame == t->rendered );
+	assert( s->frame == frame );
+
+	busy( t, rschedRender );
+
+	// Still intact, though the next frames are being prepared meanwhile
+	for( int i=0; i<N_VALUES; i++ )
+		assert( s->values[i] == (int32)( 2 * ( frame * N_VALUES + i ) ) );
+
+	return true;
+
+}
+
+static bool present( pointer arg, int64 frame, pointer snapshot ) {
+
+	Test* t = arg;
+
+	busy( t, rschedPresent );
+
+	t->rendered = frame + 1;
+	__sync_sub_and_fetch( &t->in_flight, 1 );
+
+	return true;
+
+}
+
+static rschedStage_f stages[ rschedStages ] = {
+	update, transform, cull, render, present
+};
+
+static const char* names[ rschedStages ] = {
+	"update", "transform", "cull", "render", "present"
+};
+
+// Runs the pipeline until update fails at `stop_at', returns the time taken
+static usec_t run( uint depth, int64 stop_at, const usec_t sleep[ rschedStages ],
+                   Rsched_stats* stats ) {
+
+	region_p R = region( "r.sched.test" );
+
+	Test    t;
+	World   snap[ rschedMaxDepth ];
+	pointer snapshots[ rschedMaxDepth ];
+
+	memset( &t, 0, sizeof(t) );
+	t.stop_at = stop_at;
+	memcpy( t.sleep, sleep, sizeof(t.sleep) );
+
+	for( uint i=0; i<depth; i++ )
+		snapshots[i] = &snap[i];
+
+	Rsched* sched = new_Rsched( R, depth, snapshots, stages, &t, 1 );
+
+	usec_t t0 = microseconds();
+	start_Rsched( sched );
+
+	int64 frame, expect = 0;
+	while( -1 != (frame = render_Rsched( sched )) )
+		assert( frame == expect++ );
+
+	usec_t elapsed = microseconds() - t0;
+
+	assert( expect == stop_at );
+	assert( t.rendered == stop_at );
+	assert( t.max_in_flight >= 1 && t.max_in_flight <= (int)depth );
+
+	stats_Rsched( sched, stats );
+	assert( stats->stages[rschedUpdate].count == (uint64)stop_at );
+	assert( stats->stages[rschedPresent].count == (uint64)stop_at );
+
+	delete_Rsched( sched );
+	rfree( R );
+
+	return elapsed;
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	init_Jobs( (int)sysconf( _SC_NPROCESSORS_ONLN ) );
+
+	Rsched_stats stats;
+
+	// As fast as it goes, at every depth
+	const usec_t none[ rschedStages ] = { 0 };
+	for( uint depth=1; depth<=rschedMaxDepth; depth++ )
+		run( depth, 1000, none, &stats );
+
+	// Preparing and rendering take as long as each other; they overlap from
+	// a depth of 2 on, the frame taking half as long
+	const usec_t sleep[ rschedStages ] = { 2000, 1000, 1000, 3000, 1000 };
+	const int64  frames = 50;
+
+	usec_t elapsed[ rschedMaxDepth + 1 ];
+	for( uint depth=1; depth<=3; depth++ ) {
+
+		elapsed[depth] = run( depth, frames, sleep, &stats );
+
+		printf( "depth %u: %6.2f ms/frame, latency %6.2f ms, waiting %6.2f ms\n", depth,
+		        elapsed[depth] / 1000. / frames,
+		        stats.latency.total / 1000. / stats.latency.count,
+		        stats.waiting.total / 1000. / stats.waiting.count );
+
+		for( int i=0; i<rschedStages; i++ )
+			printf( "  %-10s %6.2f ms avg, %6.2f ms max\n", names[i],
+			        stats.stages[i].total / 1000. / stats.stages[i].count,
+			        stats.stages[i].max / 1000. );
+
+	}
+
+	assert( elapsed[2] < elapsed[1] * 3 / 4 );
+
+	// Stopping mid-way drops whatever was prepared
+	{
+		region_p R = region( "r.sched.test" );
+		Test     t;
+		World    snap[2];
+		pointer  snapshots[2] = { &snap[0], &snap[1] };
+
+		memset( &t, 0, sizeof(t) );
+		t.stop_at = -1;
+
+		Rsched* sched = new_Rsched( R, 2, snapshots, stages, &t, 1 );
+		start_Rsched( sched );
+
+		for( int64 i=0; i<10; i++ )
+			assert( i == render_Rsched( sched ) );
+
+		stop_Rsched( sched );
+		assert( -1 == render_Rsched( sched ) );
+
+		delete_Rsched( sched );
+		rfree( R );
+	}
+
+	shutdown_Jobs();
+
+	printf("Ok\n");
+	return 0;
+
+}
+
+#endif
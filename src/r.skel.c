@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "control.maybe.h"
@@ -210,6 +211,178 @@ pointer      *read_Skel( FILE *inp ) {
 
 }
 
+// Packed, every array is a section and every pointer an index: into the
+// joints, into the mesh's own weights, or into the sections holding all
+// the meshes' vertices, weights, triangles and strings. Parents are stored
+// one up, so that 0 is none. Mapping turns the indices back into pointers
+// in place, which copies the pages of joints, meshes, vertices and weights
+// but leaves the triangles as they were mapped. Structures are filled in
+// field by field, never copied whole, so their padding packs as zeroes.
+
+#define as_index(p)      ( (uintptr_t)(p) )
+#define from_index(T, i) ( (T)(uintptr_t)(i) )
+
+void          pack_Skel( pointer res, Res_Pack *pack ) {
+
+	Skeleton *skel = (Skeleton*)res;
+
+	uint64 n_verts = 0, n_weights = 0, n_tris = 0, n_chars = 0;
+	for( uint32 i=0; i<skel->n_joints; i++ )
+		n_chars += strlen( skel->joints[i].name ) + 1;
+	for( uint32 i=0; i<skel->n_meshes; i++ ) {
+		n_verts   += skel->meshes[i].n_verts;
+		n_weights += skel->meshes[i].n_weights;
+		n_tris    += skel->meshes[i].n_tris;
+		n_chars   += strlen( skel->meshes[i].shader ) + 1;
+	}
+
+	Skeleton    *head    = add_Res_Pack( pack, "skel", sizeof(Skeleton), 1, NULL );
+	Skel_Joint  *joints  = add_Res_Pack( pack, "join", sizeof(Skel_Joint), skel->n_joints, NULL );
+	Skel_Mesh   *meshes  = add_Res_Pack( pack, "mesh", sizeof(Skel_Mesh), skel->n_meshes, NULL );
+	Skel_Vertex *verts   = add_Res_Pack( pack, "vert", sizeof(Skel_Vertex), n_verts, NULL );
+	Skel_Weight *weights = add_Res_Pack( pack, "wght", sizeof(Skel_Weight), n_weights, NULL );
+	uint32_t    *tris    = add_Res_Pack( pack, "tris", 3 * sizeof(uint32_t), n_tris, NULL );
+	char        *strs    = add_Res_Pack( pack, "strs", 1, n_chars, NULL );
+
+	head->n_joints = skel->n_joints;
+	head->n_meshes = skel->n_meshes;
+
+	uint64 chars = 0;
+
+	for( uint32 i=0; i<skel->n_joints; i++ ) {
+
+		const Skel_Joint *joint = &skel->joints[i];
+
+		joints[i].name   = from_index( const char*, chars );
+		joints[i].parent = from_index( Skel_Joint*, joint->parent ? joint->parent - skel->joints + 1 : 0 );
+		joints[i].p      = joint->p;
+		joints[i].qr     = joint->qr;
+
+		strcpy( strs + chars, joint->name );
+		chars += strlen( joint->name ) + 1;
+
+	}
+
+	uint64 vert = 0, weight = 0, tri = 0;
+
+	for( uint32 i=0; i<skel->n_meshes; i++ ) {
+
+		const Skel_Mesh *mesh = &skel->meshes[i];
+
+		meshes[i].shader    = from_index( const char*, chars );
+		meshes[i].n_verts   = mesh->n_verts;
+		meshes[i].n_weights = mesh->n_weights;
+		meshes[i].n_tris    = mesh->n_tris;
+		meshes[i].verts   = from_index( Skel_Vertex*, vert );
+		meshes[i].weights = from_index( Skel_Weight*, weight );
+		meshes[i].tris    = from_index( uint32_t*, tri );
+
+		strcpy( strs + chars, mesh->shader );
+		chars += strlen( mesh->shader ) + 1;
+
+		for( uint32 j=0; j<mesh->n_verts; j++, vert++ ) {
+			verts[vert].s       = mesh->verts[j].s;
+			verts[vert].t       = mesh->verts[j].t;
+			verts[vert].count   = mesh->verts[j].count;
+			verts[vert].weights = from_index( Skel_Weight*, mesh->verts[j].weights - mesh->weights );
+		}
+
+		for( uint32 j=0; j<mesh->n_weights; j++, weight++ ) {
+			weights[weight].bias  = mesh->weights[j].bias;
+			weights[weight].pos   = mesh->weights[j].pos;
+			weights[weight].joint = from_index( Skel_Joint*, mesh->weights[j].joint - skel->joints );
+		}
+
+		memcpy( tris + 3*tri, mesh->tris, 3 * sizeof(uint32_t) * mesh->n_tris );
+		tri += mesh->n_tris;
+
+	}
+
+}
+
+pointer        map_Skel( const Res_Map *map ) {
+
+	uint64 n_skel, n_joints, n_meshes, n_verts, n_weights, n_tris, n_chars;
+
+	Skeleton    *skel    = section_Res_Map( map, "skel", sizeof(Skeleton), &n_skel );
+	Skel_Joint  *joints  = section_Res_Map( map, "join", sizeof(Skel_Joint), &n_joints );
+	Skel_Mesh   *meshes  = section_Res_Map( map, "mesh", sizeof(Skel_Mesh), &n_meshes );
+	Skel_Vertex *verts   = section_Res_Map( map, "vert", sizeof(Skel_Vertex), &n_verts );
+	Skel_Weight *weights = section_Res_Map( map, "wght", sizeof(Skel_Weight), &n_weights );
+	uint32_t    *tris    = section_Res_Map( map, "tris", 3 * sizeof(uint32_t), &n_tris );
+	char        *strs    = section_Res_Map( map, "strs", 1, &n_chars );
+
+	if( !skel || !joints || !meshes || !verts || !weights || !tris || !strs
+	    || 1 != n_skel || n_joints != skel->n_joints || n_meshes != skel->n_meshes
+	    || ( n_chars > 0 && '\0' != strs[ n_chars - 1 ] ) ) {
+		error0( "Mapped skeleton is missing arrays, or they are the wrong size" );
+		return NULL;
+	}
+
+	skel->joints = joints;
+	skel->meshes = meshes;
+
+	for( uint32 i=0; i<skel->n_joints; i++ ) {
+
+		Skel_Joint *joint  = &joints[i];
+		uintptr_t   name   = as_index( joint->name );
+		uintptr_t   parent = as_index( joint->parent );
+
+		assert( name < n_chars );
+		assert( parent <= skel->n_joints );
+
+		joint->name   = strs + name;
+		joint->parent = parent ? &joints[ parent - 1 ] : NULL;
+
+	}
+
+	for( uint32 i=0; i<skel->n_meshes; i++ ) {
+
+		Skel_Mesh *mesh   = &meshes[i];
+		uintptr_t  shader = as_index( mesh->shader );
+		uintptr_t  vert   = as_index( mesh->verts );
+		uintptr_t  weight = as_index( mesh->weights );
+		uintptr_t  tri    = as_index( mesh->tris );
+
+		assert( shader < n_chars );
+		assert( vert + mesh->n_verts <= n_verts );
+		assert( weight + mesh->n_weights <= n_weights );
+		assert( tri + mesh->n_tris <= n_tris );
+
+		mesh->shader  = strs + shader;
+		mesh->verts   = &verts[ vert ];
+		mesh->weights = &weights[ weight ];
+		mesh->tris    = &tris[ 3*tri ];
+
+		for( uint32 j=0; j<mesh->n_verts; j++ ) {
+
+			Skel_Vertex *v     = &mesh->verts[j];
+			uintptr_t    first = as_index( v->weights );
+
+			assert( first + v->count <= mesh->n_weights );
+			v->weights = &mesh->weights[ first ];
+
+		}
+
+		for( uint32 j=0; j<mesh->n_weights; j++ ) {
+
+			Skel_Weight *w     = &mesh->weights[j];
+			uintptr_t    joint = as_index( w->joint );
+
+			assert( joint < skel->n_joints );
+			w->joint = &joints[ joint ];
+
+		}
+
+	}
+
+	info0( "Mapped skeleton:" );
+	dump_Skel_info( skel );
+
+	return (pointer)skel;
+
+}
+
 void          dump_Skel_info( Skeleton *skel ) {
 
 	info( "\t# joints : %u", skel->n_joints );
@@ -240,44 +413,34 @@ void          dump_Skel_info( Skeleton *skel ) {
 
 Drawable* drawable_Skel( region_p R, Skeleton *skel, int which_mesh ) {
 
-	// Attribs:
+	Vformat fmt = define_Vformat( vposFloat, vuvFloat, vnormalFloat );
+	return drawable_Skel_as( R, skel, which_mesh, &fmt );
+
+}
+
+Drawable* drawable_Skel_as( region_p R, Skeleton *skel, int which_mesh, Vformat *fmt ) {
+
+	// Attribs, interleaved as `fmt' lays them out:
 	//  0 pos:    x, y, z
 	//  1 uv:     s, t
 	//  2 normal: nx, ny, nz
-	Vattrib* verts   = new_Vattrib( "pos",       3, GL_FLOAT, GL_FALSE );
-	Vattrib* texcs   = maybe( verts, == NULL, 
-	                          new_Vattrib( "uv", 2, GL_FLOAT, GL_FALSE ) );
-	Vattrib* normals = maybe( texcs, == NULL, 
-	                          new_Vattrib( "N",  3, GL_FLOAT, GL_FALSE ) );
-	Vindex*  tris    = maybe( (Vindex*)normals, == NULL, 
-	                          new_Vindex( GL_UNSIGNED_INT ) );
-
-	if( !tris ) {
-
-		maybe( verts, == NULL, delete_Vattrib(verts) );
-		maybe( texcs, == NULL, delete_Vattrib(texcs) );
-		maybe( normals, == NULL, delete_Vattrib(normals) );
-		maybe( tris, == NULL, delete_Vindex(tris) );
-		return NULL;
-
-	}
-
 	Skel_Mesh *mesh = &skel->meshes[which_mesh];
 
-	float*  vp = alloc_Vattrib( verts, staticDraw, mesh->n_verts );
-	float*  tp = maybe( vp, == NULL, 
-	                    alloc_Vattrib( texcs, staticDraw, mesh->n_verts ) );
-	float*  np = maybe( tp, == NULL, 
-	                    alloc_Vattrib( normals, staticDraw, mesh->n_verts ) );
-	uint* trip = maybe( (uint*)np, == NULL, 
-	                    alloc_Vindex( tris, staticDraw, 3 * mesh->n_tris ) );
+	Vindex* tris = new_Vindex( GL_UNSIGNED_INT );
+	uint*   trip = maybe( (uint*)tris, == NULL, 
+	                      alloc_Vindex( tris, staticDraw, 3 * mesh->n_tris ) );
+
+	// Computed here, then encoded
+	float*  vp   = malloc( 3 * sizeof(float) * mesh->n_verts );
+	float*  tp   = malloc( 2 * sizeof(float) * mesh->n_verts );
+	float*  np   = malloc( 3 * sizeof(float) * mesh->n_verts );
 	
 	if( !vp || !tp || !np || !trip ) {
 
-		delete_Vattrib(verts);
-		delete_Vattrib(texcs);
-		delete_Vattrib(normals);
-		delete_Vindex(tris);
+		free( vp );
+		free( tp );
+		free( np );
+		maybe( tris, == NULL, delete_Vindex(tris) );
 
 		return NULL;
 	}
@@ -361,17 +524,44 @@ Drawable* drawable_Skel( region_p R, Skeleton *skel, int which_mesh ) {
 
 	}
 
+	AABB bounds = { { 0.f, 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f, 0.f } };
+	for( int i=0; i<mesh->n_verts; i++ ) {
+
+		float4 p = { vp[ 3*i + 0 ], vp[ 3*i + 1 ], vp[ 3*i + 2 ], 0.f };
+		if( 0 == i )
+			bounds.mins = bounds.maxs = p;
+		else
+			expand_AABB( &bounds, p );
+
+	}
+
+	fit_Vformat( fmt, &bounds, mesh->n_verts, tp );
+
+	pointer data = malloc( (size_t)mesh->n_verts * fmt->stride );
+	if( data )
+		encode_Vformat( fmt, mesh->n_verts, vp, tp, np, data );
+
+	free( vp );
+	free( tp );
+	free( np );
+
 	// Flush to VRAM
-	flush_Vattrib( verts );
-	flush_Vattrib( texcs );
-	flush_Vattrib( normals );
 	flush_Vindex( tris );
 
+	Varray* varray = maybe( (Varray*)data, == NULL,
+	                        new_Varray_Vformat( fmt, mesh->n_verts, data, tris ) );
+	free( data );
+
+	if( !varray ) {
+		delete_Vindex( tris );
+		return NULL;
+	}
+
 	// Package it all up
 	return new_Drawable_indexed( R,
 	                             3 * mesh->n_tris,
 	                             tris, 
-	                             define_Varray( 3, verts, texcs, normals ),
+	                             varray,
 	                             drawTris );
 
 }
@@ -0,0 +1,685 @@
+#include <assert.h>
+#include <string.h>
+
+#include "control.maybe.h"
+#include "core.features.h"
+#include "job.control.h"
+#include "mm.heap.h"
+#include "r.skin.h"
+
+declare_job( int, skin_chunk,
+
+             const Skin*  skin;
+             const mat44* palette;
+             uint32       first;
+             uint32       n;
+             float*       verts;
+             float*       normals );
+
+struct Skin_Chunk {
+
+	typeof_Job_params(skin_chunk) params;
+
+};
+
+// Bind-pose normals, averaged over the faces around each vertex
+static void bind_normals( const Skel_Mesh* mesh, const float4* pos, float4* N ) {
+
+	memset( N, 0, mesh->n_verts * sizeof(float4) );
+
+	for( uint32 i=0; i<mesh->n_tris; i++ ) {
+
+		uint32 ia = mesh->tris[ 3*i + 0 ];
+		uint32 ib = mesh->tris[ 3*i + 1 ];
+		uint32 ic = mesh->tris[ 3*i + 2 ];
+
+		// Same winding as drawable_Skel
+		float4 n = vcross( vsub( pos[ic], pos[ia] ), vsub( pos[ic], pos[ib] ) );
+
+		N[ia] = vadd( N[ia], n );
+		N[ib] = vadd( N[ib], n );
+		N[ic] = vadd( N[ic], n );
+
+	}
+
+	for( uint32 i=0; i<mesh->n_verts; i++ )
+		N[i] = vlength2( N[i] ) > 0.f ? vnormal( N[i] ) : (float4){ 0.f, 0.f, 0.f, 0.f };
+
+}
+
+// Bind-pose positions and normals of every vertex, from its weights
+static void bind_pose( const Skel_Mesh* mesh, float4* pos, float4* N ) {
+
+	for( uint32 i=0; i<mesh->n_verts; i++ ) {
+
+		const Skel_Vertex* vert = &mesh->verts[i];
+
+		pos[i] = (float4){ 0.f, 0.f, 0.f, 0.f };
+		for( uint32 j=0; j<vert->count; j++ ) {
+
+			const Skel_Weight* wgt   = &vert->weights[j];
+			const Skel_Joint*  joint = wgt->joint;
+
+			float4 wv = vadd( joint->p, qrot( joint->qr, wgt->pos ) );
+			pos[i] = vadd( pos[i], vscale( wgt->bias, wv ) );
+
+		}
+
+	}
+
+	bind_normals( mesh, pos, N );
+
+}
+
+// Instantiation
+Skin*            new_Skin( region_p R, const Skeleton* skel, int which_mesh ) {
+
+	assert( which_mesh >= 0 && (uint32)which_mesh < skel->n_meshes );
+
+	const Skel_Mesh* mesh = &skel->meshes[ which_mesh ];
+
+	Skin* skin = ralloc( R, sizeof(Skin) );
+
+	skin->R         = R;
+	skin->skel      = skel;
+	skin->mesh      = mesh;
+	skin->n_joints  = skel->n_joints;
+	skin->n_verts   = mesh->n_verts;
+
+	skin->n_weights = 0;
+	for( uint32 i=0; i<mesh->n_verts; i++ )
+		skin->n_weights += mesh->verts[i].count;
+
+	skin->first   = ralloc( R, (skin->n_verts + 1) * sizeof(uint32) );
+	skin->joint   = ralloc( R, skin->n_weights * sizeof(uint32) );
+	skin->weights = ralloc( R, skin->n_weights * sizeof(Skin_Weight) );
+
+	skin->n_chunks = (skin->n_verts + skinChunkSize - 1) / skinChunkSize;
+	skin->chunks   = ralloc( R, (skin->n_chunks > 0 ? skin->n_chunks : 1) * sizeof(Skin_Chunk) );
+
+	init_Job_Latch( &skin->pending );
+
+	skin->verts   = NULL;
+	skin->normals = NULL;
+
+	// The bind pose, to find the normals in
+	float4* pos = zalloc( ZONE_heap, 2 * mesh->n_verts * sizeof(float4) );
+	float4* N   = pos + mesh->n_verts;
+
+	bind_pose( mesh, pos, N );
+
+	// Flatten the weights, in vertex order
+	uint32 k = 0;
+	for( uint32 i=0; i<mesh->n_verts; i++ ) {
+
+		const Skel_Vertex* vert = &mesh->verts[i];
+
+		skin->first[i] = k;
+		for( uint32 j=0; j<vert->count; j++, k++ ) {
+
+			const Skel_Weight* wgt   = &vert->weights[j];
+			const Skel_Joint*  joint = wgt->joint;
+
+			float4 n = qrot( qconj( joint->qr ), (float4){ N[i].x, N[i].y, N[i].z, 0.f } );
+
+			skin->joint[k] = (uint32)( joint - skel->joints );
+			skin->weights[k].pos    = (float4){ wgt->bias * wgt->pos.x,
+			                                    wgt->bias * wgt->pos.y,
+			                                    wgt->bias * wgt->pos.z,
+			                                    wgt->bias };
+			skin->weights[k].normal = (float4){ wgt->bias * n.x,
+			                                    wgt->bias * n.y,
+			                                    wgt->bias * n.z,
+			                                    0.f };
+
+		}
+
+	}
+	skin->first[ mesh->n_verts ] = k;
+
+	zfree( ZONE_heap, pos );
+
+	return skin;
+
+}
+
+void          delete_Skin( Skin* skin ) {
+
+	maybe( skin->verts, == NULL, delete_Vattrib( skin->verts ) );
+	maybe( skin->normals, == NULL, delete_Vattrib( skin->normals ) );
+
+	skin->verts = skin->normals = NULL;
+
+	destroy_Job_Latch( &skin->pending );
+
+}
+
+// Palette ////////////////////////////////////////////////////////////////////
+
+void         palette_Skin( mat44* palette, const Skel_Joint* joints, uint32 n ) {
+
+	for( uint32 i=0; i<n; i++ ) {
+
+		palette[i]    = qmatrix( joints[i].qr );
+		palette[i]._4 = (float4){ joints[i].p.x, joints[i].p.y, joints[i].p.z, 1.f };
+
+	}
+
+}
+
+// Evaluation /////////////////////////////////////////////////////////////////
+
+static inline void store3( float* dst, float4 v ) {
+
+	dst[0] = v.x;
+	dst[1] = v.y;
+	dst[2] = v.z;
+
+}
+
+#if defined(feature_SSE2)
+
+// Writes x, y and z of `v' only; the destination is packed 3 floats apart
+static inline void store3_SSE( float* dst, __m128 v ) {
+
+	_mm_storel_pi( (__m64*)dst, v );
+	_mm_store_ss( dst + 2, _mm_movehl_ps( v, v ) );
+
+}
+
+static inline __m128 normalize_SSE( __m128 v ) {
+
+	__m128 d = _mm_mul_ps( v, v );
+	d = _mm_add_ps( d, _mm_shuffle_ps( d, d, _MM_SHUFFLE(2,3,0,1) ) );
+	d = _mm_add_ps( d, _mm_shuffle_ps( d, d, _MM_SHUFFLE(1,0,3,2) ) );
+
+	// Leave a zero normal alone
+	__m128 nz = _mm_cmpgt_ps( d, _mm_setzero_ps() );
+	return _mm_and_ps( nz, _mm_div_ps( v, _mm_sqrt_ps( d ) ) );
+
+}
+
+#endif
+
+void            eval_Skin( const Skin* skin, const mat44* palette,
+                           uint32 first, uint32 n,
+                           float* verts, float* normals ) {
+
+	assert( first + n <= skin->n_verts );
+
+	const uint32*      joint   = skin->joint;
+	const Skin_Weight* weights = skin->weights;
+
+	for( uint32 v=0; v<n; v++ ) {
+
+		uint32 begin = skin->first[ first + v ];
+		uint32 end   = skin->first[ first + v + 1 ];
+
+#if defined(feature_AVX)
+
+		// Position in the low lane and normal in the high lane; the normal
+		// has w = 0, so the translation drops out of it. Regions only align
+		// to 16 bytes, so a weight may straddle a 32 byte boundary
+		__m256 acc = _mm256_setzero_ps();
+		for( uint32 k=begin; k<end; k++ ) {
+
+			const mat44* M = &palette[ joint[k] ];
+			__m256 w = _mm256_loadu_ps( &weights[k].pos.x );
+
+			__m256 p = _mm256_mul_ps( _mm256_broadcast_ps( (const __m128*)&M->_1 ),
+			                          _mm256_permute_ps( w, _MM_SHUFFLE(0,0,0,0) ) );
+			p = _mm256_add_ps( p, _mm256_mul_ps( _mm256_broadcast_ps( (const __m128*)&M->_2 ),
+			                                     _mm256_permute_ps( w, _MM_SHUFFLE(1,1,1,1) ) ) );
+			p = _mm256_add_ps( p, _mm256_mul_ps( _mm256_broadcast_ps( (const __m128*)&M->_3 ),
+			                                     _mm256_permute_ps( w, _MM_SHUFFLE(2,2,2,2) ) ) );
+			p = _mm256_add_ps( p, _mm256_mul_ps( _mm256_broadcast_ps( (const __m128*)&M->_4 ),
+			                                     _mm256_permute_ps( w, _MM_SHUFFLE(3,3,3,3) ) ) );
+
+			acc = _mm256_add_ps( acc, p );
+
+		}
+
+		store3_SSE( verts   + 3*v, _mm256_castps256_ps128( acc ) );
+		store3_SSE( normals + 3*v, normalize_SSE( _mm256_extractf128_ps( acc, 1 ) ) );
+
+#elif defined(feature_SSE2)
+
+		__m128 p = _mm_setzero_ps();
+		__m128 N = _mm_setzero_ps();
+		for( uint32 k=begin; k<end; k++ ) {
+
+			const mat44* M = &palette[ joint[k] ];
+
+			p = _mm_add_ps( p, mtransform_SSE( M, _mm_load_ps( &weights[k].pos.x ) ) );
+			N = _mm_add_ps( N, mtransform_SSE( M, _mm_load_ps( &weights[k].normal.x ) ) );
+
+		}
+
+		store3_SSE( verts   + 3*v, p );
+		store3_SSE( normals + 3*v, normalize_SSE( N ) );
+
+#else
+
+		float4 p = { 0.f, 0.f, 0.f, 0.f };
+		float4 N = { 0.f, 0.f, 0.f, 0.f };
+		for( uint32 k=begin; k<end; k++ ) {
+
+			const mat44* M = &palette[ joint[k] ];
+
+			p = vadd( p, mtransform( *M, weights[k].pos ) );
+			N = vadd( N, mtransform( *M, weights[k].normal ) );
+
+		}
+
+		store3( verts   + 3*v, p );
+		store3( normals + 3*v, vlength2(N) > 0.f ? vnormal(N) : N );
+
+#endif
+
+	}
+
+}
+
+void  eval_Skin_reference( const Skin* skin, const Skel_Joint* joints,
+                           uint32 first, uint32 n,
+                           float* verts, float* normals ) {
+
+	assert( first + n <= skin->n_verts );
+
+	const Skel_Mesh* mesh = skin->mesh;
+
+	// Nothing flattened by new_Skin is used: the bind-pose normals are
+	// found again, and each is carried from its bind joint to the posed one
+	float4* bind = zalloc( ZONE_heap, 2 * mesh->n_verts * sizeof(float4) );
+	float4* bindN = bind + mesh->n_verts;
+
+	bind_pose( mesh, bind, bindN );
+
+	for( uint32 v=0; v<n; v++ ) {
+
+		const Skel_Vertex* vert = &mesh->verts[ first + v ];
+		const float4       bn   = { bindN[ first + v ].x, bindN[ first + v ].y,
+		                            bindN[ first + v ].z, 0.f };
+
+		float4 p = { 0.f, 0.f, 0.f, 0.f };
+		float4 N = { 0.f, 0.f, 0.f, 0.f };
+
+		for( uint32 j=0; j<vert->count; j++ ) {
+
+			const Skel_Weight* wgt   = &vert->weights[j];
+			const Skel_Joint*  from  = wgt->joint;
+			const Skel_Joint*  joint = &joints[ wgt->joint - skin->skel->joints ];
+
+			float4 wv = vadd( joint->p, qrot( joint->qr, wgt->pos ) );
+			float4 wn = qrot( joint->qr, qrot( qconj( from->qr ), bn ) );
+
+			p = vadd( p, vscale( wgt->bias, wv ) );
+			N = vadd( N, vscale( wgt->bias, wn ) );
+
+		}
+
+		store3( verts   + 3*v, p );
+		store3( normals + 3*v, vlength2(N) > 0.f ? vnormal(N) : N );
+
+	}
+
+	zfree( ZONE_heap, bind );
+
+}
+
+// Jobs ///////////////////////////////////////////////////////////////////////
+
+define_job( int, skin_chunk,
+
+            uint32 unused ) {
+
+	begin_job;
+
+	eval_Skin( arg(skin), arg(palette),
+	           arg(first), arg(n),
+	           arg(verts), arg(normals) );
+
+	// The last chunk wakes up join_Skin
+	arrive_Job_Latch( &((Skin*)arg(skin))->pending );
+
+	end_job;
+
+}
+
+int           submit_Skin( Skin* skin, const mat44* palette,
+                           float* verts, float* normals, uint32 deadline ) {
+
+	assert( 0 == skin->pending.pending );
+	add_Job_Latch( &skin->pending, (int)skin->n_chunks );
+
+	for( uint32 i=0; i<skin->n_chunks; i++ ) {
+
+		uint32 first = i * skinChunkSize;
+		uint32 n     = skin->n_verts - first < skinChunkSize ? skin->n_verts - first : skinChunkSize;
+
+		skin->chunks[i].params = (typeof_Job_params(skin_chunk)){
+			skin, palette, first, n, verts + 3*first, normals + 3*first
+		};
+
+		submit_Job( deadline, cpuBound, NULL, (jobfunc_f)skin_chunk, &skin->chunks[i].params );
+
+	}
+
+	return (int)skin->n_chunks;
+
+}
+
+void            join_Skin( Skin* skin ) {
+
+	wait_Job_Latch( &skin->pending );
+
+}
+
+// GL /////////////////////////////////////////////////////////////////////////
+
+Drawable*   drawable_Skin( region_p R, Skin* skin ) {
+
+	const Skel_Mesh* mesh = skin->mesh;
+
+	// Attribs, as drawable_Skel, but with positions and normals streamed:
+	//  0 pos:    x, y, z
+	//  1 uv:     s, t
+	//  2 normal: nx, ny, nz
+	Vattrib* verts   = new_Vattrib( "pos",       3, GL_FLOAT, GL_FALSE );
+	Vattrib* texcs   = maybe( verts, == NULL,
+	                          new_Vattrib( "uv", 2, GL_FLOAT, GL_FALSE ) );
+	Vattrib* normals = maybe( texcs, == NULL,
+	                          new_Vattrib( "N",  3, GL_FLOAT, GL_FALSE ) );
+	Vindex*  tris    = maybe( (Vindex*)normals, == NULL,
+	                          new_Vindex( GL_UNSIGNED_INT ) );
+
+	if( !tris ) {
+
+		maybe( verts, == NULL, delete_Vattrib(verts) );
+		maybe( texcs, == NULL, delete_Vattrib(texcs) );
+		maybe( normals, == NULL, delete_Vattrib(normals) );
+		return NULL;
+
+	}
+
+	float*  vp = alloc_Vattrib( verts, streamDraw, mesh->n_verts );
+	float*  tp = maybe( vp, == NULL,
+	                    alloc_Vattrib( texcs, staticDraw, mesh->n_verts ) );
+	float*  np = maybe( tp, == NULL,
+	                    alloc_Vattrib( normals, streamDraw, mesh->n_verts ) );
+	uint* trip = maybe( (uint*)np, == NULL,
+	                    alloc_Vindex( tris, staticDraw, 3 * mesh->n_tris ) );
+
+	if( !vp || !tp || !np || !trip ) {
+
+		delete_Vattrib(verts);
+		delete_Vattrib(texcs);
+		delete_Vattrib(normals);
+		delete_Vindex(tris);
+
+		return NULL;
+
+	}
+
+	for( uint32 i=0; i<mesh->n_verts; i++ ) {
+
+		tp[ 2*i + 0 ] = mesh->verts[i].s;
+		tp[ 2*i + 1 ] = mesh->verts[i].t;
+
+	}
+
+	memcpy( trip, mesh->tris, 3 * mesh->n_tris * sizeof(uint) );
+
+	// Start out in the bind pose
+	mat44* palette = zalloc( ZONE_heap, skin->n_joints * sizeof(mat44) );
+	palette_Skin( palette, skin->skel->joints, skin->n_joints );
+	eval_Skin( skin, palette, 0, skin->n_verts, vp, np );
+	zfree( ZONE_heap, palette );
+
+	flush_Vattrib( verts );
+	flush_Vattrib( texcs );
+	flush_Vattrib( normals );
+	flush_Vindex( tris );
+
+	skin->verts   = verts;
+	skin->normals = normals;
+
+	return new_Drawable_indexed( R,
+	                             3 * mesh->n_tris,
+	                             tris,
+	                             define_Varray( 3, verts, texcs, normals ),
+	                             drawTris );
+
+}
+
+// Skins the mesh straight into its vertex buffers. The buffers are mapped
+// for the duration and their old contents discarded, so the GL does not
+// have to wait for draws still using them.
+int           stream_Skin( Skin* skin, const mat44* palette, uint32 deadline ) {
+
+	assert( NULL != skin->verts && NULL != skin->normals );
+
+	const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+
+	float* vp = map_Vattrib_range( skin->verts, access, 0, skin->n_verts );
+	if( !vp )
+		return -1;
+
+	float* np = map_Vattrib_range( skin->normals, access, 0, skin->n_verts );
+	if( !np ) {
+		flush_Vattrib( skin->verts );
+		return -1;
+	}
+
+	submit_Skin( skin, palette, vp, np, deadline );
+	join_Skin( skin );
+
+	flush_Vattrib( skin->verts );
+	flush_Vattrib( skin->normals );
+
+	return 0;
+
+}
+
+#ifdef __r_skin_TEST__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "time.core.h"
+
+static float frand( float lo, float hi ) {
+
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+
+}
+
+static float4 qrand(void) {
+
+	float4 q = { frand(-1.f,1.f), frand(-1.f,1.f), frand(-1.f,1.f), frand(-1.f,1.f) };
+	float  l = sqrtf( vdot( q, q ) );
+
+	return (float4){ q.x/l, q.y/l, q.z/l, q.w/l };
+
+}
+
+// A grid of `side' x `side' vertices, each weighted to up to 4 joints
+static Skeleton* synthetic( int n_joints, int side ) {
+
+	Skeleton* skel  = calloc( 1, sizeof(Skeleton) );
+	Skel_Mesh* mesh = calloc( 1, sizeof(Skel_Mesh) );
+
+	skel->n_joints = n_joints;
+	skel->n_meshes = 1;
+	skel->joints   = calloc( n_joints, sizeof(Skel_Joint) );
+	skel->meshes   = mesh;
+
+	for( int i=0; i<n_joints; i++ ) {
+		skel->joints[i].parent = i > 0 ? &skel->joints[ (i-1)/2 ] : NULL;
+		skel->joints[i].p  = (float4){ frand(-5.f,5.f), frand(-5.f,5.f), frand(-5.f,5.f), 1.f };
+		skel->joints[i].qr = qrand();
+	}
+
+	mesh->n_verts   = side * side;
+	mesh->verts     = calloc( mesh->n_verts, sizeof(Skel_Vertex) );
+	mesh->weights   = calloc( 4 * mesh->n_verts, sizeof(Skel_Weight) );
+
+	for( uint32 i=0; i<mesh->n_verts; i++ ) {
+
+		Skel_Vertex* vert = &mesh->verts[i];
+
+		vert->s = (float)(i % side) / side;
+		vert->t = (float)(i / side) / side;
+		vert->weights = &mesh->weights[ mesh->n_weights ];
+		vert->count   = 1 + rand() % 4;
+
+		float total = 0.f;
+		for( uint32 j=0; j<vert->count; j++ ) {
+			vert->weights[j].joint = &skel->joints[ rand() % n_joints ];
+			vert->weights[j].bias  = frand( 0.1f, 1.f );
+			vert->weights[j].pos   = (float4){ frand(-1.f,1.f), frand(-1.f,1.f), frand(-1.f,1.f), 1.f };
+			total += vert->weights[j].bias;
+		}
+		for( uint32 j=0; j<vert->count; j++ )
+			vert->weights[j].bias /= total;
+
+		mesh->n_weights += vert->count;
+
+	}
+
+	mesh->n_tris = 2 * (side-1) * (side-1);
+	mesh->tris   = calloc( 3 * mesh->n_tris, sizeof(uint32) );
+
+	uint32* t = mesh->tris;
+	for( int y=0; y<side-1; y++ )
+		for( int x=0; x<side-1; x++ ) {
+			uint32 a = y*side + x, b = a + 1, c = a + side, d = c + 1;
+			*t++ = a; *t++ = c; *t++ = b;
+			*t++ = b; *t++ = c; *t++ = d;
+		}
+
+	return skel;
+
+}
+
+static void pose( Skel_Joint* dst, const Skeleton* skel, float t ) {
+
+	for( uint32 i=0; i<skel->n_joints; i++ ) {
+		float4 r = qaxis( (float4){ 0.f, 1.f, 0.f, t * (1 + i % 3) } );
+		dst[i]    = skel->joints[i];
+		dst[i].qr = qmul( r, skel->joints[i].qr );
+		dst[i].p  = vadd( skel->joints[i].p, (float4){ t, 0.f, -t, 0.f } );
+	}
+
+}
+
+static float maxdiff( const float* a, const float* b, uint32 n ) {
+
+	float d = 0.f;
+	for( uint32 i=0; i<n; i++ )
+		d = fmaxf( d, fabsf( a[i] - b[i] ) );
+	return d;
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	const int side   = argc > 1 ? (int)strtol( argv[1], NULL, 10 ) : 256;
+	const int frames = 20;
+
+	init_Jobs( (int)sysconf( _SC_NPROCESSORS_ONLN ) );
+
+	region_p  R    = region( "r.skin.test" );
+	Skeleton* skel = synthetic( 64, side );
+	Skin*     skin = new_Skin( R, skel, 0 );
+
+	const uint32 n = skin->n_verts;
+	assert( skin->n_weights == skel->meshes[0].n_weights );
+
+	float* ref_v = malloc( 3 * n * sizeof(float) );
+	float* ref_n = malloc( 3 * n * sizeof(float) );
+	float* out_v = malloc( 3 * n * sizeof(float) );
+	float* out_n = malloc( 3 * n * sizeof(float) );
+
+	Skel_Joint* joints  = calloc( skel->n_joints, sizeof(Skel_Joint) );
+	mat44*      palette = ralloc( R, skel->n_joints * sizeof(mat44) );
+
+	// The kernel, the jobs and the reference agree, in the bind pose and out
+	// of it; odd ranges leave the neighbouring vertices alone
+	for( int f=0; f<3; f++ ) {
+
+		pose( joints, skel, 0.37f * f );
+		palette_Skin( palette, joints, skel->n_joints );
+
+		eval_Skin_reference( skin, joints, 0, n, ref_v, ref_n );
+
+		eval_Skin( skin, palette, 0, n, out_v, out_n );
+		assert( maxdiff( ref_v, out_v, 3*n ) < 1e-4f );
+		assert( maxdiff( ref_n, out_n, 3*n ) < 1e-4f );
+
+		memset( out_v, 0, 3 * n * sizeof(float) );
+		memset( out_n, 0, 3 * n * sizeof(float) );
+		assert( (int)skin->n_chunks == submit_Skin( skin, palette, out_v, out_n, 1 ) );
+		join_Skin( skin );
+		assert( maxdiff( ref_v, out_v, 3*n ) < 1e-4f );
+		assert( maxdiff( ref_n, out_n, 3*n ) < 1e-4f );
+
+		out_v[ 3*7 ] = out_n[ 3*7 ] = -42.f;
+		out_v[ 3*18 - 1 ] = out_n[ 3*18 - 1 ] = -42.f;
+		eval_Skin( skin, palette, 8, 9, out_v + 3*8, out_n + 3*8 );
+		assert( -42.f == out_v[ 3*7 ] && -42.f == out_n[ 3*7 ] );
+		assert( -42.f == out_v[ 3*18 - 1 ] && -42.f == out_n[ 3*18 - 1 ] );
+
+	}
+
+	// In the bind pose, normals are those of the surface
+	palette_Skin( palette, skel->joints, skel->n_joints );
+	eval_Skin( skin, palette, 0, n, out_v, out_n );
+	for( uint32 i=0; i<n; i++ ) {
+		float l = out_n[3*i]*out_n[3*i] + out_n[3*i+1]*out_n[3*i+1] + out_n[3*i+2]*out_n[3*i+2];
+		assert( fabsf( l - 1.f ) < 1e-4f || 0.f == l );
+	}
+
+	// Benchmark
+	usec_t timebase;
+
+	timebase = microseconds();
+	for( int f=0; f<frames; f++ ) {
+		pose( joints, skel, 0.01f * f );
+		eval_Skin_reference( skin, joints, 0, n, ref_v, ref_n );
+	}
+	usec_t t_ref = microseconds() - timebase;
+
+	timebase = microseconds();
+	for( int f=0; f<frames; f++ ) {
+		pose( joints, skel, 0.01f * f );
+		palette_Skin( palette, joints, skel->n_joints );
+		eval_Skin( skin, palette, 0, n, out_v, out_n );
+	}
+	usec_t t_simd = microseconds() - timebase;
+
+	timebase = microseconds();
+	for( int f=0; f<frames; f++ ) {
+		pose( joints, skel, 0.01f * f );
+		palette_Skin( palette, joints, skel->n_joints );
+		submit_Skin( skin, palette, out_v, out_n, 2 + f );
+		join_Skin( skin );
+	}
+	usec_t t_jobs = microseconds() - timebase;
+
+	double verts = (double)n * frames;
+	printf("%u vertices, %u weights, %d joints, %u chunks, %d frames\n\n",
+	       n, skin->n_weights, skel->n_joints, skin->n_chunks, frames);
+	printf("%10s %10.1f Mverts/s\n", "reference", verts / t_ref);
+	printf("%10s %10.1f Mverts/s\n", "eval", verts / t_simd);
+	printf("%10s %10.1f Mverts/s\n", "jobs", verts / t_jobs);
+
+	shutdown_Jobs();
+
+	printf("\nOk\n");
+	return 0;
+
+}
+
+#endif
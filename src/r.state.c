@@ -1,3 +1,4 @@
+#include "gl.cache.h"
 #include "r.state.h"
 
 void query_Rstate_blend  ( Rstate_blend* out ) {
@@ -70,85 +71,68 @@ void query_Rstate( Rstate* out ) {
 
 void apply_Rstate_blend( const Rstate_blend* blend ) {
 
+	enable_Glcache( GL_BLEND, blend->enabled );
 	if( blend->enabled ) {
 
-		glEnable( GL_BLEND );
-		glBlendFuncSeparate( blend->srcColor, 
-		                     blend->dstColor,
-		                     blend->srcAlpha,
-		                     blend->dstAlpha );
+		blend_func_Glcache( blend->srcColor,
+		                    blend->dstColor,
+		                    blend->srcAlpha,
+		                    blend->dstAlpha );
 
-		glBlendEquationSeparate( blend->colorFunc,
-		                         blend->alphaFunc );
+		blend_equation_Glcache( blend->colorFunc,
+		                        blend->alphaFunc );
 
-		glBlendColor( blend->constColor.x,
-		              blend->constColor.y,
-		              blend->constColor.z,
-		              blend->constColor.w );
+		blend_color_Glcache( blend->constColor );
 
-	} else
-		glDisable( GL_BLEND );
+	}
 
 }
 
 void apply_Rstate_clear( const Rstate_clear* clear ) {
 
-	glClearColor( clear->color.x,
-	              clear->color.y, 
-	              clear->color.z, 
-	              clear->color.w );
-
-	glClearDepth( clear->depth );
-	glClearStencil( clear->stencil );
+	clear_color_Glcache( clear->color );
+	clear_depth_Glcache( clear->depth );
+	clear_stencil_Glcache( clear->stencil );
 
 }
 
 void apply_Rstate_depth( const Rstate_depth* depth ) {
 
-	if( depth->enabled ) {
-
-		glEnable( GL_DEPTH_TEST );
-		glDepthFunc( depth->func );
-
-	} else 
-		glDisable( GL_DEPTH_TEST );
-
-	if( depth->mask ) {
-
-		glDepthMask( GL_TRUE );
-		glDepthRange( depth->znear, depth->zfar );
+	enable_Glcache( GL_DEPTH_TEST, depth->enabled );
+	if( depth->enabled )
+		depth_func_Glcache( depth->func );
 
-	} else
-		glDepthMask( GL_FALSE );
+	depth_mask_Glcache( depth->mask );
+	if( depth->mask )
+		depth_range_Glcache( depth->znear, depth->zfar );
 
 }
 
 void apply_Rstate_stencil( const Rstate_stencil* stencil ) {
 
+	enable_Glcache( GL_STENCIL_TEST, stencil->enabled );
 	if( stencil->enabled ) {
 
-		glEnable( GL_STENCIL_TEST );
-		glStencilFuncSeparate( GL_FRONT, 
-		                       stencil->frontFunc,
-		                       stencil->frontRef,
-		                       stencil->frontMask );
-		glStencilFuncSeparate( GL_BACK, 
-		                       stencil->backFunc,
-		                       stencil->backRef,
-		                       stencil->backMask );
-
-		glStencilOpSeparate( GL_FRONT,
-		                     stencil->frontFail,
-		                     stencil->frontZpass,
-		                     stencil->frontZfail );
-
-		glStencilOpSeparate( GL_BACK,
-		                     stencil->backFail,
-		                     stencil->backZpass,
-		                     stencil->backZfail );
-
-	} else
-		glDisable( GL_STENCIL_TEST );
+		stencil_func_Glcache( GL_FRONT,
+		                      stencil->frontFunc,
+		                      stencil->frontRef,
+		                      stencil->frontMask );
+		stencil_func_Glcache( GL_BACK,
+		                      stencil->backFunc,
+		                      stencil->backRef,
+		                      stencil->backMask );
+
+		stencil_op_Glcache( GL_FRONT,
+		                    stencil->frontFail,
+		                    stencil->frontZpass,
+		                    stencil->frontZfail );
+
+		stencil_op_Glcache( GL_BACK,
+		                    stencil->backFail,
+		                    stencil->backZpass,
+		                    stencil->backZfail );
+
+	}
 
 }
 
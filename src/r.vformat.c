@@ -0,0 +1,384 @@
+#include <string.h>
+
+#include "gl.buf.h"
+#include "math.pack.h"
+#include "r.vformat.h"
+
+const char* vformat_GLSL =
+	"uniform vec3 vposOffset;\n"
+	"uniform vec3 vposScale;\n"
+	"uniform vec2 vuvOffset;\n"
+	"uniform vec2 vuvScale;\n"
+	"\n"
+	"vec3 vformat_pos( vec3 p ) { return vposOffset + vposScale * p; }\n"
+	"vec2 vformat_uv( vec2 t )  { return vuvOffset + vuvScale * t; }\n"
+	"\n"
+	"vec3 vformat_oct( vec2 e ) {\n"
+	"\tvec3 n = vec3( e, 1.0 - abs( e.x ) - abs( e.y ) );\n"
+	"\tif( n.z < 0.0 )\n"
+	"\t\tn.xy = ( 1.0 - abs( n.yx ) ) * vec2( n.x < 0.0 ? -1.0 : 1.0, n.y < 0.0 ? -1.0 : 1.0 );\n"
+	"\treturn normalize( n );\n"
+	"}\n";
+
+// Layout //////////////////////////////////////////////////////////////////////
+
+Vformat define_Vformat( vpos_e pos, vuv_e uv, vnormal_e normal ) {
+
+	Vformat fmt = {
+		.pos        = pos,
+		.uv         = uv,
+		.normal     = normal,
+		.pos_offset = { 0.f, 0.f, 0.f, 0.f },
+		.pos_scale  = { 1.f, 1.f, 1.f, 0.f },
+		.uv_offset  = { 0.f, 0.f },
+		.uv_scale   = { 1.f, 1.f }
+	};
+
+	short ofs = 0;
+
+	// Packed positions are padded to 8 bytes, to keep the fields after
+	// them aligned
+	switch( pos ) {
+	case vposFloat:
+		fmt.fields[0] = (Vfield){ "pos", 3, GL_FLOAT, GL_FALSE, ofs };
+		ofs += 12;
+		break;
+	case vposHalf:
+		fmt.fields[0] = (Vfield){ "pos", 3, GL_HALF_FLOAT, GL_FALSE, ofs };
+		ofs += 8;
+		break;
+	case vposUnorm16:
+		fmt.fields[0] = (Vfield){ "pos", 3, GL_UNSIGNED_SHORT, GL_TRUE, ofs };
+		ofs += 8;
+		break;
+	}
+
+	switch( uv ) {
+	case vuvFloat:
+		fmt.fields[1] = (Vfield){ "uv", 2, GL_FLOAT, GL_FALSE, ofs };
+		ofs += 8;
+		break;
+	case vuvUnorm16:
+		fmt.fields[1] = (Vfield){ "uv", 2, GL_UNSIGNED_SHORT, GL_TRUE, ofs };
+		ofs += 4;
+		break;
+	}
+
+	switch( normal ) {
+	case vnormalFloat:
+		fmt.fields[2] = (Vfield){ "n", 3, GL_FLOAT, GL_FALSE, ofs };
+		ofs += 12;
+		break;
+	case vnormalOct16:
+		fmt.fields[2] = (Vfield){ "n", 2, GL_SHORT, GL_TRUE, ofs };
+		ofs += 4;
+		break;
+	}
+
+	fmt.stride = ofs;
+	return fmt;
+
+}
+
+void       fit_Vformat( Vformat* fmt, const AABB* bounds, uint32 n, const float* uvs ) {
+
+	float4 extent = vsub( bounds->maxs, bounds->mins );
+
+	switch( fmt->pos ) {
+	case vposFloat:
+		break;
+	case vposHalf:
+		fmt->pos_offset = vscale( 0.5f, vadd( bounds->mins, bounds->maxs ) );
+		fmt->pos_scale  = (float4){ 1.f, 1.f, 1.f, 0.f };
+		break;
+	case vposUnorm16:
+		fmt->pos_offset = bounds->mins;
+		fmt->pos_scale  = (float4){ extent.x > 0.f ? extent.x : 1.f,
+		                            extent.y > 0.f ? extent.y : 1.f,
+		                            extent.z > 0.f ? extent.z : 1.f, 0.f };
+		break;
+	}
+	fmt->pos_offset.w = 0.f;
+
+	if( vuvUnorm16 == fmt->uv && uvs && n > 0 ) {
+
+		float lo[2] = { uvs[0], uvs[1] }, hi[2] = { uvs[0], uvs[1] };
+		for( uint32 i=1; i<n; i++ )
+			for( int k=0; k<2; k++ ) {
+				lo[k] = fminf( lo[k], uvs[ 2*i + k ] );
+				hi[k] = fmaxf( hi[k], uvs[ 2*i + k ] );
+			}
+
+		for( int k=0; k<2; k++ ) {
+			fmt->uv_offset[k] = lo[k];
+			fmt->uv_scale[k]  = hi[k] > lo[k] ? hi[k] - lo[k] : 1.f;
+		}
+
+	}
+
+}
+
+// Encoding ////////////////////////////////////////////////////////////////////
+
+void    encode_Vformat( const Vformat* fmt, uint32 n,
+                        const float* verts, const float* uvs, const float* normals,
+                        pointer out ) {
+
+	const float zero[3] = { 0.f, 0.f, 0.f };
+
+	memset( out, 0, (size_t)n * fmt->stride );
+
+	for( uint32 i=0; i<n; i++ ) {
+
+		byte*        vert = (byte*)out + (size_t)i * fmt->stride;
+		const float* v    = &verts[ 3*i ];
+		const float* t    = uvs     ? &uvs[ 2*i ]     : zero;
+		const float* N    = normals ? &normals[ 3*i ] : zero;
+
+		float rel[3] = {
+			( v[0] - fmt->pos_offset.x ) / fmt->pos_scale.x,
+			( v[1] - fmt->pos_offset.y ) / fmt->pos_scale.y,
+			( v[2] - fmt->pos_offset.z ) / fmt->pos_scale.z
+		};
+
+		switch( fmt->pos ) {
+		case vposFloat:
+			memcpy( vert + fmt->fields[0].offset, v, 3 * sizeof(float) );
+			break;
+		case vposHalf: {
+			uint16* p = (uint16*)( vert + fmt->fields[0].offset );
+			for( int k=0; k<3; k++ )
+				p[k] = pack_half( rel[k] );
+			break;
+		}
+		case vposUnorm16: {
+			uint16* p = (uint16*)( vert + fmt->fields[0].offset );
+			for( int k=0; k<3; k++ )
+				p[k] = pack_unorm16( rel[k] );
+			break;
+		}
+		}
+
+		switch( fmt->uv ) {
+		case vuvFloat:
+			memcpy( vert + fmt->fields[1].offset, t, 2 * sizeof(float) );
+			break;
+		case vuvUnorm16: {
+			uint16* p = (uint16*)( vert + fmt->fields[1].offset );
+			for( int k=0; k<2; k++ )
+				p[k] = pack_unorm16( ( t[k] - fmt->uv_offset[k] ) / fmt->uv_scale[k] );
+			break;
+		}
+		}
+
+		switch( fmt->normal ) {
+		case vnormalFloat:
+			memcpy( vert + fmt->fields[2].offset, N, 3 * sizeof(float) );
+			break;
+		case vnormalOct16:
+			pack_oct16( (float4){ N[0], N[1], N[2], 0.f },
+			            (int16*)( vert + fmt->fields[2].offset ) );
+			break;
+		}
+
+	}
+
+}
+
+void    decode_Vformat( const Vformat* fmt, const void* in, uint32 i,
+                        float v[3], float uv[2], float n[3] ) {
+
+	const byte* vert = (const byte*)in + (size_t)i * fmt->stride;
+
+	if( v ) {
+
+		const float* ofs   = &fmt->pos_offset.x;
+		const float* scale = &fmt->pos_scale.x;
+
+		switch( fmt->pos ) {
+		case vposFloat:
+			memcpy( v, vert + fmt->fields[0].offset, 3 * sizeof(float) );
+			break;
+		case vposHalf: {
+			const uint16* p = (const uint16*)( vert + fmt->fields[0].offset );
+			for( int k=0; k<3; k++ )
+				v[k] = ofs[k] + scale[k] * unpack_half( p[k] );
+			break;
+		}
+		case vposUnorm16: {
+			const uint16* p = (const uint16*)( vert + fmt->fields[0].offset );
+			for( int k=0; k<3; k++ )
+				v[k] = ofs[k] + scale[k] * unpack_unorm16( p[k] );
+			break;
+		}
+		}
+
+	}
+
+	if( uv ) {
+
+		switch( fmt->uv ) {
+		case vuvFloat:
+			memcpy( uv, vert + fmt->fields[1].offset, 2 * sizeof(float) );
+			break;
+		case vuvUnorm16: {
+			const uint16* p = (const uint16*)( vert + fmt->fields[1].offset );
+			for( int k=0; k<2; k++ )
+				uv[k] = fmt->uv_offset[k] + fmt->uv_scale[k] * unpack_unorm16( p[k] );
+			break;
+		}
+		}
+
+	}
+
+	if( n ) {
+
+		switch( fmt->normal ) {
+		case vnormalFloat:
+			memcpy( n, vert + fmt->fields[2].offset, 3 * sizeof(float) );
+			break;
+		case vnormalOct16: {
+			float4 N = unpack_oct16( (const int16*)( vert + fmt->fields[2].offset ) );
+			n[0] = N.x; n[1] = N.y; n[2] = N.z;
+			break;
+		}
+		}
+
+	}
+
+}
+
+// Vertex arrays ///////////////////////////////////////////////////////////////
+
+Varray*   new_Varray_Vformat( const Vformat* fmt, uint32 n, const void* data, Vindex* index ) {
+
+	Vattrib* storage = new_Vattrib( "vertex", fmt->stride, GL_UNSIGNED_BYTE, GL_FALSE );
+	if( !storage )
+		return NULL;
+
+	if( upload_Vattrib( storage, staticDraw, n, (pointer)data ) < 0 ) {
+		delete_Vattrib( storage );
+		return NULL;
+	}
+
+	Varray* va = new_Varray_interleaved( storage, 3, fmt->fields, index );
+	if( !va )
+		delete_Vattrib( storage );
+
+	return va;
+
+}
+
+#ifdef __r_vformat_TEST__
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static float frand( float lo, float hi ) {
+
+	return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+
+}
+
+#define N 100000
+
+int main( int argc, char* argv[] ) {
+
+	float* verts   = malloc( 3 * N * sizeof(float) );
+	float* uvs     = malloc( 2 * N * sizeof(float) );
+	float* normals = malloc( 3 * N * sizeof(float) );
+	byte*  buf     = malloc( (size_t)N * 32 );
+
+	AABB bounds = { { -50.f, 0.f, 10.f, 1.f }, { 50.f, 20.f, 10.5f, 1.f } };
+	for( uint32 i=0; i<N; i++ ) {
+
+		verts[ 3*i + 0 ] = frand( bounds.mins.x, bounds.maxs.x );
+		verts[ 3*i + 1 ] = frand( bounds.mins.y, bounds.maxs.y );
+		verts[ 3*i + 2 ] = frand( bounds.mins.z, bounds.maxs.z );
+
+		uvs[ 2*i + 0 ] = frand( -1.f, 3.f );
+		uvs[ 2*i + 1 ] = frand( 0.25f, 0.75f );
+
+		float4 n;
+		do
+			n = (float4){ frand( -1.f, 1.f ), frand( -1.f, 1.f ), frand( -1.f, 1.f ), 0.f };
+		while( vlength2( n ) < 1e-4f || vlength2( n ) > 1.f );
+		n = vnormal( n );
+
+		normals[ 3*i + 0 ] = n.x;
+		normals[ 3*i + 1 ] = n.y;
+		normals[ 3*i + 2 ] = n.z;
+
+	}
+
+	// Strides, and fields that stay inside them
+	assert( 32 == define_Vformat( vposFloat, vuvFloat, vnormalFloat ).stride );
+	assert( 16 == define_Vformat( vposUnorm16, vuvUnorm16, vnormalOct16 ).stride );
+	assert( 16 == define_Vformat( vposHalf, vuvUnorm16, vnormalOct16 ).stride );
+	assert( 28 == define_Vformat( vposHalf, vuvFloat, vnormalFloat ).stride );
+
+	const vpos_e    poss[]    = { vposFloat, vposHalf, vposUnorm16 };
+	const vuv_e     uvss[]    = { vuvFloat, vuvUnorm16 };
+	const vnormal_e normalss[] = { vnormalFloat, vnormalOct16 };
+
+	for( int a=0; a<3; a++ )
+	for( int b=0; b<2; b++ )
+	for( int c=0; c<2; c++ ) {
+
+		Vformat fmt = define_Vformat( poss[a], uvss[b], normalss[c] );
+		fit_Vformat( &fmt, &bounds, N, uvs );
+
+		for( int k=0; k<3; k++ )
+			assert( fmt.fields[k].offset % 4 == 0
+			        && fmt.fields[k].offset < fmt.stride );
+		assert( fmt.stride % 4 == 0 );
+
+		encode_Vformat( &fmt, N, verts, uvs, normals, buf );
+
+		float max_pos = 0.f, max_uv = 0.f, max_n = 0.f;
+		for( uint32 i=0; i<N; i++ ) {
+
+			float v[3], t[2], n[3];
+			decode_Vformat( &fmt, buf, i, v, t, n );
+
+			for( int k=0; k<3; k++ )
+				max_pos = fmaxf( max_pos, fabsf( v[k] - verts[ 3*i + k ] ) );
+			for( int k=0; k<2; k++ )
+				max_uv = fmaxf( max_uv, fabsf( t[k] - uvs[ 2*i + k ] ) );
+
+			// By distance; acosf of the dot product is too coarse this near 1
+			float dx = n[0] - normals[ 3*i + 0 ];
+			float dy = n[1] - normals[ 3*i + 1 ];
+			float dz = n[2] - normals[ 3*i + 2 ];
+			max_n = fmaxf( max_n, sqrtf( dx*dx + dy*dy + dz*dz ) );
+
+		}
+
+		// Half a step of each quantization, a little over for rounding in
+		// the decode; halves about the center are good to 2^-11 of the
+		// half-extent, here 50
+		float pos_bound = poss[a] == vposFloat ? 0.f
+		                : poss[a] == vposHalf  ? 50.f * 0x1p-11f
+		                : 0.5f * 100.f / 65535.f * 1.01f;
+		float uv_bound  = uvss[b] == vuvFloat  ? 0.f
+		                : 0.5f * 4.f / 65535.f * 1.01f;
+		float n_bound   = normalss[c] == vnormalFloat ? 0.f : 1e-4f;
+
+		assert( max_pos   <= pos_bound );
+		assert( max_uv    <= uv_bound );
+		assert( max_n     <= n_bound );
+
+		printf( "stride %2d: pos %.3g, uv %.3g, normal %.3g\n",
+		        fmt.stride, max_pos, max_uv, max_n );
+
+	}
+
+	free( verts ); free( uvs ); free( normals ); free( buf );
+
+	printf("Ok\n");
+	return 0;
+
+}
+
+#endif
@@ -1,69 +1,326 @@
+#include <assert.h>
+#include <string.h>
+
 #include "core.features.h"
 #include "core.types.h"
-#include "data.list.h"
+#include "mm.heap.h"
 #include "mm.region.h"
 #include "r.xform.h"
 
-typedef enum { 
+// An Xform is a handle to a slot in its store. The slot changes when the
+// store is re-ordered; the handle does not.
+struct Xform  {
+
+	Xform_Store* S;
+	uint32       slot;
+
+	pointer      tag;
+
+};
+
+typedef enum {
 
-	worldDirty   = 0x01,
-	world_1Dirty  = 0x02,
-	object_1Dirty = 0x04,
-	
-	allDirty     = 0xFF,
+	objectDirty = 0x01,
 
 } xformDirty_e;
 
-struct Xform  {
+struct xform_arrays {
+
+	mat44*  object;
+	mat44*  world;
+	mat44*  object_;
+	mat44*  world_;
+
+	Xform** handle;   // NULL once the slot has moved to another store
+	int32*  parent;   // -1 for roots
+	uint32* size;     // Slots in the subtree rooted here, when sorted
+	uint32* stamp;    // Pass in which the world matrices last changed
+	uint8*  dirty;
+
+};
+
+struct Xform_Store {
+
+	region_p R;
 
-	Xform*  parent;
-	List*   children;
-	pointer tag;
+	uint32   n;
+	uint32   capacity;
 
-	byte    dirty;
+	bool     sorted;  // Slots are in depth-first order
+	bool     dirty;   // An object matrix has changed since the last update
+	uint32   pass;
+
+	struct xform_arrays a;
+	struct xform_arrays b;  // Where the slots are permuted to when sorting
 
-	mat44   object;
-	mat44   world;
-	mat44   object_;
-	mat44   world_;
-	
 };
 
-static void mark( Xform* xf, uint flags ) {
+#define minCapacity 16
+
+// Store //////////////////////////////////////////////////////////////////////
+
+static void alloc_arrays( region_p R, uint32 capacity, struct xform_arrays* A ) {
+
+	size_t m = (size_t)capacity * sizeof(mat44);
+	uint8* p = ralloc( R, 4 * m + (size_t)capacity * ( sizeof(Xform*)
+	                                                  + sizeof(int32)
+	                                                  + 2 * sizeof(uint32)
+	                                                  + sizeof(uint8) ) );
+
+	// Matrices first, to keep them aligned
+	A->object  = (mat44*)p;  p += m;
+	A->world   = (mat44*)p;  p += m;
+	A->object_ = (mat44*)p;  p += m;
+	A->world_  = (mat44*)p;  p += m;
+
+	A->handle  = (Xform**)p; p += capacity * sizeof(Xform*);
+	A->parent  = (int32*)p;  p += capacity * sizeof(int32);
+	A->size    = (uint32*)p; p += capacity * sizeof(uint32);
+	A->stamp   = (uint32*)p; p += capacity * sizeof(uint32);
+	A->dirty   = p;
+
+}
+
+static void copy_slot( struct xform_arrays* dst, uint32 j, const struct xform_arrays* src, uint32 i ) {
+
+	dst->object[j]  = src->object[i];
+	dst->world[j]   = src->world[i];
+	dst->object_[j] = src->object_[i];
+	dst->world_[j]  = src->world_[i];
+	dst->handle[j]  = src->handle[i];
+	dst->parent[j]  = src->parent[i];
+	dst->size[j]    = src->size[i];
+	dst->stamp[j]   = src->stamp[i];
+	dst->dirty[j]   = src->dirty[i];
+
+}
+
+// Double the capacity. The old arrays are left to the region.
+static void grow( Xform_Store* S ) {
+
+	uint32 capacity = S->capacity > 0 ? 2 * S->capacity : minCapacity;
+
+	struct xform_arrays a;
+	alloc_arrays( S->R, capacity, &a );
+	for( uint32 i=0; i<S->n; i++ )
+		copy_slot( &a, i, &S->a, i );
+
+	S->a = a;
+	S->b.object = NULL;
+	S->capacity = capacity;
+
+}
+
+static Xform_Store* new_store( region_p R ) {
+
+	Xform_Store* S = ralloc( R, sizeof(Xform_Store) );
+	memset( S, 0, sizeof(Xform_Store) );
+
+	S->R      = R;
+	S->sorted = true;
+
+	return S;
+
+}
+
+static uint32 new_slot( Xform_Store* S, Xform* xf, int32 parent, const mat44* m ) {
+
+	if( S->n == S->capacity )
+		grow( S );
+
+	struct xform_arrays* A = &S->a;
+	uint32 i = S->n++;
+
+	A->object[i] = *m;
+	A->handle[i] = xf;
+	A->parent[i] = parent;
+	A->size[i]   = 1;
+	A->stamp[i]  = 0;
+	A->dirty[i]  = objectDirty;
+
+	// The slot extends the depth-first order if it is a new root or lands
+	// right at the end of its parent's subtree
+	if( S->sorted && parent >= 0 ) {
+
+		if( (uint32)parent + A->size[parent] == i ) {
+
+			for( int32 p = parent; p >= 0; p = A->parent[p] )
+				A->size[p]++;
+
+		} else
+			S->sorted = false;
+
+	}
+
+	S->dirty = true;
+	return i;
+
+}
+
+// Put the slots in depth-first order, children in the order they were
+// attached, dropping the slots that have moved to other stores
+static void sort( Xform_Store* S ) {
+
+	if( S->sorted )
+		return;
+
+	struct xform_arrays* A = &S->a;
+	const uint32 n = S->n;
 
-	xf->dirty |= flags;
+	uint32* scratch = zalloc( ZONE_heap, (int)((5 * n + 1) * sizeof(uint32)) );
+	uint32* first   = scratch;          // first[p]..first[p+1]: children of p
+	uint32* kids    = first + n + 1;
+	uint32* stack   = kids + n;
+	uint32* order   = stack + n;        // Old slot of each new slot
+	uint32* slot    = order + n;        // New slot of each old slot
+
+	memset( first, 0, (n + 1) * sizeof(uint32) );
+	for( uint32 i=0; i<n; i++ )
+		if( A->handle[i] && A->parent[i] >= 0 )
+			first[ A->parent[i] + 1 ]++;
+	for( uint32 i=0; i<n; i++ )
+		first[i+1] += first[i];
+	for( uint32 i=0; i<n; i++ )
+		if( A->handle[i] && A->parent[i] >= 0 )
+			kids[ first[ A->parent[i] ]++ ] = i;
+
+	// Filling moved every first[p] to the start of p+1's children
+	for( uint32 i=n; i>0; i-- )
+		first[i] = first[i-1];
+	first[0] = 0;
+
+	uint32 k = 0;
+	for( uint32 r=0; r<n; r++ ) {
+
+		if( NULL == A->handle[r] || A->parent[r] >= 0 )
+			continue;
+
+		uint32 top = 0;
+		stack[top++] = r;
+
+		while( top > 0 ) {
+
+			uint32 i = stack[--top];
+			slot[i]    = k;
+			order[k++] = i;
+
+			for( uint32 c = first[i+1]; c > first[i]; c-- )
+				stack[top++] = kids[c-1];
+
+		}
+
+	}
+
+	bool identity = (k == n);
+	for( uint32 j=0; j<k && identity; j++ )
+		identity = (order[j] == j);
+
+	if( !identity ) {
+
+		if( NULL == S->b.object )
+			alloc_arrays( S->R, S->capacity, &S->b );
+
+		struct xform_arrays* B = &S->b;
+		for( uint32 j=0; j<k; j++ ) {
+
+			uint32 i = order[j];
+			copy_slot( B, j, A, i );
+
+			B->parent[j] = A->parent[i] >= 0 ? (int32)slot[ A->parent[i] ] : -1;
+			B->handle[j]->slot = j;
+
+		}
+
+		struct xform_arrays t = S->a;
+		S->a = S->b;
+		S->b = t;
+		S->n = k;
+		A = &S->a;
+
+	}
+
+	// Children come after their parents, so sum subtree sizes backwards
+	for( uint32 j=0; j<k; j++ )
+		A->size[j] = 1;
+	for( uint32 j=k; j>0; j-- )
+		if( A->parent[j-1] >= 0 )
+			A->size[ A->parent[j-1] ] += A->size[j-1];
+
+	zfree( ZONE_heap, scratch );
+	S->sorted = true;
 
 }
 
-static void mark_children( Xform* xf, uint flags ) {
+static inline void sync( Xform_Store* S ) {
+
+	if( S->dirty || !S->sorted )
+		update_Xform_Store( S );
+
+}
+
+// Move the subtree of `xf' to the end of store `D', as a new tree
+static void move( Xform* xf, Xform_Store* D ) {
+
+	Xform_Store* S = xf->S;
+	sort( S );
 
-	// Mark children dirty
-	for( Xform* child=first_List(xf->children);
-	     NULL != child;
-	     child = next_List( child ) ) {
+	uint32 b = xf->slot;
+	uint32 e = b + S->a.size[b];
+	uint32 base = D->n;
 
-		mark( child, flags );
+	for( uint32 i=b; i<e; i++ ) {
+
+		if( D->n == D->capacity )
+			grow( D );
+
+		uint32 j = D->n++;
+		copy_slot( &D->a, j, &S->a, i );
+
+		D->a.parent[j] = i == b ? -1 : (int32)( base + (S->a.parent[i] - b) );
+		D->a.stamp[j]  = 0;
+
+		Xform* h = S->a.handle[i];
+		h->S    = D;
+		h->slot = j;
+
+		S->a.handle[i] = NULL;
 
 	}
 
+	D->a.dirty[base] = objectDirty;
+	D->dirty = true;
+
+	S->sorted = false;
+
 }
 
-static void clean( Xform* xf, uint flags ) {
+// Make `parent' the parent of `xf'; NULL makes it a root
+static void reparent( Xform* xf, Xform* parent ) {
 
-	xf->dirty &= ~(flags);
+	if( parent && parent->S != xf->S )
+		move( xf, parent->S );
+
+	Xform_Store* S = xf->S;
+
+	S->a.parent[ xf->slot ] = parent ? (int32)parent->slot : -1;
+	S->a.dirty[ xf->slot ]  = objectDirty;
+
+	S->sorted = false;
+	S->dirty  = true;
 
 }
 
-static bool isdirty( Xform* xf, uint flags ) {
+static inline void mark( Xform* xf ) {
 
-	return 0 != (xf->dirty & flags);
+	xf->S->a.dirty[ xf->slot ] = objectDirty;
+	xf->S->dirty = true;
 
 }
 
 // Public /////////////////////////////////////////////////////////////////////
 
 Xform          *new_Xform( region_p R, Xform* parent, pointer tag ) {
-	
+
 	return new_Xform_m( R, parent, tag, &identity_MAT44 );
 
 }
@@ -104,71 +361,45 @@ Xform          *new_Xform_scale_qr_tr( region_p R,  Xform *parent, pointer tag,
                                        float4   scale, float4   qr, float4   tr ) {
 
 	// Tr . Rot . Sc . v
-	mat44 M = mmul( mmul( mtranslation(tr), qmatrix(qr) ), mscaling( scale ) );	
+	mat44 M = mmul( mmul( mtranslation(tr), qmatrix(qr) ), mscaling( scale ) );
 	return new_Xform_m( R, parent, tag, &M );
 
 }
 
 Xform          *new_Xform_m( region_p R, Xform *parent, pointer tag, const mat44 *m ) {
 
-	
-	Xform* xf = NULL;
-	
-	if( parent ) { 
-		
-		xf = new_List_item( parent->children );
-		push_back_List( parent->children, xf );
-		
-	} else {
-		
-		xf = ralloc( R, sizeof(Xform) );
-		
-	}
-	
-	xf->parent   = parent;
-	xf->children = new_List( R, sizeof(Xform) );
-	xf->tag      = tag;
+	Xform* xf = ralloc( R, sizeof(Xform) );
 
-	xf->object   = *(m);
-	mark( xf, object_1Dirty | worldDirty | world_1Dirty );
+	xf->S    = parent ? parent->S : new_store( R );
+	xf->tag  = tag;
+	xf->slot = new_slot( xf->S, xf, parent ? (int32)parent->slot : -1, m );
 
 	return xf;
-	
+
 }
 
 // Tree manipulation //////////////////////////////////////////////////////////
 
 Xform        *adopt_Xform( Xform *xf, Xform *child ) {
 
-	child->parent = xf;
-	push_back_List( xf->children, child );
-
-	return xf;;
+	reparent( child, xf );
+	return xf;
 
 }
 
 Xform       *orphan_Xform( Xform *xf, Xform *child ) {
 
 	// Make sure child is in our list of children
-#if defined(feature_DEBUG)
-	Xform* node;
-	find__List( xf->children, node, node == child );
-
-	assert( NULL != node );
-#endif
-
-	remove_List( xf->children, child );
-	child->parent = NULL;
+	assert( parent_Xform(child) == xf );
 
+	reparent( child, NULL );
 	return xf;
 
 }
 
 Xform       *attach_Xform( Xform *xf, Xform *parent ) {
 
-	xf->parent = parent;
-	push_back_List( parent->children, xf );
-
+	reparent( xf, parent );
 	return xf;
 
 }
@@ -176,16 +407,9 @@ Xform       *attach_Xform( Xform *xf, Xform *parent ) {
 Xform       *detach_Xform( Xform *xf, Xform *parent ) {
 
 	// Make sure we are in parent's list of children
-#if defined(feature_DEBUG)
-	Xform* node;
-	find__List( parent->children, node, node == xf );
-	
-	assert( NULL != node );
-#endif
+	assert( parent_Xform(xf) == parent );
 
-	remove_List( parent->children, xf );
-	xf->parent = NULL;
-	
+	reparent( xf, NULL );
 	return xf;
 
 }
@@ -194,7 +418,8 @@ Xform       *detach_Xform( Xform *xf, Xform *parent ) {
 
 Xform       *parent_Xform( const Xform *xf ) {
 
-	return xf->parent;
+	int32 p = xf->S->a.parent[ xf->slot ];
+	return p >= 0 ? xf->S->a.handle[p] : NULL;
 
 }
 
@@ -204,28 +429,130 @@ pointer         tag_Xform( const Xform *xf ) {
 
 }
 
+Xform  *first_child_Xform( const Xform *xf ) {
+
+	Xform_Store* S = xf->S;
+	sort( S );
+
+	uint32 i = xf->slot;
+	return S->a.size[i] > 1 ? S->a.handle[i+1] : NULL;
+
+}
+
+Xform *next_sibling_Xform( const Xform *xf ) {
+
+	Xform_Store* S = xf->S;
+	sort( S );
+
+	uint32 i = xf->slot;
+	int32  p = S->a.parent[i];
+	uint32 j = i + S->a.size[i];
+
+	return p >= 0 && j < (uint32)p + S->a.size[p] ? S->a.handle[j] : NULL;
+
+}
+
 void       traverse_Xform( const Xform *xf, xformVisitor_f visit ) {
 
-	
-	if( visit( xf, xf->tag ) ) {
+	Xform_Store* S = xf->S;
+	sort( S );
 
-		for( Xform* child=first_List(xf->children);
-		     NULL != child;
-		     child = next_List( xf->children ) )
-			
-			traverse_Xform( child, visit );
+	uint32 i   = xf->slot;
+	uint32 end = i + S->a.size[i];
+
+	// Skip the subtree of a node whose visit returns false
+	while( i < end ) {
+
+		Xform* node = S->a.handle[i];
+		if( visit( node, node->tag ) )
+			i++;
+		else
+			i += S->a.size[i];
 
 	}
 
 }
 
+// Store //////////////////////////////////////////////////////////////////////
+
+Xform_Store   *store_Xform( const Xform *xf ) {
+
+	return xf->S;
+
+}
+
+void            span_Xform( const Xform *xf, uint32 *begin, uint32 *end ) {
+
+	sort( xf->S );
+
+	*begin = xf->slot;
+	*end   = xf->slot + xf->S->a.size[ xf->slot ];
+
+}
+
+uint32     size_Xform_Store( const Xform_Store *S ) {
+
+	return S->n;
+
+}
+
+void begin_update_Xform_Store( Xform_Store *S ) {
+
+	sort( S );
+
+	S->pass++;
+	S->dirty = false;
+
+}
+
+void update_Xform_Store_range( Xform_Store *S, uint32 begin, uint32 end ) {
+
+	struct xform_arrays* A = &S->a;
+	const uint32 pass = S->pass;
+
+	for( uint32 i=begin; i<end; i++ ) {
+
+		int32 p     = A->parent[i];
+		bool  dirty = 0 != A->dirty[i];
+
+		if( dirty ) {
+			A->object_[i] = minverse33( A->object[i] );
+			A->dirty[i]   = 0;
+		}
+
+		if( p >= 0 ) {
+
+			// World matrices follow the parent's
+			if( dirty || pass == A->stamp[p] ) {
+				A->world[i]  = mmulv( &A->world[p], &A->object[i] );
+				A->world_[i] = mmulv( &A->object_[i], &A->world_[p] );
+				A->stamp[i] = pass;
+			}
+
+		} else if( dirty ) {
+
+			A->world[i]  = A->object[i];
+			A->world_[i] = A->object_[i];
+			A->stamp[i]  = pass;
+
+		}
+
+	}
+
+}
+
+void      update_Xform_Store( Xform_Store *S ) {
+
+	begin_update_Xform_Store( S );
+	update_Xform_Store_range( S, 0, S->n );
+
+}
+
 // Mutators ///////////////////////////////////////////////////////////////////
 Xform          *set_Xform( Xform *xf, const mat44 *t ) {
 
-	xf->object = *t;
-
-	mark( xf, object_1Dirty | worldDirty | world_1Dirty );
-	mark_children( xf, worldDirty | world_1Dirty );
+	xf->S->a.object[ xf->slot ] = *t;
+	mark( xf );
 
 	return xf;
 
@@ -233,59 +560,44 @@ Xform          *set_Xform( Xform *xf, const mat44 *t ) {
 
 Xform          *mul_Xform( Xform *xf, const mat44 *t ) {
 
-	mat44 tr = mmulv( &xf->object, t );
+	mat44 tr = mmulv( &xf->S->a.object[ xf->slot ], t );
 	return set_Xform( xf, &tr );
 
 }
 
-
 Xform        *scale_Xform( Xform *xf, float4 scale ) {
 
-	mat44 tr = mmul( xf->object, mscaling(scale) );
+	mat44 tr = mmul( xf->S->a.object[ xf->slot ], mscaling(scale) );
 	return set_Xform( xf, &tr );
 
 }
 
 Xform*       rotate_Xform( Xform *xf, float4 qr ) {
 
-	mat44 tr = mmul( xf->object, qmatrix(qr) );
+	mat44 tr = mmul( xf->S->a.object[ xf->slot ], qmatrix(qr) );
 	return set_Xform( xf, &tr );
 
 }
 
 Xform    *translate_Xform( Xform *xf, float4 v ) {
 
-	mat44 tr = mmul( xf->object, mtranslation(v) );
+	mat44 tr = mmul( xf->S->a.object[ xf->slot ], mtranslation(v) );
 	return set_Xform( xf, &tr );
 
 }
 
-const mat44 *object_Xform( Xform *xform ) {
+const mat44 *object_Xform( Xform *xf ) {
 
-	return &xform->object;
+	// Bring the store up to date first, so the matrix doesn't move
+	sync( xf->S );
+	return &xf->S->a.object[ xf->slot ];
 
 }
 
 const mat44  *world_Xform( Xform *xf ) {
 
-	if( isdirty( xf, worldDirty ) ) {
-		
-		// If we have a parent, we pre-multiply its transform with our own
-		if( xf->parent ) {
-
-			xf->world = mmulv(world_Xform(xf->parent), 
-			                  object_Xform(xf));
-			
-		} else
-			// We are the top, just return our transform
-			xf->world = *(object_Xform(xf));
-
-		
-		clean( xf, worldDirty );
-
-	}
-
-	return &xf->world;
+	sync( xf->S );
+	return &xf->S->a.world[ xf->slot ];
 
 }
 
@@ -297,51 +609,96 @@ mat44        worldview_Xform( Xform *view, Xform *world ) {
 
 const mat44 *object_Xform_1( Xform *xf ) {
 
-	if( isdirty(xf, object_1Dirty) ) {
+	sync( xf->S );
+	return &xf->S->a.object_[ xf->slot ];
 
-		xf->object_ = minverse33( xf->object );
-		clean( xf, object_1Dirty);
+}
 
-	}
+const mat44  *world_Xform_1( Xform *xf ) {
 
-	return &xf->object_;
+	sync( xf->S );
+	return &xf->S->a.world_[ xf->slot ];
 
 }
 
-const mat44  *world_Xform_1( Xform *xf ) {
+mat44     worldview_Xform_1( Xform *view, Xform *world ) {
+
+	return mmulv(world_Xform_1(world), world_Xform_1(view));
+
+}
+
+#ifdef __r_xform_TEST__
 
-	if( isdirty(xf, world_1Dirty) ) {
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sync.thread.h"
+#include "time.core.h"
 
-		// If we have a parent, we pre-multiply its inverse with our own
-		if( xf->parent ) {
+static mat44 ref_world( Xform* xf ) {
 
-			xf->world_ = mmulv( object_Xform_1(xf), 
-			                    world_Xform_1(xf->parent) );
-	   
-		} else // We are the top, just return our transform
+	Xform* parent = parent_Xform( xf );
+	const mat44* object = &xf->S->a.object[ xf->slot ];
 
-			xf->world_ = *object_Xform_1(xf);
-		
-		clean( xf, world_1Dirty );
-		
+	if( parent ) {
+		mat44 pw = ref_world( parent );
+		return mmulv( &pw, object );
 	}
+	return *object;
+
+}
 
-	return &xf->world_;
+static bool near( const mat44* a, const mat44* b ) {
+
+	const float* x = (const float*)a;
+	const float* y = (const float*)b;
+	for( int i=0; i<16; i++ )
+		if( fabsf( x[i] - y[i] ) > 1e-3f * (1.f + fabsf(y[i])) )
+			return false;
+	return true;
 
 }
 
-mat44     worldview_Xform_1( Xform *view, Xform *world ) {
+static float4 random_qr( void ) {
+
+	return qaxis( (float4){ 0.f, 0.f, 1.f, (float)rand() / RAND_MAX } );
 
-	return mmulv(world_Xform_1(world), world_Xform_1(view));
-	
 }
 
-#ifdef __r_xform_TEST__
+static float4 random_tr( void ) {
 
-#include <stdio.h>
+	return (float4){ (float)(rand() % 10), (float)(rand() % 10), 0.f, 1.f };
+
+}
+
+static int counted;
+static bool count_visit( const Xform* xf, pointer tag ) {
+
+	counted++;
+	return true;
+
+}
+
+struct span_arg {
+
+	Xform_Store* S;
+	uint32       begin, end;
+
+};
+
+static int update_span( void* arg ) {
+
+	struct span_arg* span = arg;
+	update_Xform_Store_range( span->S, span->begin, span->end );
+	return 0;
+
+}
 
 int main( int argc, char* argv[] ) {
 
+	const int N = argc > 1 ? (int)strtol( argv[1], NULL, 10 ) : 50000;
+
 	init_printf_MAT44();
 
 	region_p R = region( "r.xform.TEST" );
@@ -350,18 +707,18 @@ int main( int argc, char* argv[] ) {
 
 	// Identity
 	Xform* root = new_Xform_qr_tr( R, NULL, NULL,
-	                              (float4){ 0.f, 0.f, 0.f, 1.f }, 
+	                              (float4){ 0.f, 0.f, 0.f, 1.f },
 	                              (float4){ 0.f, 0.f, 0.f, 1.f } );
 	Xform* X = new_Xform_qr_tr( R, root, NULL,
-	                           qaxis((float4){ 1.f, 0.f, 0.f, pi6 }), 
+	                           qaxis((float4){ 1.f, 0.f, 0.f, pi6 }),
 	                           (float4){ 0.f, 0.f, 0.f, 1.f } );
 	Xform* Y = new_Xform_qr_tr( R, X, NULL,
-	                           qaxis((float4){ 0.f, 1.f, 0.f, pi6 }), 
+	                           qaxis((float4){ 0.f, 1.f, 0.f, pi6 }),
 	                           (float4){ 0.f, 0.f, 0.f, 1.f } );
 	Xform* Z = new_Xform_qr_tr( R, X, NULL,
-	                           qaxis((float4){ 0.f, 0.f, 1.f, pi6 }), 
+	                           qaxis((float4){ 0.f, 0.f, 1.f, pi6 }),
 	                           (float4){ 0.f, 0.f, 0.f, 1.f } );
-	
+
 	const mat44* rootM = world_Xform(root);
 
 	const mat44*    oX = object_Xform(X);
@@ -370,7 +727,7 @@ int main( int argc, char* argv[] ) {
 	const mat44*   ioX = object_Xform_1(X);
 	const mat44*   ioY = object_Xform_1(Y);
 	const mat44*   ioZ = object_Xform_1(Z);
-	
+
 	const mat44*    wX = world_Xform(X);
 	const mat44*    wY = world_Xform(Y);
 	const mat44*    wZ = world_Xform(Z);
@@ -401,8 +758,140 @@ int main( int argc, char* argv[] ) {
 	printf("  world(Y) * world_1(Y) = % #4.2M\n", &IwY);
 	printf("  world(Z) * world_1(Z) = % #4.2M\n", &IwZ);
 
+	assert( near( &IwY, &identity_MAT44 ) && near( &IwZ, &identity_MAT44 ) );
+
+	// Changing the root moves the grandchildren too
+	translate_Xform( root, (float4){ 1.f, 2.f, 3.f, 1.f } );
+	mat44 expected = ref_world( Y );
+	assert( near( world_Xform(Y), &expected ) );
+
+	// Moving a subtree between stores, and back out
+	Xform* other = new_Xform_tr( R, NULL, NULL, (float4){ 5.f, 0.f, 0.f, 1.f } );
+	orphan_Xform( root, X );
+	attach_Xform( X, other );
+	assert( store_Xform(Y) == store_Xform(other) );
+	assert( parent_Xform(Y) == X && parent_Xform(X) == other );
+	expected = ref_world( Z );
+	assert( near( world_Xform(Z), &expected ) );
+	detach_Xform( X, other );
+	adopt_Xform( root, X );
+	expected = ref_world( Z );
+	assert( near( world_Xform(Z), &expected ) );
+
+	counted = 0;
+	traverse_Xform( root, count_visit );
+	assert( 4 == counted );
+	assert( first_child_Xform(X) == Y && next_sibling_Xform(Y) == Z );
+	assert( NULL == next_sibling_Xform(Z) && NULL == first_child_Xform(Z) );
+
 	rcollect( R );
 
+	// A big random tree, built breadth-first so it needs sorting
+	Xform** nodes = malloc( N * sizeof(Xform*) );
+	nodes[0] = new_Xform( R, NULL, NULL );
+	for( int i=1; i<N; i++ )
+		nodes[i] = new_Xform_qr_tr( R, nodes[ rand() % i ], NULL, random_qr(), random_tr() );
+
+	Xform_Store* S = store_Xform( nodes[0] );
+
+	usec_t timebase = microseconds();
+	update_Xform_Store( S );
+	usec_t first_time = microseconds() - timebase;
+
+	for( int i=0; i<N; i+=N/100 ) {
+		expected = ref_world( nodes[i] );
+		assert( near( world_Xform(nodes[i]), &expected ) );
+	}
+
+	// Everything dirty, and only a few
+	const int M = 20;
+
+	usec_t all_time = 0, few_time = 0;
+	for( int m=0; m<M; m++ ) {
+
+		for( int i=0; i<N; i++ )
+			rotate_Xform( nodes[i], (float4){ 0.f, 0.f, 0.f, 1.f } );
+
+		timebase = microseconds();
+		update_Xform_Store( S );
+		all_time += microseconds() - timebase;
+
+		for( int i=N-1; i>=N/2; i-=500 )
+			rotate_Xform( nodes[i], (float4){ 0.f, 0.f, 0.f, 1.f } );
+
+		timebase = microseconds();
+		update_Xform_Store( S );
+		few_time += microseconds() - timebase;
+
+	}
+	all_time /= M;
+	few_time /= M;
+
+	// The same, one node at a time with the scalar multiply
+	mat44* worlds = malloc( N * sizeof(mat44) );
+	timebase = microseconds();
+	for( int m=0; m<M; m++ )
+		for( int i=0; i<N; i++ ) {
+			Xform* p = parent_Xform( nodes[i] );
+			worlds[ nodes[i]->slot ] = p ? mmul( worlds[p->slot], S->a.object[ nodes[i]->slot ] )
+			                             : S->a.object[ nodes[i]->slot ];
+		}
+	usec_t scalar_time = (microseconds() - timebase) / M;
+	free( worlds );
+
+	// Updating the subtrees of the root's children on separate threads
+	for( int i=0; i<N; i++ )
+		translate_Xform( nodes[i], (float4){ 1.f, 0.f, 0.f, 1.f } );
+
+	enum { nThreads = 4 };
+	struct span_arg spans[nThreads];
+	thread_t threads[nThreads];
+
+	uint32 begin, end;
+	span_Xform( nodes[0], &begin, &end );
+
+	begin_update_Xform_Store( S );
+	update_Xform_Store_range( S, begin, begin + 1 );
+
+	int t = 0;
+	uint32 split = (end - begin) / nThreads + 1;
+	for( Xform* child = first_child_Xform( nodes[0] ); child; ) {
+
+		span_Xform( child, &spans[t].begin, &spans[t].end );
+		spans[t].S = S;
+
+		// Give each thread a run of whole subtrees
+		while( (child = next_sibling_Xform( child ))
+		       && (spans[t].end - spans[t].begin < split || t == nThreads - 1) ) {
+			uint32 b, e;
+			span_Xform( child, &b, &e );
+			spans[t].end = e;
+		}
+
+		create_THREAD( &threads[t], update_span, &spans[t] );
+		t++;
+
+	}
+	for( int i=0; i<t; i++ )
+		join_THREAD( &threads[i], NULL );
+
+	for( int i=0; i<N; i+=N/100 ) {
+		expected = ref_world( nodes[i] );
+		assert( near( world_Xform(nodes[i]), &expected ) );
+	}
+
+	printf("\n%d nodes, split %d ways\n", N, t);
+	printf("first update:  %8.3f ms\n", first_time / 1000.0);
+	printf("all dirty:     %8.3f ms\n", all_time / 1000.0);
+	printf("50 dirty:      %8.3f ms\n", few_time / 1000.0);
+	printf("scalar worlds: %8.3f ms\n", scalar_time / 1000.0);
+
+	free( nodes );
+	rfree( R );
+
+	printf("\nOk\n");
+	return 0;
+
 }
 
 #endif
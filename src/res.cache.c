@@ -0,0 +1,388 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.log.h"
+#include "res.cache.h"
+#include "sys.fs.h"
+
+// Layout /////////////////////////////////////////////////////////////////////
+
+#define resCacheMagic   "RCCH"
+#define resCacheVersion 1
+
+#define copyChunk ( 64 * 1024 )
+
+typedef struct Res_Cache_Header Res_Cache_Header;
+struct Res_Cache_Header {
+
+	char   magic[4];
+	uint32 version;
+	uint64 key;
+	uint64 cost;          // usec
+	uint32 count;
+	uint32 pad;
+
+};
+
+// Followed by the name, then the bytes
+typedef struct Res_Cache_File Res_Cache_File;
+struct Res_Cache_File {
+
+	uint32 namelen;
+	uint32 pad;
+	uint64 size;
+
+};
+
+struct Res_Cache {
+
+	char* dir;
+
+};
+
+// <dir>/<key, 16 hex digits>
+#define keyPathMax( cache ) ( strlen( (cache)->dir ) + 1 + 16 + 1 )
+
+static void key_path( const Res_Cache* cache, uint64 key, char* path ) {
+
+	sprintf( path, "%s" fileSeparator_string "%016" PRIx64, cache->dir, key );
+
+}
+
+static bool copy_bytes( FILE* in, FILE* out, uint64 size ) {
+
+	char* buf = malloc( copyChunk );
+	if( !buf )
+		return false;
+
+	while( size > 0 ) {
+
+		size_t chunk = size < copyChunk ? (size_t)size : copyChunk;
+		if( chunk != fread( buf, 1, chunk, in ) || chunk != fwrite( buf, 1, chunk, out ) )
+			break;
+
+		size -= chunk;
+
+	}
+
+	free( buf );
+	return 0 == size;
+
+}
+
+// Instantiation //////////////////////////////////////////////////////////////
+
+Res_Cache*   open_Res_Cache( const char* dir ) {
+
+	if( Fs_mkdirs( dir ) < 0 )
+		return NULL;
+
+	Res_Cache* cache = malloc( sizeof(Res_Cache) + strlen(dir) + 1 );
+	if( !cache )
+		return NULL;
+
+	cache->dir = strcpy( (char*)( cache + 1 ), dir );
+	return cache;
+
+}
+
+void        close_Res_Cache( Res_Cache* cache ) {
+
+	free( cache );
+
+}
+
+// Functions //////////////////////////////////////////////////////////////////
+
+static int fetch_file( FILE* inp, const char* outdir, char** name, uint64* size ) {
+
+	Res_Cache_File file;
+	if( 1 != fread( &file, sizeof(file), 1, inp ) || 0 == file.namelen )
+		return -1;
+
+	*name = malloc( file.namelen + 1 );
+	*size = file.size;
+	if( !*name || file.namelen != fread( *name, 1, file.namelen, inp ) )
+		return -1;
+	(*name)[ file.namelen ] = '\0';
+
+	// outdir/`dirname name`
+	char *stem = strrchr( *name, fileSeparator );
+	char path[ strlen(outdir) + 1 + file.namelen + 1 ];
+	strcpy( path, outdir );
+	strcat( path, fileSeparator_string );
+	strncat( path, *name, stem ? (size_t)(stem - *name) : 0 );
+
+	if( stem && Fs_mkdirs( path ) < 0 )
+		return -1;
+
+	strcpy( path, outdir );
+	strcat( path, fileSeparator_string );
+	strcat( path, *name );
+
+	FILE* outp = fopen( path, "wb" );
+	if( !outp )
+		return -1;
+
+	bool copied = copy_bytes( inp, outp, file.size );
+	if( 0 != fclose( outp ) || !copied )
+		return -1;
+
+	return 0;
+
+}
+
+int         fetch_Res_Cache( const Res_Cache* cache, uint64 key, const char* outdir,
+                             char** output, size_t* size, usec_t* cost ) {
+
+	char path[ keyPathMax(cache) ];
+	key_path( cache, key, path );
+
+	FILE* inp = fopen( path, "rb" );
+	if( !inp )
+		return -1;
+
+	Res_Cache_Header header;
+	if( 1 != fread( &header, sizeof(header), 1, inp )
+	    || 0 != memcmp( header.magic, resCacheMagic, sizeof(header.magic) )
+	    || resCacheVersion != header.version
+	    || key != header.key ) {
+
+		warning( "%s: not a cache entry for %016" PRIx64 ", ignored", path, key );
+		fclose( inp );
+		return -1;
+
+	}
+
+	char*  first = NULL;
+	size_t total = 0;
+	uint32 i     = 0;
+
+	for( ; i < header.count; i++ ) {
+
+		char*  name = NULL;
+		uint64 sz   = 0;
+
+		int rc = fetch_file( inp, outdir, &name, &sz );
+		if( rc < 0 ) {
+			error( "%s: could not copy `%s' out of the cache", path, name ? name : "?" );
+			free( name );
+			break;
+		}
+
+		total += sz;
+		if( 0 == i )
+			first = name;
+		else
+			free( name );
+
+	}
+
+	fclose( inp );
+
+	if( i < header.count ) {
+		free( first );
+		return -1;
+	}
+
+	if( output ) *output = first; else free( first );
+	if( size )   *size   = total;
+	if( cost )   *cost   = header.cost;
+
+	return (int)header.count;
+
+}
+
+int         store_Res_Cache( const Res_Cache* cache, uint64 key, const char* outdir,
+                             int n, const char* outputs[], usec_t cost ) {
+
+	static volatile uint32 serial = 0;
+
+	char path[ keyPathMax(cache) ];
+	key_path( cache, key, path );
+
+	// Unique to this store, whoever else is storing the same key
+	char tmp[ sizeof(path) + 32 ];
+	sprintf( tmp, "%s.%d.%u.tmp", path, (int)getpid(), __sync_fetch_and_add( &serial, 1 ) );
+
+	FILE* outp = fopen( tmp, "wb" );
+	if( !outp )
+		return -1;
+
+	Res_Cache_Header header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, resCacheMagic, sizeof(header.magic) );
+	header.version = resCacheVersion;
+	header.key     = key;
+	header.cost    = cost;
+	header.count   = n;
+
+	bool ok = 1 == fwrite( &header, sizeof(header), 1, outp );
+
+	for( int i=0; ok && i<n; i++ ) {
+
+		char in[ strlen(outdir) + 1 + strlen(outputs[i]) + 1 ];
+		strcpy( in, outdir );
+		strcat( in, fileSeparator_string );
+		strcat( in, outputs[i] );
+
+		FILE* inp = fopen( in, "rb" );
+		if( !inp ) {
+			ok = false;
+			break;
+		}
+
+		fseek( inp, 0L, SEEK_END );
+		Res_Cache_File file = { strlen(outputs[i]), 0, ftell( inp ) };
+		rewind( inp );
+
+		ok = 1 == fwrite( &file, sizeof(file), 1, outp )
+		     && file.namelen == fwrite( outputs[i], 1, file.namelen, outp )
+		     && copy_bytes( inp, outp, file.size );
+
+		fclose( inp );
+
+	}
+
+	if( 0 != fclose( outp ) )
+		ok = false;
+
+	if( !ok || 0 != rename( tmp, path ) ) {
+		remove( tmp );
+		return -1;
+	}
+
+	return 0;
+
+}
+
+#ifdef __res_cache_TEST__
+
+#include <assert.h>
+
+static void put( const char* path, const char* s ) {
+
+	FILE* fp = fopen( path, "wb" );
+	fputs( s, fp );
+	fclose( fp );
+
+}
+
+static bool same( const char* path, const char* s ) {
+
+	char buf[ 256 ] = { 0 };
+	FILE* fp = fopen( path, "rb" );
+	if( !fp )
+		return false;
+
+	size_t n = fread( buf, 1, sizeof(buf)-1, fp );
+	fclose( fp );
+
+	return n == strlen(s) && 0 == memcmp( buf, s, n );
+
+}
+
+// Everything the test makes under `dir' and `out', from this run or one
+// that failed before it could clean up
+static void clean( const char* dir, const char* out ) {
+
+	const char* files[] = { "models/a.mesh", "models/a.anim", "models", "b.skel" };
+	const uint64 keys[] = { 0x0123456789abcdefULL, 42 };
+
+	char path[ strlen(dir) + strlen(out) + 64 ];
+
+	for( int i=0; i<sizeof(files)/sizeof(files[0]); i++ ) {
+		sprintf( path, "%s/%s", out, files[i] );
+		remove( path );
+	}
+	for( int i=0; i<sizeof(keys)/sizeof(keys[0]); i++ ) {
+		sprintf( path, "%s/%016" PRIx64, dir, keys[i] );
+		remove( path );
+	}
+
+	rmdir( out );
+	rmdir( dir );
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	char tmpl[] = "/tmp/res.cache.XXXXXX";
+	const char* base = argc > 1 ? argv[1] : mkdtemp( tmpl );
+	assert( base );
+
+	char dir[ strlen(base) + 16 ], out[ strlen(base) + 16 ], path[ strlen(base) + 64 ];
+	sprintf( dir, "%s/cache", base );
+	sprintf( out, "%s/out", base );
+
+	clean( dir, out );
+
+	Res_Cache* cache = open_Res_Cache( dir );
+	assert( cache );
+
+	// A resource with a child in a subdirectory, and a large one
+	sprintf( path, "%s/models", out );
+	assert( 0 == Fs_mkdirs( path ) );
+	sprintf( path, "%s/models/a.mesh", out ); put( path, "mesh bytes" );
+	sprintf( path, "%s/models/a.anim", out ); put( path, "" );
+
+	size_t big = 3 * copyChunk + 17;
+	char*  blob = malloc( big );
+	for( size_t i=0; i<big; i++ )
+		blob[i] = (char)( i * 2654435761u >> 24 );
+	sprintf( path, "%s/b.skel", out );
+	FILE* fp = fopen( path, "wb" ); fwrite( blob, 1, big, fp ); fclose( fp );
+
+	const uint64 a = 0x0123456789abcdefULL, b = 42;
+
+	assert( -1 == fetch_Res_Cache( cache, a, out, NULL, NULL, NULL ) );
+	assert( 0 == store_Res_Cache( cache, a, out, 2, (const char*[]){ "models/a.mesh", "models/a.anim" }, 1234 ) );
+	assert( 0 == store_Res_Cache( cache, b, out, 1, (const char*[]){ "b.skel" }, 5 ) );
+	assert( -1 == store_Res_Cache( cache, 7, out, 1, (const char*[]){ "missing.mesh" }, 5 ) );
+	assert( -1 == fetch_Res_Cache( cache, 7, out, NULL, NULL, NULL ) );
+
+	// Gone from the output, and back from the cache
+	sprintf( path, "%s/models/a.mesh", out ); remove( path );
+	sprintf( path, "%s/models/a.anim", out ); remove( path );
+	sprintf( path, "%s/models", out );        rmdir( path );
+	sprintf( path, "%s/b.skel", out );        remove( path );
+
+	char*  output = NULL;
+	size_t size   = 0;
+	usec_t cost   = 0;
+
+	assert( 2 == fetch_Res_Cache( cache, a, out, &output, &size, &cost ) );
+	assert( 0 == strcmp( output, "models/a.mesh" ) && 10 == size && 1234 == cost );
+	free( output );
+
+	sprintf( path, "%s/models/a.mesh", out ); assert( same( path, "mesh bytes" ) );
+	sprintf( path, "%s/models/a.anim", out ); assert( same( path, "" ) );
+
+	assert( 1 == fetch_Res_Cache( cache, b, out, NULL, &size, NULL ) && big == size );
+	sprintf( path, "%s/b.skel", out );
+	fp = fopen( path, "rb" );
+	char* back = malloc( big + 1 );
+	assert( big == fread( back, 1, big + 1, fp ) && 0 == memcmp( back, blob, big ) );
+	fclose( fp );
+
+	// A truncated entry is a miss
+	sprintf( path, "%s/%016" PRIx64, dir, b );
+	assert( 0 == truncate( path, sizeof(Res_Cache_Header) + sizeof(Res_Cache_File) + 10 ) );
+	assert( -1 == fetch_Res_Cache( cache, b, out, NULL, NULL, NULL ) );
+
+	close_Res_Cache( cache );
+	free( blob );
+	free( back );
+
+	clean( dir, out );
+	if( argc <= 1 )
+		rmdir( base );
+
+	printf("Ok\n");
+	return 0;
+
+}
+
+#endif
@@ -56,6 +56,8 @@ void  register_Res_type( const char id[4],
  
 	restype->write = writefunc;
 	restype->read  = readfunc;
+	restype->pack  = NULL;
+	restype->map   = NULL;
 
 	// insert into list
 	restype->next = res_types;
@@ -72,6 +74,21 @@ static Res_Type *lookup_res_type( const char typeid[4] ) {
 
 }
 
+void  register_Res_map( const char id[4],
+                        pack_Resource_f packfunc,
+                        map_Resource_f mapfunc ) {
+
+	Res_Type *restype = lookup_res_type( id );
+	if( !restype ) {
+		warning( "register_Res_map: unknown type `%.4s'", id );
+		return;
+	}
+
+	restype->pack = packfunc;
+	restype->map  = mapfunc;
+
+}
+
 // Resource search paths //////////////////////////////////////////////////////
 
 struct Res_Path {
@@ -285,7 +302,16 @@ size_t     write_Res( Resource *res, const char *outdir ) {
 	fwrite( &len, sizeof(len), 1, outp );
 	fwrite( res->name, sizeof(char), len, outp );
 
-	res->type->write( res->data, outp );
+	// Packed when the type can be mapped back in
+	if( res->type->pack ) {
+
+		Res_Pack *pack = new_Res_Pack();
+		res->type->pack( res->data, pack );
+		write_Res_Pack( pack, outp );
+		delete_Res_Pack( pack );
+
+	} else
+		res->type->write( res->data, outp );
 	
 	// Measure size
 	size_t sz = ftell( outp );
@@ -349,7 +375,22 @@ Resource   *read_Res( const char *name ) {
 		return NULL;
 	}
 
-	pointer data = type->read( inp );
+	pointer data = NULL;
+	if( is_Res_Map( inp ) ) {
+
+		// The mapping stays open for as long as the data might be used,
+		// which, resources never being freed, is for good
+		Res_Map *map = type->map ? open_Res_Map( inp ) : NULL;
+		if( !type->map )
+			error( "Resource `%s' is packed, but `%.4s' cannot be mapped", name, typeid );
+		else if( map ) {
+			data = type->map( map );
+			if( !data )
+				close_Res_Map( map );
+		}
+
+	} else
+		data = type->read( inp );
 	fclose( inp );
 
 	if( !data ) {
@@ -363,23 +404,39 @@ Resource   *read_Res( const char *name ) {
 
 }
 
-Resource *import_Res( const char *name, const char* path ) {
+static struct Importer *lookup_importer( const char *path ) {
+
+	const char* ext = strrchr(path, '.');
+	if( !ext )
+		return NULL;
 
-	const char* ext = strrchr(path, '.') + 1;
-	struct Importer* imptr = importers;
+	for( struct Importer* imptr = importers; imptr; imptr = imptr->next )
+		if( 0 == strcmp(ext + 1, imptr->ext) )
+			return imptr;
 
-	while( imptr ) {
+	return NULL;
 
-		if( 0 == strcmp(ext, imptr->ext) )
-			break;
+}
 
-		imptr = imptr->next;
+Resource *import_Res_buf( const char *name, const char *path, size_t sz, const pointer buf ) {
 
-	}
+	struct Importer* imptr = lookup_importer( path );
+	if( !imptr )
+		return NULL;
+
+	return imptr->import( name, sz, buf );
+
+}
+
+Resource *import_Res( const char *name, const char* path ) {
+
+	struct Importer* imptr = lookup_importer( path );
 	if( !imptr )
 		return NULL;
 
 	FILE *fp = fopen( path, "rb" );
+	if( !fp )
+		return NULL;
 
 	fseek( fp, 0L, SEEK_END );
 	long sz = ftell( fp );
@@ -1,76 +1,434 @@
+#include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "core.system.h"
+#include "data.hash64.h"
+#include "job.control.h"
+#include "job.core.h"
+#include "res.cache.h"
 #include "res.core.h"
+#include "res.manifest.h"
 #include "res.spec.h"
+#include "sys.fs.h"
+#include "time.core.h"
+
+// Each input is imported and written by a job of its own. Inputs the
+// manifest says are unchanged, and whose output is still there, are
+// skipped: without reading them when their size, mtime and importer match,
+// after hashing them when only the mtime moved. Inputs that changed are
+// looked up in the build cache by that hash, and their outputs copied
+// from it when it has them; only what it has never seen is imported, and
+// then added to it.
+
+#define MANIFEST ".res.import.manifest"
+#define CACHE    ".res.cache"
+
+typedef enum {
+
+	importFailed = -1,
+	importDone,
+	importCached,
+	importUnchanged,
+
+} importstatus_e;
+
+typedef struct Import Import;
+
+declare_job( void, import_file, Job_Latch *pending; Import *imp );
+
+struct Import {
+
+	const char *arg;          // As given, relative to the base directory
+	char       *path;
+	const char *outdir;
+
+	const Res_Cache          *cache;
+	bool                      force;
+	const Res_Manifest_Entry *last;  // From the manifest; may be NULL
+	uint64      importer;
+	int64       mtime;
+	uint64      size;
+
+	// Results
+	importstatus_e status;
+	uint64         hash;
+	char          *output;
+	int            count;
+	size_t         written;
+	usec_t         elapsed;
+	usec_t         cost;      // When cached, what importing took
+
+	typeof_Job_params(import_file) params;
+
+};
 
 static int usage( const char* arg0, FILE *fp ) {
 
-	fprintf( fp, "Usage: %s <base-dir> <output-dir> [resource1 [resource2 [...]]]\n", arg0);
+	fprintf( fp, "Usage: %s [-j workers] [-f] [-m manifest] [-c cache-dir] [--stats] <base-dir> <output-dir> [resource1 [resource2 [...]]]\n", arg0);
+	fprintf( fp, "  -j       number of worker threads (default: one per cpu)\n" );
+	fprintf( fp, "  -f       import everything, whatever the manifest and the cache say\n" );
+	fprintf( fp, "  -m       manifest to use (default: <output-dir>/" MANIFEST ")\n" );
+	fprintf( fp, "  -c       build cache to use (default: <output-dir>/" CACHE ")\n" );
+	fprintf( fp, "  --stats  report cache hits and misses, and the time saved\n" );
 	return -1;
 
 }
 
-static int dumpInfo( FILE *fp, Resource *res ) {
+static int countRes( Resource *res ) {
+
+	int count = 1;
+	for( Resource *child=res->child; child; child=child->next )
+		count += countRes( child );
 
-	char typeid[4]; memcpy( typeid, res->type->id, sizeof(typeid) );
+	return count;
+
+}
+
+static int nameRes( Resource *res, const char **names ) {
 
-	fprintf( fp, "\tresource: %40s\n", res->name );
 	int count = 1;
+	names[0] = res->name;
 	for( Resource *child=res->child; child; child=child->next )
-		count += dumpInfo( fp, child );
+		count += nameRes( child, names + count );
 
 	return count;
 
 }
 
+static bool stat_input( const char *path, int64 *mtime, uint64 *size ) {
+
+	struct stat st;
+	if( stat( path, &st ) < 0 )
+		return false;
+
+	*mtime = (int64)st.st_mtim.tv_sec * nsec_perSecond + st.st_mtim.tv_nsec;
+	*size  = st.st_size;
+	return true;
+
+}
+
+static bool output_exists( const char *outdir, const char *output ) {
+
+	char path[ strlen(outdir) + 1 + strlen(output) + 1 ];
+	strcpy( path, outdir );
+	strcat( path, fileSeparator_string );
+	strcat( path, output );
+
+	return Fs_exists( path );
+
+}
+
+static void run_import( Import *imp ) {
+
+	usec_t begin = microseconds();
+
+	imp->status = importFailed;
+
+	FILE *fp = fopen( imp->path, "rb" );
+	pointer buf = fp ? malloc( imp->size ? imp->size : 1 ) : NULL;
+
+	if( !buf || imp->size != fread( buf, 1, imp->size, fp ) ) {
+		if( fp ) fclose( fp );
+		free( buf );
+		imp->elapsed = microseconds() - begin;
+		return;
+	}
+	fclose( fp );
+
+	imp->hash = hash64( buf, imp->size, imp->importer );
+
+	// Touched, but the same bytes
+	if( imp->last && imp->last->hash == imp->hash
+	    && output_exists( imp->outdir, imp->last->output ) ) {
+
+		imp->status  = importUnchanged;
+		imp->output  = strdup( imp->last->output );
+		free( buf );
+		imp->elapsed = microseconds() - begin;
+		return;
+
+	}
+
+	// Made before, by this importer, from the same bytes
+	if( !imp->force && imp->cache ) {
+
+		int n = fetch_Res_Cache( imp->cache, imp->hash, imp->outdir,
+		                         &imp->output, &imp->written, &imp->cost );
+		if( n >= 0 ) {
+			imp->status  = importCached;
+			imp->count   = n;
+			free( buf );
+			imp->elapsed = microseconds() - begin;
+			return;
+		}
+
+	}
+
+	const char *ext = strrchr( imp->arg, '.' );
+	if( !ext )
+		ext = imp->arg + strlen(imp->arg);
+
+	char name[ ext - imp->arg + 1 ];
+	strncpy( name, imp->arg, ext - imp->arg );
+	name[ ext - imp->arg ] = '\0';
+
+	Resource *res = import_Res_buf( name, imp->path, imp->size, buf );
+	free( buf );
+
+	if( res ) {
+
+		size_t sz = write_Res( res, imp->outdir );
+		if( (size_t)-1 != sz ) {
+			imp->status  = importDone;
+			imp->output  = strdup( res->name );
+			imp->count   = countRes( res );
+			imp->written = sz;
+		}
+
+	}
+
+	imp->elapsed = microseconds() - begin;
+
+	if( importDone == imp->status && imp->cache ) {
+
+		const char *names[ imp->count ];
+		nameRes( res, names );
+
+		if( store_Res_Cache( imp->cache, imp->hash, imp->outdir, imp->count, names, imp->elapsed ) < 0 )
+			fprintf( stderr, "Could not cache %s\n", imp->arg );
+
+	}
+
+}
+
+define_job( void, import_file,
+
+            uint32 unused ) {
+
+	begin_job;
+
+	run_import( arg(imp) );
+
+	// The last import done wakes up main
+	arrive_Job_Latch( arg(pending) );
+
+	end_job;
+
+}
+
+static double mb_per_s( uint64 bytes, usec_t elapsed ) {
+
+	return elapsed ? (double)bytes / 1048576.0 / ( (double)elapsed / usec_perSecond ) : 0.0;
+
+}
+
 #define RES_SPEC "etc/res.import.spec"
 int main( int argc, char *argv[] ) {
 
 	load_Res_spec( RES_SPEC );
 
-	if( argc < 3 )
+	int         workers  = cpu_count_SYS();
+	bool        force    = false;
+	const char *manifest_path = NULL;
+	const char *cache_path    = NULL;
+	bool        stats         = false;
+
+	int i = 1;
+	for( ; i<argc && '-' == argv[i][0]; i++ ) {
+
+		if( 0 == strcmp( argv[i], "-f" ) )
+			force = true;
+		else if( 0 == strcmp( argv[i], "-j" ) && i+1 < argc )
+			workers = atoi( argv[++i] );
+		else if( 0 == strcmp( argv[i], "-m" ) && i+1 < argc )
+			manifest_path = argv[++i];
+		else if( 0 == strcmp( argv[i], "-c" ) && i+1 < argc )
+			cache_path = argv[++i];
+		else if( 0 == strcmp( argv[i], "--stats" ) )
+			stats = true;
+		else
+			return usage( argv[0], stderr );
+
+	}
+
+	if( argc - i < 2 || workers < 1 )
 		return usage( argv[0], stderr );
 
 	FILE *loginfo = stdout;
 
-	int count = 0;
-	size_t sz = 0;
+	const char *basedir = argv[i++];
+	const char *outdir  = argv[i++];
 
-	const char *basedir = argv[1];
-	const char *outdir  = argv[2];
-	
+	char default_manifest[ strlen(outdir) + 1 + sizeof(MANIFEST) ];
+	strcpy( default_manifest, outdir );
+	strcat( default_manifest, fileSeparator_string MANIFEST );
+	if( !manifest_path )
+		manifest_path = default_manifest;
 
-	for( int i=3; i<argc; i++ ) {
+	char default_cache[ strlen(outdir) + 1 + sizeof(CACHE) ];
+	strcpy( default_cache, outdir );
+	strcat( default_cache, fileSeparator_string CACHE );
+	if( !cache_path )
+		cache_path = default_cache;
 
-		fprintf( loginfo, "importing: %s\n", argv[i] );
+	if( Fs_mkdirs( outdir ) < 0 ) {
+		fprintf( stderr, "Could not create output directory: %s\n", outdir );
+		return -1;
+	}
 
-		char *ext = strrchr( argv[i], '.' );
-		if( !ext )
-			ext = argv[i] + strlen(argv[i]);
+	Res_Manifest *manifest = read_Res_Manifest( manifest_path );
+	if( !manifest ) {
+		fprintf( stderr, "Could not read manifest: %s\n", manifest_path );
+		return -1;
+	}
 
-		char name[ ext - argv[i] + 1 ];
-		char path[ strlen(basedir) + 1 + strlen(argv[i]) + 1 ];
+	// Without one, everything is imported, as if every lookup missed
+	Res_Cache *cache = open_Res_Cache( cache_path );
+	if( !cache )
+		fprintf( stderr, "Could not open build cache: %s\n", cache_path );
 
-		strncpy( name, argv[i], ext - argv[i] );
-		name[ ext - argv[i] ] = '\0';
+	int     n    = argc - i;
+	Import *imps = calloc( n, sizeof(Import) );
 
-		strcpy( path, basedir );
-		strcat( path, "/" );
-		strcat( path, argv[i] );
+	if( init_Jobs( workers ) < 0 ) {
+		fprintf( stderr, "Failed to initialize jobs runtime\n" );
+		return -1;
+	}
 
-		Resource *res = import_Res( name, path );
-		if( !res )
-			fprintf( stderr, "Failed to import resource: %s\n", path );
-		else
-			count += dumpInfo( loginfo, res );
+	Job_Latch pending;
+	init_Job_Latch( &pending );
+
+	usec_t begin   = microseconds();
+	int    skipped = 0;
 
-		if( res )
-			sz += write_Res( res, outdir );
+	for( int j=0; j<n; j++ ) {
+
+		Import *imp = &imps[j];
+
+		imp->arg    = argv[i + j];
+		imp->outdir = outdir;
+		imp->cache  = cache;
+		imp->force  = force;
+		imp->path   = malloc( strlen(basedir) + 1 + strlen(imp->arg) + 1 );
+		strcpy( imp->path, basedir );
+		strcat( imp->path, "/" );
+		strcat( imp->path, imp->arg );
+
+		imp->importer = importer_Res_spec( imp->arg );
+		if( !imp->importer || !stat_input( imp->path, &imp->mtime, &imp->size ) ) {
+			imp->status = importFailed;
+			continue;
+		}
+
+		imp->last = force ? NULL : lookup_Res_Manifest( manifest, imp->arg );
+
+		// Untouched since it was last imported, by the same importer
+		if( imp->last && imp->last->importer == imp->importer
+		    && imp->last->mtime == imp->mtime && imp->last->size == imp->size
+		    && output_exists( outdir, imp->last->output ) ) {
+			imp->status = importUnchanged;
+			imp->hash   = imp->last->hash;
+			imp->output = strdup( imp->last->output );
+			skipped++;
+			continue;
+		}
+
+		// Counted before it is submitted, so that it cannot finish first
+		add_Job_Latch( &pending, 1 );
+		imp->params = (typeof_Job_params(import_file)){ &pending, imp };
+		submit_Job( 0, cpuBound, NULL, (jobfunc_f)import_file, &imp->params );
 
 	}
 
-	fprintf( loginfo, "imported %d resources (%zd bytes)\n", count, sz );
+	wait_Job_Latch( &pending );
+	destroy_Job_Latch( &pending );
+
+	usec_t elapsed = microseconds() - begin;
+	shutdown_Jobs();
+
+	// Report in the order given, and record what was made
+	int    count = 0, imported = 0, cached = 0, unchanged = 0, failed = 0;
+	uint64 bytes_in = 0;
+	size_t bytes_out = 0, bytes_cached = 0;
+	usec_t import_time = 0, cost_cached = 0, fetch_time = 0;
+
+	for( int j=0; j<n; j++ ) {
+
+		Import *imp = &imps[j];
+
+		switch( imp->status ) {
+
+		case importDone:
+			fprintf( loginfo, "imported:  %s -> %s (%d resources, %" PRIu64 " bytes in, %zu out, %.2f ms, %.1f MB/s)\n",
+			         imp->arg, imp->output, imp->count, imp->size, imp->written,
+			         (double)imp->elapsed / 1000.0, mb_per_s( imp->size, imp->elapsed ) );
+			update_Res_Manifest( manifest, imp->arg, imp->output, imp->hash, imp->importer, imp->mtime, imp->size );
+			imported++;
+			count       += imp->count;
+			bytes_in    += imp->size;
+			bytes_out   += imp->written;
+			import_time += imp->elapsed;
+			break;
+
+		case importCached:
+			fprintf( loginfo, "cached:    %s -> %s (%d resources, %zu bytes, %.2f ms, %.2f ms to import)\n",
+			         imp->arg, imp->output, imp->count, imp->written,
+			         (double)imp->elapsed / 1000.0, (double)imp->cost / 1000.0 );
+			update_Res_Manifest( manifest, imp->arg, imp->output, imp->hash, imp->importer, imp->mtime, imp->size );
+			cached++;
+			count        += imp->count;
+			bytes_cached += imp->written;
+			cost_cached  += imp->cost;
+			fetch_time   += imp->elapsed;
+			break;
+
+		case importUnchanged:
+			fprintf( loginfo, "unchanged: %s\n", imp->arg );
+			update_Res_Manifest( manifest, imp->arg, imp->output, imp->hash, imp->importer, imp->mtime, imp->size );
+			unchanged++;
+			break;
+
+		case importFailed:
+			fprintf( stderr, "Failed to import resource: %s\n", imp->path );
+			failed++;
+			break;
+
+		}
+
+		free( imp->path );
+		free( imp->output );
+
+	}
+
+	if( write_Res_Manifest( manifest, manifest_path ) < 0 )
+		fprintf( stderr, "Could not write manifest: %s\n", manifest_path );
+
+	fprintf( loginfo, "%d resources (%zd bytes) from %d files imported, %d cached, %d unchanged (%d not read), %d failed\n",
+	         count, bytes_out + bytes_cached, imported, cached, unchanged, skipped, failed );
+	fprintf( loginfo, "%.2f s on %d workers, %.1f MB/s in\n",
+	         (double)elapsed / usec_perSecond, workers, mb_per_s( bytes_in, elapsed ) );
+
+	// Hits and misses count the inputs looked up, that is, those that changed
+	if( stats ) {
+
+		int lookups = cached + imported;
+		fprintf( loginfo, "cache: %d hits, %d misses (%.0f%% hit), %d unchanged, %s\n",
+		         cached, imported, lookups ? 100.0 * cached / lookups : 0.0, unchanged,
+		         cache ? cache_path : "no cache" );
+		fprintf( loginfo, "cache: %.2f s of importing saved, %.2f s copying %.1f MB out; %.2f s importing misses\n",
+		         (double)( cost_cached > fetch_time ? cost_cached - fetch_time : 0 ) / usec_perSecond,
+		         (double)fetch_time / usec_perSecond, (double)bytes_cached / 1048576.0,
+		         (double)import_time / usec_perSecond );
+
+	}
+
+	if( cache )
+		close_Res_Cache( cache );
+	delete_Res_Manifest( manifest );
+	free( imps );
+
 	return 0;
 
 }
@@ -0,0 +1,230 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.log.h"
+#include "data.map.h"
+#include "mm.heap.h"
+#include "res.manifest.h"
+
+#define manifestLineMax 4096
+
+struct Res_Manifest {
+
+	Map* entries;  // input -> Res_Manifest_Entry*
+
+};
+
+// Instantiation //////////////////////////////////////////////////////////////
+
+Res_Manifest*    new_Res_Manifest( void ) {
+
+	Res_Manifest* manifest = malloc( sizeof(Res_Manifest) );
+	if( !manifest )
+		return NULL;
+
+	manifest->entries = new_Map( ZONE_heap, 64 );
+	if( !manifest->entries ) {
+		free( manifest );
+		return NULL;
+	}
+
+	return manifest;
+
+}
+
+void          delete_Res_Manifest( Res_Manifest* manifest ) {
+
+	for( pointer kv = first_Map( manifest->entries ); kv; kv = next_Map( manifest->entries, kv ) )
+		free( value_Map( kv ) );
+
+	delete_Map( manifest->entries );
+	free( manifest );
+
+}
+
+// Functions //////////////////////////////////////////////////////////////////
+
+uint             size_Res_Manifest( const Res_Manifest* manifest ) {
+
+	return size_Map( manifest->entries );
+
+}
+
+Res_Manifest_Entry*
+               lookup_Res_Manifest( const Res_Manifest* manifest, const char* input ) {
+
+	return lookup_Map( manifest->entries, strlen(input), (pointer)input );
+
+}
+
+// Mutators ///////////////////////////////////////////////////////////////////
+
+Res_Manifest_Entry*
+               update_Res_Manifest( Res_Manifest* manifest,
+                                    const char* input, const char* output,
+                                    uint64 hash, uint64 importer,
+                                    int64 mtime, uint64 size ) {
+
+	// The strings live after the entry
+	Res_Manifest_Entry* entry = malloc( sizeof(Res_Manifest_Entry)
+	                                    + strlen(output) + 1
+	                                    + strlen(input) + 1 );
+	if( !entry )
+		return NULL;
+
+	entry->hash     = hash;
+	entry->importer = importer;
+	entry->mtime  = mtime;
+	entry->size   = size;
+	entry->output = (char*)( entry + 1 );
+	entry->input  = entry->output + strlen(output) + 1;
+
+	strcpy( entry->output, output );
+	strcpy( entry->input, input );
+
+	Res_Manifest_Entry* old = put_Map( manifest->entries, strlen(input), entry->input, entry );
+	if( old != entry )
+		free( old );
+
+	return entry;
+
+}
+
+// IO /////////////////////////////////////////////////////////////////////////
+
+Res_Manifest*   read_Res_Manifest( const char* path ) {
+
+	FILE* fp = fopen( path, "r" );
+	if( !fp )
+		return ENOENT == errno ? new_Res_Manifest() : NULL;
+
+	Res_Manifest* manifest = new_Res_Manifest();
+	if( !manifest ) {
+		fclose( fp );
+		return NULL;
+	}
+
+	char line[ manifestLineMax ];
+	int  lineno = 0;
+
+	while( fgets( line, sizeof(line), fp ) ) {
+
+		lineno++;
+
+		size_t len = strlen( line );
+		if( len > 0 && '\n' == line[ len-1 ] )
+			line[ --len ] = '\0';
+
+		if( 0 == len || '#' == line[0] )
+			continue;
+
+		uint64 hash, importer, size;
+		int64  mtime;
+		int    n = 0;
+
+		char* output = line;
+		char* input  = NULL;
+
+		if( 4 == sscanf( line, "%" SCNx64 "\t%" SCNx64 "\t%" SCNd64 "\t%" SCNu64 "\t%n",
+		                 &hash, &importer, &mtime, &size, &n )
+		    && n > 0 ) {
+			output = line + n;
+			input  = strchr( output, '\t' );
+		}
+
+		if( !input || input == output || '\0' == input[1] ) {
+			warning( "%s:%d: malformed manifest entry, skipped", path, lineno );
+			continue;
+		}
+
+		*input++ = '\0';
+		update_Res_Manifest( manifest, input, output, hash, importer, mtime, size );
+
+	}
+
+	fclose( fp );
+	return manifest;
+
+}
+
+int            write_Res_Manifest( const Res_Manifest* manifest, const char* path ) {
+
+	char tmp[ strlen(path) + 5 ];
+	strcpy( tmp, path );
+	strcat( tmp, ".tmp" );
+
+	FILE* fp = fopen( tmp, "w" );
+	if( !fp )
+		return -1;
+
+	fprintf( fp, "# res.import manifest: hash, importer, mtime (ns), size, output, input\n" );
+
+	for( pointer kv = first_Map( manifest->entries ); kv; kv = next_Map( manifest->entries, kv ) ) {
+
+		const Res_Manifest_Entry* entry = value_Map( kv );
+		fprintf( fp, "%016" PRIx64 "\t%016" PRIx64 "\t%" PRId64 "\t%" PRIu64 "\t%s\t%s\n",
+		         entry->hash, entry->importer, entry->mtime, entry->size, entry->output, entry->input );
+
+	}
+
+	if( 0 != fclose( fp ) ) {
+		remove( tmp );
+		return -1;
+	}
+
+	return rename( tmp, path );
+
+}
+
+#ifdef __res_manifest_TEST__
+
+#include <assert.h>
+
+int main( int argc, char* argv[] ) {
+
+	const char* path = argc > 1 ? argv[1] : "/tmp/res.manifest.test";
+
+	remove( path );
+
+	// No file yet: empty
+	Res_Manifest* manifest = read_Res_Manifest( path );
+	assert( manifest && 0 == size_Res_Manifest( manifest ) );
+
+	update_Res_Manifest( manifest, "models/a.obj", "models/a.mesh", 0x0123456789abcdefULL, 1, 1700000000123456789LL, 42 );
+	update_Res_Manifest( manifest, "models/b c.md5mesh", "models/b c.skel", ~0ULL, ~0ULL, -1, 0 );
+	update_Res_Manifest( manifest, "models/a.obj", "models/a.mesh", 7, 0xfedcba9876543210ULL, 8, 9 );
+	assert( 2 == size_Res_Manifest( manifest ) );
+	assert( 7 == lookup_Res_Manifest( manifest, "models/a.obj" )->hash );
+	assert( NULL == lookup_Res_Manifest( manifest, "models/c.obj" ) );
+
+	assert( 0 == write_Res_Manifest( manifest, path ) );
+	delete_Res_Manifest( manifest );
+
+	// Round trip, with a junk line and a comment that are skipped
+	FILE* fp = fopen( path, "a" );
+	fprintf( fp, "not an entry\n# a comment\n" );
+	fclose( fp );
+
+	manifest = read_Res_Manifest( path );
+	assert( manifest && 2 == size_Res_Manifest( manifest ) );
+
+	Res_Manifest_Entry* a = lookup_Res_Manifest( manifest, "models/a.obj" );
+	assert( a && 7 == a->hash && 0xfedcba9876543210ULL == a->importer && 8 == a->mtime && 9 == a->size );
+	assert( 0 == strcmp( a->output, "models/a.mesh" ) );
+
+	Res_Manifest_Entry* b = lookup_Res_Manifest( manifest, "models/b c.md5mesh" );
+	assert( b && ~0ULL == b->hash && ~0ULL == b->importer && -1 == b->mtime && 0 == b->size );
+	assert( 0 == strcmp( b->output, "models/b c.skel" ) );
+
+	delete_Res_Manifest( manifest );
+	remove( path );
+
+	printf("Ok\n");
+	return 0;
+
+}
+
+#endif
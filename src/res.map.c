@@ -0,0 +1,631 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.features.h"
+#include "core.log.h"
+#include "res.map.h"
+
+#if defined( feature_POSIX )
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Layout /////////////////////////////////////////////////////////////////////
+
+#define resMapByteOrder 0x01020304
+
+typedef struct Res_Map_Header Res_Map_Header;
+struct Res_Map_Header {
+
+	char   magic[4];
+	uint16 version;
+	uint8  ptrsize;
+	uint8  pad;
+	uint32 byteorder;
+	uint32 n_sections;
+	uint64 size;          // From the header to the end of the last section
+
+};
+
+typedef struct Res_Map_Section Res_Map_Section;
+struct Res_Map_Section {
+
+	char   id[4];
+	uint32 stride;
+	uint64 count;
+	uint64 offset;        // From the header
+
+};
+
+static inline uint64 align_up( uint64 x ) {
+
+	return ( x + resMapAlign - 1 ) & ~(uint64)( resMapAlign - 1 );
+
+}
+
+// Writing ////////////////////////////////////////////////////////////////////
+
+typedef struct Res_Pack_Section Res_Pack_Section;
+struct Res_Pack_Section {
+
+	Res_Map_Section entry;
+
+	const void* data;
+	bool        owned;
+
+};
+
+struct Res_Pack {
+
+	uint32            n, capacity;
+	Res_Pack_Section *sections;
+
+};
+
+Res_Pack*    new_Res_Pack( void ) {
+
+	return calloc( 1, sizeof(Res_Pack) );
+
+}
+
+void      delete_Res_Pack( Res_Pack* pack ) {
+
+	for( uint32 i=0; i<pack->n; i++ )
+		if( pack->sections[i].owned )
+			free( (pointer)pack->sections[i].data );
+
+	free( pack->sections );
+	free( pack );
+
+}
+
+pointer      add_Res_Pack( Res_Pack* pack, const char id[4], uint32 stride, uint64 count, const void* data ) {
+
+	assert( stride > 0 );
+
+	if( pack->n == pack->capacity ) {
+
+		uint32 capacity = pack->capacity ? 2 * pack->capacity : 8;
+		Res_Pack_Section* sections = realloc( pack->sections, capacity * sizeof(Res_Pack_Section) );
+		if( !sections )
+			return NULL;
+
+		pack->sections = sections;
+		pack->capacity = capacity;
+
+	}
+
+	bool owned = NULL == data;
+	if( owned ) {
+		// One byte at least, so that an empty section still has an address
+		data = calloc( 1, count * stride + 1 );
+		if( !data )
+			return NULL;
+	}
+
+	Res_Pack_Section* section = &pack->sections[ pack->n++ ];
+
+	memcpy( section->entry.id, id, sizeof(section->entry.id) );
+	section->entry.stride = stride;
+	section->entry.count  = count;
+	section->entry.offset = 0;
+	section->data         = data;
+	section->owned        = owned;
+
+	return (pointer)data;
+
+}
+
+static size_t write_zeros( FILE* outp, uint64 n ) {
+
+	static const char zeros[ resMapAlign ] = { 0 };
+
+	assert( n <= resMapAlign );
+	return fwrite( zeros, 1, n, outp );
+
+}
+
+size_t     write_Res_Pack( Res_Pack* pack, FILE* outp ) {
+
+	// The magic, then padding up to the header
+	long start = ftell( outp );
+	if( start < 0 )
+		return 0;
+
+	uint64 at = align_up( (uint64)start + 4 );
+	size_t sz = fwrite( resMapMagic, 1, 4, outp );
+	sz += write_zeros( outp, at - (uint64)start - 4 );
+
+	// Lay the sections out after the table
+	uint64 ofs = align_up( sizeof(Res_Map_Header) + pack->n * sizeof(Res_Map_Section) );
+	for( uint32 i=0; i<pack->n; i++ ) {
+
+		Res_Map_Section* entry = &pack->sections[i].entry;
+
+		entry->offset = ofs;
+		ofs = align_up( ofs + entry->count * entry->stride );
+
+	}
+
+	Res_Map_Header header = {
+		.version    = resMapVersion,
+		.ptrsize    = sizeof(pointer),
+		.byteorder  = resMapByteOrder,
+		.n_sections = pack->n,
+		.size       = ofs
+	};
+	memcpy( header.magic, resMapMagic, sizeof(header.magic) );
+
+	sz += fwrite( &header, 1, sizeof(header), outp );
+	for( uint32 i=0; i<pack->n; i++ )
+		sz += fwrite( &pack->sections[i].entry, 1, sizeof(Res_Map_Section), outp );
+
+	uint64 pos = sizeof(header) + pack->n * sizeof(Res_Map_Section);
+	for( uint32 i=0; i<pack->n; i++ ) {
+
+		const Res_Pack_Section* section = &pack->sections[i];
+		uint64                  bytes   = section->entry.count * section->entry.stride;
+
+		sz  += write_zeros( outp, section->entry.offset - pos );
+		sz  += fwrite( section->data, 1, bytes, outp );
+		pos  = section->entry.offset + bytes;
+
+	}
+	sz += write_zeros( outp, ofs - pos );
+
+	return sz;
+
+}
+
+// Reading ////////////////////////////////////////////////////////////////////
+
+struct Res_Map {
+
+	byte*                  base;
+	size_t                 length;
+
+	const Res_Map_Header  *header;
+	const Res_Map_Section *sections;
+
+};
+
+bool          is_Res_Map( FILE* inp ) {
+
+	long pos = ftell( inp );
+	char magic[4];
+
+	bool is = 1 == fread( magic, sizeof(magic), 1, inp )
+		&& 0 == memcmp( magic, resMapMagic, sizeof(magic) );
+
+	fseek( inp, pos, SEEK_SET );
+	return is;
+
+}
+
+static byte* map_file( FILE* inp, size_t* length ) {
+
+#if defined( feature_POSIX )
+
+	struct stat st;
+	if( fstat( fileno( inp ), &st ) < 0 || st.st_size <= 0 )
+		return NULL;
+
+	pointer base = mmap( NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+	                     fileno( inp ), 0 );
+	if( MAP_FAILED == base )
+		return NULL;
+
+	*length = st.st_size;
+	return base;
+
+#else
+
+	// No mapping; read it all in
+	long pos = ftell( inp );
+	fseek( inp, 0L, SEEK_END );
+	long sz = ftell( inp );
+	rewind( inp );
+
+	byte* base = malloc( sz );
+	if( base && 1 != fread( base, sz, 1, inp ) ) {
+		free( base );
+		base = NULL;
+	}
+
+	fseek( inp, pos, SEEK_SET );
+
+	*length = sz;
+	return base;
+
+#endif
+
+}
+
+static void unmap_file( byte* base, size_t length ) {
+
+#if defined( feature_POSIX )
+	munmap( base, length );
+#else
+	free( base );
+#endif
+
+}
+
+Res_Map*    open_Res_Map( FILE* inp ) {
+
+	long pos = ftell( inp );
+	if( pos < 0 || !is_Res_Map( inp ) )
+		return NULL;
+
+	Res_Map* map = malloc( sizeof(Res_Map) );
+	if( !map )
+		return NULL;
+
+	map->base = map_file( inp, &map->length );
+	if( !map->base ) {
+		error( "Could not map resource: %s", strerror( errno ) );
+		free( map );
+		return NULL;
+	}
+
+	uint64 at = align_up( (uint64)pos + 4 );
+	const Res_Map_Header* header = (const Res_Map_Header*)( map->base + at );
+
+	if( at + sizeof(Res_Map_Header) > map->length
+	    || 0 != memcmp( header->magic, resMapMagic, sizeof(header->magic) ) ) {
+		error0( "Resource map header is missing" );
+		goto fail;
+	}
+
+	if( header->version != resMapVersion ) {
+		error( "Resource map version mis-match: expected %u, found %u",
+		       resMapVersion, header->version );
+		goto fail;
+	}
+
+	if( header->ptrsize != sizeof(pointer) || header->byteorder != resMapByteOrder ) {
+		error( "Resource map was written for another platform (%u byte pointers, byte order %08x)",
+		       header->ptrsize, header->byteorder );
+		goto fail;
+	}
+
+	if( at + header->size > map->length
+	    || sizeof(Res_Map_Header) + header->n_sections * sizeof(Res_Map_Section) > header->size ) {
+		error0( "Resource map is truncated" );
+		goto fail;
+	}
+
+	map->header   = header;
+	map->sections = (const Res_Map_Section*)( header + 1 );
+
+	for( uint32 i=0; i<header->n_sections; i++ ) {
+
+		const Res_Map_Section* s = &map->sections[i];
+		if( s->offset % resMapAlign || s->offset + s->count * s->stride > header->size ) {
+			error( "Resource map section `%.4s' is out of bounds", s->id );
+			goto fail;
+		}
+
+	}
+
+	return map;
+
+fail:
+	unmap_file( map->base, map->length );
+	free( map );
+	return NULL;
+
+}
+
+void       close_Res_Map( Res_Map* map ) {
+
+	unmap_file( map->base, map->length );
+	free( map );
+
+}
+
+pointer  section_Res_Map( const Res_Map* map, const char id[4], uint32 stride, uint64* count ) {
+
+	for( uint32 i=0; i<map->header->n_sections; i++ ) {
+
+		const Res_Map_Section* s = &map->sections[i];
+		if( 0 != memcmp( s->id, id, sizeof(s->id) ) )
+			continue;
+
+		if( s->stride != stride )
+			return NULL;
+
+		if( count )
+			*count = s->count;
+		return (byte*)map->header + s->offset;
+
+	}
+
+	return NULL;
+
+}
+
+#ifdef __res_map_TEST__
+
+#include <stdio.h>
+
+#include "r.mesh.h"
+#include "r.skel.h"
+#include "res.core.h"
+#include "time.core.h"
+
+// Resident pages, in bytes
+static int64 resident( void ) {
+
+	long size = 0, pages = 0;
+	FILE* fp = fopen( "/proc/self/statm", "r" );
+	if( fp ) {
+		if( 2 != fscanf( fp, "%ld %ld", &size, &pages ) )
+			pages = 0;
+		fclose( fp );
+	}
+	return (int64)pages * sysconf( _SC_PAGESIZE );
+
+}
+
+static float frand( void ) {
+
+	return (float)rand() / (float)RAND_MAX;
+
+}
+
+static Mesh* big_mesh( uint32 n_verts, uint32 n_tris ) {
+
+	Mesh* mesh = malloc( sizeof(Mesh) );
+
+	mesh->n_verts = mesh->n_uvs = mesh->n_normals = n_verts;
+	mesh->n_tris  = n_tris;
+
+	mesh->verts   = malloc( 3 * sizeof(float) * n_verts );
+	mesh->uvs     = malloc( 2 * sizeof(float) * n_verts );
+	mesh->normals = malloc( 3 * sizeof(float) * n_verts );
+	mesh->tris    = malloc( 3 * sizeof(Mesh_Vertex) * n_tris );
+
+	for( uint32 i=0; i<3*n_verts; i++ ) mesh->verts[i]   = frand();
+	for( uint32 i=0; i<2*n_verts; i++ ) mesh->uvs[i]     = frand();
+	for( uint32 i=0; i<3*n_verts; i++ ) mesh->normals[i] = frand();
+	for( uint32 i=0; i<3*n_tris; i++ )
+		mesh->tris[i] = (Mesh_Vertex){ rand() % n_verts, rand() % n_verts, rand() % n_verts };
+
+	mesh->bounds = (AABB){ { 0.f, 0.f, 0.f, 1.f }, { 1.f, 1.f, 1.f, 1.f } };
+	return mesh;
+
+}
+
+static Skeleton* big_skel( uint32 n_joints, uint32 n_meshes, uint32 n_verts, uint32 per_vert ) {
+
+	Skeleton* skel = malloc( sizeof(Skeleton) );
+
+	skel->n_joints = n_joints;
+	skel->n_meshes = n_meshes;
+	skel->joints   = calloc( n_joints, sizeof(Skel_Joint) );
+	skel->meshes   = calloc( n_meshes, sizeof(Skel_Mesh) );
+
+	for( uint32 i=0; i<n_joints; i++ ) {
+		char* name = malloc( 16 );
+		snprintf( name, 16, "joint%u", i );
+		skel->joints[i] = (Skel_Joint){ name, i ? &skel->joints[ rand() % i ] : NULL,
+		                                { frand(), frand(), frand(), 1.f },
+		                                { frand(), frand(), frand(), frand() } };
+	}
+
+	for( uint32 m=0; m<n_meshes; m++ ) {
+
+		Skel_Mesh* mesh = &skel->meshes[m];
+
+		mesh->shader    = "shader";
+		mesh->n_verts   = n_verts;
+		mesh->n_weights = n_verts * per_vert;
+		mesh->n_tris    = 2 * n_verts;
+		mesh->verts     = calloc( mesh->n_verts, sizeof(Skel_Vertex) );
+		mesh->weights   = calloc( mesh->n_weights, sizeof(Skel_Weight) );
+		mesh->tris      = calloc( 3 * mesh->n_tris, sizeof(uint32_t) );
+
+		for( uint32 i=0; i<n_verts; i++ )
+			mesh->verts[i] = (Skel_Vertex){ frand(), frand(), &mesh->weights[ i * per_vert ], per_vert };
+		for( uint32 i=0; i<mesh->n_weights; i++ )
+			mesh->weights[i] = (Skel_Weight){ &skel->joints[ rand() % n_joints ], frand(),
+			                                  { frand(), frand(), frand(), 1.f } };
+		for( uint32 i=0; i<3*mesh->n_tris; i++ )
+			mesh->tris[i] = rand() % n_verts;
+
+	}
+
+	return skel;
+
+}
+
+static bool same_mesh( const Mesh* a, const Mesh* b ) {
+
+	return a->n_verts == b->n_verts && a->n_uvs == b->n_uvs
+		&& a->n_normals == b->n_normals && a->n_tris == b->n_tris
+		&& 0 == memcmp( a->verts, b->verts, 3 * sizeof(float) * a->n_verts )
+		&& 0 == memcmp( a->uvs, b->uvs, 2 * sizeof(float) * a->n_uvs )
+		&& 0 == memcmp( a->normals, b->normals, 3 * sizeof(float) * a->n_normals )
+		&& 0 == memcmp( a->tris, b->tris, 3 * sizeof(Mesh_Vertex) * a->n_tris )
+		&& 0 == memcmp( &a->bounds, &b->bounds, sizeof(AABB) );
+
+}
+
+static bool same_skel( const Skeleton* a, const Skeleton* b ) {
+
+	if( a->n_joints != b->n_joints || a->n_meshes != b->n_meshes )
+		return false;
+
+	for( uint32 i=0; i<a->n_joints; i++ ) {
+		const Skel_Joint *ja = &a->joints[i], *jb = &b->joints[i];
+		if( strcmp( ja->name, jb->name )
+		    || ( ja->parent ? ja->parent - a->joints : -1 ) != ( jb->parent ? jb->parent - b->joints : -1 )
+		    || memcmp( &ja->p, &jb->p, sizeof(float4) ) || memcmp( &ja->qr, &jb->qr, sizeof(float4) ) )
+			return false;
+	}
+
+	for( uint32 m=0; m<a->n_meshes; m++ ) {
+
+		const Skel_Mesh *ma = &a->meshes[m], *mb = &b->meshes[m];
+		if( strcmp( ma->shader, mb->shader ) || ma->n_verts != mb->n_verts
+		    || ma->n_weights != mb->n_weights || ma->n_tris != mb->n_tris
+		    || memcmp( ma->tris, mb->tris, 3 * sizeof(uint32_t) * ma->n_tris ) )
+			return false;
+
+		for( uint32 i=0; i<ma->n_verts; i++ )
+			if( ma->verts[i].s != mb->verts[i].s || ma->verts[i].t != mb->verts[i].t
+			    || ma->verts[i].count != mb->verts[i].count
+			    || ma->verts[i].weights - ma->weights != mb->verts[i].weights - mb->weights )
+				return false;
+
+		for( uint32 i=0; i<ma->n_weights; i++ )
+			if( ma->weights[i].bias != mb->weights[i].bias
+			    || ma->weights[i].joint - a->joints != mb->weights[i].joint - b->joints
+			    || memcmp( &ma->weights[i].pos, &mb->weights[i].pos, sizeof(float4) ) )
+				return false;
+
+	}
+
+	return true;
+
+}
+
+// Sums every float, so that all of the data is paged in
+static float touch_mesh( const Mesh* mesh ) {
+
+	float sum = 0.f;
+	for( int32_t i=0; i<3*mesh->n_verts; i++ ) sum += mesh->verts[i] + mesh->normals[i];
+	for( int32_t i=0; i<mesh->n_tris; i++ )    sum += (float)mesh->tris[i].v;
+	return sum;
+
+}
+
+static float touch_skel( const Skeleton* skel ) {
+
+	float sum = 0.f;
+	for( uint32 m=0; m<skel->n_meshes; m++ ) {
+		const Skel_Mesh* mesh = &skel->meshes[m];
+		for( uint32 i=0; i<mesh->n_weights; i++ ) sum += mesh->weights[i].bias;
+		for( uint32 i=0; i<3*mesh->n_tris; i++ )  sum += (float)mesh->tris[i];
+	}
+	return sum;
+
+}
+
+// Writes `res' both ways, then reads each back, timing it and measuring
+// how much more is resident after loading and after touching everything
+static void compare( Resource* res, const char* dir,
+                     float (*touch)( pointer ), bool (*same)( pointer, pointer ) ) {
+
+	char stream_dir[ strlen(dir) + 16 ], mapped_dir[ strlen(dir) + 16 ];
+	sprintf( stream_dir, "%s/stream", dir );
+	sprintf( mapped_dir, "%s/mapped", dir );
+
+	pack_Resource_f pack = res->type->pack;
+	res->type->pack = NULL;
+	size_t stream_sz = write_Res( res, stream_dir );
+	res->type->pack = pack;
+	size_t mapped_sz = write_Res( res, mapped_dir );
+
+	const char* ways[] = { "stream", "mapped" };
+	const char* dirs[] = { stream_dir, mapped_dir };
+	size_t      sizes[] = { stream_sz, mapped_sz };
+
+	for( int i=0; i<2; i++ ) {
+
+		// Searched most recent first
+		add_Res_path( "file", dirs[i] );
+
+		int64  rss  = resident();
+		usec_t t    = microseconds();
+
+		Resource* loaded = read_Res( res->name );
+
+		t = microseconds() - t;
+		assert( loaded );
+
+		int64 rss_loaded  = resident() - rss;
+		float sum         = touch( loaded->data );
+		int64 rss_touched = resident() - rss;
+
+		assert( same( res->data, loaded->data ) );
+
+		printf( "%s %s: %9zu bytes, loaded in %7.2f ms, resident +%6.1f MB loaded, +%6.1f MB touched (%g)\n",
+		        res->name, ways[i], sizes[i], (double)t / 1000.0,
+		        rss_loaded / 1048576.0, rss_touched / 1048576.0, sum );
+
+	}
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	const char* dir = argc > 1 ? argv[1] : "/tmp/res.map.test";
+
+	// A container round trip, sections aligned and found by id
+	{
+		char path[ strlen(dir) + 16 ];
+		sprintf( path, "%s.rmap", dir );
+
+		FILE* fp = fopen( path, "w+b" );
+		assert( fp );
+		fwrite( "abc", 1, 3, fp );
+
+		uint32  ints[] = { 1, 2, 3, 4, 5 };
+		Res_Pack* pack = new_Res_Pack();
+		add_Res_Pack( pack, "ints", sizeof(uint32), 5, ints );
+		add_Res_Pack( pack, "none", 8, 0, NULL );
+		char* s = add_Res_Pack( pack, "strs", 1, 6, NULL );
+		strcpy( s, "hello" );
+		write_Res_Pack( pack, fp );
+		delete_Res_Pack( pack );
+
+		fseek( fp, 3, SEEK_SET );
+		assert( is_Res_Map( fp ) );
+		Res_Map* map = open_Res_Map( fp );
+		assert( map );
+
+		uint64 n;
+		uint32* mints = section_Res_Map( map, "ints", sizeof(uint32), &n );
+		assert( mints && 5 == n && 0 == memcmp( mints, ints, sizeof(ints) ) );
+		assert( 0 == (uintptr_t)mints % resMapAlign );
+		assert( section_Res_Map( map, "none", 8, &n ) && 0 == n );
+		assert( 0 == strcmp( section_Res_Map( map, "strs", 1, NULL ), "hello" ) );
+		assert( NULL == section_Res_Map( map, "ints", 8, NULL ) );
+		assert( NULL == section_Res_Map( map, "nope", 1, NULL ) );
+
+		// Private: writes do not reach the file
+		mints[0] = 42;
+		close_Res_Map( map );
+
+		fseek( fp, 0, SEEK_SET );
+		assert( !is_Res_Map( fp ) );
+		fseek( fp, 3, SEEK_SET );
+		map = open_Res_Map( fp );
+		assert( 1 == *(uint32*)section_Res_Map( map, "ints", sizeof(uint32), NULL ) );
+		close_Res_Map( map );
+
+		fclose( fp );
+		remove( path );
+	}
+
+	register_Res_type( "mesh", write_Mesh, (read_Resource_f)read_Mesh );
+	register_Res_map( "mesh", pack_Mesh, map_Mesh );
+	register_Res_type( "skel", write_Skel, (read_Resource_f)read_Skel );
+	register_Res_map( "skel", pack_Skel, map_Skel );
+
+	compare( new_Res( NULL, "big", "mesh", big_mesh( 500000, 1000000 ) ), dir,
+	         (float (*)( pointer ))touch_mesh, (bool (*)( pointer, pointer ))same_mesh );
+	compare( new_Res( NULL, "big", "skel", big_skel( 64, 2, 100000, 4 ) ), dir,
+	         (float (*)( pointer ))touch_skel, (bool (*)( pointer, pointer ))same_skel );
+
+	printf("Ok\n");
+	return 0;
+
+}
+
+#endif
@@ -1,9 +1,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "control.maybe.h"
 #include "core.log.h"
 #include "math.vec.h"
 #include "parse.core.h"
+#include "r.anim.h"
 #include "r.skel.h"
 #include "res.core.h"
 #include "res.md5.h"
@@ -70,9 +72,8 @@ static parse_p parse_float3( parse_p P, float4 *pos) {
 
 }
 
-static parse_p parse_quat( parse_p P, float4 *q ) {
-
-	parse_float3( P, q );
+// MD5 stores unit quaternions without w
+static void quat_w( float4 *q ) {
 
   float w = 1.0 - (q->x*q->x) - (q->y*q->y) - (q->z*q->z);
   if( w < 0.0f )
@@ -80,7 +81,14 @@ static parse_p parse_quat( parse_p P, float4 *q ) {
   else
     q->w = -sqrt(w);
 
-  return P;
+}
+
+static parse_p parse_quat( parse_p P, float4 *q ) {
+
+	parse_float3( P, q );
+	quat_w( q );
+
+	return P;
 
 }
 
@@ -266,6 +274,168 @@ Skeleton * parse_md5_model( parse_p P ) {
 
 }
 
+// .md5anim ///////////////////////////////////////////////////////////////////
+
+// Joint flags: which components of the base frame each frame replaces
+enum md5anim_flags_e {
+
+	md5Tx = 0x01, md5Ty = 0x02, md5Tz = 0x04,
+	md5Qx = 0x08, md5Qy = 0x10, md5Qz = 0x20
+
+};
+
+typedef struct {
+
+	char   *name;
+	int     parent;
+	int     flags;
+	int     start;
+
+} md5_hierarchy_t;
+
+static Anim *parse_md5_anim( parse_p P ) {
+
+	int version, n_frames, n_joints, n_components;
+	float frame_rate;
+
+	integer( ff( match( ff(P), "MD5Version" ) ), &version );
+	if( !parsok(P) || 10 != version ) {
+		parserr( P, "Expected: `MD5Version 10'" );
+		return NULL;
+	}
+
+	qstring( ff( match( ff(P), "commandline" ) ), NULL );
+	integer( ff( match( ff(P), "numFrames" ) ), &n_frames );
+	integer( ff( match( ff(P), "numJoints" ) ), &n_joints );
+	decimalf( ff( match( ff(P), "frameRate" ) ), &frame_rate );
+	integer( ff( match( ff(P), "numAnimatedComponents" ) ), &n_components );
+
+	if( !parsok(P) || n_frames <= 0 || n_joints <= 0 || n_components < 0 ) {
+		parserr( P, "Expected: numFrames, numJoints, frameRate, numAnimatedComponents" );
+		return NULL;
+	}
+
+	md5_hierarchy_t *hier       = calloc( n_joints, sizeof(md5_hierarchy_t) );
+	const char     **names      = calloc( n_joints, sizeof(char*) );
+	int32          *parents     = calloc( n_joints, sizeof(int32) );
+	float4         *base_p      = calloc( n_joints, sizeof(float4) );
+	float4         *base_q      = calloc( n_joints, sizeof(float4) );
+	float4         *bounds      = calloc( 2 * n_frames, sizeof(float4) );
+	float4         *p           = calloc( (size_t)n_frames * n_joints, sizeof(float4) );
+	float4         *q           = calloc( (size_t)n_frames * n_joints, sizeof(float4) );
+	float          *components  = calloc( n_components > 0 ? n_components : 1, sizeof(float) );
+	bool           *seen        = calloc( n_frames, sizeof(bool) );
+
+	Anim *anim = NULL;
+
+	match( ff(P), "hierarchy" ); matchc( ff(P), '{' );
+	for( int i=0; i<n_joints && parsok(P); i++ ) {
+
+		qstring( ff(P), &hier[i].name );
+		integer( ff(P), &hier[i].parent );
+		integer( ff(P), &hier[i].flags );
+		integer( ff(P), &hier[i].start );
+
+		if( parsok(P) && ( hier[i].parent >= i
+		                   || hier[i].start < 0
+		                   || hier[i].start + __builtin_popcount( hier[i].flags & 0x3f ) > n_components ) ) {
+			parserr( P, "Bad joint `%s'", hier[i].name );
+			goto done;
+		}
+
+		names[i]   = hier[i].name;
+		parents[i] = hier[i].parent;
+
+	}
+	matchc( ff(P), '}' );
+
+	if( !parsok(P) ) {
+		parserr( P, "Expected: `hierarchy { \"<name>\" <parent> <flags> <start> ... }'" );
+		goto done;
+	}
+
+	match( ff(P), "bounds" ); matchc( ff(P), '{' );
+	for( int i=0; i<n_frames && parsok(P); i++ ) {
+		parse_float3( ff(P), &bounds[ 2*i + 0 ] ); bounds[ 2*i + 0 ].w = 1.0f;
+		parse_float3( ff(P), &bounds[ 2*i + 1 ] ); bounds[ 2*i + 1 ].w = 1.0f;
+	}
+	matchc( ff(P), '}' );
+
+	if( !parsok(P) ) {
+		parserr( P, "Expected: `bounds { (<min>) (<max>) ... }'" );
+		goto done;
+	}
+
+	match( ff(P), "baseframe" ); matchc( ff(P), '{' );
+	for( int i=0; i<n_joints && parsok(P); i++ ) {
+		parse_float3( ff(P), &base_p[i] );
+		parse_float3( ff(P), &base_q[i] );
+	}
+	matchc( ff(P), '}' );
+
+	if( !parsok(P) ) {
+		parserr( P, "Expected: `baseframe { (<pos>) (<quat>) ... }'" );
+		goto done;
+	}
+
+	for( int f=0; f<n_frames; f++ ) {
+
+		int idx;
+
+		integer( ff( match( ff(P), "frame" ) ), &idx );
+		matchc( ff(P), '{' );
+		for( int k=0; k<n_components && parsok(P); k++ )
+			decimalf( ff(P), &components[k] );
+		matchc( ff(P), '}' );
+
+		if( !parsok(P) ) {
+			parserr( P, "Expected: `frame <int> { <float> ... }'" );
+			goto done;
+		}
+
+		// Each frame once, or one would be left unset
+		if( idx < 0 || idx >= n_frames || seen[idx] ) {
+			parserr( P, "Frame %d repeated, or not in [0, %d)", idx, n_frames );
+			goto done;
+		}
+		seen[idx] = true;
+
+		// Replace the animated components of the base frame
+		for( int j=0; j<n_joints; j++ ) {
+
+			float4 pj = base_p[j], qj = base_q[j];
+			const float *c = &components[ hier[j].start ];
+
+			if( hier[j].flags & md5Tx ) pj.x = *c++;
+			if( hier[j].flags & md5Ty ) pj.y = *c++;
+			if( hier[j].flags & md5Tz ) pj.z = *c++;
+			if( hier[j].flags & md5Qx ) qj.x = *c++;
+			if( hier[j].flags & md5Qy ) qj.y = *c++;
+			if( hier[j].flags & md5Qz ) qj.z = *c++;
+
+			quat_w( &qj );
+
+			p[ idx*n_joints + j ] = pj;
+			q[ idx*n_joints + j ] = qj;
+
+		}
+
+	}
+
+	anim = new_Anim( n_joints, n_frames, frame_rate, names, parents, p, q, bounds );
+
+done:
+	for( int i=0; i<n_joints; i++ )
+		free( hier[i].name );
+
+	free( hier ); free( names ); free( parents );
+	free( base_p ); free( base_q ); free( bounds );
+	free( p ); free( q ); free( components ); free( seen );
+
+	return anim;
+
+}
+
 // Public API /////////////////////////////////////////////////////////////////
 
 Resource *import_MD5( const char *name, size_t sz, const pointer data ) {
@@ -294,28 +464,175 @@ Resource *import_MD5( const char *name, size_t sz, const pointer data ) {
 
 }
 
+Resource *import_MD5anim( const char *name, size_t sz, const pointer data ) {
+
+	parse_p P = new_buf_PARSE( sz, (const char*)data );
+
+	Anim * anim = parse_md5_anim( P );
+
+	if( !parsok(P) || !anim ) {
+
+		maybe( anim, == NULL, delete_Anim(anim) );
+		destroy_PARSE(P);
+
+		return NULL;
+
+	}
+
+	info( "import_MD5anim: %s (%u joints, %u frames at %g fps)",
+	      name, anim->n_joints, anim->n_frames, anim->frame_rate );
+
+	destroy_PARSE( P );
+	return new_Res( NULL, name, "anim", anim );
+
+}
+
 #ifdef __res_md5_TEST__
 
-#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+// Two joints: a root with every component animated, and a child with only
+// its x position and quaternion x
+static const char md5anim[] =
+	"MD5Version 10\n"
+	"commandline \"\"\n"
+	"\n"
+	"numFrames 2\n"
+	"numJoints 2\n"
+	"frameRate 24\n"
+	"numAnimatedComponents 8\n"
+	"\n"
+	"hierarchy {\n"
+	"\t\"root\"\t-1 63 0\t// every component\n"
+	"\t\"arm\"\t0 9 6\n"
+	"}\n"
+	"\n"
+	"bounds {\n"
+	"\t( -1 -1 -1 ) ( 1 1 1 )\n"
+	"\t( -2 -2 -2 ) ( 2 2 2 )\n"
+	"}\n"
+	"\n"
+	"baseframe {\n"
+	"\t( 0 0 0 ) ( 0 0 0 )\n"
+	"\t( 1 2 3 ) ( 0 0.6 0 )\n"
+	"}\n"
+	"\n"
+	"frame 1 {\n"
+	"\t4 5 6 0.6 0 0\n"
+	"\t7 0.8\n"
+	"}\n"
+	"\n"
+	"frame 0 {\n"
+	"\t0 0 0 0 0 0\n"
+	"\t-1 0\n"
+	"}\n";
+
+static Anim* parse_anim( const char* text ) {
+
+	parse_p P = new_string_PARSE( text );
+	Anim* anim = parse_md5_anim( P );
+
+	if( anim && !parsok(P) ) {
+		delete_Anim( anim );
+		anim = NULL;
+	}
 
-int main( int argc, char* argv[] ) {
+	destroy_PARSE( P );
+	return anim;
+
+}
+
+// Positions are quantized to 16 bits of the range a joint moves over, and
+// quaternions to 16-bit fractions, flipped to stay in one hemisphere
+static void check_key( const Anim* anim, uint32 frame, uint32 joint, float4 p, float4 q ) {
+
+	float4 dp, dq;
+	decode_Anim( anim, frame, joint, &dp, &dq );
 
-	register_loader_RES( "md5mesh", load_resource_MD5 );
-	add_path_RES( "file", "${PWD}" );
+	assert( fabsf( dp.x - p.x ) < 1e-3f && fabsf( dp.y - p.y ) < 1e-3f && fabsf( dp.z - p.z ) < 1e-3f );
 
-	if( argc < 2 ) {
-		printf("Usage:\t%s <path to .md5mesh>\n", argv[0]);
-		return 1;
+	float dot = dq.x*q.x + dq.y*q.y + dq.z*q.z + dq.w*q.w;
+	assert( fabsf( fabsf( dot ) - 1.f ) < 1e-3f );
+
+}
+
+// `md5anim' with `from' replaced by `to'
+static Anim* parse_edited( const char* from, const char* to ) {
+
+	const char* at = strstr( md5anim, from );
+	assert( at );
+
+	char text[ sizeof(md5anim) + strlen(to) ];
+	sprintf( text, "%.*s%s%s", (int)(at - md5anim), md5anim, to, at + strlen(from) );
+
+	return parse_anim( text );
+
+}
+
+static void test_md5anim( void ) {
+
+	Anim* anim = parse_anim( md5anim );
+	assert( anim );
+	assert( 2 == anim->n_joints && 2 == anim->n_frames && 24.f == anim->frame_rate );
+	assert( 0 == strcmp( anim->joints[0].name, "root" ) && -1 == anim->joints[0].parent );
+	assert( 0 == strcmp( anim->joints[1].name, "arm" )  &&  0 == anim->joints[1].parent );
+
+	// w is recovered as the negative root, as for .md5mesh
+	check_key( anim, 0, 0, (float4){ 0, 0, 0, 0 }, (float4){ 0, 0, 0, -1 } );
+	check_key( anim, 1, 0, (float4){ 4, 5, 6, 0 }, (float4){ 0.6f, 0, 0, -0.8f } );
+
+	// The child keeps y and z of its base frame, and its base quaternion y
+	check_key( anim, 0, 1, (float4){ -1, 2, 3, 0 }, (float4){ 0, 0.6f, 0, -0.8f } );
+	check_key( anim, 1, 1, (float4){ 7, 2, 3, 0 }, (float4){ 0.8f, 0.6f, 0, 0 } );
+
+	assert( -2.f == anim->bounds[2].x && 2.f == anim->bounds[3].z );
+
+	delete_Anim( anim );
+
+	// Frames repeated, out of range or missing
+	assert( !parse_edited( "frame 0 {", "frame 1 {" ) );
+	assert( !parse_edited( "frame 0 {", "frame 2 {" ) );
+	assert( !parse_edited( "frame 1 {", "frame -1 {" ) );
+	assert( !parse_edited( "numFrames 2", "numFrames 3" ) );
+
+	// Too few components, components past the end, a parent after its child
+	assert( !parse_edited( "\t7 0.8\n", "\t7\n" ) );
+	assert( !parse_edited( "\"arm\"\t0 9 6", "\"arm\"\t0 9 7" ) );
+	assert( !parse_edited( "\"root\"\t-1", "\"root\"\t1" ) );
+	assert( !parse_edited( "MD5Version 10", "MD5Version 11" ) );
+
+	printf( "md5anim: ok\n" );
+
+}
+
+// With a path, prints what is in an .md5mesh
+static int stat_md5mesh( const char* path ) {
+
+	FILE* fp = fopen( path, "rb" );
+	if( !fp ) {
+		printf("Failed to open: %s\n", path);
+		return 255;
 	}
 
-	Skeleton * skel = resource(Skeleton,argv[1]);
-	if( !skel ) {
-		printf("Failed to load: %s\n", argv[1]);
+	fseek( fp, 0L, SEEK_END );
+	long sz = ftell( fp );
+	char* buf = malloc( sz );
+	rewind( fp );
+	sz = fread( buf, 1, sz, fp );
+	fclose( fp );
+
+	Resource* res = import_MD5( path, sz, buf );
+	free( buf );
+	if( !res ) {
+		printf("Failed to load: %s\n", path);
 		return 255;
 	}
 
-	printf("md5stat %s:\n\n", argv[1]);
-	printf("version:\t%d\n", skel->version);
+	Skeleton * skel = res->data;
+
+	printf("md5stat %s:\n\n", path);
 	printf("n_joints:\t%d\n", skel->n_joints);
 	printf("n_meshes:\t%d\n", skel->n_meshes);
 
@@ -336,6 +653,17 @@ int main( int argc, char* argv[] ) {
 	}
 
 	return 0;
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	test_md5anim();
+
+	if( argc > 1 )
+		return stat_md5mesh( argv[1] );
+
+	return 0;
 }
 
 #endif
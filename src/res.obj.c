@@ -24,8 +24,8 @@ struct Obj_extents {
 static parse_p ff( parse_p P ) {
 
 	P = skipws(P);
-	if( '#' == lookahead(P,0) )
-		return skipws( parsync(P, '\n', NULL) );
+	while( '#' == lookahead(P,0) )
+		P = skipws( parsync(P, '\n', NULL) );
 
 	return P;
 
@@ -286,9 +286,11 @@ static parse_error_p parse_uv( parse_p P, Mesh *mesh,
 	
 	// Some OBJ files contain 3d tex coords; our rendering model only uses
 	// 2d coords, so we'll just ignore the 3rd component if it exists.
-	float dummy;
+	float   dummy;
+	parse_t Pstate = (*P);
 
-	decimalf( ff( P ), &dummy );
+	if( !parsok( decimalf( ff( P ), &dummy ) ) )
+		(*P) = Pstate;
 	return NULL;
 }
 
@@ -435,31 +437,98 @@ Resource *import_Obj( const char *name, size_t sz, const pointer data ) {
 
 #ifdef __res_obj_TEST__
 
+#include <math.h>
+#include <stdio.h>
 #include <string.h>
 
-int main( int argc, char* argv[] ) {
+// A quad with a run of comments between statements, and texcoords with two
+// components as well as three
+static const char obj[] =
+	"# exported by hand\n"
+	"# two comment lines, then a blank one\n"
+	"\n"
+	"o quad\n"
+	"v 0 0 0\n"
+	"v 1 0 0\n"
+	"v 1 1 0\n"
+	"v 0 1 0\n"
+	"vt 0 0\n"
+	"vt 1 0\n"
+	"# a comment between texcoords\n"
+	"# and another\n"
+	"vt 1 1 0\n"
+	"vt 0.5 1\n"
+	"vn 0 0 1\n"
+	"f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+	"# trailing\n"
+	"# comments\n";
+
+static void test_obj( void ) {
+
+	Resource *res = import_Obj( "quad", sizeof(obj)-1, (const pointer)obj );
+	assert( res );
+
+	Mesh *mesh = res->data;
+	assert( 4 == mesh->n_verts );
+	assert( 4 == mesh->n_uvs );
+	assert( 1 == mesh->n_normals );
+	assert( 2 == mesh->n_tris );
+
+	const float uvs[] = { 0,0, 1,0, 1,1, 0.5f,1 };
+	for( int i=0; i<8; i++ )
+		assert( fabsf( mesh->uvs[i] - uvs[i] ) < 1e-6f );
+
+	// The second triangle fans from the first vertex
+	const int tris[] = { 0,1,2, 0,2,3 };
+	for( int i=0; i<6; i++ )
+		assert( tris[i] == mesh->tris[i].v && tris[i] == mesh->tris[i].uv
+		        && 0 == mesh->tris[i].n );
+
+}
 
-	register_loader_RES( "obj", load_resource_Obj );
-	add_path_RES( "file", "${PWD}" );
+static int stat_obj( const char *path ) {
 
-	if( argc < 2 ) {
-		printf("Usage:\t%s <path to .obj>\n", argv[0]);
-		return 1;
+	FILE* fp = fopen( path, "rb" );
+	if( !fp ) {
+		printf("Failed to open: %s\n", path);
+		return 255;
 	}
 
-	Mesh *mesh = resource(Mesh,argv[1]);
-	if( !mesh ) {
-		printf("Failed to load: %s\n", argv[1]);
+	fseek( fp, 0L, SEEK_END );
+	long sz = ftell( fp );
+	char* buf = malloc( sz );
+	rewind( fp );
+	sz = fread( buf, 1, sz, fp );
+	fclose( fp );
+
+	Resource* res = import_Obj( path, sz, buf );
+	free( buf );
+	if( !res ) {
+		printf("Failed to load: %s\n", path);
 		return 255;
 	}
 
-	printf(".objstat %s:\n\n", argv[1]);
+	Mesh *mesh = res->data;
+
+	printf(".objstat %s:\n\n", path);
 	printf("n_verts:\t%d\n", mesh->n_verts);
 	printf("n_uvs:\t%d\n", mesh->n_uvs);
 	printf("n_normals:\t%d\n", mesh->n_normals);
 	printf("n_tris:\t%d\n", mesh->n_tris);
 
 	return 0;
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	test_obj();
+
+	if( argc > 1 )
+		return stat_obj( argv[1] );
+
+	printf("Ok\n");
+	return 0;
 }
 
 #endif
@@ -5,19 +5,94 @@
 
 #include "control.maybe.h"
 #include "core.log.h"
+#include "data.hash64.h"
 #include "parse.core.h"
 #include "res.core.h"
 #include "res.spec.h"
 
 #include "sys.dll.h"
 
-static void addimport( const char type[4], const char* ext, const char* module, const char* entry ) {
+// What each record that resolved says, hashed, for importer_Res_spec.
+// Later records come first, as they do in res.core's lists
+typedef enum { specImport, specType, specMap } spec_e;
+
+struct Spec_Record {
+
+	spec_e  kind;
+	char    type[4];
+	char   *ext;         // Import records only
+
+	uint64  identity;
+
+	struct Spec_Record *next;
+
+};
+
+static struct Spec_Record *records = NULL;
+
+static void addrecord( spec_e kind, const char type[4], const char *ext, uint64 seed, int fieldc, const char *fieldv[] ) {
+
+	struct Spec_Record *rec = malloc( sizeof(struct Spec_Record) + (ext ? strlen(ext)+1 : 0) );
+
+	rec->kind = kind;
+	memcpy( rec->type, type, sizeof(rec->type) );
+	rec->ext  = ext ? strcpy( (char*)(rec + 1), ext ) : NULL;
+
+	rec->identity = hash64( &kind, sizeof(kind), seed );
+	rec->identity = hash64( rec->type, sizeof(rec->type), rec->identity );
+	for( int i=0; i<fieldc; i++ )
+		rec->identity = hash64( fieldv[i], strlen(fieldv[i])+1, rec->identity );
+
+	rec->next = records;
+	records = rec;
+
+}
+
+static const struct Spec_Record *lookup_record( spec_e kind, const char type[4] ) {
+
+	for( const struct Spec_Record *rec = records; rec; rec = rec->next )
+		if( kind == rec->kind && 0 == memcmp( rec->type, type, sizeof(rec->type) ) )
+			return rec;
+
+	return NULL;
+
+}
+
+uint64 importer_Res_spec( const char* path ) {
+
+	const char *ext = strrchr( path, '.' );
+	if( !ext )
+		return 0;
+
+	const struct Spec_Record *import = NULL;
+	for( const struct Spec_Record *rec = records; rec && !import; rec = rec->next )
+		if( specImport == rec->kind && 0 == strcmp( rec->ext, ext ) )
+			import = rec;
+
+	if( !import )
+		return 0;
+
+	// What is written depends on the type's writer, and on whether and how
+	// it is packed
+	const struct Spec_Record *type = lookup_record( specType, import->type );
+	const struct Spec_Record *map  = lookup_record( specMap,  import->type );
+
+	uint64 identity = import->identity;
+	identity = hash64( type ? &type->identity : &(uint64){0}, sizeof(uint64), identity );
+	identity = hash64( map  ? &map->identity  : &(uint64){0}, sizeof(uint64), identity );
+
+	return identity ? identity : 1;
+
+}
+
+static void addimport( const char type[4], const char* ext, const char* module, const char* entry, unsigned version ) {
 	dll_t dll = open_DLL( module );
 	void* func = maybe( dll, == NULL, lookup_DLL( dll, entry ) );
 
 	if( func ) {
-		debug("addimport: %.4s %s %s %s", type, ext, module, entry);
+		debug("addimport: %.4s %s %s %s %u", type, ext, module, entry, version);
 		register_Res_importer( type, ext+1, (import_Resource_f)func );
+		addrecord( specImport, type, ext, version, 3, (const char*[]){ ext, module, entry } );
 	} else {
 #if defined( feature_POSIX )
 		warning("addimport: failed to resolve %s(%s): %s", 
@@ -39,6 +114,7 @@ static void addtype( const char type[4], const char *module, const char *write,
 	if( readfunc && writefunc ) {
 		debug("addtype: %.4s %s %s %s", type, module, write, read);
 		register_Res_type( type, writefunc, readfunc );
+		addrecord( specType, type, NULL, 0, 3, (const char*[]){ module, write, read } );
 	} else {
 #if defined( feature_POSIX )
 		warning("addtype: failed to resolve %s(%s,%s): %s", 
@@ -51,6 +127,28 @@ static void addtype( const char type[4], const char *module, const char *write,
 
 }
 
+static void addmap( const char type[4], const char *module, const char *pack, const char *map ) {
+
+	dll_t dll = open_DLL( module );
+	void* packfunc = maybe( dll, == NULL, lookup_DLL( dll, pack ) );
+	void* mapfunc = maybe( dll, == NULL, lookup_DLL( dll, map ) );
+
+	if( packfunc && mapfunc ) {
+		debug("addmap: %.4s %s %s %s", type, module, pack, map);
+		register_Res_map( type, packfunc, mapfunc );
+		addrecord( specMap, type, NULL, resMapVersion, 3, (const char*[]){ module, pack, map } );
+	} else {
+#if defined( feature_POSIX )
+		warning("addmap: failed to resolve %s(%s,%s): %s", 
+		        module, pack, map, dlerror());
+#else
+		warning("addmap: failed to resolve %s(%s,%s)", 
+		        module, pack, map);
+#endif
+	}
+
+}
+
 int load_Res_spec( const char* spec ) {
 
 	FILE* fp = fopen( spec, "r" );
@@ -76,7 +174,7 @@ int load_Res_spec( const char* spec ) {
 	parse_p P = new_buf_PARSE( length, buf );
 	while( !parseof(P) && parsok(P) ) {
 
-		const char *optv[] = { "import", "type" };
+		const char *optv[] = { "import", "type", "map" };
 		int optc = sizeof(optv) / sizeof(optv[0]);
 		int recordtype;
 
@@ -100,14 +198,22 @@ int load_Res_spec( const char* spec ) {
 			char *ext;
 			char *module;
 			char *entry;
+			unsigned version = 0;
 			
 			P = string( skipws(P), isspace, &type );
 			P = string( skipws(P), isspace, &ext );
 			P = string( skipws(P), isspace, &module );
-			P = matchc( string( skipws(P), isspace, &entry ), '\n' );
+			P = string( skipws(P), isspace, &entry );
+
+			// An optional version, bumped when the importer's output changes
+			while( trymatchc( P, ' ' ) || trymatchc( P, '\t' ) );
+			if( parsok(P) && '\n' != peek(P) )
+				P = uinteger( P, &version );
+
+			P = matchc( P, '\n' );
 		
 			if( parsok(P) )
-				addimport( type, ext, module, entry );
+				addimport( type, ext, module, entry, version );
 			else
 				P = parsync( P, '\n', NULL );
 
@@ -142,6 +248,30 @@ int load_Res_spec( const char* spec ) {
 
 			break;
 		}
+		case 2: {
+
+			char *type;
+			char *module;
+			char *pack;
+			char *map;
+			
+			P = string( skipws(P), isspace, &type );
+			P = string( skipws(P), isspace, &module );
+			P = string( skipws(P), isspace, &pack );
+			P = matchc( string( skipws(P), isspace, &map ), '\n' );
+		
+			if( parsok(P) )
+				addmap( type, module, pack, map );
+			else
+				P = parsync( P, '\n', NULL );
+
+			if( type )   free( type );
+			if( module ) free( module );
+			if( pack )   free( pack );
+			if( map )    free( map );
+
+			break;
+		}
 			
 		default:
 			fatal("unhandled record type: %d", recordtype);
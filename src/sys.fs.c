@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <string.h>
 
 #include "sys.fs.h"
@@ -32,19 +33,22 @@ int Fs_mkdirs( const char *path ) {
 			: mkdir( workpath );
 #endif
 
-		if( ret < 0 )
+		// Someone else may have made it since we looked
+		if( ret < 0 && EEXIST != errno )
 			return ret;
 
 		*sep = fileSeparator;
 
 	}
 	
-	if( !Fs_exists(workpath) )
+	if( !Fs_exists(workpath) ) {
 #if defined( feature_POSIX )
-		return mkdir( workpath, S_IRUSR|S_IWUSR|S_IXUSR|S_IRGRP|S_IWGRP|S_IXGRP|S_IROTH|S_IXOTH );
+		int ret = mkdir( workpath, S_IRUSR|S_IWUSR|S_IXUSR|S_IRGRP|S_IWGRP|S_IXGRP|S_IROTH|S_IXOTH );
 #elif defined( feature_MINGW )
-		return mkdir( workpath );
+		int ret = mkdir( workpath );
 #endif
+		return ( ret < 0 && EEXIST != errno ) ? ret : 0;
+	}
 
 	return 0;
 
@@ -57,3 +61,91 @@ bool Fs_exists( const char *path ) {
 }
 
 #endif
+
+#ifdef __sys_fs_TEST__
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sync.thread.h"
+
+#define n_racers 8
+#define n_rounds 2000
+
+static const char*  base;
+static volatile int started;
+
+static int racer( void* arg ) {
+
+	char path[ strlen(base) + 32 ];
+	sprintf( path, "%s/r/s/t/u/v/w/x/y", base );
+
+	__sync_fetch_and_add( &started, 1 );
+	while( started < n_racers )
+		yield_THREAD();
+
+	*(int*)arg = Fs_mkdirs( path );
+	return 0;
+
+}
+
+static void remove_tree( const char* root, const char* dirs[], int n ) {
+
+	char path[ strlen(base) + 32 ];
+	for( int i=n-1; i>=0; i-- ) {
+		sprintf( path, "%s/%s/%s", base, root, dirs[i] );
+		rmdir( path );
+	}
+	sprintf( path, "%s/%s", base, root );
+	rmdir( path );
+
+}
+
+int main( int argc, char* argv[] ) {
+
+	char tmpl[] = "/tmp/sys.fs.XXXXXX";
+	base = mkdtemp( tmpl );
+	assert( base );
+
+	char path[ strlen(base) + 32 ];
+
+	// Every missing level is made, and making them again is not an error
+	sprintf( path, "%s/a/b/c", base );
+	assert( 0 == Fs_mkdirs( path ) && Fs_exists( path ) );
+	assert( 0 == Fs_mkdirs( path ) );
+
+	sprintf( path, "%s/a/b", base );
+	assert( 0 == Fs_mkdirs( path ) );
+
+	// Whoever loses the race to make a level still succeeds
+	const char* race[] = { "s", "s/t", "s/t/u", "s/t/u/v", "s/t/u/v/w", "s/t/u/v/w/x", "s/t/u/v/w/x/y" };
+	for( int round=0; round<n_rounds; round++ ) {
+
+		thread_t threads[ n_racers ];
+		int      rets[ n_racers ];
+
+		started = 0;
+		for( int i=0; i<n_racers; i++ )
+			create_THREAD( &threads[i], racer, &rets[i] );
+		for( int i=0; i<n_racers; i++ ) {
+			join_THREAD( &threads[i], NULL );
+			assert( 0 == rets[i] );
+		}
+
+		sprintf( path, "%s/r/s/t/u/v/w/x/y", base );
+		assert( Fs_exists( path ) );
+		remove_tree( "r", race, 7 );
+
+	}
+
+	const char* made[] = { "b", "b/c" };
+	remove_tree( "a", made, 2 );
+	assert( 0 == rmdir( base ) );
+
+	printf("Ok\n");
+	return 0;
+
+}
+
+#endif